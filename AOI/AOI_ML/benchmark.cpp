@@ -0,0 +1,494 @@
+// Benchmark das etapas do AOI_ML
+//
+// Mede o pre-processamento, a extracao de caracteristicas e a predicao da SVM
+// com as imagens do dataset, com a imagem de teste ampliada e com cenas
+// sinteticas de milhares de pecas, e grava pixels/s e objetos/s em JSON para
+// comparar otimizacoes.
+
+// Arquivos de include do C++
+#include <iostream>
+#include <string>
+#include <sstream>
+#include <cstdio>
+#include <algorithm>
+
+// Arquivos de include do OpenCV
+#include <opencv2/core.hpp>
+#include <opencv2/imgproc.hpp>
+#include <opencv2/imgcodecs.hpp>
+#include <opencv2/ml.hpp>
+#include <opencv2/core/utility.hpp>
+
+using namespace cv;
+using namespace cv::ml;
+using namespace std;
+
+// Utilitarios comuns ao AOI_PDI e ao AOI_ML (AOI/common)
+#include "PadraoLuz.h"
+#include "ImagemPGM.h"
+#include "MascaraRLE.h"
+#include "GeradorCenas.h"
+#include "Benchmark.h"
+
+#include "utils/Dataset.h"
+#include "utils/CorpusEmpacotado.h"
+#include "utils/ModeloSVM.h"
+#include "utils/InferenciaSVM.h"
+#include "utils/Classificacao.h"
+#include "utils/SegmentacaoMultiescala.h"
+#include "utils/ServidorInspecao.h"
+
+const char *chavesB =
+    {
+        "{help h uso ? |   | Imprime essa mensagem}"
+        "{data         | ../x64/Debug/data | Diretorio do dataset (nut, ring, screw, test.pgm e pattern.pgm)}"
+        "{model        | modelo_svm.yml | Modelo SVM gravado pelo main; sem ele a SVM e treinada com o dataset inteiro}"
+        "{scales       | 2,4 | Fatores de ampliacao da imagem de teste para os tamanhos sinteticos}"
+        "{synthetic    | 4096x4096@120,5472x3648@100 | Cenas do GeradorCenas, LxA@pecas por MP separadas por virgula; vazio nao gera}"
+        "{minTime      | 0.5 | Tempo minimo em segundos de cada medida}"
+        "{json         | benchmark_ml.json | Arquivo JSON com as medidas}"};
+
+struct EntradaBenchmark
+{
+    String nome;
+    Mat img;
+    PadraoLuz padrao;
+    int pecas_geradas; // cenas sinteticas: numero real de pecas; -1 nas outras
+
+    EntradaBenchmark() : pecas_geradas(-1) {}
+};
+
+static vector<double> leFatores(const String &texto)
+{
+    vector<double> fatores;
+    stringstream ss(texto);
+    String item;
+    while (getline(ss, item, ','))
+    {
+        double fator = atof(item.c_str());
+        if (fator > 0)
+            fatores.push_back(fator);
+    }
+    return fatores;
+}
+
+// SVM so para medir a predicao: todas as imagens do dataset, sem separar teste, normalizadas como no main
+static Ptr<SVM> treinaSVM(const String &pasta, const PadraoLuz &padrao, MetadadosModelo &meta)
+{
+    const char *sequencias[] = {"/nut/tuerca_%04d.pgm", "/ring/arandela_%04d.pgm", "/screw/tornillo_%04d.pgm"};
+
+    Mat dados, respostas;
+    for (int rotulo = 0; rotulo < 3; rotulo++)
+    {
+        vector<CaracteristicasQuadro> quadros = processaSequencia(listaSequencia(pasta + sequencias[rotulo]), [&](const Mat &quadro, int) {
+            if (!padrao.compativel(quadro.size()))
+                return CaracteristicasQuadro();
+            return ExtraiCaracteristicas(preProcessaImagem(quadro, padrao));
+        });
+        for (size_t q = 0; q < quadros.size(); q++)
+        {
+            if (quadros[q].rows == 0)
+                continue;
+            dados.push_back(quadros[q]);
+            respostas.push_back(Mat(quadros[q].rows, 1, CV_32SC1, Scalar(rotulo)));
+        }
+    }
+    if (dados.empty())
+        return Ptr<SVM>();
+
+    calculaNormalizacao(dados, meta);
+    Mat normalizados;
+    aplicaNormalizacao(dados, meta.minimo, meta.maximo, normalizados);
+    Ptr<SVM> svm = criaSVM();
+    svm->train(normalizados, ROW_SAMPLE, respostas);
+    return svm;
+}
+
+static int contaObjetos(const vector<CaracteristicasQuadro> &quadros)
+{
+    int total = 0;
+    for (size_t q = 0; q < quadros.size(); q++)
+        total += quadros[q].rows;
+    return total;
+}
+
+static bool mesmasCaracteristicas(const vector<CaracteristicasQuadro> &a, const vector<CaracteristicasQuadro> &b)
+{
+    if (a.size() != b.size())
+        return false;
+    for (size_t q = 0; q < a.size(); q++)
+    {
+        if (a[q].rows != b[q].rows)
+            return false;
+        if (a[q].rows > 0 && countNonZero(a[q] != b[q]) > 0)
+            return false;
+    }
+    return true;
+}
+
+// Linhas de uma matriz de caracteristicas em ordem lexicografica, para comparar objetos achados em outra ordem
+static vector<vector<float>> linhasOrdenadas(const Mat &caracteristicas)
+{
+    vector<vector<float>> linhas;
+    for (int i = 0; i < caracteristicas.rows; i++)
+        linhas.push_back(vector<float>(caracteristicas.ptr<float>(i), caracteristicas.ptr<float>(i) + caracteristicas.cols));
+    sort(linhas.begin(), linhas.end());
+    return linhas;
+}
+
+// Ingestao do dataset inteiro: as sequencias de PGMs contra o corpus empacotado, com e sem mascaras
+static void medeIngestao(Benchmark &bench, const String &pasta, const PadraoLuz &padrao)
+{
+    const char *sequencias[] = {"/nut/tuerca_%04d.pgm", "/ring/arandela_%04d.pgm", "/screw/tornillo_%04d.pgm"};
+    String arq_corpus = "benchmark_corpus.aoic";
+
+    vector<String> arquivos;
+    GravadorCorpus gravador;
+    if (!gravador.abre(arq_corpus, "benchmark"))
+    {
+        cout << "Erro ao criar " << arq_corpus << ", ingestao nao sera medida" << endl;
+        return;
+    }
+    Size tamanho;
+    for (int rotulo = 0; rotulo < 3; rotulo++)
+    {
+        vector<String> sequencia = listaSequencia(pasta + sequencias[rotulo]);
+        for (size_t i = 0; i < sequencia.size(); i++)
+        {
+            Mat img = leImagemCinza(sequencia[i]);
+            if (img.empty() || !padrao.compativel(img.size()))
+                continue;
+            gravador.adiciona(img, rotulo, false, preProcessaImagem(img, padrao));
+            arquivos.push_back(sequencia[i]);
+            tamanho = Size(img.cols, img.rows * (int)arquivos.size());
+        }
+    }
+    if (!gravador.fecha("") || arquivos.empty())
+    {
+        remove(arq_corpus.c_str());
+        return;
+    }
+
+    vector<CaracteristicasQuadro> por_arquivo, por_corpus, por_mascara;
+    bench.mede("ingestao (sequencias PGM)", "dataset", tamanho, [&]() {
+        por_arquivo = processaSequencia(arquivos, [&](const Mat &quadro, int) {
+            return ExtraiCaracteristicas(preProcessaImagem(quadro, padrao));
+        });
+        return contaObjetos(por_arquivo);
+    });
+    bench.mede("ingestao (corpus)", "dataset", tamanho, [&]() {
+        CorpusEmpacotado corpus;
+        corpus.abre(arq_corpus);
+        por_corpus = processaCorpus(corpus, [&](int indice) {
+            return ExtraiCaracteristicas(preProcessaImagem(corpus.quadro(indice), padrao));
+        });
+        return contaObjetos(por_corpus);
+    });
+    bench.mede("ingestao (corpus com mascaras)", "dataset", tamanho, [&]() {
+        CorpusEmpacotado corpus;
+        corpus.abre(arq_corpus);
+        por_mascara = processaCorpus(corpus, [&](int indice) {
+            return ExtraiCaracteristicas(corpus.mascara(indice));
+        });
+        return contaObjetos(por_mascara);
+    });
+    if (!mesmasCaracteristicas(por_corpus, por_arquivo) || !mesmasCaracteristicas(por_mascara, por_arquivo))
+        cout << "ERRO: caracteristicas lidas do corpus diferem das lidas das sequencias" << endl;
+
+    remove(arq_corpus.c_str());
+}
+
+static void medeEntrada(Benchmark &bench, const EntradaBenchmark &entrada, const Ptr<SVM> &svm, const MetadadosModelo &meta)
+{
+    const Mat &img = entrada.img;
+    const PadraoLuz &padrao = entrada.padrao;
+    Size tamanho = img.size();
+
+    // Saidas de cada etapa, usadas como entrada da seguinte
+    Mat sem_ruido = removeRuido(img);
+    Mat sem_fundo = removeFundo(sem_ruido, padrao);
+    Mat pre = thresholding(sem_fundo);
+    Mat caracteristicas = ExtraiCaracteristicas(pre);
+    int num_objetos = caracteristicas.rows;
+    if (entrada.pecas_geradas >= 0)
+        cout << "Cena sintetica " << entrada.nome << ": " << entrada.pecas_geradas << " pecas geradas, "
+             << num_objetos << " objetos encontrados" << endl;
+
+    bench.mede("removeRuido (medianBlur 3)", entrada.nome, tamanho, [&]() {
+        removeRuido(img);
+        return 0;
+    });
+    bench.mede("removeFundo (divisao)", entrada.nome, tamanho, [&]() {
+        removeFundo(sem_ruido, padrao);
+        return 0;
+    });
+    bench.mede("thresholding", entrada.nome, tamanho, [&]() {
+        thresholding(sem_fundo);
+        return 0;
+    });
+    bench.mede("thresholding Otsu", entrada.nome, tamanho, [&]() {
+        thresholding(sem_fundo, LIMIAR_OTSU);
+        return 0;
+    });
+    bench.mede("preProcessaImagem", entrada.nome, tamanho, [&]() {
+        preProcessaImagem(img, padrao);
+        return 0;
+    });
+    bench.mede("preProcessaImagem fundido", entrada.nome, tamanho, [&]() {
+        preProcessaImagem(img, padrao, LIMIAR_FIXO, 90, true);
+        return 0;
+    });
+
+    // O caminho fundido deve ser identico bit a bit as etapas separadas
+    int pixels_diferentes = countNonZero(preProcessaImagem(img, padrao, LIMIAR_FIXO, 90, true) != pre);
+    if (pixels_diferentes > 0)
+        cout << "ERRO: pre-processamento fundido difere em " << pixels_diferentes << " pixels de " << entrada.nome << endl;
+    bench.mede("binarizaRLE + rotulaRLE", entrada.nome, tamanho, [&]() {
+        MascaraRLE mascara;
+        vector<int> rotulos;
+        vector<ComponenteRLE> componentes;
+        binarizaRLE(sem_fundo, LIMIAR_BINARIZACAO, THRESH_BINARY, mascara);
+        return rotulaRLE(mascara, rotulos, componentes) - 1;
+    });
+    bench.mede("ExtraiCaracteristicas", entrada.nome, tamanho, [&]() {
+        return ExtraiCaracteristicas(pre).rows;
+    });
+    // Mesma matriz a cada quadro, como no stream: sem alocacao depois do primeiro
+    Mat reaproveitada;
+    bench.mede("ExtraiCaracteristicas (matriz reaproveitada)", entrada.nome, tamanho, [&]() {
+        return ExtraiCaracteristicas(pre, reaproveitada);
+    });
+    bench.mede("preProcessaImagem + ExtraiCaracteristicas", entrada.nome, tamanho, [&]() {
+        return ExtraiCaracteristicas(preProcessaImagem(img, padrao)).rows;
+    });
+
+    // Do grosseiro ao fino: mesmos objetos do quadro inteiro, em outra ordem
+    SegmentacaoMultiescala multiescala;
+    multiescala.define(padrao, 4);
+    Mat por_regiao;
+    bench.mede("multiescala (blocos 4x4)", entrada.nome, tamanho, [&]() {
+        return multiescala.extrai(img, por_regiao);
+    });
+    vector<vector<float>> esperadas = linhasOrdenadas(caracteristicas), multiescala_obtidas = linhasOrdenadas(por_regiao);
+    if (multiescala_obtidas != esperadas)
+        cout << "ERRO: multiescala encontrou " << multiescala_obtidas.size() << " objetos diferentes dos " << esperadas.size()
+             << " do quadro inteiro em " << entrada.nome << endl;
+
+    if (svm.empty() || num_objetos == 0)
+        return;
+
+    // SVM::predict recebe as amostras ja normalizadas; a InferenciaSVM normaliza por conta propria
+    Mat normalizadas;
+    aplicaNormalizacao(caracteristicas, meta.minimo, meta.maximo, normalizadas);
+    bench.mede("aplicaNormalizacao", entrada.nome, tamanho, [&]() {
+        Mat saida;
+        aplicaNormalizacao(caracteristicas, meta.minimo, meta.maximo, saida);
+        return num_objetos;
+    });
+
+    // Uma predicao por objeto, como no main, e todas as amostras de uma vez
+    bench.mede("SVM predict (por objeto)", entrada.nome, tamanho, [&]() {
+        for (int i = 0; i < num_objetos; i++)
+            svm->predict(normalizadas.row(i));
+        return num_objetos;
+    });
+    bench.mede("SVM predict (lote)", entrada.nome, tamanho, [&]() {
+        Mat resultados;
+        svm->predict(normalizadas, resultados);
+        return num_objetos;
+    });
+
+    // A matriz de caracteristicas ja e o lote da InferenciaSVM
+    const Mat &amostras = caracteristicas;
+    InferenciaSVM inferencia;
+    inferencia.compila(svm, meta.minimo, meta.maximo);
+    bench.mede("InferenciaSVM (lote)", entrada.nome, tamanho, [&]() {
+        Mat resultados;
+        inferencia.prediz(amostras, resultados);
+        return num_objetos;
+    });
+
+    // Lote grande com as amostras repetidas, para medir as threads e conferir o resultado
+    Mat amostras_repetidas = repeat(amostras, (4096 + num_objetos - 1) / num_objetos, 1);
+    Mat normalizadas_repetidas = repeat(normalizadas, (4096 + num_objetos - 1) / num_objetos, 1);
+    bench.mede("SVM predict (4096+ amostras)", entrada.nome, tamanho, [&]() {
+        Mat resultados;
+        svm->predict(normalizadas_repetidas, resultados);
+        return normalizadas_repetidas.rows;
+    });
+    bench.mede("InferenciaSVM (4096+ amostras, threads)", entrada.nome, tamanho, [&]() {
+        Mat resultados;
+        inferencia.prediz(amostras_repetidas, resultados, 0);
+        return amostras_repetidas.rows;
+    });
+
+    Mat esperado, obtido;
+    svm->predict(normalizadas_repetidas, esperado);
+    inferencia.prediz(amostras_repetidas, obtido, 0);
+    int diferentes = countNonZero(esperado != obtido);
+    if (diferentes > 0)
+        cout << "ERRO: InferenciaSVM difere de SVM::predict em " << diferentes << " amostras de " << entrada.nome << endl;
+
+    Mat lote, resultados_lote;
+    bench.mede("classificacao completa", entrada.nome, tamanho, [&]() {
+        int n = ExtraiCaracteristicas(preProcessaImagem(img, padrao), lote);
+        inferencia.prediz(lote, resultados_lote);
+        return n;
+    });
+
+    // A mesma classificacao atras do socket do daemon: a diferenca e o custo da ida e volta
+    ServidorInspecao servidor;
+    ProcessaInspecao processa = [&](const Mat &quadro, vector<ObjetoInspecionado> &objetos, int &versao) {
+        Mat caracteristicas, classes;
+        vector<Point> posicoes;
+        ExtraiCaracteristicas(preProcessaImagem(quadro, padrao), caracteristicas, &posicoes);
+        inferencia.prediz(caracteristicas, classes);
+        for (int i = 0; i < caracteristicas.rows; i++)
+        {
+            ObjetoInspecionado objeto = {(int32_t)classes.at<float>(i), (float)posicoes[i].x, (float)posicoes[i].y,
+                                         caracteristicas.at<float>(i, CARAC_AREA), caracteristicas.at<float>(i, CARAC_PROPORCAO)};
+            objetos.push_back(objeto);
+        }
+        versao = 1;
+        return (int)RESPOSTA_OK;
+    };
+    if (!servidor.inicia("benchmark_aoi.sock", processa, [](int &) { return false; }, 1))
+        return;
+    thread aceitacao([&]() { servidor.executa(); });
+    ClienteInspecao cliente;
+    if (cliente.conecta("benchmark_aoi.sock"))
+    {
+        vector<ObjetoInspecionado> objetos;
+        bench.mede("classificacao pelo daemon (socket Unix)", entrada.nome, tamanho, [&]() {
+            cliente.inspeciona(img, objetos);
+            return (int)objetos.size();
+        });
+        if ((int)objetos.size() != num_objetos)
+            cout << "ERRO: daemon devolveu " << objetos.size() << " objetos em vez de " << num_objetos << " em " << entrada.nome << endl;
+        cliente.fecha();
+    }
+    servidor.solicitaParada();
+    aceitacao.join();
+}
+
+int main(int argc, const char **argv)
+{
+    CommandLineParser parser(argc, argv, chavesB);
+
+    if (parser.has("help"))
+    {
+        parser.printMessage();
+        return 0;
+    }
+
+    String pasta = parser.get<String>("data");
+    String arq_modelo = parser.get<String>("model");
+    vector<double> fatores = leFatores(parser.get<String>("scales"));
+    String cenas = parser.get<String>("synthetic");
+    double tempo_minimo = parser.get<double>("minTime");
+    String arq_json = parser.get<String>("json");
+
+    if (!parser.check())
+    {
+        parser.printErrors();
+        return 0;
+    }
+
+    // Mesmo padrao do main: mediana 3, sem gravar cache
+    PadraoLuz padrao;
+    if (!padrao.carrega(pasta + "/pattern.pgm", TAMANHO_MEDIANA, false))
+    {
+        cout << "Erro ao carregar " << pasta << "/pattern.pgm" << endl;
+        return 1;
+    }
+
+    MetadadosModelo meta;
+    Ptr<SVM> svm = carregaModelo(arq_modelo, meta);
+    if (svm.empty())
+    {
+        cout << "Modelo " << arq_modelo << " nao encontrado, treinando com o dataset" << endl;
+        svm = treinaSVM(pasta, padrao, meta);
+    }
+    if (svm.empty())
+        cout << "SVM nao treinada, predicao nao sera medida" << endl;
+
+    const char *imagens[][2] = {
+        {"nut", "nut/tuerca_0000.pgm"},
+        {"ring", "ring/arandela_0000.pgm"},
+        {"screw", "screw/tornillo_0000.pgm"},
+        {"test", "test.pgm"}};
+
+    vector<EntradaBenchmark> entradas;
+    for (int i = 0; i < 4; i++)
+    {
+        EntradaBenchmark entrada;
+        entrada.nome = imagens[i][0];
+        entrada.img = imread(pasta + "/" + imagens[i][1], IMREAD_GRAYSCALE);
+        if (entrada.img.empty() || !padrao.compativel(entrada.img.size()))
+        {
+            cout << "Imagem " << imagens[i][1] << " ignorada (ilegivel ou de tamanho diferente do padrao)" << endl;
+            continue;
+        }
+        entrada.padrao = padrao;
+        entradas.push_back(entrada);
+    }
+    if (entradas.empty())
+        return 1;
+
+    // Tamanhos sinteticos: a ultima entrada (test) e o padrao ampliados
+    EntradaBenchmark base = entradas.back();
+    for (size_t i = 0; i < fatores.size(); i++)
+    {
+        EntradaBenchmark entrada;
+        entrada.nome = base.nome + format("_x%g", fatores[i]);
+        resize(base.img, entrada.img, Size(), fatores[i], fatores[i], INTER_LINEAR);
+        Mat padrao_ampliado;
+        resize(padrao.padrao(), padrao_ampliado, entrada.img.size(), 0, 0, INTER_LINEAR);
+        entrada.padrao.define(padrao_ampliado, 1);
+        entradas.push_back(entrada);
+    }
+
+    // Cenas sinteticas com o padrao do proprio gerador e pecas do tamanho das do dataset
+    stringstream ss(cenas);
+    String cena;
+    while (getline(ss, cena, ','))
+    {
+        ParametrosCena parametros;
+        if (sscanf(cena.c_str(), "%dx%d@%lf", &parametros.tamanho.width, &parametros.tamanho.height, &parametros.densidade) != 3)
+        {
+            cout << "Cena sintetica " << cena << " ignorada (use LxA@densidade)" << endl;
+            continue;
+        }
+        GeradorCenas gerador;
+        if (!gerador.define(parametros))
+            continue;
+
+        EntradaBenchmark entrada;
+        entrada.nome = "sintetico_" + cena;
+        vector<ObjetoGerado> objetos;
+        gerador.gera(0, entrada.img, &objetos);
+        entrada.padrao.define(gerador.padrao(), 1);
+        entrada.pecas_geradas = (int)objetos.size();
+        entradas.push_back(entrada);
+    }
+
+    Benchmark bench(tempo_minimo);
+    for (size_t i = 0; i < entradas.size(); i++)
+    {
+        cout << "Medindo " << entradas[i].nome << " (" << entradas[i].img.cols << "x" << entradas[i].img.rows << ")" << endl;
+        medeEntrada(bench, entradas[i], svm, meta);
+    }
+
+    cout << "Medindo a ingestao do dataset" << endl;
+    medeIngestao(bench, pasta, padrao);
+
+    bench.imprime();
+    if (!bench.gravaJson(arq_json, "AOI_ML"))
+    {
+        cout << "Erro ao gravar " << arq_json << endl;
+        return 1;
+    }
+    cout << "Medidas gravadas em " << arq_json << endl;
+
+    return 0;
+}
@@ -10,6 +10,9 @@
 #include <string>
 #include <sstream>
 #include <cmath>
+#include <algorithm>
+#include <memory>
+#include <csignal>
 
 // Arquivos de include do OpenCV
 #include <opencv2/core.hpp>
@@ -23,12 +26,65 @@ using namespace cv;
 using namespace cv::ml;
 using namespace std;
 
-#include "utils/MultipleImageWindow.h"
+// Utilitarios comuns ao AOI_PDI e ao AOI_ML (AOI/common)
+#include "MultipleImageWindow.h"
+#include "PadraoLuz.h"
+#include "ImagemPGM.h"
+#include "PipelineStream.h"
+#include "Instrumentacao.h"
+
+#include "utils/Dataset.h"
+#include "utils/CorpusEmpacotado.h"
+#include "utils/ModeloSVM.h"
+#include "utils/InferenciaSVM.h"
+#include "utils/Classificacao.h"
+#include "utils/SegmentacaoMultiescala.h"
+#include "utils/ClassificadorOnline.h"
+#include "utils/BuscaParametros.h"
+#include "utils/ServidorInspecao.h"
 MultipleImageWindow *miw;
 
-Mat padrao_fundo, objeto;
+// Com -headless as janelas viram mosaicos fora da tela, gravados em -mosaic
+MultipleImageWindow::Backend backend_janela = MultipleImageWindow::BACKEND_HIGHGUI;
+String arq_mosaico;
+
+// Limiar de binarizacao do treinamento e da classificacao: fixo ou escolhido pelo histograma de cada quadro
+int metodo_limiar = LIMIAR_FIXO;
+double percentil_limiar = 90;
+
+// Com -fused mediana, fundo e limiar sao feitos numa unica passada por faixas, com o mesmo resultado
+bool pre_fundido = false;
+
+// Com -corpus o treinamento le um unico arquivo empacotado no lugar das sequencias de imagens
+String arq_corpus;
+CorpusEmpacotado corpus_treino;
+bool usa_mascaras_corpus = false;
+
+// Com -coarse o stream procura as pecas numa escala reduzida e so processa em volta delas
+int fator_grosseiro = 0;
+SegmentacaoMultiescala multiescala;
+
+// Com -online o stream aceita exemplos rotulados pelo operador sem retreinar a SVM
+bool modo_online = false;
+ClassificadorOnline classificador_online;
+
+// Com -daemon o padrao de fundo, o modelo e as threads ficam residentes; cada recarga monta um estado novo
+struct EstadoDaemon
+{
+    PadraoLuz padrao;
+    SegmentacaoMultiescala multiescala;
+    InferenciaSVM inferencia;
+    int versao;
+};
+shared_ptr<const EstadoDaemon> estado_daemon;
+ServidorInspecao *servidor_daemon = NULL;
+
+PadraoLuz padrao_fundo;
+Mat objeto;
 
 Ptr<SVM> svm;
+MetadadosModelo meta_svm;
+InferenciaSVM inferencia_svm;
 Scalar azul(255, 0, 0), verde(0, 255, 0), vermelho(0, 0, 255);
 
 // Funes do OpenCV para parsing de argumentos em linha de comando
@@ -36,7 +92,68 @@ Scalar azul(255, 0, 0), verde(0, 255, 0), vermelho(0, 0, 255);
 const char *chavesS =
     {
         "{help h uso ? | | Imprime essa mensagem}"
-        "{@image       | | Imagem a classificar}"};
+        "{@image       | | Imagem a classificar}"
+        "{lightCache   | 1 | Le/grava o padrao de luz ja suavizado em um cache binario ao lado do arquivo (.plc)}"
+        "{model        | modelo_svm.yml | Modelo SVM treinado, com a faixa das caracteristicas e a impressao digital do dataset}"
+        "{train        |   | Apenas treina, grava o modelo em -model e sai sem abrir janela}"
+        "{retrain      |   | Retreina o modelo mesmo que o arquivo gravado ainda seja valido}"
+        "{stream       |   | Classifica continuamente @image como camera (indice 0, 1, ...), arquivo de video ou cenas sinteticas (sintetico:pattern=...,density=N,...)}"
+        "{queueSize    | 4 | Quadros em cada fila entre os estagios do stream}"
+        "{dropFrames   | 1 | Com a fila cheia: 1 descarta o quadro novo, 0 espera o estagio seguinte (backpressure)}"
+        "{playFps      | 0 | Ritmo de leitura de arquivos no stream: 0 usa o FPS do arquivo, -1 o mais rapido possivel}"
+        "{thrMethod    | 0 | Limiar: 0 fixo (30), 1 Otsu, 2 triangulo, 3 percentil, escolhido a cada quadro; muda o modelo}"
+        "{thrPercentile | 90 | Com thrMethod=3, porcentagem de pixels de fundo}"
+        "{fused        |   | Mediana, fundo e limiar numa unica passada por faixas, mesmo resultado; so com limiar fixo}"
+        "{coarse       | 0 | Stream do grosseiro ao fino: busca as pecas em blocos de NxN (N >= 2) e so processa em volta delas; 0 desliga}"
+        "{online       |   | Stream aprende com o operador: teclas 1 porca, 2 arruela, 3 parafuso rotulam os objetos do quadro}"
+        "{retrainEvery | 50 | Com -online, exemplos novos que disparam o retreino da SVM em segundo plano; 0 nunca}"
+        "{daemon       |   | Fica residente atendendo quadros pelo socket Unix dado, ex. /tmp/aoi.sock; SIGHUP recarrega o modelo e o padrao}"
+        "{workers      | 0 | Com -daemon, conexoes atendidas em paralelo; 0 usa todos os nucleos}"
+        "{client       |   | Manda @image ao daemon no socket dado e imprime os objetos, sem carregar padrao nem modelo}"
+        "{requests     | 1 | Com -client, vezes que @image e mandada na mesma conexao; imprime a latencia de ida e volta}"
+        "{reload       |   | Com -client, pede ao daemon para reler o modelo gravado e o padrao de fundo}"
+        "{svm          |   | Hiper-parametros da SVM, ex. C_SVC,RBF,C=10,gamma=0.001,MAX_ITER=100; vazio usa os gravados no modelo}"
+        "{search       |   | Busca kernel, C e gamma por validacao cruzada, grava o vencedor em -model e sai}"
+        "{folds        | 5 | Com -search, numero de dobras da validacao cruzada}"
+        "{searchRandom | 0 | Com -search, sorteia N candidatos da grade; 0 avalia a grade inteira}"
+        "{pack         |   | Empacota as sequencias de treinamento num unico arquivo (ex. corpus.aoic) e sai}"
+        "{packMasks    |   | Com -pack, grava tambem a mascara pre-processada (limiar fixo) de cada quadro}"
+        "{corpus       |   | Corpus gravado por -pack, lido no treinamento no lugar das sequencias de imagens}"
+        "{headless     |   | Sem janelas nem highgui: o mosaico das imagens fica so na memoria ou e gravado em -mosaic}"
+        "{mosaic       |   | Grava o mosaico a cada atualizacao, ex. mosaico.png ou mosaico_%05d.png (um arquivo por quadro)}"
+        "{profile      |   | Mede o tempo de cada etapa e imprime p50/p95/p99 no fim}"
+        "{profileEvery | 0 | Com -profile, imprime tambem o relatorio a cada N segundos}"};
+
+// Sequencias de treinamento; o rotulo de cada classe e a sua posicao na lista
+const char *sequenciasTreinamento[] = {
+    "../x64/Debug/data/nut/tuerca_%04d.pgm",      // 0 Porca
+    "../x64/Debug/data/ring/arandela_%04d.pgm",   // 1 Arruela
+    "../x64/Debug/data/screw/tornillo_%04d.pgm"}; // 2 Parafuso
+const int NUM_CLASSES = 3;
+const int NUM_PARA_TESTE = 20;
+
+/**
+ * Tudo o que muda o modelo treinado alem das imagens; entra na impressao digital
+ *
+ * Montado das mesmas constantes que o treinamento usa: mudar qualquer uma
+ * delas, ou a lista de caracteristicas, invalida os modelos gravados.
+ * @param ParametrosSVM parametros - hiper-parametros, via descreveParametrosSVM()
+ */
+String parametrosTreinamento(const ParametrosSVM &parametros)
+{
+    const vector<String> &nomes = nomesCaracteristicas();
+    String caracteristicas;
+    for (size_t i = 0; i < nomes.size(); i++)
+        caracteristicas += (i > 0 ? "," : "") + nomes[i];
+
+    return format("teste=%d;mediana=%d;limiar=%d;area_min=%d;svm=%s;caracteristicas=%s;normalizacao=minmax;contornos=externos", NUM_PARA_TESTE,
+                  TAMANHO_MEDIANA, LIMIAR_BINARIZACAO, AREA_MINIMA_OBJETO, descreveParametrosSVM(parametros).c_str(),
+                  caracteristicas.c_str());
+}
+
+// Hiper-parametros da SVM: os de -svm, senao os gravados com o modelo (ex. escolhidos por -search), senao os padrao
+ParametrosSVM parametros_svm;
+bool svm_definida = false;
 
 void plotaDadosTreinamento(Mat dadosTreinamento, Mat rotulos, float *erro = NULL)
 {
@@ -96,117 +213,98 @@ void plotaDadosTreinamento(Mat dadosTreinamento, Mat rotulos, float *erro = NULL
         putText(grafico, ss.str().c_str(), Point(20, 512 - 40), FONT_HERSHEY_SIMPLEX, 0.75, Scalar(200, 200, 200), 1, LINE_AA);
     }
 
-    miw->addImage("Grafico", grafico);
+    if (miw != NULL)
+        miw->addImage("Grafico", grafico);
     //  imshow("Grafico", grafico);
 }
 
 /**
- * Extrai as caractersticas de todos os objetos em uma imagem
- *
- * @param Mat img - imagem de entrada
- * @param vector<int> esquerda - sada das coordenadas da esquerda de cada objeto
- * @param vector<int> topo - sada das coordenadas superiores de cada objeto
- * @return vector< vector<float> >  - matriz de linhas das caratersticas de cada objeto detectado
- **/
-vector<vector<float>> ExtraiCaracteristicas(Mat img, vector<int> *esquerda = NULL, vector<int> *topo = NULL)
+ * Nome e cor de exibicao de uma classe prevista pela SVM
+ * @param float classe - rotulo previsto
+ * @param Scalar cor - saida da cor usada para desenhar a classe
+ * @return String nome da classe, vazio para um rotulo desconhecido
+ */
+String nomeClasse(float classe, Scalar &cor)
 {
-    vector<vector<float>> resultado;
-    vector<vector<Point>> contornos;
-    Mat entrada = img.clone();
-
-    vector<Vec4i> hierarquia;
-    findContours(entrada, contornos, hierarquia, RETR_CCOMP, CHAIN_APPROX_SIMPLE);
-
-    // Verifica o nmero de objetos detectados
-    if (contornos.size() == 0)
+    if (classe == 0)
     {
-        return resultado;
+        cor = verde; // Porca
+        return "Porca";
     }
-
-    RNG rng(0xFFFFFFFF);
-    for (int i = 0; i < contornos.size(); i++)
+    else if (classe == 1)
     {
-        Mat mascara = Mat::zeros(img.rows, img.cols, CV_8UC1);
-        drawContours(mascara, contornos, i, Scalar(1), FILLED, LINE_8, hierarquia, 1);
-        Scalar area_s = sum(mascara);
-        float area = area_s[0];
-
-        if (area > 500)
-        { // Se a rea  maior do que a mnima
-            RotatedRect r = minAreaRect(contornos[i]);
-            float comprimento = r.size.width;
-            float altura = r.size.height;
-            float proporcao = (comprimento < altura) ? altura / comprimento : comprimento / altura;
-
-            vector<float> elemento;
-            elemento.push_back(area);
-            elemento.push_back(proporcao);
-            resultado.push_back(elemento);
-
-            if (esquerda != NULL)
-                esquerda->push_back((int)r.center.x);
-            if (topo != NULL)
-                topo->push_back((int)r.center.y);
-
-            objeto = mascara;
-        }
+        cor = azul; // Arruela
+        return "Arruela";
+    }
+    else if (classe == 2)
+    {
+        cor = vermelho; // Parafuso
+        return "Parafuso";
     }
 
-    return resultado;
-}
-
-/**
- * Remove th light and return new image without light
- * @param img Mat image to remove the light pattern
- * @param pattern Mat image with light pattern
- * @return a new image Mat without light
- */
-Mat removeFundo(Mat img, Mat padrao)
-{
-    Mat aux;
-
-    // Necessrio mudar imagem para float 32 bits para divisao
-    Mat img32, padrao32;
-    img.convertTo(img32, CV_32F);
-    padrao.convertTo(padrao32, CV_32F);
-
-    // Divide imagem pelo padrao
-    aux = 1 - (img32 / padrao32);
-
-    // Escalona cores para converter para 8 bits
-    aux *= 255;
-
-    // Converte para formato 8 bits
-    aux.convertTo(aux, CV_8U);
-
-    // equalizeHist( aux, aux );
-    // aux = padrao - img;
-
-    return aux;
+    cor = Scalar();
+    return "";
 }
 
 /**
- * Preprocess an input image to extract components and stats
- * @params Mat input image to preprocess
- * @return Mat binary image
+ * Acrescenta as linhas de cada quadro ao treino ou ao teste
+ *
+ * Conta as linhas antes e cresce cada matriz uma unica vez; depois cada
+ * quadro e copiado inteiro, ja no formato de linhas que a SVM recebe.
+ *
+ * @param vector<CaracteristicasQuadro> quadros - caracteristicas de cada quadro
+ * @param function rotulo - rotulo do quadro i
+ * @param function teste - se o quadro i vai para o teste
  */
-Mat preProcessaImagem(Mat entrada)
+void acrescentaQuadros(const vector<CaracteristicasQuadro> &quadros, function<int(int)> rotulo, function<bool(int)> teste,
+                       Mat &dadosTreinamento, Mat &dadosResposta, Mat &dadosTeste, Mat &dadosRespostasTestes)
 {
-    Mat resultado;
-
-    // Remove rudo
-    Mat img_sem_ruido, img_box_smooth;
-    medianBlur(entrada, img_sem_ruido, 3);
+    int num_treino = 0, num_teste = 0;
+    for (int i = 0; i < (int)quadros.size(); i++)
+    {
+        if (teste(i))
+            num_teste += quadros[i].rows;
+        else
+            num_treino += quadros[i].rows;
+    }
 
-    // Remove fundo
-    Mat img_sem_fundo;
-    img_sem_ruido.copyTo(img_sem_fundo);
-    img_sem_fundo = removeFundo(img_sem_ruido, padrao_fundo);
+    // Matrizes vazias ganham o tipo antes de crescer; resize preserva as linhas ja lidas
+    if (dadosTreinamento.empty())
+    {
+        dadosTreinamento.create(0, NUM_CARACTERISTICAS, CV_32FC1);
+        dadosResposta.create(0, 1, CV_32SC1);
+    }
+    if (dadosTeste.empty())
+    {
+        dadosTeste.create(0, NUM_CARACTERISTICAS, CV_32FC1);
+        dadosRespostasTestes.create(0, 1, CV_32FC1);
+    }
+    int linha_treino = dadosTreinamento.rows, linha_teste = dadosTeste.rows;
+    dadosTreinamento.resize(linha_treino + num_treino);
+    dadosResposta.resize(linha_treino + num_treino);
+    dadosTeste.resize(linha_teste + num_teste);
+    dadosRespostasTestes.resize(linha_teste + num_teste);
 
-    // Binariza imagem para segmentao
-    threshold(img_sem_fundo, resultado, 30, 255, THRESH_BINARY);
+    for (int i = 0; i < (int)quadros.size(); i++)
+    {
+        const Mat &caracteristicas = quadros[i];
+        int n = caracteristicas.rows;
+        if (n == 0)
+            continue;
 
-    return resultado;
+        if (!teste(i))
+        {
+            caracteristicas.copyTo(dadosTreinamento.rowRange(linha_treino, linha_treino + n));
+            dadosResposta.rowRange(linha_treino, linha_treino + n).setTo(Scalar(rotulo(i)));
+            linha_treino += n;
+        }
+        else
+        {
+            caracteristicas.copyTo(dadosTeste.rowRange(linha_teste, linha_teste + n));
+            dadosRespostasTestes.rowRange(linha_teste, linha_teste + n).setTo(Scalar((float)rotulo(i)));
+            linha_teste += n;
+        }
+    }
 }
 
 /**
@@ -221,102 +319,214 @@ Mat preProcessaImagem(Mat entrada)
  * @return true if can read the folder images, false in error case
  **/
 bool lePastaEExtraiCaracteristicas(string pasta, int rotulo, int num_para_teste,
-                                   vector<float> &dadosTreinamento, vector<int> &dadosResposta,
-                                   vector<float> &dadosTeste, vector<float> &dadosRespostasTestes)
+                                   Mat &dadosTreinamento, Mat &dadosResposta, Mat &dadosTeste, Mat &dadosRespostasTestes)
 {
-    VideoCapture imagens;
-
-    if (imagens.open(pasta) == false)
+    // Lista a sequencia inteira antes, assim o indice de cada imagem nao depende da ordem de processamento
+    vector<String> arquivos = listaSequencia(pasta);
+    if (arquivos.empty())
     {
         cout << "Erro ao abrir pasta de imagens" << endl;
         return false;
     }
 
-    Mat quadro;
-    int img_indice = 0;
-    while (imagens.read(quadro))
+    // Pre-processamento e extracao de caracteristicas em todos os nucleos, com leitura antecipada
+    vector<CaracteristicasQuadro> quadros = processaSequencia(arquivos, [&](const Mat &quadro_cinza, int img_indice) {
+        if (!padrao_fundo.compativel(quadro_cinza.size()))
+        {
+            cout << "Imagem " << img_indice << " de " << pasta << " com tamanho diferente do padrao de fundo, ignorada" << endl;
+            return CaracteristicasQuadro();
+        }
+        Mat pre = preProcessaImagem(quadro_cinza, padrao_fundo, metodo_limiar, percentil_limiar, pre_fundido);
+        return ExtraiCaracteristicas(pre);
+    });
+
+    // Junta na ordem da sequencia: as num_para_teste primeiras imagens vao para teste
+    acrescentaQuadros(
+        quadros, [&](int) { return rotulo; }, [&](int img_indice) { return img_indice < num_para_teste; },
+        dadosTreinamento, dadosResposta, dadosTeste, dadosRespostasTestes);
+    return true;
+}
+
+/**
+ * Extrai as caracteristicas de todos os quadros do corpus empacotado
+ *
+ * Os quadros estao na ordem das classes e das sequencias, e cada um ja traz
+ * o seu rotulo e se e de teste, entao os vetores saem iguais aos de
+ * lePastaEExtraiCaracteristicas com as sequencias que geraram o corpus.
+ * Com mascaras validas o pre-processamento e pulado.
+ *
+ * @param CorpusEmpacotado corpus - corpus aberto
+ * @param bool usa_mascaras - extrai direto das mascaras gravadas no corpus
+ */
+void leCorpusEExtraiCaracteristicas(const CorpusEmpacotado &corpus, bool usa_mascaras,
+                                    Mat &dadosTreinamento, Mat &dadosResposta, Mat &dadosTeste, Mat &dadosRespostasTestes)
+{
+    vector<CaracteristicasQuadro> quadros = processaCorpus(corpus, [&](int indice) {
+        if (usa_mascaras)
+            return ExtraiCaracteristicas(corpus.mascara(indice));
+
+        Mat quadro_cinza = corpus.quadro(indice);
+        if (!padrao_fundo.compativel(quadro_cinza.size()))
+        {
+            cout << "Quadro " << indice << " do corpus com tamanho diferente do padrao de fundo, ignorado" << endl;
+            return CaracteristicasQuadro();
+        }
+        Mat pre = preProcessaImagem(quadro_cinza, padrao_fundo, metodo_limiar, percentil_limiar, pre_fundido);
+        return ExtraiCaracteristicas(pre);
+    });
+
+    acrescentaQuadros(
+        quadros, [&](int indice) { return corpus.rotulo(indice); }, [&](int indice) { return corpus.teste(indice); },
+        dadosTreinamento, dadosResposta, dadosTeste, dadosRespostasTestes);
+}
+
+/**
+ * Descricao das mascaras de um corpus: o pre-processamento com limiar fixo e o padrao de fundo usado
+ */
+String descricaoMascarasCorpus(const String &arq_padrao_luz)
+{
+    return format("mediana=%d;limiar=%d;padrao=", TAMANHO_MEDIANA, LIMIAR_BINARIZACAO) +
+           impressaoDigital(vector<String>(1, arq_padrao_luz), "");
+}
+
+/**
+ * Empacota as sequencias de treinamento num corpus
+ *
+ * Le cada quadro uma unica vez e grava, na ordem das classes, os pixels, o
+ * rotulo e a marcacao de teste (as NUM_PARA_TESTE primeiras imagens de cada
+ * classe), e opcionalmente a mascara pre-processada com o padrao de fundo.
+ *
+ * @param String arq_corpus - arquivo do corpus a gravar
+ * @param String arq_padrao_luz - padrao de fundo, ja carregado se com_mascaras
+ * @param bool com_mascaras - grava tambem as mascaras
+ * @return int codigo de saida do programa
+ */
+int empacotaCorpus(const String &arq_corpus, const String &arq_padrao_luz, bool com_mascaras)
+{
+    GravadorCorpus gravador;
+    if (!gravador.abre(arq_corpus, com_mascaras ? descricaoMascarasCorpus(arq_padrao_luz) : String()))
     {
-        // Preprocessa frame
-        Mat quadro_cinza;
-        cvtColor(quadro, quadro_cinza, COLOR_BGR2GRAY);
-        Mat pre = preProcessaImagem(quadro_cinza);
+        cout << "Erro ao criar o corpus " << arq_corpus << endl;
+        return 1;
+    }
 
-        // Extrai caractersticas
-        vector<vector<float>> caracteristicas = ExtraiCaracteristicas(pre);
-        for (int i = 0; i < caracteristicas.size(); i++)
+    vector<String> origem;
+    int num_quadros = 0;
+    for (int rotulo = 0; rotulo < NUM_CLASSES; rotulo++)
+    {
+        vector<String> arquivos = listaSequencia(sequenciasTreinamento[rotulo]);
+        if (arquivos.empty())
         {
-            if (img_indice >= num_para_teste)
-            {
-                dadosTreinamento.push_back(caracteristicas[i][0]);
-                dadosTreinamento.push_back(caracteristicas[i][1]);
+            cout << "Erro ao abrir pasta de imagens " << sequenciasTreinamento[rotulo] << endl;
+            return 1;
+        }
 
-                dadosResposta.push_back(rotulo);
+        for (int img_indice = 0; img_indice < (int)arquivos.size(); img_indice++)
+        {
+            Mat img = leImagemCinza(arquivos[img_indice]);
+            if (img.empty())
+            {
+                cout << "Erro ao ler " << arquivos[img_indice] << ", quadro ignorado" << endl;
+                continue;
             }
-            else
+
+            Mat mascara;
+            if (com_mascaras)
             {
-                dadosTeste.push_back(caracteristicas[i][0]);
-                dadosTeste.push_back(caracteristicas[i][1]);
+                // O treinamento tambem ignora esses quadros, o resultado e o mesmo
+                if (!padrao_fundo.compativel(img.size()))
+                {
+                    cout << "Imagem " << arquivos[img_indice] << " com tamanho diferente do padrao de fundo, ignorada" << endl;
+                    continue;
+                }
+                mascara = preProcessaImagem(img, padrao_fundo, LIMIAR_FIXO, percentil_limiar, pre_fundido);
+            }
 
-                dadosRespostasTestes.push_back((float)rotulo);
+            if (!gravador.adiciona(img, rotulo, img_indice < NUM_PARA_TESTE, mascara))
+            {
+                cout << "Erro ao gravar o corpus " << arq_corpus << endl;
+                return 1;
             }
+            num_quadros++;
         }
-        img_indice++;
+        origem.insert(origem.end(), arquivos.begin(), arquivos.end());
     }
-    return true;
+
+    if (!gravador.fecha(impressaoDigital(origem, "")))
+    {
+        cout << "Erro ao gravar o corpus " << arq_corpus << endl;
+        return 1;
+    }
+    cout << num_quadros << " quadros empacotados em " << arq_corpus << (com_mascaras ? " com mascaras" : "") << endl;
+    return 0;
 }
 
-void treinaETesta()
+/**
+ * Caracteristicas de treino e de teste de todas as classes, do corpus ou de cada sequencia
+ */
+void leDadosTreinamento(Mat &dadosTreinamento, Mat &dadosResposta, Mat &dadosTeste, Mat &dadosRespostasTestes)
 {
-    vector<float> dadosTreinamento;
-    vector<int> dadosResposta;
-    vector<float> dadosTeste;
-    vector<float> dadosRespostasTestes;
-
-    int num_for_test = 20;
-
-    // Recupera e processa as imagens de porcas
-    lePastaEExtraiCaracteristicas("../x64/Debug/data/nut/tuerca_%04d.pgm", 0, num_for_test, dadosTreinamento, dadosResposta, dadosTeste, dadosRespostasTestes);
+    int num_for_test = NUM_PARA_TESTE;
 
-    // Recupera e processa as imagens de arruelas
-    lePastaEExtraiCaracteristicas("../x64/Debug/data/ring/arandela_%04d.pgm", 1, num_for_test, dadosTreinamento, dadosResposta, dadosTeste, dadosRespostasTestes);
-
-    // Recupera e processa as imagens de parafusos
-    lePastaEExtraiCaracteristicas("../x64/Debug/data/screw/tornillo_%04d.pgm", 2, num_for_test, dadosTreinamento, dadosResposta, dadosTeste, dadosRespostasTestes);
-
-    cout << "Numero de exemplos de treinamento: " << dadosResposta.size() << endl;
-    cout << "Numero de exemplos de teste......: " << dadosRespostasTestes.size() << endl;
+    // Recupera e processa as imagens de porcas, arruelas e parafusos
+    if (corpus_treino.numQuadros() > 0)
+        leCorpusEExtraiCaracteristicas(corpus_treino, usa_mascaras_corpus, dadosTreinamento, dadosResposta, dadosTeste, dadosRespostasTestes);
+    else
+    {
+        for (int rotulo = 0; rotulo < NUM_CLASSES; rotulo++)
+            lePastaEExtraiCaracteristicas(sequenciasTreinamento[rotulo], rotulo, num_for_test, dadosTreinamento, dadosResposta, dadosTeste, dadosRespostasTestes);
+    }
+}
 
-    // Une todos os dados
-    Mat matrizDadosTreinamento(dadosTreinamento.size() / 2, 2, CV_32FC1, &dadosTreinamento[0]);
-    Mat respostas(dadosResposta.size(), 1, CV_32SC1, &dadosResposta[0]);
+void treinaETesta()
+{
+    // Todos os dados ja vem em matrizes de uma linha por objeto
+    Mat matrizDadosTreinamento, respostas, matrizDadosTeste, respostasTestes;
+    leDadosTreinamento(matrizDadosTreinamento, respostas, matrizDadosTeste, respostasTestes);
 
-    Mat matrizDadosTeste(dadosTeste.size() / 2, 2, CV_32FC1, &dadosTeste[0]);
-    Mat respostasTestes(dadosRespostasTestes.size(), 1, CV_32FC1, &dadosRespostasTestes[0]);
+    cout << "Numero de exemplos de treinamento: " << respostas.rows << endl;
+    cout << "Numero de exemplos de teste......: " << respostasTestes.rows << endl;
 
     // Define os parmetros da SVM
-    svm = SVM::create();
-    svm->setType(SVM::C_SVC);
-    svm->setKernel(SVM::CHI2);
-    svm->setTermCriteria(TermCriteria(TermCriteria::MAX_ITER, 100, 1e-6));
+    svm = criaSVM(parametros_svm);
+
+    // Metadados gravados junto com o modelo; a faixa do treinamento normaliza o treino e toda predicao
+    meta_svm = MetadadosModelo();
+    meta_svm.parametros_svm = descreveParametrosSVM(parametros_svm);
+    meta_svm.caracteristicas = nomesCaracteristicas();
+    calculaNormalizacao(matrizDadosTreinamento, meta_svm);
 
     // Treina a SVM
     // Ptr<TrainData> td = TrainData::create(matrizDadosTreinamento, ROW_SAMPLE, respostas);
-    svm->train(matrizDadosTreinamento, ROW_SAMPLE, respostas);
+    {
+        MEDE_ETAPA("treino");
+        Mat normalizados;
+        aplicaNormalizacao(matrizDadosTreinamento, meta_svm.minimo, meta_svm.maximo, normalizados);
+        svm->train(normalizados, ROW_SAMPLE, respostas);
+    }
+    inferencia_svm.compila(svm, meta_svm.minimo, meta_svm.maximo);
 
-    if (dadosRespostasTestes.size() > 0)
+    meta_svm.num_treino = respostas.rows;
+    meta_svm.num_teste = respostasTestes.rows;
+
+    if (respostasTestes.rows > 0)
     {
         cout << "Avaliacao" << endl;
         cout << "=========" << endl;
 
         // Testa o modelo de ML
         Mat testaPredicao;
-        svm->predict(matrizDadosTeste, testaPredicao);
+        {
+            MEDE_ETAPA("predicao (teste)");
+            inferencia_svm.prediz(matrizDadosTeste, testaPredicao, 0);
+        }
         cout << "Predicao concluida!" << endl;
 
         // Clculo do erro
         Mat matrizErros = (testaPredicao != respostasTestes);
-        float erro = 100.0f * countNonZero(matrizErros) / dadosRespostasTestes.size();
+        float erro = 100.0f * countNonZero(matrizErros) / respostasTestes.rows;
         cout << "Erro: " << erro << "\%" << endl;
+        meta_svm.erro = erro;
 
         // Plota dados do treinamento com rtulo de erro
         plotaDadosTreinamento(matrizDadosTreinamento, respostas, &erro);
@@ -327,6 +537,525 @@ void treinaETesta()
     }
 }
 
+/**
+ * Impressao digital de um modelo treinado agora: imagens de treinamento, padrao de fundo e parametros
+ * @param String arq_padrao_luz - padrao de fundo usado no pre-processamento
+ * @param ParametrosSVM parametros - hiper-parametros da SVM
+ * @return String impressao digital, comparada com a gravada no modelo
+ */
+String impressaoTreinamento(const String &arq_padrao_luz, const ParametrosSVM &parametros)
+{
+    // Com corpus vale a impressao das imagens gravada nele, sem listar as sequencias
+    vector<String> arquivos;
+    if (corpus_treino.numQuadros() == 0)
+    {
+        for (int rotulo = 0; rotulo < NUM_CLASSES; rotulo++)
+        {
+            vector<String> sequencia = listaSequencia(sequenciasTreinamento[rotulo]);
+            arquivos.insert(arquivos.end(), sequencia.begin(), sequencia.end());
+        }
+    }
+    arquivos.push_back(arq_padrao_luz);
+
+    // O limiar muda as caracteristicas; o fixo mantem a impressao dos modelos ja gravados
+    String texto = parametrosTreinamento(parametros);
+    if (metodo_limiar != LIMIAR_FIXO)
+        texto += format(";metodo_limiar=%d;percentil=%g", metodo_limiar, percentil_limiar);
+    if (corpus_treino.numQuadros() > 0)
+        texto += ";corpus=" + corpus_treino.impressaoOrigem();
+    return impressaoDigital(arquivos, texto);
+}
+
+/**
+ * Carrega o modelo gravado ou treina um novo
+ *
+ * O modelo gravado so e usado se a sua impressao digital bate com a das
+ * imagens de treinamento, do padrao de fundo e dos parametros atuais.
+ *
+ * @param String arq_modelo - arquivo do modelo
+ * @param String arq_padrao_luz - padrao de fundo usado no pre-processamento
+ * @param bool forca_treino - retreina mesmo com um modelo valido gravado
+ * @return bool true se a SVM global esta treinada
+ */
+bool obtemModelo(const String &arq_modelo, const String &arq_padrao_luz, bool forca_treino)
+{
+    int64 inicio = getTickCount();
+    MetadadosModelo meta;
+    Ptr<SVM> carregada;
+    {
+        MEDE_ETAPA("carga do modelo");
+        carregada = carregaModelo(arq_modelo, meta);
+    }
+    if (!svm_definida && !carregada.empty() && !meta.parametros_svm.empty() &&
+        !interpretaParametrosSVM(meta.parametros_svm, parametros_svm))
+        cout << "Hiper-parametros " << meta.parametros_svm << " de " << arq_modelo << " invalidos, usando os padrao" << endl;
+
+    String impressao = impressaoTreinamento(arq_padrao_luz, parametros_svm);
+
+    if (!forca_treino)
+    {
+        if (!carregada.empty() && meta.impressao_digital == impressao)
+        {
+            svm = carregada;
+            meta_svm = meta;
+            inferencia_svm.compila(svm, meta.minimo, meta.maximo);
+            cout << "Modelo carregado de " << arq_modelo << " em " << 1000.0 * (getTickCount() - inicio) / getTickFrequency() << " ms" << endl;
+            return true;
+        }
+        if (!carregada.empty())
+            cout << "Modelo " << arq_modelo << " foi treinado com outro dataset ou outros parametros, retreinando" << endl;
+    }
+
+    treinaETesta();
+    if (svm.empty() || !svm->isTrained())
+    {
+        cout << "ERRO: SVM nao treinada" << endl;
+        return false;
+    }
+
+    meta_svm.impressao_digital = impressao;
+    if (gravaModelo(arq_modelo, svm, meta_svm))
+        cout << "Modelo gravado em " << arq_modelo << endl;
+    else
+        cout << "Erro ao gravar o modelo em " << arq_modelo << endl;
+
+    return true;
+}
+
+/**
+ * Escolhe os hiper-parametros da SVM por validacao cruzada
+ *
+ * As caracteristicas de treino sao extraidas uma unica vez; cada candidato
+ * e avaliado em k dobras delas, em paralelo. O vencedor e treinado com todo
+ * o treino, avaliado no teste separado e gravado em arq_modelo junto com os
+ * seus hiper-parametros, que passam a valer nas proximas execucoes.
+ *
+ * @param String arq_modelo - arquivo do modelo
+ * @param String arq_padrao_luz - padrao de fundo usado no pre-processamento
+ * @param int num_dobras - k da validacao cruzada
+ * @param int num_sorteados - candidatos sorteados da grade, 0 avalia a grade inteira
+ * @return int codigo de saida do programa
+ */
+int buscaHiperParametros(const String &arq_modelo, const String &arq_padrao_luz, int num_dobras, int num_sorteados)
+{
+    Mat amostras, rotulos, dadosTeste, dadosRespostasTestes;
+    leDadosTreinamento(amostras, rotulos, dadosTeste, dadosRespostasTestes);
+    if (rotulos.empty())
+    {
+        cout << "ERRO: sem amostras de treino" << endl;
+        return 1;
+    }
+
+    vector<ParametrosSVM> candidatos = gradeParametros(num_sorteados);
+    cout << "Avaliando " << candidatos.size() << " candidatos com " << num_dobras << " dobras de " << amostras.rows << " amostras" << endl;
+
+    vector<ResultadoCandidato> resultados;
+    {
+        MEDE_ETAPA("busca de parametros");
+        resultados = buscaParametros(amostras, rotulos, candidatos, num_dobras);
+    }
+
+    // Do mais preciso para o menos preciso: acerto contra latencia de cada candidato
+    vector<int> ordem(resultados.size());
+    for (size_t i = 0; i < ordem.size(); i++)
+        ordem[i] = (int)i;
+    sort(ordem.begin(), ordem.end(), [&](int a, int b) {
+        if (resultados[a].acuracia != resultados[b].acuracia)
+            return resultados[a].acuracia > resultados[b].acuracia;
+        return resultados[a].latencia < resultados[b].latencia;
+    });
+    cout << format("%-46s %9s %7s %14s %8s", "parametros", "acerto", "desvio", "us/amostra", "vetores") << endl;
+    for (size_t i = 0; i < ordem.size(); i++)
+    {
+        const ResultadoCandidato &r = resultados[ordem[i]];
+        cout << format("%-46s %8.2f%% %7.2f %14.3f %8.1f", descreveParametrosSVM(r.parametros).c_str(), r.acuracia, r.desvio,
+                       r.latencia, r.vetores_suporte);
+        if (r.falhas > 0)
+            cout << "  (" << r.falhas << " dobra(s) falharam)";
+        cout << endl;
+    }
+
+    int melhor = melhorCandidato(resultados);
+    if (melhor < 0)
+    {
+        cout << "ERRO: nenhum candidato treinou em todas as dobras" << endl;
+        return 1;
+    }
+    parametros_svm = resultados[melhor].parametros;
+    svm_definida = true;
+    cout << "Vencedor: " << descreveParametrosSVM(parametros_svm) << endl;
+
+    return obtemModelo(arq_modelo, arq_padrao_luz, true) ? 0 : 1;
+}
+
+/**
+ * Classifica todos os objetos de um quadro com a SVM global, numa unica chamada
+ * @param Mat caracteristicas - matriz de ExtraiCaracteristicas, passada sem copia para a SVM
+ * @return vector<float> classe prevista de cada objeto
+ */
+vector<float> classificaObjetos(const Mat &caracteristicas)
+{
+    MEDE_ETAPA("predicao");
+    if (modo_online)
+        return classificador_online.classifica(caracteristicas);
+
+    Mat resultados;
+    inferencia_svm.prediz(caracteristicas, resultados);
+
+    vector<float> classes;
+    for (int i = 0; i < resultados.rows; i++)
+        classes.push_back(resultados.at<float>(i));
+    return classes;
+}
+
+/**
+ * Classifica continuamente os quadros de uma camera ou de um video
+ *
+ * Captura, remocao de ruido, remocao de fundo, binarizacao, extracao de
+ * caracteristicas e classificacao rodam cada uma na sua thread, ligadas por
+ * filas limitadas; os resultados sao desenhados na thread principal.
+ *
+ * @param String fonte - indice da camera ou arquivo de video
+ * @param int capacidade_fila - quadros em cada fila entre os estagios
+ * @param PoliticaFila politica - descarta ou espera com a fila cheia
+ * @param double fps_captura - ritmo de leitura de arquivos, 0 usa o FPS do arquivo
+ * @return int codigo de saida do programa
+ */
+int processaStream(const String &fonte, int capacidade_fila, PoliticaFila politica, double fps_captura)
+{
+    FonteStream captura;
+    if (!abreFonteStream(captura, fonte, fps_captura))
+    {
+        cout << "Erro ao abrir a camera ou o video " << fonte << endl;
+        return 1;
+    }
+
+    PipelineStream pipeline(capacidade_fila, politica);
+    if (!multiescala.vazio())
+    {
+        // Busca grossa e caracteristicas so nas regioes candidatas, no lugar de todos os estagios do quadro inteiro
+        pipeline.adicionaEstagio("multiescala", [](QuadroStream &quadro) {
+            if (!padrao_fundo.compativel(quadro.img.size()))
+                return false;
+            quadro.num_objetos = multiescala.extrai(quadro.img, quadro.caracteristicas, &quadro.posicoes);
+            return true;
+        });
+    }
+    else if (pre_fundido)
+    {
+        // Um unico estagio no lugar de ruido, fundo e limiar; o paralelismo fica nas faixas do quadro
+        pipeline.adicionaEstagio("preprocessamento", [](QuadroStream &quadro) {
+            if (!padrao_fundo.compativel(quadro.img.size()))
+                return false;
+            quadro.img = preProcessaImagem(quadro.img, padrao_fundo, metodo_limiar, percentil_limiar, true);
+            return true;
+        });
+    }
+    else
+    {
+        pipeline.adicionaEstagio("ruido", [](QuadroStream &quadro) {
+            quadro.img = removeRuido(quadro.img);
+            return true;
+        });
+        pipeline.adicionaEstagio("fundo", [](QuadroStream &quadro) {
+            if (!padrao_fundo.compativel(quadro.img.size()))
+                return false;
+            quadro.img = removeFundo(quadro.img, padrao_fundo);
+            return true;
+        });
+        pipeline.adicionaEstagio("limiar", [](QuadroStream &quadro) {
+            quadro.img = thresholding(quadro.img, metodo_limiar, percentil_limiar);
+            return true;
+        });
+    }
+    if (multiescala.vazio())
+    {
+        pipeline.adicionaEstagio("caracteristicas", [](QuadroStream &quadro) {
+            quadro.num_objetos = ExtraiCaracteristicas(quadro.img, quadro.caracteristicas, &quadro.posicoes);
+            return true;
+        });
+    }
+    pipeline.adicionaEstagio("classificacao", [](QuadroStream &quadro) {
+        quadro.classes = classificaObjetos(quadro.caracteristicas);
+        return true;
+    });
+
+    EstatisticasStream estatisticas = pipeline.executa(captura, [](QuadroStream &quadro) {
+        // Sem janela e sem arquivo de mosaico nao ha o que desenhar
+        if (miw->isOffscreen() && arq_mosaico.empty())
+            return true;
+
+        Mat img_saida;
+        if (quadro.original.channels() == 1)
+            cvtColor(quadro.original, img_saida, COLOR_GRAY2BGR);
+        else
+            img_saida = quadro.original.clone();
+
+        for (size_t i = 0; i < quadro.classes.size(); i++)
+        {
+            Scalar cor;
+            putText(img_saida, nomeClasse(quadro.classes[i], cor), quadro.posicoes[i], FONT_HERSHEY_SIMPLEX, 0.4, cor);
+        }
+
+        // Em modo anel a imagem nova substitui a do quadro anterior
+        miw->addImage("Resultado", img_saida);
+        miw->render();
+        if (miw->isOffscreen())
+            return true;
+
+        // ESC ou q encerram o stream
+        int tecla = waitKey(1);
+        if (modo_online && tecla >= '1' && tecla < '1' + NUM_CLASSES)
+        {
+            // O operador rotula todos os objetos do quadro mostrado; vale a partir do proximo quadro
+            for (int i = 0; i < quadro.caracteristicas.rows; i++)
+                classificador_online.adiciona(quadro.caracteristicas.row(i), tecla - '1');
+            Scalar cor;
+            cout << quadro.caracteristicas.rows << " exemplo(s) de " << nomeClasse((float)(tecla - '1'), cor) << " adicionado(s), "
+                 << classificador_online.numNovas() << " ainda fora da SVM" << endl;
+        }
+        return tecla != 27 && tecla != 'q';
+    }, fps_captura);
+
+    if (modo_online)
+    {
+        classificador_online.aguardaRetreino();
+        cout << "Retreinos em segundo plano: " << classificador_online.numRetreinos() << ", exemplos fora da SVM: "
+             << classificador_online.numNovas() << endl;
+    }
+
+    imprimeEstatisticasStream(estatisticas);
+
+    return 0;
+}
+
+/**
+ * Classifica um quadro recebido pelo daemon com o estado em vigor
+ *
+ * O estado e pego uma vez no inicio do quadro: uma recarga no meio dele so
+ * vale para os quadros seguintes. Chamada em paralelo pelas threads do servidor.
+ */
+int inspecionaQuadroDaemon(const Mat &quadro, vector<ObjetoInspecionado> &objetos, int &versao)
+{
+    shared_ptr<const EstadoDaemon> estado = atomic_load(&estado_daemon);
+    versao = estado->versao;
+    if (!estado->padrao.compativel(quadro.size()))
+        return RESPOSTA_TAMANHO_INCOMPATIVEL;
+
+    Mat caracteristicas;
+    vector<Point> posicoes;
+    if (!estado->multiescala.vazio())
+        estado->multiescala.extrai(quadro, caracteristicas, &posicoes);
+    else
+        ExtraiCaracteristicas(preProcessaImagem(quadro, estado->padrao, metodo_limiar, percentil_limiar, pre_fundido),
+                              caracteristicas, &posicoes);
+
+    Mat classes;
+    if (caracteristicas.rows > 0)
+        estado->inferencia.prediz(caracteristicas, classes);
+    for (int i = 0; i < caracteristicas.rows; i++)
+    {
+        const float *c = caracteristicas.ptr<float>(i);
+        ObjetoInspecionado objeto;
+        objeto.classe = (int32_t)classes.at<float>(i);
+        objeto.x = (float)posicoes[i].x;
+        objeto.y = (float)posicoes[i].y;
+        objeto.area = c[CARAC_AREA];
+        objeto.proporcao = c[CARAC_PROPORCAO];
+        objetos.push_back(objeto);
+    }
+    return RESPOSTA_OK;
+}
+
+/**
+ * Le de novo o padrao de fundo e o modelo gravado e troca o estado do daemon de uma vez
+ *
+ * Nao treina: o modelo tem que ter sido gravado (ex. por -train em outro
+ * processo) com o padrao e os parametros atuais, pela mesma impressao
+ * digital de obtemModelo. Em qualquer erro o estado atual continua valendo.
+ *
+ * @param bool usa_cache - le/grava o cache do padrao suavizado
+ * @param int versao - saida da versao em vigor depois da recarga
+ * @return bool true se o estado foi trocado
+ */
+bool recarregaDaemon(const String &arq_modelo, const String &arq_padrao_luz, bool usa_cache, int &versao)
+{
+    int64 inicio = getTickCount();
+    shared_ptr<const EstadoDaemon> atual = atomic_load(&estado_daemon);
+    versao = atual->versao;
+
+    // Um modelo ou padrao lido no meio de uma gravacao pode lancar excecao nesta thread:
+    // sem o catch ela chamaria std::terminate e derrubaria o daemon
+    shared_ptr<EstadoDaemon> novo = make_shared<EstadoDaemon>();
+    try
+    {
+        if (!novo->padrao.carrega(arq_padrao_luz, TAMANHO_MEDIANA, usa_cache))
+        {
+            cout << "Recarga: padrao de fundo " << arq_padrao_luz << " nao carregado, mantendo a versao " << versao << endl;
+            return false;
+        }
+
+        MetadadosModelo meta;
+        Ptr<SVM> carregada = carregaModelo(arq_modelo, meta);
+        ParametrosSVM parametros = parametros_svm;
+        if (!svm_definida && !carregada.empty() && !meta.parametros_svm.empty())
+            interpretaParametrosSVM(meta.parametros_svm, parametros);
+        if (carregada.empty() || meta.impressao_digital != impressaoTreinamento(arq_padrao_luz, parametros) ||
+            !novo->inferencia.compila(carregada, meta.minimo, meta.maximo))
+        {
+            cout << "Recarga: modelo " << arq_modelo << " ausente ou treinado com outro padrao ou outros parametros (rode -train), mantendo a versao "
+                 << versao << endl;
+            return false;
+        }
+        if (fator_grosseiro > 1)
+            novo->multiescala.define(novo->padrao, fator_grosseiro);
+    }
+    catch (const cv::Exception &e)
+    {
+        cout << "Recarga: erro ao montar o novo estado (" << e.what() << "), mantendo a versao " << versao << endl;
+        return false;
+    }
+    catch (const std::exception &e)
+    {
+        cout << "Recarga: erro ao montar o novo estado (" << e.what() << "), mantendo a versao " << versao << endl;
+        return false;
+    }
+
+    novo->versao = atual->versao + 1;
+    atomic_store(&estado_daemon, shared_ptr<const EstadoDaemon>(novo));
+    versao = novo->versao;
+    cout << "Recarga: versao " << versao << " em vigor depois de " << 1000.0 * (getTickCount() - inicio) / getTickFrequency() << " ms" << endl;
+    return true;
+}
+
+// Tratador de sinal do daemon: so grava pedidos atomicos no servidor
+void trataSinalDaemon(int sinal)
+{
+    if (servidor_daemon == NULL)
+        return;
+#ifdef SIGHUP
+    if (sinal == SIGHUP)
+    {
+        servidor_daemon->solicitaRecarga();
+        return;
+    }
+#endif
+    servidor_daemon->solicitaParada();
+}
+
+/**
+ * Modo daemon: atende quadros pelo socket Unix ate SIGINT ou SIGTERM
+ *
+ * O padrao de fundo e o modelo globais, ja carregados, viram a versao 1 do
+ * estado; SIGHUP ou um pedido de recarga (-client -reload) leem os arquivos
+ * de novo sem parar o atendimento.
+ *
+ * @param String caminho - arquivo do socket
+ * @param int num_threads - threads de atendimento, 0 usa todos os nucleos
+ * @param bool usa_cache - cache do padrao suavizado nas recargas
+ * @return int codigo de saida do programa
+ */
+int executaDaemon(const String &caminho, int num_threads, const String &arq_modelo, const String &arq_padrao_luz, bool usa_cache)
+{
+    shared_ptr<EstadoDaemon> inicial = make_shared<EstadoDaemon>();
+    inicial->padrao = padrao_fundo;
+    inicial->inferencia = inferencia_svm;
+    if (fator_grosseiro > 1)
+        inicial->multiescala.define(padrao_fundo, fator_grosseiro);
+    inicial->versao = 1;
+    atomic_store(&estado_daemon, shared_ptr<const EstadoDaemon>(inicial));
+
+    ServidorInspecao servidor;
+    RecarregaInspecao recarrega = [&](int &versao) { return recarregaDaemon(arq_modelo, arq_padrao_luz, usa_cache, versao); };
+    if (!servidor.inicia(caminho, inspecionaQuadroDaemon, recarrega, num_threads))
+        return 1;
+
+    servidor_daemon = &servidor;
+    signal(SIGINT, trataSinalDaemon);
+    signal(SIGTERM, trataSinalDaemon);
+#ifdef SIGHUP
+    signal(SIGHUP, trataSinalDaemon);
+#endif
+    cout << "Daemon em " << caminho << ": SIGHUP ou -client=" << caminho << " -reload recarregam o modelo e o padrao, SIGINT encerra" << endl;
+
+    servidor.executa();
+
+    signal(SIGINT, SIG_DFL);
+    signal(SIGTERM, SIG_DFL);
+#ifdef SIGHUP
+    signal(SIGHUP, SIG_DFL);
+#endif
+    servidor_daemon = NULL;
+    cout << "Daemon encerrado depois de " << servidor.numQuadros() << " quadros" << endl;
+    return 0;
+}
+
+/**
+ * Modo cliente: manda a imagem ao daemon e imprime os objetos e a latencia de ida e volta
+ * @param String caminho - socket do daemon
+ * @param int num_pedidos - vezes que a imagem e mandada, todas na mesma conexao
+ * @param bool recarrega - so pede a recarga do modelo e do padrao
+ * @return int codigo de saida do programa
+ */
+int executaCliente(const String &caminho, const String &img_file, int num_pedidos, bool recarrega)
+{
+    ClienteInspecao cliente;
+    if (!cliente.conecta(caminho))
+    {
+        cout << "ERRO: nenhum daemon em " << caminho << endl;
+        return 1;
+    }
+
+    int versao = 0;
+    if (recarrega)
+    {
+        int estado = cliente.recarrega(&versao);
+        cout << (estado == RESPOSTA_OK ? "Recarregado" : "Recarga recusada") << ", versao em vigor: " << versao << endl;
+        return estado == RESPOSTA_OK ? 0 : 1;
+    }
+
+    Mat img = leImagemCinza(img_file);
+    if (img.empty())
+    {
+        cout << "Erro carregando imagem " << img_file << endl;
+        return 1;
+    }
+
+    vector<ObjetoInspecionado> objetos;
+    vector<double> latencias;
+    int64 microssegundos = 0;
+    int64 inicio = getTickCount();
+    for (int i = 0; i < max(1, num_pedidos); i++)
+    {
+        int64 envio = getTickCount();
+        int estado = cliente.inspeciona(img, objetos, &versao, &microssegundos);
+        latencias.push_back(1000.0 * (getTickCount() - envio) / getTickFrequency());
+        if (estado != RESPOSTA_OK)
+        {
+            cout << "ERRO: daemon respondeu " << estado
+                 << (estado == RESPOSTA_TAMANHO_INCOMPATIVEL ? " (tamanho diferente do padrao de fundo)" :
+                     estado == RESPOSTA_ERRO_PROCESSAMENTO ? " (erro ao processar o quadro, veja o log do daemon)" : "") << endl;
+            return 1;
+        }
+    }
+    double segundos = (getTickCount() - inicio) / getTickFrequency();
+
+    cout << "Numero de objetos detectados: " << objetos.size() << " (modelo versao " << versao << ")" << endl;
+    for (size_t i = 0; i < objetos.size(); i++)
+    {
+        Scalar cor;
+        cout << "Objeto previsto: " << nomeClasse((float)objetos[i].classe, cor) << " em (" << objetos[i].x << ", " << objetos[i].y
+             << ") Area: " << objetos[i].area << " Relacao de aspecto: " << objetos[i].proporcao << endl;
+    }
+
+    sort(latencias.begin(), latencias.end());
+    size_t n = latencias.size();
+    cout << "Ida e volta em " << n << " pedido(s): p50 " << latencias[n / 2] << " ms, p95 " << latencias[min(n - 1, n * 95 / 100)]
+         << " ms, p99 " << latencias[min(n - 1, n * 99 / 100)] << " ms; " << n / segundos << " quadros/s; servidor "
+         << microssegundos / 1000.0 << " ms no ultimo" << endl;
+    return 0;
+}
+
 int main(int argc, const char **argv)
 {
     CommandLineParser parser(argc, argv, chavesS);
@@ -339,6 +1068,7 @@ int main(int argc, const char **argv)
 
     String img_file = parser.get<String>(0);
     String arq_padrao_luz = "../x64/Debug/data/pattern.pgm";
+    String arq_modelo = parser.get<String>("model");
 
     if (!parser.check())
     {
@@ -346,10 +1076,145 @@ int main(int argc, const char **argv)
         return 0;
     }
 
-    miw = new MultipleImageWindow("Janela", 2, 2, WINDOW_AUTOSIZE);
+    if (parser.has("headless"))
+        backend_janela = MultipleImageWindow::BACKEND_OFFSCREEN;
+    arq_mosaico = parser.get<String>("mosaic");
+    metodo_limiar = parser.get<int>("thrMethod");
+    percentil_limiar = parser.get<double>("thrPercentile");
+    pre_fundido = parser.has("fused");
+    if (pre_fundido && metodo_limiar != LIMIAR_FIXO)
+        cout << "Limiar automatico precisa do quadro inteiro, pre-processamento feito etapa por etapa" << endl;
+    fator_grosseiro = parser.get<int>("coarse");
+    if (fator_grosseiro > 0 && metodo_limiar != LIMIAR_FIXO)
+    {
+        cout << "Busca grosseira so com limiar fixo, stream feito no quadro inteiro" << endl;
+        fator_grosseiro = 0;
+    }
+
+    // Relatorio de tempo por etapa na saida do programa, em qualquer modo
+    if (parser.has("profile"))
+        Instrumentacao::inicia(parser.get<double>("profileEvery"));
+
+    // Cliente do daemon: o processamento fica todo do outro lado do socket
+    if (parser.has("client"))
+        return executaCliente(parser.get<String>("client"), img_file, parser.get<int>("requests"), parser.has("reload"));
+
+    String texto_svm = parser.get<String>("svm");
+    if (!texto_svm.empty())
+    {
+        if (!interpretaParametrosSVM(texto_svm, parametros_svm))
+        {
+            cout << "ERRO: hiper-parametros invalidos em -svm: " << texto_svm << endl;
+            return 1;
+        }
+        svm_definida = true;
+    }
+
+    // Empacotamento: um unico arquivo com os quadros, os rotulos e a separacao de teste
+    if (parser.has("pack"))
+    {
+        bool com_mascaras = parser.has("packMasks");
+        if (com_mascaras && !padrao_fundo.carrega(arq_padrao_luz, TAMANHO_MEDIANA, parser.get<bool>("lightCache")))
+        {
+            cout << "ERRO: Padrao de fundo nao carregado" << endl;
+            return 1;
+        }
+        return empacotaCorpus(parser.get<String>("pack"), arq_padrao_luz, com_mascaras);
+    }
+
+    arq_corpus = parser.get<String>("corpus");
+    if (!arq_corpus.empty())
+    {
+        if (!corpus_treino.abre(arq_corpus) || corpus_treino.numQuadros() == 0)
+        {
+            cout << "ERRO: Corpus " << arq_corpus << " vazio, de outra versao ou corrompido" << endl;
+            return 1;
+        }
+        // As mascaras so valem com o limiar fixo e o mesmo padrao de fundo
+        usa_mascaras_corpus = corpus_treino.temMascaras() && metodo_limiar == LIMIAR_FIXO &&
+                              corpus_treino.descricaoMascaras() == descricaoMascarasCorpus(arq_padrao_luz);
+        if (corpus_treino.temMascaras() && !usa_mascaras_corpus)
+            cout << "Mascaras do corpus feitas com outro limiar ou outro padrao de fundo, pre-processando os quadros" << endl;
+    }
+
+    // Busca de hiper-parametros: como o treinamento, sem janela
+    if (parser.has("search"))
+    {
+        if (!padrao_fundo.carrega(arq_padrao_luz, TAMANHO_MEDIANA, parser.get<bool>("lightCache")))
+        {
+            cout << "ERRO: Padrao de fundo nao carregado" << endl;
+            return 1;
+        }
+        return buscaHiperParametros(arq_modelo, arq_padrao_luz, max(2, parser.get<int>("folds")), parser.get<int>("searchRandom"));
+    }
+
+    // Modo de treinamento: so o padrao de fundo e o dataset, sem janela
+    if (parser.has("train"))
+    {
+        if (!padrao_fundo.carrega(arq_padrao_luz, TAMANHO_MEDIANA, parser.get<bool>("lightCache")))
+        {
+            cout << "ERRO: Padrao de fundo nao carregado" << endl;
+            return 1;
+        }
+        return obtemModelo(arq_modelo, arq_padrao_luz, true) ? 0 : 1;
+    }
+
+    // Modo daemon: padrao, modelo e threads carregados uma vez, sem janela, para todos os quadros do socket
+    if (parser.has("daemon"))
+    {
+        if (!padrao_fundo.carrega(arq_padrao_luz, TAMANHO_MEDIANA, parser.get<bool>("lightCache")))
+        {
+            cout << "ERRO: Padrao de fundo nao carregado" << endl;
+            return 1;
+        }
+        if (!obtemModelo(arq_modelo, arq_padrao_luz, parser.has("retrain")))
+            return 1;
+        return executaDaemon(parser.get<String>("daemon"), parser.get<int>("workers"), arq_modelo, arq_padrao_luz,
+                             parser.get<bool>("lightCache"));
+    }
+
+    // Modo stream: o modelo e o padrao de fundo sao carregados antes de abrir a camera ou o video
+    if (parser.has("stream"))
+    {
+        if (!padrao_fundo.carrega(arq_padrao_luz, TAMANHO_MEDIANA, parser.get<bool>("lightCache")))
+        {
+            cout << "ERRO: Padrao de fundo nao carregado" << endl;
+            return 1;
+        }
+        if (!obtemModelo(arq_modelo, arq_padrao_luz, parser.has("retrain")))
+            return 1;
+        if (fator_grosseiro > 1)
+            multiescala.define(padrao_fundo, fator_grosseiro);
+
+        // O classificador online parte das amostras de treino da SVM atual
+        modo_online = parser.has("online");
+        if (modo_online)
+        {
+            Mat amostras, rotulos, dadosTeste, dadosRespostasTestes;
+            leDadosTreinamento(amostras, rotulos, dadosTeste, dadosRespostasTestes);
+            if (!classificador_online.inicia(svm, meta_svm, amostras, rotulos, parametros_svm, parser.get<int>("retrainEvery")))
+            {
+                cout << "ERRO: sem amostras de treino para o classificador online" << endl;
+                return 1;
+            }
+        }
+
+        miw = new MultipleImageWindow("Janela", 1, 1, WINDOW_AUTOSIZE, backend_janela);
+        miw->setRingBuffer(true);
+        miw->setOutputFile(arq_mosaico);
+        return processaStream(img_file, parser.get<int>("queueSize"), parser.get<bool>("dropFrames") ? FILA_DESCARTA : FILA_BLOQUEIA,
+                              parser.get<double>("playFps"));
+    }
+
+    miw = new MultipleImageWindow("Janela", 2, 2, WINDOW_AUTOSIZE, backend_janela);
+    miw->setOutputFile(arq_mosaico);
 
     // Carrega imagem
-    Mat img = imread(img_file, 0);
+    Mat img;
+    {
+        MEDE_ETAPA("carga");
+        img = leImagemCinza(img_file);
+    }
     if (img.data == NULL)
     {
         cout << "Erro carregando imagem " << img_file << endl;
@@ -359,59 +1224,47 @@ int main(int argc, const char **argv)
     Mat img_saida = img.clone();
     cvtColor(img_saida, img_saida, COLOR_GRAY2BGR);
 
-    // Carrega imagem
-    padrao_fundo = imread(arq_padrao_luz, 0);
-    if (padrao_fundo.data == NULL)
+    // Carrega o padrao de fundo ja suavizado (usa o cache .plc quando valido)
+    if (!padrao_fundo.carrega(arq_padrao_luz, TAMANHO_MEDIANA, parser.get<bool>("lightCache")))
     {
-        // Calcula padrao de fundo
         cout << "ERRO: Padrao de fundo nao carregado" << endl;
         return 0;
     }
-    medianBlur(padrao_fundo, padrao_fundo, 3);
+    if (!padrao_fundo.compativel(img.size()))
+    {
+        cout << "ERRO: Padrao de fundo com tamanho diferente da imagem " << img_file << endl;
+        return 0;
+    }
 
     // Pr-processa a imagem de entrada
-    Mat pre = preProcessaImagem(img);
+    Mat pre = preProcessaImagem(img, padrao_fundo, metodo_limiar, percentil_limiar, pre_fundido);
 
     // Extrai caractersticas
-    vector<int> pos_topo, pos_esquerda;
-    vector<vector<float>> caracteristicas = ExtraiCaracteristicas(pre, &pos_esquerda, &pos_topo);
+    Mat caracteristicas;
+    vector<Point> posicoes;
+    ExtraiCaracteristicas(pre, caracteristicas, &posicoes, &objeto);
     miw->addImage("Objeto", objeto * 255);
     miw->render();
 
-    // Extrai caractersticas
-    treinaETesta();
+    // Carrega o modelo gravado; so treina se o dataset ou os parametros mudaram
+    if (!obtemModelo(arq_modelo, arq_padrao_luz, parser.has("retrain")))
+        return 0;
 
-    cout << "\nNumero de objetos detectados: " << caracteristicas.size() << endl;
+    cout << "\nNumero de objetos detectados: " << caracteristicas.rows << endl;
 
-    for (int i = 0; i < caracteristicas.size(); i++)
+    vector<float> resultados = classificaObjetos(caracteristicas);
+    for (int i = 0; i < caracteristicas.rows; i++)
     {
-        cout << "\nArea: " << caracteristicas[i][0] << " Relacao de aspecto: " << caracteristicas[i][1] << endl;
-
-        Mat matrizDadosTreinamento(1, 2, CV_32FC1, &caracteristicas[i][0]);
-
-        float resultado = svm->predict(matrizDadosTreinamento);
+        const float *c = caracteristicas.ptr<float>(i);
+        cout << "\nArea: " << c[CARAC_AREA] << " Relacao de aspecto: " << c[CARAC_PROPORCAO] << " Perimetro: " << c[CARAC_PERIMETRO]
+             << " Circularidade: " << c[CARAC_CIRCULARIDADE] << " Buracos: " << c[CARAC_BURACOS] << endl;
 
-        stringstream ss;
         Scalar cor;
-        if (resultado == 0)
-        {
-            cor = verde; // Porca
-            ss << "Porca";
-        }
-        else if (resultado == 1)
-        {
-            cor = azul; // Arruela
-            ss << "Arruela";
-        }
-        else if (resultado == 2)
-        {
-            cor = vermelho; // Parafuso
-            ss << "Parafuso";
-        }
+        String nome = nomeClasse(resultados[i], cor);
 
-        cout << "Objeto previsto: " << ss.str() << endl;
+        cout << "Objeto previsto: " << nome << endl;
 
-        putText(img_saida, ss.str(), Point2d(pos_esquerda[i], pos_topo[i]), FONT_HERSHEY_SIMPLEX, 0.4, cor);
+        putText(img_saida, nome, posicoes[i], FONT_HERSHEY_SIMPLEX, 0.4, cor);
     }
 
     // vector<int> results= evaluate(caracteristicas);
@@ -422,7 +1275,8 @@ int main(int argc, const char **argv)
     miw->addImage("Resultado", img_saida);
     //  imshow("Resultado", img_saida);
     miw->render();
-    waitKey(0);
+    if (!miw->isOffscreen())
+        waitKey(0);
 
     return 0;
 }
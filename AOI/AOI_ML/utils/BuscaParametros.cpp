@@ -0,0 +1,254 @@
+#include "BuscaParametros.h"
+#include "Classificacao.h"
+#include "InferenciaSVM.h"
+#include "ThreadsOpenCV.h"
+
+#include <cmath>
+#include <thread>
+#include <atomic>
+#include <iostream>
+#include <algorithm>
+
+#include "opencv2/core/utility.hpp"
+
+vector<ParametrosSVM> gradeParametros(int num_sorteados, uint64 semente)
+{
+    const double valores_C[] = {0.1, 1, 10, 100};
+    const double valores_gamma[] = {1e-6, 1e-5, 1e-4, 1e-3, 1e-2, 0.1, 1};
+
+    vector<ParametrosSVM> grade;
+    for (int c = 0; c < 4; c++)
+    {
+        ParametrosSVM p;
+        p.C = valores_C[c];
+
+        p.kernel = SVM::LINEAR;
+        grade.push_back(p);
+        p.kernel = SVM::INTER;
+        grade.push_back(p);
+
+        for (int g = 0; g < 7; g++)
+        {
+            p.gamma = valores_gamma[g];
+            p.kernel = SVM::RBF;
+            grade.push_back(p);
+            p.kernel = SVM::CHI2;
+            grade.push_back(p);
+            // Com as caracteristicas em [0, 1] o polinomio nao estoura com nenhum gamma da grade
+            p.kernel = SVM::POLY;
+            p.grau = 2;
+            grade.push_back(p);
+            p.grau = 3;
+            grade.push_back(p);
+        }
+    }
+
+    // O padrao (CHI2, C=1, gamma=1) esta na grade; na busca aleatoria entra sempre, como referencia
+    if (num_sorteados > 0 && num_sorteados < (int)grade.size())
+    {
+        RNG rng(semente);
+        vector<ParametrosSVM> sorteados(1, ParametrosSVM());
+        String padrao = descreveParametrosSVM(ParametrosSVM());
+        for (int i = (int)grade.size() - 1; i > 0; i--)
+            swap(grade[i], grade[rng.uniform(0, i + 1)]);
+        for (size_t i = 0; i < grade.size() && (int)sorteados.size() < num_sorteados; i++)
+        {
+            if (descreveParametrosSVM(grade[i]) != padrao)
+                sorteados.push_back(grade[i]);
+        }
+        grade = sorteados;
+    }
+
+    return grade;
+}
+
+// Amostras de treino e de validacao de uma dobra, ja normalizadas pela faixa do treino da dobra
+struct Dobra
+{
+    Mat treino, rotulos_treino;
+    Mat validacao, rotulos_validacao;
+};
+
+/**
+ * Divide as amostras em dobras estratificadas: as de cada classe sao embaralhadas e distribuidas em rodizio
+ */
+static vector<Dobra> divideDobras(const Mat &amostras, const Mat &rotulos, int num_dobras)
+{
+    vector<int> dobra_da_amostra(amostras.rows);
+    vector<int> classes;
+    for (int i = 0; i < rotulos.rows; i++)
+        classes.push_back(rotulos.at<int>(i));
+    sort(classes.begin(), classes.end());
+    classes.erase(unique(classes.begin(), classes.end()), classes.end());
+
+    RNG rng(12345);
+    for (size_t c = 0; c < classes.size(); c++)
+    {
+        vector<int> indices;
+        for (int i = 0; i < rotulos.rows; i++)
+        {
+            if (rotulos.at<int>(i) == classes[c])
+                indices.push_back(i);
+        }
+        for (int i = (int)indices.size() - 1; i > 0; i--)
+            swap(indices[i], indices[rng.uniform(0, i + 1)]);
+        for (size_t i = 0; i < indices.size(); i++)
+            dobra_da_amostra[indices[i]] = (int)(i % num_dobras);
+    }
+
+    vector<Dobra> dobras(num_dobras);
+    for (int i = 0; i < amostras.rows; i++)
+    {
+        for (int d = 0; d < num_dobras; d++)
+        {
+            if (dobra_da_amostra[i] == d)
+            {
+                dobras[d].validacao.push_back(amostras.row(i));
+                dobras[d].rotulos_validacao.push_back(rotulos.row(i));
+            }
+            else
+            {
+                dobras[d].treino.push_back(amostras.row(i));
+                dobras[d].rotulos_treino.push_back(rotulos.row(i));
+            }
+        }
+    }
+
+    // Como no treinamento final: a faixa sai so do treino da dobra e e aplicada tambem a validacao,
+    // sem que a dobra separada influencie a normalizacao
+    for (int d = 0; d < num_dobras; d++)
+    {
+        Mat minimo, maximo;
+        calculaNormalizacao(dobras[d].treino, minimo, maximo);
+        if (!dobras[d].treino.empty())
+            aplicaNormalizacao(dobras[d].treino, minimo, maximo, dobras[d].treino);
+        if (!dobras[d].validacao.empty())
+            aplicaNormalizacao(dobras[d].validacao, minimo, maximo, dobras[d].validacao);
+    }
+
+    return dobras;
+}
+
+// Medidas de um candidato numa dobra
+struct MedidaDobra
+{
+    double acuracia;
+    double latencia;
+    int vetores_suporte;
+    bool falhou;
+};
+
+static MedidaDobra avaliaDobra(const ParametrosSVM &parametros, const Dobra &dobra)
+{
+    MedidaDobra medida = {0, 0, 0, true};
+    if (dobra.validacao.empty() || dobra.treino.empty())
+        return medida;
+
+    try
+    {
+        Ptr<SVM> svm = criaSVM(parametros);
+        svm->train(dobra.treino, ROW_SAMPLE, dobra.rotulos_treino);
+
+        InferenciaSVM inferencia;
+        if (!inferencia.compila(svm))
+            return medida;
+
+        Mat previstos;
+        int64 inicio = getTickCount();
+        inferencia.prediz(dobra.validacao, previstos);
+        double segundos = (getTickCount() - inicio) / getTickFrequency();
+
+        int acertos = 0;
+        for (int i = 0; i < previstos.rows; i++)
+        {
+            if ((int)previstos.at<float>(i) == dobra.rotulos_validacao.at<int>(i))
+                acertos++;
+        }
+
+        medida.acuracia = 100.0 * acertos / previstos.rows;
+        medida.latencia = 1e6 * segundos / previstos.rows;
+        medida.vetores_suporte = svm->getSupportVectors().rows;
+        medida.falhou = false;
+    }
+    catch (const cv::Exception &e)
+    {
+        cout << "Treino falhou com " << descreveParametrosSVM(parametros) << ": " << e.what() << endl;
+    }
+
+    return medida;
+}
+
+vector<ResultadoCandidato> buscaParametros(const Mat &amostras, const Mat &rotulos, const vector<ParametrosSVM> &candidatos,
+                                           int num_dobras, int num_threads)
+{
+    CV_Assert(amostras.type() == CV_32FC1 && rotulos.type() == CV_32SC1 && amostras.rows == rotulos.rows);
+    CV_Assert(num_dobras >= 2);
+
+    vector<Dobra> dobras = divideDobras(amostras, rotulos, num_dobras);
+
+    // Uma tarefa por par (candidato, dobra), todas independentes
+    int num_tarefas = (int)candidatos.size() * num_dobras;
+    vector<MedidaDobra> medidas(num_tarefas);
+
+    if (num_threads <= 0)
+        num_threads = max(1, (int)thread::hardware_concurrency());
+    num_threads = max(1, min(num_threads, num_tarefas));
+
+    // Uma tarefa por thread: o paralelismo interno do OpenCV so atrapalharia.
+    // O valor anterior volta ao fim do bloco, o resto do programa nao ve a mudanca
+    {
+        RestauraThreadsOpenCV restaura;
+        setNumThreads(0);
+
+        atomic<int> proxima(0);
+        vector<thread> trabalhadores;
+        for (int t = 0; t < num_threads; t++)
+        {
+            trabalhadores.push_back(thread([&]() {
+                for (int tarefa = proxima++; tarefa < num_tarefas; tarefa = proxima++)
+                    medidas[tarefa] = avaliaDobra(candidatos[tarefa / num_dobras], dobras[tarefa % num_dobras]);
+            }));
+        }
+        for (size_t t = 0; t < trabalhadores.size(); t++)
+            trabalhadores[t].join();
+    }
+
+    vector<ResultadoCandidato> resultados(candidatos.size());
+    for (size_t c = 0; c < candidatos.size(); c++)
+    {
+        ResultadoCandidato &r = resultados[c];
+        r.parametros = candidatos[c];
+        for (int d = 0; d < num_dobras; d++)
+        {
+            const MedidaDobra &m = medidas[c * num_dobras + d];
+            r.acuracia += m.acuracia / num_dobras;
+            r.latencia += m.latencia / num_dobras;
+            r.vetores_suporte += (double)m.vetores_suporte / num_dobras;
+            if (m.falhou)
+                r.falhas++;
+        }
+        double variancia = 0;
+        for (int d = 0; d < num_dobras; d++)
+        {
+            double diferenca = medidas[c * num_dobras + d].acuracia - r.acuracia;
+            variancia += diferenca * diferenca / num_dobras;
+        }
+        r.desvio = sqrt(variancia);
+    }
+
+    return resultados;
+}
+
+int melhorCandidato(const vector<ResultadoCandidato> &resultados)
+{
+    int melhor = -1;
+    for (int i = 0; i < (int)resultados.size(); i++)
+    {
+        if (resultados[i].falhas > 0)
+            continue;
+        if (melhor < 0 || resultados[i].acuracia > resultados[melhor].acuracia ||
+            (resultados[i].acuracia == resultados[melhor].acuracia && resultados[i].latencia < resultados[melhor].latencia))
+            melhor = i;
+    }
+    return melhor;
+}
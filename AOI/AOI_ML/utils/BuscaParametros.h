@@ -0,0 +1,77 @@
+/**
+ * Busca de hiper-parametros da SVM
+ *
+ * Avalia cada candidato (kernel, C, gamma, grau) com validacao cruzada em
+ * k dobras estratificadas sobre a matriz de caracteristicas ja extraida:
+ * treina em k - 1 dobras e classifica a restante com a InferenciaSVM,
+ * medindo o acerto e o tempo de predicao por amostra. Cada par
+ * (candidato, dobra) e uma tarefa independente, e as tarefas sao
+ * distribuidas entre as threads de um pool, entao a busca usa todos os
+ * nucleos mesmo com poucas dobras ou poucos candidatos.
+ *
+ * Cada dobra e normalizada como o treinamento final (aplicaNormalizacao):
+ * a faixa sai das k - 1 dobras de treino e e aplicada tambem a dobra de
+ * validacao. O vencedor e retreinado com todo o treino e gravado com a
+ * faixa dele, a mesma normalizacao que a busca avaliou.
+ *
+ * As dobras sao sorteadas com uma semente fixa: a mesma busca da o mesmo
+ * resultado, com qualquer numero de threads. O numero de threads do OpenCV
+ * e zerado durante a busca e restaurado no fim.
+ *
+ */
+
+#ifndef BUSCA_PARAMETROS_h
+#define BUSCA_PARAMETROS_h
+
+#include <vector>
+using namespace std;
+
+// OpenCV includes
+#include "opencv2/core.hpp"
+#include "opencv2/ml.hpp"
+using namespace cv;
+using namespace cv::ml;
+
+#include "ModeloSVM.h"
+
+/**
+ * Resultado da validacao cruzada de um candidato
+ */
+struct ResultadoCandidato
+{
+    ParametrosSVM parametros;
+    double acuracia;       // acerto medio das dobras, em porcentagem
+    double desvio;         // desvio padrao do acerto entre as dobras
+    double latencia;       // microssegundos por amostra na InferenciaSVM
+    double vetores_suporte; // media das dobras
+    int falhas;            // dobras em que o treino falhou; contam como acerto 0
+
+    ResultadoCandidato() : acuracia(0), desvio(0), latencia(0), vetores_suporte(0), falhas(0) {}
+};
+
+/**
+ * Grade de candidatos: LINEAR e INTER com C; RBF e CHI2 com C e gamma; POLY com C, gamma e grau 2 ou 3
+ * @param int num_sorteados - busca aleatoria com esse numero de candidatos da grade, 0 usa a grade inteira
+ * @param uint64 semente - semente do sorteio
+ * @return vector<ParametrosSVM> candidatos, sempre com os parametros padrao entre eles
+ */
+vector<ParametrosSVM> gradeParametros(int num_sorteados = 0, uint64 semente = 12345);
+
+/**
+ * Validacao cruzada de todos os candidatos em paralelo
+ * @param Mat amostras - N x numero de caracteristicas, CV_32F, sem normalizar
+ * @param Mat rotulos - N x 1 CV_32S
+ * @param vector<ParametrosSVM> candidatos - ex. de gradeParametros()
+ * @param int num_dobras - k da validacao cruzada, pelo menos 2
+ * @param int num_threads - threads do pool, 0 usa todos os nucleos
+ * @return vector<ResultadoCandidato> um resultado por candidato, na ordem dos candidatos
+ */
+vector<ResultadoCandidato> buscaParametros(const Mat &amostras, const Mat &rotulos, const vector<ParametrosSVM> &candidatos,
+                                           int num_dobras = 5, int num_threads = 0);
+
+/**
+ * @return int indice do candidato de maior acuracia; no empate, o de menor latencia
+ */
+int melhorCandidato(const vector<ResultadoCandidato> &resultados);
+
+#endif
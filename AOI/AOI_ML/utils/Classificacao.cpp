@@ -0,0 +1,227 @@
+#include "Classificacao.h"
+#include "PreProcessamentoFundido.h"
+#include "Instrumentacao.h"
+
+#include "opencv2/imgproc.hpp"
+
+#include <cmath>
+
+/**
+ * Conta os pixels de um contorno preenchido, incluindo a propria borda
+ *
+ * Os vertices do contorno estao na grade de pixels, entao pelo teorema de Pick
+ * o numero de pixels = area + pontos_na_borda / 2 + 1. Com CHAIN_APPROX_SIMPLE
+ * cada segmento e horizontal, vertical ou diagonal e tem max(|dx|, |dy|) pontos.
+ * Idas e voltas sobre a mesma linha (objetos de 1 pixel de largura) continuam
+ * contadas uma unica vez.
+ *
+ * @param vector<Point> contorno - contorno de findContours
+ * @param double* pontos_borda - saida opcional do numero de pixels da borda
+ * @return double numero de pixels cobertos pelo contorno preenchido
+ */
+static double pixelsContornoPreenchido(const vector<Point> &contorno, double *pontos_borda = NULL)
+{
+    double borda = 0;
+    for (size_t k = 0; k < contorno.size(); k++)
+    {
+        Point d = contorno[(k + 1) % contorno.size()] - contorno[k];
+        borda += max(abs(d.x), abs(d.y));
+    }
+
+    if (pontos_borda != NULL)
+        *pontos_borda = borda;
+
+    return contourArea(contorno) + borda / 2 + 1;
+}
+
+const vector<String> &nomesCaracteristicas()
+{
+    static const vector<String> nomes = {"area", "proporcao", "perimetro", "circularidade", "buracos",
+                                         "hu1", "hu2", "hu3", "hu4", "hu5", "hu6", "hu7"};
+    return nomes;
+}
+
+/**
+ * Momentos da regiao de um contorno externo sem os seus buracos
+ *
+ * Os momentos espaciais sao aditivos, entao os da regiao sao os do contorno
+ * externo menos os de cada contorno filho; os centrais e normalizados saem
+ * do construtor de Moments, sem desenhar a regiao.
+ *
+ * @param int indice - contorno externo
+ * @param int* num_buracos - saida do numero de contornos filhos
+ * @return Moments momentos da regiao
+ */
+static Moments momentosRegiao(const vector<vector<Point>> &contornos, const vector<Vec4i> &hierarquia, int indice, int *num_buracos)
+{
+    Moments e = moments(contornos[indice]);
+    double m[10] = {e.m00, e.m10, e.m01, e.m20, e.m11, e.m02, e.m30, e.m21, e.m12, e.m03};
+
+    int buracos = 0;
+    for (int filho = hierarquia[indice][2]; filho >= 0; filho = hierarquia[filho][0])
+    {
+        Moments b = moments(contornos[filho]);
+        double mb[10] = {b.m00, b.m10, b.m01, b.m20, b.m11, b.m02, b.m30, b.m21, b.m12, b.m03};
+        for (int k = 0; k < 10; k++)
+            m[k] -= mb[k];
+        buracos++;
+    }
+
+    *num_buracos = buracos;
+    return Moments(m[0], m[1], m[2], m[3], m[4], m[5], m[6], m[7], m[8], m[9]);
+}
+
+int ExtraiCaracteristicas(const Mat &img, Mat &caracteristicas, vector<Point> *posicoes, Mat *mascara_objeto, Point deslocamento)
+{
+    MEDE_ETAPA("caracteristicas");
+    vector<vector<Point>> contornos;
+
+    // Desde o OpenCV 3.2 o findContours nao altera a imagem de entrada
+    vector<Vec4i> hierarquia;
+    findContours(img, contornos, hierarquia, RETR_CCOMP, CHAIN_APPROX_SIMPLE, deslocamento);
+
+    // No maximo uma linha por contorno; dentro da capacidade ja alocada o resize nao realoca
+    if (caracteristicas.type() != CV_32FC1 || caracteristicas.cols != NUM_CARACTERISTICAS)
+        caracteristicas.create(0, NUM_CARACTERISTICAS, CV_32FC1);
+    caracteristicas.resize(contornos.size());
+    if (posicoes != NULL)
+        posicoes->clear();
+
+    int num_objetos = 0;
+    int ultimo_objeto = -1;
+    for (size_t i = 0; i < contornos.size(); i++)
+    {
+        // Buracos entram na area e nos momentos do contorno pai, nao sao objetos
+        if (hierarquia[i][3] >= 0)
+            continue;
+
+        // Mesma area do drawContours(FILLED) com os buracos do nivel seguinte,
+        // calculada so com a geometria do contorno, sem mascara do tamanho da imagem
+        double area = pixelsContornoPreenchido(contornos[i]);
+        for (int filho = hierarquia[i][2]; filho >= 0; filho = hierarquia[filho][0])
+        {
+            double borda_buraco = 0;
+            double pixels_buraco = pixelsContornoPreenchido(contornos[filho], &borda_buraco);
+            // Os pixels da borda do buraco pertencem ao objeto; so o interior e descontado
+            area -= pixels_buraco - borda_buraco;
+        }
+
+        if (area > AREA_MINIMA_OBJETO)
+        { // Se a area e maior do que a minima
+            RotatedRect r = minAreaRect(contornos[i]);
+            float comprimento = r.size.width;
+            float altura = r.size.height;
+            float proporcao = (comprimento < altura) ? altura / comprimento : comprimento / altura;
+
+            double perimetro = arcLength(contornos[i], true);
+            int buracos = 0;
+            double hu[7];
+            HuMoments(momentosRegiao(contornos, hierarquia, (int)i, &buracos), hu);
+
+            float *linha = caracteristicas.ptr<float>(num_objetos++);
+            linha[CARAC_AREA] = (float)area;
+            linha[CARAC_PROPORCAO] = proporcao;
+            linha[CARAC_PERIMETRO] = (float)perimetro;
+            linha[CARAC_CIRCULARIDADE] = perimetro > 0 ? (float)(4 * CV_PI * area / (perimetro * perimetro)) : 0.0f;
+            linha[CARAC_BURACOS] = (float)buracos;
+            // Os momentos de Hu variam em ordens de grandeza; em -log10 ficam na mesma escala e
+            // nao negativos, como o kernel CHI2 espera
+            for (int k = 0; k < 7; k++)
+                linha[CARAC_HU1 + k] = (float)-log10(min(max(fabs(hu[k]), 1e-30), 1.0));
+
+            if (posicoes != NULL)
+                posicoes->push_back(Point((int)r.center.x, (int)r.center.y));
+
+            ultimo_objeto = (int)i;
+        }
+    }
+    caracteristicas.resize(num_objetos);
+
+    // Mascara do ultimo objeto aceito, desenhada uma unica vez e so se pedida
+    if (mascara_objeto != NULL && ultimo_objeto >= 0)
+    {
+        *mascara_objeto = Mat::zeros(img.rows, img.cols, CV_8UC1);
+        drawContours(*mascara_objeto, contornos, ultimo_objeto, Scalar(1), FILLED, LINE_8, hierarquia, 1, -deslocamento);
+    }
+
+    return num_objetos;
+}
+
+Mat ExtraiCaracteristicas(const Mat &img)
+{
+    Mat caracteristicas;
+    ExtraiCaracteristicas(img, caracteristicas);
+    return caracteristicas;
+}
+
+Mat removeFundo(Mat img, const PadraoLuz &padrao)
+{
+    MEDE_ETAPA("fundo");
+    Mat aux;
+
+    // 255 * (1 - img / padrao) em uma passada 8 bits, exata; LUZ_DIVISAO_RECIPROCO trocaria por inteiros
+    padrao.removeLuz(img, aux, LUZ_DIVISAO);
+
+    // equalizeHist( aux, aux );
+    // aux = padrao - img;
+
+    return aux;
+}
+
+Mat removeRuido(Mat imagem)
+{
+    MEDE_ETAPA("ruido");
+    // Remove ruido
+    Mat img_sem_ruido;
+    medianBlur(imagem, img_sem_ruido, TAMANHO_MEDIANA);
+
+    return img_sem_ruido;
+}
+
+Mat thresholding(Mat img_sem_fundo, int metodo_limiar, double percentil)
+{
+    MEDE_ETAPA("limiar");
+    // Limiar automatico pelo histograma do proprio quadro; -1 mantem o fixo
+    int limiar = escolheLimiar(img_sem_fundo, metodo_limiar, percentil);
+
+    // Binariza imagem para segmentacao
+    Mat img_thr;
+    threshold(img_sem_fundo, img_thr, limiar >= 0 ? limiar : LIMIAR_BINARIZACAO, 255, THRESH_BINARY);
+
+    return img_thr;
+}
+
+Mat preProcessaImagem(Mat entrada, const PadraoLuz &padrao, int metodo_limiar, double percentil, bool fundido)
+{
+    // Mediana 3, divisao e limiar 30 numa passada por faixas; o limiar automatico precisa do quadro inteiro
+    if (fundido && metodo_limiar == LIMIAR_FIXO)
+    {
+        Mat img_thr;
+        preProcessaFundido(entrada, padrao, TAMANHO_MEDIANA, LUZ_DIVISAO, LIMIAR_BINARIZACAO, THRESH_BINARY, img_thr);
+        return img_thr;
+    }
+
+    // Remove rudo
+    Mat img_sem_ruido = removeRuido(entrada);
+
+    // Remove fundo
+    Mat img_sem_fundo = removeFundo(img_sem_ruido, padrao);
+
+    // Binariza imagem para segmentao
+    return thresholding(img_sem_fundo, metodo_limiar, percentil);
+}
+
+Ptr<SVM> criaSVM(const ParametrosSVM &parametros)
+{
+    // Define os parmetros da SVM
+    Ptr<SVM> svm = SVM::create();
+    svm->setType(SVM::C_SVC);
+    svm->setKernel(parametros.kernel);
+    svm->setC(parametros.C);
+    svm->setGamma(parametros.gamma);
+    if (parametros.kernel == SVM::POLY)
+        svm->setDegree(parametros.grau);
+    svm->setTermCriteria(TermCriteria(TermCriteria::MAX_ITER, parametros.max_iter, 1e-6));
+
+    return svm;
+}
@@ -0,0 +1,114 @@
+/**
+ * Etapas de classificacao do AOI_ML
+ *
+ * Pre-processamento, extracao de caracteristicas e criacao da SVM,
+ * usados pelo treinamento, pela classificacao interativa, pelo stream
+ * e pelo benchmark.
+ *
+ */
+
+#ifndef CLASSIFICACAO_h
+#define CLASSIFICACAO_h
+
+#include <vector>
+using namespace std;
+
+// OpenCV includes
+#include "opencv2/core.hpp"
+#include "opencv2/ml.hpp"
+using namespace cv;
+using namespace cv::ml;
+
+#include "PadraoLuz.h"
+#include "Histograma.h"
+#include "ModeloSVM.h"
+
+/**
+ * Colunas da matriz de caracteristicas, uma linha por objeto
+ */
+enum ColunaCaracteristica
+{
+    CARAC_AREA,          // pixels do objeto, sem o interior dos buracos
+    CARAC_PROPORCAO,     // lado maior / lado menor do minAreaRect
+    CARAC_PERIMETRO,     // comprimento do contorno externo
+    CARAC_CIRCULARIDADE, // 4 pi area / perimetro^2, perto de 1 para um disco
+    CARAC_BURACOS,       // contornos filhos na hierarquia RETR_CCOMP
+    CARAC_HU1,           // 7 momentos de Hu da regiao com buracos, em -log10 |h|
+    NUM_CARACTERISTICAS = CARAC_HU1 + 7
+};
+
+/**
+ * Parametros fixos do pre-processamento e da extracao; entram na impressao digital do modelo
+ */
+const int TAMANHO_MEDIANA = 3;      // mediana do quadro e do padrao de fundo
+const int LIMIAR_BINARIZACAO = 30;  // limiar fixo depois da remocao de luz
+const int AREA_MINIMA_OBJETO = 500; // objetos com ate esta area sao descartados
+
+/**
+ * Nome de cada coluna da matriz de caracteristicas, na ordem de ColunaCaracteristica
+ */
+const vector<String> &nomesCaracteristicas();
+
+/**
+ * Extrai as caracteristicas de todos os objetos de uma imagem binaria
+ *
+ * Tudo sai do mesmo laco sobre os contornos: a area pelo teorema de Pick, o
+ * perimetro, os buracos pela hierarquia e os momentos de Hu pela soma dos
+ * momentos do contorno externo menos os dos buracos, sem desenhar mascaras.
+ * Cada objeto vira uma linha de `caracteristicas`, ja no formato da SVM. A
+ * matriz so e realocada quando a sua capacidade nao comporta os contornos
+ * do quadro, entao reaproveitar a mesma matriz evita alocacoes por quadro.
+ *
+ * @param Mat img - imagem binaria de entrada
+ * @param Mat caracteristicas - saida N x NUM_CARACTERISTICAS CV_32F, uma linha por objeto
+ * @param vector<Point>* posicoes - saida opcional do centro de cada objeto
+ * @param Mat* mascara_objeto - saida opcional da mascara (0/1) do ultimo objeto aceito
+ * @param Point deslocamento - posicao de img no quadro, somada aos contornos quando img e uma regiao
+ * @return int numero de objetos, igual a caracteristicas.rows
+ **/
+int ExtraiCaracteristicas(const Mat &img, Mat &caracteristicas, vector<Point> *posicoes = NULL, Mat *mascara_objeto = NULL,
+                          Point deslocamento = Point());
+
+/**
+ * Atalho que devolve uma matriz nova com as caracteristicas de cada objeto
+ */
+Mat ExtraiCaracteristicas(const Mat &img);
+
+/**
+ * Remove th light and return new image without light
+ * @param img Mat image to remove the light pattern
+ * @param pattern PadraoLuz light pattern, already smoothed, with its fixed-point reciprocal
+ * @return a new image Mat without light
+ */
+Mat removeFundo(Mat img, const PadraoLuz &padrao);
+
+/**
+ * Remove ruido com filtro de mediana 3x3
+ */
+Mat removeRuido(Mat imagem);
+
+/**
+ * Binariza a imagem sem fundo com limiar fixo 30 ou escolhido pelo histograma da imagem
+ * @param int metodo_limiar - LIMIAR_FIXO ou um MetodoLimiar automatico
+ * @param double percentil - porcentagem de pixels de fundo com LIMIAR_PERCENTIL
+ */
+Mat thresholding(Mat img_sem_fundo, int metodo_limiar = LIMIAR_FIXO, double percentil = 90);
+
+/**
+ * Preprocess an input image to extract components and stats
+ * @params Mat input image to preprocess
+ * @param padrao PadraoLuz background light pattern
+ * @param int metodo_limiar - see thresholding()
+ * @param double percentil - see thresholding()
+ * @param bool fundido - with the fixed threshold, one strip-wise pass (preProcessaFundido), same output
+ * @return Mat binary image
+ */
+Mat preProcessaImagem(Mat entrada, const PadraoLuz &padrao, int metodo_limiar = LIMIAR_FIXO, double percentil = 90,
+                      bool fundido = false);
+
+/**
+ * SVM com os hiper-parametros do treinamento; os padrao sao C_SVC, kernel CHI2 e 100 iteracoes
+ */
+Ptr<SVM> criaSVM(const ParametrosSVM &parametros = ParametrosSVM());
+
+#endif
@@ -0,0 +1,257 @@
+#include "ClassificadorOnline.h"
+#include "Classificacao.h"
+
+#include <cmath>
+#include <map>
+#include <mutex>
+#include <algorithm>
+#include <iostream>
+
+ClassificadorOnline::ClassificadorOnline()
+    : lado(1), num_novas(0), retreino_a_cada(0), k(3), retreinando(false), retreinos(0)
+{
+    minimo[0] = minimo[1] = 0;
+    escala[0] = escala[1] = 1;
+}
+
+ClassificadorOnline::~ClassificadorOnline()
+{
+    aguardaRetreino();
+}
+
+bool ClassificadorOnline::inicia(const Ptr<SVM> &svm, const MetadadosModelo &meta, const Mat &amostras_treino, const Mat &rotulos,
+                                 const ParametrosSVM &parametros, int retreino_a_cada_, int k_)
+{
+    CV_Assert(amostras_treino.empty() || (amostras_treino.type() == CV_32FC1 && amostras_treino.cols >= 2));
+    CV_Assert(rotulos.empty() || rotulos.type() == CV_32SC1);
+    CV_Assert(amostras_treino.rows == rotulos.rows);
+
+    aguardaRetreino();
+
+    shared_ptr<InferenciaSVM> compilada = make_shared<InferenciaSVM>();
+    if (amostras_treino.empty() || svm.empty() || !compilada->compila(svm, meta.minimo, meta.maximo))
+        return false;
+
+    unique_lock<shared_mutex> lock(trava);
+    inferencia = compilada;
+    minimo_treino = meta.minimo.clone();
+    maximo_treino = meta.maximo.clone();
+    parametros_svm = parametros;
+    retreino_a_cada = retreino_a_cada_;
+    k = max(1, k_);
+    num_novas = 0;
+    dados = amostras_treino.clone();
+    respostas = rotulos.clone();
+    amostras.clear();
+    for (int i = 0; i < amostras_treino.rows; i++)
+    {
+        Amostra amostra;
+        amostra.area = amostras_treino.at<float>(i, CARAC_AREA);
+        amostra.proporcao = amostras_treino.at<float>(i, CARAC_PROPORCAO);
+        amostra.rotulo = rotulos.at<int>(i);
+        amostra.nova = false;
+        amostras.push_back(amostra);
+    }
+    refazGrade();
+    return true;
+}
+
+void ClassificadorOnline::normaliza(Amostra &amostra) const
+{
+    amostra.x = (amostra.area - minimo[0]) * escala[0];
+    amostra.y = (amostra.proporcao - minimo[1]) * escala[1];
+}
+
+int ClassificadorOnline::celula(float x, float y) const
+{
+    // Fora da faixa do treinamento fica nas celulas da borda
+    int cx = min(lado - 1, max(0, (int)floor(x * lado)));
+    int cy = min(lado - 1, max(0, (int)floor(y * lado)));
+    return cy * lado + cx;
+}
+
+void ClassificadorOnline::refazGrade()
+{
+    // Faixa de todas as amostras atuais; cerca de 4 amostras por celula
+    float maximo[2] = {amostras[0].area, amostras[0].proporcao};
+    minimo[0] = maximo[0];
+    minimo[1] = maximo[1];
+    for (size_t i = 1; i < amostras.size(); i++)
+    {
+        minimo[0] = min(minimo[0], amostras[i].area);
+        maximo[0] = max(maximo[0], amostras[i].area);
+        minimo[1] = min(minimo[1], amostras[i].proporcao);
+        maximo[1] = max(maximo[1], amostras[i].proporcao);
+    }
+    for (int c = 0; c < 2; c++)
+        escala[c] = maximo[c] > minimo[c] ? 1.0f / (maximo[c] - minimo[c]) : 1.0f;
+
+    lado = max(1, (int)sqrt(amostras.size() / 4.0));
+    celulas.assign(lado * lado, vector<int>());
+    for (size_t i = 0; i < amostras.size(); i++)
+    {
+        normaliza(amostras[i]);
+        celulas[celula(amostras[i].x, amostras[i].y)].push_back((int)i);
+    }
+}
+
+void ClassificadorOnline::adiciona(const Mat &caracteristicas, int rotulo)
+{
+    CV_Assert(caracteristicas.type() == CV_32FC1 && caracteristicas.rows == 1);
+
+    unique_lock<shared_mutex> lock(trava);
+    CV_Assert(inferencia && caracteristicas.cols == dados.cols);
+
+    Amostra amostra;
+    amostra.area = caracteristicas.at<float>(0, CARAC_AREA);
+    amostra.proporcao = caracteristicas.at<float>(0, CARAC_PROPORCAO);
+    amostra.rotulo = rotulo;
+    amostra.nova = true;
+    normaliza(amostra);
+    amostras.push_back(amostra);
+    dados.push_back(caracteristicas);
+    respostas.push_back(rotulo);
+    celulas[celula(amostra.x, amostra.y)].push_back((int)amostras.size() - 1);
+    num_novas++;
+
+    if (retreino_a_cada > 0 && num_novas >= retreino_a_cada)
+        disparaRetreino();
+}
+
+void ClassificadorOnline::disparaRetreino()
+{
+    // Chamada com a trava exclusiva; so um retreino por vez
+    if (retreinando)
+        return;
+    // O retreino anterior ja trocou a SVM e soltou a trava, o join nao espera por ela
+    if (retreino.joinable())
+        retreino.join();
+
+    // Copia: as insercoes durante o retreino podem realocar as matrizes
+    Mat dados_retreino = dados.clone();
+    Mat respostas_retreino = respostas.clone();
+    int incluidas = dados_retreino.rows;
+
+    retreinando = true;
+    retreino = thread([this, dados_retreino, respostas_retreino, incluidas]() {
+        shared_ptr<InferenciaSVM> compilada = make_shared<InferenciaSVM>();
+        bool ok = false;
+        try
+        {
+            // minimo_treino e maximo_treino so mudam em inicia(), que espera este retreino
+            Mat normalizados;
+            aplicaNormalizacao(dados_retreino, minimo_treino, maximo_treino, normalizados);
+            Ptr<SVM> svm = criaSVM(parametros_svm);
+            svm->train(normalizados, ROW_SAMPLE, respostas_retreino);
+            ok = compilada->compila(svm, minimo_treino, maximo_treino);
+        }
+        catch (const cv::Exception &e)
+        {
+            // Uma excecao aqui encerraria o programa; o modelo atual continua valendo
+            cout << "Erro no retreino em segundo plano: " << e.what() << endl;
+        }
+
+        if (ok)
+        {
+            // Troca a SVM e refaz a grade de uma vez: a classificacao ve o modelo antigo ou o novo inteiro
+            unique_lock<shared_mutex> lock(trava);
+            inferencia = compilada;
+            for (int i = 0; i < incluidas; i++)
+                amostras[i].nova = false;
+            num_novas = (int)amostras.size() - incluidas;
+            refazGrade();
+            retreinos++;
+        }
+        retreinando = false;
+    });
+}
+
+int ClassificadorOnline::vota(float x, float y, int rotulo_svm) const
+{
+    // Os k mais proximos, ordenados pela distancia; aneis de celulas ao redor da celula da consulta
+    vector<pair<float, int>> vizinhos;
+    int c = celula(x, y);
+    int cx = c % lado, cy = c / lado;
+    float tamanho_celula = 1.0f / lado;
+    for (int anel = 0; anel < lado; anel++)
+    {
+        // Nenhum ponto deste anel fica a menos de (anel - 1) celulas da consulta
+        if ((int)vizinhos.size() == k && vizinhos.back().first < (anel - 1) * tamanho_celula * (anel - 1) * tamanho_celula)
+            break;
+
+        for (int gy = max(0, cy - anel); gy <= min(lado - 1, cy + anel); gy++)
+        {
+            for (int gx = max(0, cx - anel); gx <= min(lado - 1, cx + anel); gx++)
+            {
+                if (max(abs(gx - cx), abs(gy - cy)) != anel)
+                    continue;
+                const vector<int> &indices = celulas[gy * lado + gx];
+                for (size_t i = 0; i < indices.size(); i++)
+                {
+                    const Amostra &a = amostras[indices[i]];
+                    float d = (a.x - x) * (a.x - x) + (a.y - y) * (a.y - y);
+                    if ((int)vizinhos.size() == k && d >= vizinhos.back().first)
+                        continue;
+                    if ((int)vizinhos.size() == k)
+                        vizinhos.pop_back();
+                    vizinhos.insert(upper_bound(vizinhos.begin(), vizinhos.end(), make_pair(d, indices[i])), make_pair(d, indices[i]));
+                }
+            }
+        }
+    }
+
+    bool tem_nova = false;
+    for (size_t i = 0; i < vizinhos.size(); i++)
+        tem_nova = tem_nova || amostras[vizinhos[i].second].nova;
+    if (!tem_nova)
+        return rotulo_svm;
+
+    // Voto dos vizinhos; no empate vence a classe do mais proximo
+    map<int, int> votos;
+    for (size_t i = 0; i < vizinhos.size(); i++)
+        votos[amostras[vizinhos[i].second].rotulo]++;
+    int vencedor = amostras[vizinhos[0].second].rotulo;
+    for (map<int, int>::const_iterator v = votos.begin(); v != votos.end(); ++v)
+    {
+        if (v->second > votos[vencedor])
+            vencedor = v->first;
+    }
+    return vencedor;
+}
+
+vector<float> ClassificadorOnline::classifica(const Mat &caracteristicas) const
+{
+    vector<float> classes;
+    if (caracteristicas.empty())
+        return classes;
+
+    shared_lock<shared_mutex> lock(trava);
+    Mat resultados;
+    inferencia->prediz(caracteristicas, resultados);
+    for (int i = 0; i < caracteristicas.rows; i++)
+    {
+        Amostra consulta;
+        consulta.area = caracteristicas.at<float>(i, CARAC_AREA);
+        consulta.proporcao = caracteristicas.at<float>(i, CARAC_PROPORCAO);
+        normaliza(consulta);
+        classes.push_back((float)vota(consulta.x, consulta.y, (int)resultados.at<float>(i)));
+    }
+    return classes;
+}
+
+int ClassificadorOnline::numNovas() const
+{
+    shared_lock<shared_mutex> lock(trava);
+    return num_novas;
+}
+
+int ClassificadorOnline::numRetreinos() const
+{
+    return retreinos;
+}
+
+void ClassificadorOnline::aguardaRetreino()
+{
+    if (retreino.joinable())
+        retreino.join();
+}
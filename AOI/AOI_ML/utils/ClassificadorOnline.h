@@ -0,0 +1,129 @@
+/**
+ * Classificador online
+ *
+ * Aceita exemplos rotulados pelo operador enquanto o stream classifica,
+ * sem retreinar a SVM. As amostras do treinamento e as novas ficam num
+ * indice de vizinhos mais proximos (grade uniforme sobre a area e a
+ * proporcao normalizadas pela faixa do treinamento), e inserir uma amostra
+ * e so acrescenta-la a uma celula da grade e uma linha a matriz de retreino.
+ *
+ * Cada objeto e classificado pela SVM, a nao ser que algum dos k vizinhos
+ * mais proximos seja uma amostra nova: ai vale o voto dos k vizinhos. Longe
+ * dos exemplos novos o resultado continua o da SVM; perto deles a correcao
+ * do operador vale na hora.
+ *
+ * A cada retreino_a_cada amostras novas uma SVM e treinada em segundo plano
+ * com todas as amostras, os mesmos hiper-parametros e a mesma faixa de
+ * normalizacao do modelo original, sem separar teste. Quando termina, a SVM
+ * e trocada de uma vez, junto com a grade refeita, e as amostras que ela ja
+ * viu deixam de ser novas; as inseridas durante o retreino continuam novas.
+ *
+ * classifica() pode rodar em varias threads ao mesmo tempo que adiciona();
+ * ambas so seguram a trava pelo tempo de uma consulta ou de uma insercao.
+ *
+ */
+
+#ifndef CLASSIFICADOR_ONLINE_h
+#define CLASSIFICADOR_ONLINE_h
+
+#include <vector>
+#include <memory>
+#include <thread>
+#include <atomic>
+#include <shared_mutex>
+using namespace std;
+
+// OpenCV includes
+#include "opencv2/core.hpp"
+#include "opencv2/ml.hpp"
+using namespace cv;
+using namespace cv::ml;
+
+#include "InferenciaSVM.h"
+#include "ModeloSVM.h"
+
+class ClassificadorOnline
+{
+public:
+    ClassificadorOnline();
+
+    /**
+     * Espera o retreino em andamento
+     */
+    ~ClassificadorOnline();
+
+    /**
+     * @param Ptr<SVM> svm - SVM treinada com as amostras
+     * @param MetadadosModelo meta - metadados da SVM, com a faixa usada na normalizacao
+     * @param Mat amostras - amostras do treinamento sem normalizar, N x M CV_32F com a area e a proporcao nas 2 primeiras colunas
+     * @param Mat rotulos - rotulo de cada amostra, N x 1 CV_32S
+     * @param ParametrosSVM parametros - hiper-parametros usados nos retreinos
+     * @param int retreino_a_cada - amostras novas que disparam o retreino em segundo plano, 0 nunca retreina
+     * @param int k - vizinhos consultados
+     * @return bool false se a SVM nao esta treinada ou nao ha amostras
+     */
+    bool inicia(const Ptr<SVM> &svm, const MetadadosModelo &meta, const Mat &amostras, const Mat &rotulos,
+                const ParametrosSVM &parametros, int retreino_a_cada = 50, int k = 3);
+
+    /**
+     * Insere uma amostra rotulada; vale ja na proxima classificacao
+     * @param Mat caracteristicas - linha 1 x M do objeto, com as colunas das amostras do treinamento
+     * @param int rotulo - classe dada pelo operador
+     */
+    void adiciona(const Mat &caracteristicas, int rotulo);
+
+    /**
+     * Classifica todos os objetos de um quadro
+     * @param Mat caracteristicas - N x M CV_32F, uma linha por objeto, sem normalizar
+     * @return vector<float> classe de cada objeto
+     */
+    vector<float> classifica(const Mat &caracteristicas) const;
+
+    /**
+     * Amostras que a SVM atual ainda nao viu
+     */
+    int numNovas() const;
+
+    /**
+     * Retreinos em segundo plano ja concluidos
+     */
+    int numRetreinos() const;
+
+    /**
+     * Espera o retreino em andamento, se houver
+     */
+    void aguardaRetreino();
+
+private:
+    struct Amostra
+    {
+        float area, proporcao; // valores originais
+        float x, y;            // normalizados pela faixa do treinamento
+        int rotulo;
+        bool nova;
+    };
+
+    mutable shared_mutex trava;
+    shared_ptr<InferenciaSVM> inferencia;
+    vector<Amostra> amostras;
+    Mat dados, respostas;        // todas as caracteristicas e rotulos, na ordem de amostras, para o retreino
+    Mat minimo_treino, maximo_treino; // normalizacao da SVM, mantida nos retreinos
+    vector<vector<int>> celulas; // indice das amostras em cada celula da grade, linha a linha
+    int lado;                    // celulas em cada eixo
+    float minimo[2], escala[2];
+    int num_novas;
+    int retreino_a_cada, k;
+    ParametrosSVM parametros_svm;
+
+    thread retreino;
+    atomic<bool> retreinando;
+    atomic<int> retreinos;
+
+    void normaliza(Amostra &amostra) const;
+    int celula(float x, float y) const;
+    void refazGrade();
+    void disparaRetreino();
+    int vota(float x, float y, int rotulo_svm) const;
+};
+
+#endif
@@ -0,0 +1,292 @@
+#include "CorpusEmpacotado.h"
+#include "ImagemPGM.h"
+#include "ThreadsOpenCV.h"
+
+#include <cstring>
+#include <thread>
+#include <atomic>
+#include <filesystem>
+
+// Cabecalho do corpus; o indice fica no fim do arquivo, em deslocamento_indice
+struct CabecalhoCorpus
+{
+    char magica[4];
+    uint32_t versao;
+    uint32_t num_quadros;
+    uint32_t ordem_bytes; // ORDEM_BYTES_CORPUS na ordem de bytes de quem gravou
+    uint64_t deslocamento_indice;
+    char impressao_origem[32];
+    char descricao_mascaras[192];
+};
+
+// Os campos ja caem alinhados: sem padding, o layout no arquivo e o mesmo em qualquer ABI de 32 ou 64 bits
+static_assert(sizeof(CabecalhoCorpus) == 248, "CabecalhoCorpus com padding");
+static_assert(sizeof(EntradaCorpus) == 32, "EntradaCorpus com padding");
+
+static const char MAGICA_CORPUS[4] = {'A', 'O', 'I', 'C'};
+static const uint32_t VERSAO_CORPUS = 2;
+static const uint32_t ORDEM_BYTES_CORPUS = 0x01020304;
+static const uint64_t ALINHAMENTO_CORPUS = 64;
+
+GravadorCorpus::GravadorCorpus()
+    : posicao(0)
+{
+}
+
+GravadorCorpus::~GravadorCorpus()
+{
+    if (saida.is_open())
+    {
+        saida.close();
+        std::error_code erro;
+        std::filesystem::remove(temporario.c_str(), erro);
+    }
+}
+
+bool GravadorCorpus::abre(const String &arquivo, const String &descricao_mascaras)
+{
+    if (descricao_mascaras.size() >= sizeof(CabecalhoCorpus().descricao_mascaras))
+        return false;
+
+    // Reescrever o corpus no lugar truncaria o arquivo sob quem o tem mapeado (SIGBUS)
+    destino = arquivo;
+    temporario = arquivo + ".tmp";
+    saida.open(temporario.c_str(), ios::binary | ios::trunc);
+    if (!saida)
+        return false;
+    descricao = descricao_mascaras;
+    entradas.clear();
+
+    // Cabecalho provisorio, reescrito por fecha() com o numero de quadros e o indice
+    CabecalhoCorpus cabecalho;
+    memset(&cabecalho, 0, sizeof(cabecalho));
+    saida.write((const char *)&cabecalho, sizeof(cabecalho));
+    posicao = sizeof(cabecalho);
+    return saida.good();
+}
+
+// Completa com zeros ate o proximo multiplo de ALINHAMENTO_CORPUS
+void GravadorCorpus::alinha()
+{
+    static const char zeros[ALINHAMENTO_CORPUS] = {};
+    uint64_t resto = posicao % ALINHAMENTO_CORPUS;
+    if (resto != 0)
+    {
+        saida.write(zeros, ALINHAMENTO_CORPUS - resto);
+        posicao += ALINHAMENTO_CORPUS - resto;
+    }
+}
+
+bool GravadorCorpus::escreveAlinhado(const Mat &img, uint64_t &deslocamento)
+{
+    alinha();
+    deslocamento = posicao;
+    if (img.isContinuous())
+        saida.write((const char *)img.data, img.total());
+    else
+    {
+        for (int y = 0; y < img.rows; y++)
+            saida.write((const char *)img.ptr<uchar>(y), img.cols);
+    }
+    posicao += img.total();
+    return saida.good();
+}
+
+bool GravadorCorpus::adiciona(const Mat &img, int rotulo, bool teste, const Mat &mascara)
+{
+    if (!saida.is_open() || img.empty() || img.type() != CV_8UC1)
+        return false;
+    bool com_mascara = !descricao.empty();
+    if (com_mascara && (mascara.size() != img.size() || mascara.type() != CV_8UC1))
+        return false;
+
+    EntradaCorpus entrada;
+    memset(&entrada, 0, sizeof(entrada));
+    entrada.largura = img.cols;
+    entrada.altura = img.rows;
+    entrada.rotulo = rotulo;
+    entrada.teste = teste ? 1 : 0;
+    if (!escreveAlinhado(img, entrada.deslocamento_quadro))
+        return false;
+    if (com_mascara && !escreveAlinhado(mascara, entrada.deslocamento_mascara))
+        return false;
+
+    entradas.push_back(entrada);
+    return true;
+}
+
+bool GravadorCorpus::fecha(const String &impressao_origem)
+{
+    if (!saida.is_open())
+        return false;
+
+    // abre() so aceita o indice alinhado, para le-lo no lugar
+    alinha();
+
+    CabecalhoCorpus cabecalho;
+    memset(&cabecalho, 0, sizeof(cabecalho));
+    memcpy(cabecalho.magica, MAGICA_CORPUS, 4);
+    cabecalho.versao = VERSAO_CORPUS;
+    cabecalho.num_quadros = (uint32_t)entradas.size();
+    cabecalho.ordem_bytes = ORDEM_BYTES_CORPUS;
+    cabecalho.deslocamento_indice = posicao;
+    strncpy(cabecalho.impressao_origem, impressao_origem.c_str(), sizeof(cabecalho.impressao_origem) - 1);
+    strncpy(cabecalho.descricao_mascaras, descricao.c_str(), sizeof(cabecalho.descricao_mascaras) - 1);
+
+    if (!entradas.empty())
+        saida.write((const char *)&entradas[0], entradas.size() * sizeof(EntradaCorpus));
+    saida.seekp(0);
+    saida.write((const char *)&cabecalho, sizeof(cabecalho));
+    saida.close();
+
+    bool ok = !saida.fail();
+    entradas.clear();
+
+    std::error_code erro;
+    if (ok)
+        std::filesystem::rename(temporario.c_str(), destino.c_str(), erro);
+    if (!ok || erro)
+    {
+        std::filesystem::remove(temporario.c_str(), erro);
+        return false;
+    }
+    return true;
+}
+
+CorpusEmpacotado::CorpusEmpacotado()
+    : entradas(NULL), num_quadros(0)
+{
+}
+
+static bool dentroDoArquivo(uint64_t deslocamento, const EntradaCorpus &entrada, uint64_t limite)
+{
+    uint64_t tamanho = (uint64_t)entrada.largura * (uint64_t)entrada.altura;
+    return deslocamento >= sizeof(CabecalhoCorpus) && deslocamento <= limite && tamanho <= limite - deslocamento;
+}
+
+bool CorpusEmpacotado::abre(const String &arquivo)
+{
+    bytes.release();
+    entradas = NULL;
+    num_quadros = 0;
+
+    Mat mapeado = mapeiaArquivo(arquivo);
+    if (mapeado.empty() || mapeado.total() < sizeof(CabecalhoCorpus))
+        return false;
+
+    CabecalhoCorpus cabecalho;
+    memcpy(&cabecalho, mapeado.data, sizeof(cabecalho));
+    uint64_t tamanho = mapeado.total();
+    // Gravado numa maquina de outra ordem de bytes, a marca aparece invertida: o indice nao pode ser lido no lugar
+    if (memcmp(cabecalho.magica, MAGICA_CORPUS, 4) != 0 || cabecalho.ordem_bytes != ORDEM_BYTES_CORPUS ||
+        cabecalho.versao != VERSAO_CORPUS ||
+        cabecalho.deslocamento_indice % ALINHAMENTO_CORPUS != 0 || cabecalho.deslocamento_indice > tamanho ||
+        (tamanho - cabecalho.deslocamento_indice) / sizeof(EntradaCorpus) < cabecalho.num_quadros ||
+        memchr(cabecalho.impressao_origem, 0, sizeof(cabecalho.impressao_origem)) == NULL ||
+        memchr(cabecalho.descricao_mascaras, 0, sizeof(cabecalho.descricao_mascaras)) == NULL)
+        return false;
+
+    // O indice esta alinhado a 64 bytes dentro do mapeamento, pode ser lido no lugar
+    const EntradaCorpus *indice = (const EntradaCorpus *)(mapeado.data + cabecalho.deslocamento_indice);
+    bool com_mascaras = cabecalho.descricao_mascaras[0] != 0;
+    for (uint32_t i = 0; i < cabecalho.num_quadros; i++)
+    {
+        const EntradaCorpus &entrada = indice[i];
+        if (entrada.largura <= 0 || entrada.altura <= 0 ||
+            !dentroDoArquivo(entrada.deslocamento_quadro, entrada, cabecalho.deslocamento_indice) ||
+            (com_mascaras && !dentroDoArquivo(entrada.deslocamento_mascara, entrada, cabecalho.deslocamento_indice)))
+            return false;
+    }
+
+    bytes = mapeado;
+    entradas = indice;
+    num_quadros = (int)cabecalho.num_quadros;
+    return true;
+}
+
+int CorpusEmpacotado::numQuadros() const
+{
+    return num_quadros;
+}
+
+int CorpusEmpacotado::rotulo(int indice) const
+{
+    CV_Assert(indice >= 0 && indice < num_quadros);
+    return entradas[indice].rotulo;
+}
+
+bool CorpusEmpacotado::teste(int indice) const
+{
+    CV_Assert(indice >= 0 && indice < num_quadros);
+    return entradas[indice].teste != 0;
+}
+
+static Mat vistaPixels(const Mat &bytes, uint64_t deslocamento, const EntradaCorpus &entrada)
+{
+    int inicio = (int)deslocamento;
+    return bytes.colRange(inicio, inicio + entrada.largura * entrada.altura).reshape(1, entrada.altura);
+}
+
+Mat CorpusEmpacotado::quadro(int indice) const
+{
+    CV_Assert(indice >= 0 && indice < num_quadros);
+    return vistaPixels(bytes, entradas[indice].deslocamento_quadro, entradas[indice]);
+}
+
+Mat CorpusEmpacotado::mascara(int indice) const
+{
+    CV_Assert(indice >= 0 && indice < num_quadros);
+    if (!temMascaras())
+        return Mat();
+    return vistaPixels(bytes, entradas[indice].deslocamento_mascara, entradas[indice]);
+}
+
+bool CorpusEmpacotado::temMascaras() const
+{
+    return !bytes.empty() && ((const CabecalhoCorpus *)bytes.data)->descricao_mascaras[0] != 0;
+}
+
+String CorpusEmpacotado::descricaoMascaras() const
+{
+    if (bytes.empty())
+        return String();
+    return String(((const CabecalhoCorpus *)bytes.data)->descricao_mascaras);
+}
+
+String CorpusEmpacotado::impressaoOrigem() const
+{
+    if (bytes.empty())
+        return String();
+    return String(((const CabecalhoCorpus *)bytes.data)->impressao_origem);
+}
+
+vector<CaracteristicasQuadro> processaCorpus(const CorpusEmpacotado &corpus, function<CaracteristicasQuadro(int)> processa,
+                                             int num_threads)
+{
+    int num_quadros = corpus.numQuadros();
+    vector<CaracteristicasQuadro> resultados(num_quadros);
+    if (num_quadros == 0)
+        return resultados;
+
+    if (num_threads <= 0)
+        num_threads = max(1, (int)thread::hardware_concurrency());
+    num_threads = min(num_threads, num_quadros);
+
+    // Um quadro por thread: o paralelismo interno do OpenCV so atrapalharia
+    RestauraThreadsOpenCV restaura;
+    setNumThreads(0);
+
+    atomic<int> proximo(0);
+    vector<thread> trabalhadores;
+    for (int t = 0; t < num_threads; t++)
+    {
+        trabalhadores.push_back(thread([&]() {
+            for (int indice = proximo++; indice < num_quadros; indice = proximo++)
+                resultados[indice] = processa(indice);
+        }));
+    }
+    for (size_t t = 0; t < trabalhadores.size(); t++)
+        trabalhadores[t].join();
+
+    return resultados;
+}
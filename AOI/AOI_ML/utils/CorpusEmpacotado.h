@@ -0,0 +1,170 @@
+/**
+ * Corpus de treinamento empacotado
+ *
+ * Um unico arquivo com todos os quadros do dataset, os seus rotulos e a
+ * marcacao de teste/treino, no lugar de centenas de PGMs abertos um a um:
+ *
+ *   cabecalho | pixels do quadro 0 | mascara 0 | pixels do quadro 1 | ... | indice
+ *
+ * Cada quadro e guardado em cinza 8 bits, linha a linha e sem padding,
+ * comecando num deslocamento multiplo de 64 bytes; opcionalmente vem logo
+ * depois a mascara ja binarizada do quadro. O indice no fim do arquivo, tambem
+ * num multiplo de 64 bytes, tem uma entrada por quadro (deslocamentos,
+ * tamanho, rotulo e teste).
+ *
+ * Cabecalho e indice sao gravados como as structs estao na memoria, na
+ * ordem de bytes da maquina que gravou, para o indice ser lido no lugar,
+ * sem conversao. O cabecalho leva uma marca de ordem de bytes e abre()
+ * recusa um corpus gravado numa maquina de outra ordem: nesse caso basta
+ * empacotar de novo com -pack.
+ *
+ * A leitura mapeia o arquivo inteiro (mapeiaArquivo) e cada quadro vira um
+ * Mat que aponta direto para o mapeamento: abrir o corpus e uma unica
+ * leitura sequencial, e o acesso a qualquer quadro e aleatorio e sem copia.
+ *
+ */
+
+#ifndef CORPUS_EMPACOTADO_h
+#define CORPUS_EMPACOTADO_h
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <fstream>
+#include <functional>
+using namespace std;
+
+// OpenCV includes
+#include "opencv2/core.hpp"
+using namespace cv;
+
+#include "Dataset.h"
+
+/**
+ * Entrada do indice do corpus, uma por quadro
+ */
+struct EntradaCorpus
+{
+    uint64_t deslocamento_quadro;
+    uint64_t deslocamento_mascara; // 0 sem mascara
+    int32_t largura;
+    int32_t altura;
+    int32_t rotulo;
+    int32_t teste; // 1 se o quadro e reservado para teste
+};
+
+/**
+ * Grava um corpus empacotado quadro a quadro, sem guardar os quadros na memoria
+ */
+class GravadorCorpus
+{
+public:
+    GravadorCorpus();
+
+    /**
+     * Apaga o arquivo temporario se fecha() nao foi chamado
+     */
+    ~GravadorCorpus();
+
+    /**
+     * Grava em <arquivo>.tmp, que so substitui o corpus existente em fecha(): quem
+     * esta com o corpus antigo mapeado continua lendo o arquivo antigo
+     * @param String arquivo - corpus a gravar, substitui o existente
+     * @param String descricao_mascaras - como as mascaras foram geradas (pre-processamento e padrao de fundo); vazio sem mascaras
+     * @return bool false se o arquivo nao pode ser criado
+     */
+    bool abre(const String &arquivo, const String &descricao_mascaras = String());
+
+    /**
+     * Acrescenta um quadro ao corpus
+     * @param Mat img - quadro CV_8UC1
+     * @param int rotulo - classe do quadro
+     * @param bool teste - true se o quadro e reservado para teste
+     * @param Mat mascara - mascara binarizada do quadro, do mesmo tamanho; obrigatoria se abre() recebeu uma descricao
+     * @return bool false com tipo ou tamanho invalido ou erro de escrita
+     */
+    bool adiciona(const Mat &img, int rotulo, bool teste, const Mat &mascara = Mat());
+
+    /**
+     * Grava o indice e o cabecalho final e renomeia o temporario para o corpus
+     * @param String impressao_origem - impressao digital das imagens de origem, ex. de impressaoDigital()
+     * @return bool false com erro de escrita ou se o corpus nao pode ser substituido
+     */
+    bool fecha(const String &impressao_origem);
+
+private:
+    ofstream saida;
+    String destino;
+    String temporario;
+    String descricao;
+    vector<EntradaCorpus> entradas;
+    uint64_t posicao;
+
+    void alinha();
+    bool escreveAlinhado(const Mat &img, uint64_t &deslocamento);
+};
+
+/**
+ * Corpus empacotado aberto para leitura
+ */
+class CorpusEmpacotado
+{
+public:
+    CorpusEmpacotado();
+
+    /**
+     * Mapeia o corpus e confere o cabecalho e o indice
+     * @param String arquivo - corpus gravado pelo GravadorCorpus
+     * @return bool false se o arquivo nao existe, e de outra versao, de outra ordem de bytes ou esta truncado
+     */
+    bool abre(const String &arquivo);
+
+    int numQuadros() const;
+    int rotulo(int indice) const;
+    bool teste(int indice) const;
+
+    /**
+     * @return Mat quadro em cinza, vista do mapeamento sem copia
+     */
+    Mat quadro(int indice) const;
+
+    /**
+     * @return Mat mascara binarizada do quadro, vista sem copia; vazia num corpus sem mascaras
+     */
+    Mat mascara(int indice) const;
+
+    bool temMascaras() const;
+
+    /**
+     * @return String descricao das mascaras passada ao GravadorCorpus, vazia sem mascaras
+     */
+    String descricaoMascaras() const;
+
+    /**
+     * @return String impressao digital das imagens de origem passada ao GravadorCorpus
+     */
+    String impressaoOrigem() const;
+
+private:
+    Mat bytes;
+    const EntradaCorpus *entradas;
+    int num_quadros;
+};
+
+/**
+ * Processa todos os quadros de um corpus em paralelo
+ *
+ * Cada thread pega o proximo indice livre e chama processa(); o resultado
+ * fica na posicao do quadro no corpus, entao a ordem nao depende do numero
+ * de threads. Como em processaSequencia, o paralelismo interno do OpenCV e
+ * desligado durante o processamento.
+ *
+ * @param CorpusEmpacotado corpus - corpus aberto
+ * @param function processa - recebe o indice do quadro; chamada em paralelo
+ * @param int num_threads - threads de trabalho, 0 usa todos os nucleos
+ * @return vector<CaracteristicasQuadro> resultado de cada quadro, na ordem do corpus
+ */
+vector<CaracteristicasQuadro> processaCorpus(const CorpusEmpacotado &corpus, function<CaracteristicasQuadro(int)> processa,
+                                             int num_threads = 0);
+
+#endif
@@ -0,0 +1,174 @@
+#include "Dataset.h"
+#include "ImagemPGM.h"
+#include "Instrumentacao.h"
+#include "ThreadsOpenCV.h"
+
+#include <cstdint>
+#include <exception>
+#include <iostream>
+#include <fstream>
+#include <filesystem>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+
+namespace fs = std::filesystem;
+
+static bool arquivoExiste(const String &arquivo)
+{
+    ifstream f(arquivo.c_str());
+    return f.good();
+}
+
+vector<String> listaSequencia(const String &sequencia)
+{
+    vector<String> arquivos;
+    if (!formatoSequenciaValido(sequencia))
+    {
+        cout << "Sequencia " << sequencia << " precisa de exatamente um campo inteiro (ex. %04d)" << endl;
+        return arquivos;
+    }
+
+    int indice = arquivoExiste(format(sequencia.c_str(), 0)) ? 0 : 1;
+    for (;; indice++)
+    {
+        String arquivo = format(sequencia.c_str(), indice);
+        if (!arquivoExiste(arquivo))
+            break;
+        arquivos.push_back(arquivo);
+    }
+
+    return arquivos;
+}
+
+static void misturaFnv(uint64_t &hash, const void *dados, size_t tamanho)
+{
+    const unsigned char *bytes = (const unsigned char *)dados;
+    for (size_t i = 0; i < tamanho; i++)
+    {
+        hash ^= bytes[i];
+        hash *= 1099511628211ULL;
+    }
+}
+
+String impressaoDigital(const vector<String> &arquivos, const String &parametros)
+{
+    uint64_t hash = 14695981039346656037ULL;
+    misturaFnv(hash, parametros.data(), parametros.size());
+
+    for (size_t i = 0; i < arquivos.size(); i++)
+    {
+        std::error_code erro;
+        uint64_t tamanho = fs::file_size(arquivos[i], erro);
+        if (erro)
+            tamanho = 0;
+        int64_t data = fs::last_write_time(arquivos[i], erro).time_since_epoch().count();
+        if (erro)
+            data = 0;
+
+        misturaFnv(hash, arquivos[i].data(), arquivos[i].size() + 1);
+        misturaFnv(hash, &tamanho, sizeof(tamanho));
+        misturaFnv(hash, &data, sizeof(data));
+    }
+
+    return format("%016llx", (unsigned long long)hash);
+}
+
+// Quadro mapeado do disco e ainda nao decodificado
+struct QuadroLido
+{
+    int indice;
+    Mat bytes;
+};
+
+vector<CaracteristicasQuadro> processaSequencia(const vector<String> &arquivos,
+                                                function<CaracteristicasQuadro(const Mat &, int)> processa,
+                                                int num_threads, int prefetch)
+{
+    vector<CaracteristicasQuadro> resultados(arquivos.size());
+    if (arquivos.empty())
+        return resultados;
+
+    if (num_threads <= 0)
+        num_threads = max(1, (int)thread::hardware_concurrency());
+    num_threads = min(num_threads, (int)arquivos.size());
+    if (prefetch <= 0)
+        prefetch = 2 * num_threads;
+
+    // Um quadro por thread: o paralelismo interno do OpenCV so atrapalharia
+    RestauraThreadsOpenCV restaura;
+    setNumThreads(0);
+
+    mutex trava;
+    condition_variable tem_quadro, tem_espaco;
+    deque<QuadroLido> fila;
+    bool leitura_terminada = false;
+
+    // Leitura sequencial dos arquivos, no maximo `prefetch` quadros a frente das threads de trabalho
+    thread leitor([&]() {
+        for (size_t i = 0; i < arquivos.size(); i++)
+        {
+            QuadroLido quadro;
+            quadro.indice = (int)i;
+            // So mapeia e pede a leitura antecipada; as paginas chegam enquanto o quadro espera na fila
+            quadro.bytes = mapeiaArquivo(arquivos[i]);
+
+            unique_lock<mutex> lock(trava);
+            tem_espaco.wait(lock, [&]() { return (int)fila.size() < prefetch; });
+            fila.push_back(std::move(quadro));
+            tem_quadro.notify_one();
+        }
+
+        lock_guard<mutex> lock(trava);
+        leitura_terminada = true;
+        tem_quadro.notify_all();
+    });
+
+    vector<thread> trabalhadores;
+    for (int t = 0; t < num_threads; t++)
+    {
+        trabalhadores.push_back(thread([&]() {
+            for (;;)
+            {
+                QuadroLido quadro;
+                {
+                    unique_lock<mutex> lock(trava);
+                    tem_quadro.wait(lock, [&]() { return !fila.empty() || leitura_terminada; });
+                    if (fila.empty())
+                        return;
+                    quadro = std::move(fila.front());
+                    fila.pop_front();
+                    tem_espaco.notify_one();
+                }
+
+                try
+                {
+                    // Decodifica direto em cinza, sem passar por BGR; PGM P5 vira uma vista do mapeamento
+                    Mat cinza;
+                    if (!quadro.bytes.empty())
+                        cinza = decodificaImagemCinza(quadro.bytes);
+                    if (cinza.empty())
+                    {
+                        cout << "Erro ao ler " << arquivos[quadro.indice] << ", quadro ignorado" << endl;
+                        continue;
+                    }
+
+                    resultados[quadro.indice] = processa(cinza, quadro.indice);
+                }
+                catch (const exception &e)
+                {
+                    // Uma excecao saindo da thread chamaria terminate; o quadro fica vazio como um quadro ilegivel
+                    cout << "Erro ao processar " << arquivos[quadro.indice] << ": " << e.what() << ", quadro ignorado" << endl;
+                    resultados[quadro.indice] = CaracteristicasQuadro();
+                }
+            }
+        }));
+    }
+
+    leitor.join();
+    for (size_t t = 0; t < trabalhadores.size(); t++)
+        trabalhadores[t].join();
+
+    return resultados;
+}
@@ -0,0 +1,72 @@
+/**
+ * Dataset de treinamento
+ *
+ * Funcoes para enumerar as sequencias de imagens do dataset
+ * (ex. "data/nut/tuerca_%04d.pgm") e identificar o seu conteudo.
+ *
+ */
+
+#ifndef DATASET_h
+#define DATASET_h
+
+#include <string>
+#include <vector>
+using namespace std;
+
+// OpenCV includes
+#include "opencv2/core.hpp"
+using namespace cv;
+
+/**
+ * Lista os arquivos de uma sequencia no estilo do VideoCapture
+ *
+ * A sequencia comeca no indice 0 ou 1 e termina no primeiro arquivo que
+ * nao existe, como na leitura feita pelo VideoCapture.
+ *
+ * @param String sequencia - caminho com um campo printf de inteiro, ex. "tuerca_%04d.pgm"
+ * @return vector<String> arquivos na ordem da sequencia, vazio se o formato nao e valido
+ */
+vector<String> listaSequencia(const String &sequencia);
+
+/**
+ * Impressao digital de um conjunto de arquivos e parametros
+ *
+ * Combina (FNV-1a 64 bits) o nome, o tamanho e a data de modificacao de
+ * cada arquivo com a descricao dos parametros de treinamento. Nao le o
+ * conteudo das imagens, entao custa poucos milissegundos.
+ *
+ * @param vector<String> arquivos - arquivos que entram no treinamento
+ * @param String parametros - descricao dos parametros que afetam o modelo
+ * @return String impressao digital em hexadecimal
+ */
+String impressaoDigital(const vector<String> &arquivos, const String &parametros);
+
+/**
+ * Caracteristicas de todos os objetos de um quadro: matriz N x NUM_CARACTERISTICAS
+ * CV_32F de ExtraiCaracteristicas, uma linha por objeto
+ */
+typedef Mat CaracteristicasQuadro;
+
+/**
+ * Processa todos os quadros de uma sequencia em paralelo
+ *
+ * Uma thread de leitura mapeia os arquivos em ordem (mapeiaArquivo, com
+ * leitura antecipada) e os entrega a uma fila limitada a `prefetch` quadros;
+ * as threads de trabalho decodificam cada quadro direto em cinza
+ * (decodificaImagemCinza: PGM sem imread, o resto por imdecode) e chamam
+ * processa(). O resultado de cada quadro fica na posicao do quadro na
+ * sequencia, entao a ordem nao depende do numero de threads. Quadros que
+ * nao podem ser lidos ou decodificados, ou cujo processa() lanca excecao,
+ * ficam vazios.
+ *
+ * @param vector<String> arquivos - quadros, ex. de listaSequencia()
+ * @param function processa - recebe o quadro em cinza e o seu indice; chamada em paralelo
+ * @param int num_threads - threads de trabalho, 0 usa todos os nucleos
+ * @param int prefetch - quadros lidos a frente, 0 usa 2 por thread
+ * @return vector<CaracteristicasQuadro> resultado de cada quadro, na ordem da sequencia
+ */
+vector<CaracteristicasQuadro> processaSequencia(const vector<String> &arquivos,
+                                                function<CaracteristicasQuadro(const Mat &, int)> processa,
+                                                int num_threads = 0, int prefetch = 0);
+
+#endif
@@ -0,0 +1,361 @@
+#include "InferenciaSVM.h"
+#include "ModeloSVM.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <limits>
+#include <thread>
+
+// Menor numero de amostras por thread; abaixo disso as threads custam mais que a predicao
+static const int AMOSTRAS_POR_THREAD = 64;
+
+InferenciaSVM::InferenciaSVM()
+    : tipo_svm(0), tipo_kernel(0), num_variaveis(0), num_vetores(0), passo_vetores(0), gamma(0), coef0(0), grau(0)
+{
+}
+
+bool InferenciaSVM::compila(const Ptr<SVM> &svm, const Mat &minimo, const Mat &maximo)
+{
+    num_variaveis = 0;
+    original = Ptr<SVM>();
+    if (svm.empty() || !svm->isTrained())
+        return false;
+
+    int variaveis = svm->getVarCount();
+    minimo_treino.release();
+    maximo_treino.release();
+    escala_treino.clear();
+    if (!minimo.empty() || !maximo.empty())
+    {
+        if (minimo.type() != CV_32FC1 || maximo.type() != CV_32FC1 || (int)minimo.total() != variaveis ||
+            (int)maximo.total() != variaveis)
+            return false;
+        minimo_treino = minimo.reshape(1, 1).clone();
+        maximo_treino = maximo.reshape(1, 1).clone();
+        for (int k = 0; k < variaveis; k++)
+            escala_treino.push_back(escalaNormalizacao(minimo_treino.at<float>(k), maximo_treino.at<float>(k)));
+    }
+
+    tipo_svm = svm->getType();
+    tipo_kernel = svm->getKernelType();
+    gamma = svm->getGamma();
+    coef0 = svm->getCoef0();
+    grau = svm->getDegree();
+    num_variaveis = variaveis;
+    if (tipo_kernel == SVM::CUSTOM)
+    {
+        original = svm;
+        return true;
+    }
+
+    // Vetores de suporte transpostos; com kernel LINEAR o OpenCV ja os comprimiu um por funcao
+    Mat vetores = svm->getSupportVectors();
+    num_vetores = vetores.rows;
+    passo_vetores = (num_vetores + 7) & ~7;
+    vetores_t.assign((size_t)num_variaveis * passo_vetores, 0.f);
+    for (int j = 0; j < num_vetores; j++)
+    {
+        const float *v = vetores.ptr<float>(j);
+        for (int k = 0; k < num_variaveis; k++)
+            vetores_t[(size_t)k * passo_vetores + j] = v[k];
+    }
+
+    // Os rotulos das classes nao tem getter: vem da serializacao do proprio modelo
+    classes.clear();
+    if (tipo_svm == SVM::C_SVC || tipo_svm == SVM::NU_SVC)
+    {
+        FileStorage escrita(".yml", FileStorage::WRITE | FileStorage::MEMORY);
+        svm->write(escrita);
+        FileStorage leitura(escrita.releaseAndGetString(), FileStorage::READ | FileStorage::MEMORY);
+        Mat rotulos;
+        leitura["class_labels"] >> rotulos;
+        for (size_t i = 0; i < rotulos.total(); i++)
+            classes.push_back(rotulos.ptr<int>()[i]);
+    }
+
+    int num_funcoes = classes.empty() ? 1 : (int)(classes.size() * (classes.size() - 1) / 2);
+    rho.clear();
+    alfas.clear();
+    indices.clear();
+    inicio_funcao.assign(1, 0);
+    for (int f = 0; f < num_funcoes; f++)
+    {
+        Mat alfa, indice;
+        rho.push_back(svm->getDecisionFunction(f, alfa, indice));
+        for (size_t k = 0; k < alfa.total(); k++)
+        {
+            alfas.push_back(alfa.ptr<double>()[k]);
+            indices.push_back(indice.ptr<int>()[k]);
+        }
+        inicio_funcao.push_back((int)alfas.size());
+    }
+
+    return true;
+}
+
+bool InferenciaSVM::compilada() const
+{
+    return num_variaveis > 0;
+}
+
+int InferenciaSVM::numCaracteristicas() const
+{
+    return num_variaveis;
+}
+
+// Kernel da amostra com todos os vetores de suporte; N > 0 fixa o numero de caracteristicas.
+// Cada expressao repete a do SVMKernelImpl do OpenCV, inclusive os grupos de 4 caracteristicas
+// somados em float, para o resultado ser o mesmo bit a bit.
+template <int N>
+void InferenciaSVM::calculaKernel(const float *amostra, Rascunho &rascunho) const
+{
+    const int n = N > 0 ? N : num_variaveis;
+    const int m = num_vetores;
+    double *s = rascunho.acumulado.data();
+    float *kernel = rascunho.kernel.data();
+    const float *vt = vetores_t.data();
+
+    fill(s, s + m, 0.0);
+    int k = 0;
+
+    switch (tipo_kernel)
+    {
+    case SVM::LINEAR:
+    case SVM::POLY:
+    case SVM::SIGMOID:
+    {
+        for (; k <= n - 4; k += 4)
+        {
+            const float *v0 = vt + (size_t)k * passo_vetores, *v1 = v0 + passo_vetores;
+            const float *v2 = v1 + passo_vetores, *v3 = v2 + passo_vetores;
+            float x0 = amostra[k], x1 = amostra[k + 1], x2 = amostra[k + 2], x3 = amostra[k + 3];
+            for (int j = 0; j < m; j++)
+                s[j] += v0[j] * x0 + v1[j] * x1 + v2[j] * x2 + v3[j] * x3;
+        }
+        for (; k < n; k++)
+        {
+            const float *v = vt + (size_t)k * passo_vetores;
+            float x = amostra[k];
+            for (int j = 0; j < m; j++)
+                s[j] += v[j] * x;
+        }
+
+        double alfa = tipo_kernel == SVM::LINEAR ? 1 : tipo_kernel == SVM::POLY ? gamma : 2 * gamma;
+        double beta = tipo_kernel == SVM::LINEAR ? 0 : tipo_kernel == SVM::POLY ? coef0 : 2 * coef0;
+        for (int j = 0; j < m; j++)
+            kernel[j] = (float)(s[j] * alfa + beta);
+
+        if (tipo_kernel == SVM::POLY)
+        {
+            Mat linha(1, m, CV_32F, kernel);
+            pow(linha, grau, linha);
+        }
+        else if (tipo_kernel == SVM::SIGMOID)
+        {
+            for (int j = 0; j < m; j++)
+            {
+                float t = kernel[j];
+                float e = std::exp(std::abs(t));
+                float r = (float)((e - 1.) / (e + 1.));
+                if (cvIsNaN(r))
+                    r = numeric_limits<float>::infinity();
+                if (t < 0)
+                    r = -r;
+                kernel[j] = r;
+            }
+        }
+        break;
+    }
+    case SVM::RBF:
+    {
+        for (; k <= n - 4; k += 4)
+        {
+            const float *v0 = vt + (size_t)k * passo_vetores, *v1 = v0 + passo_vetores;
+            const float *v2 = v1 + passo_vetores, *v3 = v2 + passo_vetores;
+            float x0 = amostra[k], x1 = amostra[k + 1], x2 = amostra[k + 2], x3 = amostra[k + 3];
+            for (int j = 0; j < m; j++)
+            {
+                double t0 = v0[j] - x0;
+                double t1 = v1[j] - x1;
+                s[j] += t0 * t0 + t1 * t1;
+                t0 = v2[j] - x2;
+                t1 = v3[j] - x3;
+                s[j] += t0 * t0 + t1 * t1;
+            }
+        }
+        for (; k < n; k++)
+        {
+            const float *v = vt + (size_t)k * passo_vetores;
+            float x = amostra[k];
+            for (int j = 0; j < m; j++)
+            {
+                double t0 = v[j] - x;
+                s[j] += t0 * t0;
+            }
+        }
+
+        double g = -gamma;
+        for (int j = 0; j < m; j++)
+            kernel[j] = (float)(s[j] * g);
+        Mat linha(1, m, CV_32F, kernel);
+        exp(linha, linha);
+        break;
+    }
+    case SVM::CHI2:
+    {
+        for (; k < n; k++)
+        {
+            const float *v = vt + (size_t)k * passo_vetores;
+            float x = amostra[k];
+            for (int j = 0; j < m; j++)
+            {
+                double d = v[j] - x;
+                double divisor = v[j] + x;
+                // Divisor 0: a parcela e 0, como o if do OpenCV
+                s[j] += divisor != 0 ? d * d / divisor : 0.0;
+            }
+        }
+
+        double g = -gamma;
+        for (int j = 0; j < m; j++)
+            kernel[j] = (float)(g * s[j]);
+        Mat linha(1, m, CV_32F, kernel);
+        exp(linha, linha);
+        break;
+    }
+    case SVM::INTER:
+    {
+        for (; k <= n - 4; k += 4)
+        {
+            const float *v0 = vt + (size_t)k * passo_vetores, *v1 = v0 + passo_vetores;
+            const float *v2 = v1 + passo_vetores, *v3 = v2 + passo_vetores;
+            float x0 = amostra[k], x1 = amostra[k + 1], x2 = amostra[k + 2], x3 = amostra[k + 3];
+            for (int j = 0; j < m; j++)
+                s[j] += std::min(v0[j], x0) + std::min(v1[j], x1) + std::min(v2[j], x2) + std::min(v3[j], x3);
+        }
+        for (; k < n; k++)
+        {
+            const float *v = vt + (size_t)k * passo_vetores;
+            float x = amostra[k];
+            for (int j = 0; j < m; j++)
+                s[j] += std::min(v[j], x);
+        }
+
+        for (int j = 0; j < m; j++)
+            kernel[j] = (float)s[j];
+        break;
+    }
+    }
+
+    // Mesmo limite que o OpenCV aplica aos valores do kernel
+    const float maximo = (float)(FLT_MAX * 1e-3);
+    for (int j = 0; j < m; j++)
+    {
+        if (kernel[j] > maximo)
+            kernel[j] = maximo;
+    }
+}
+
+float InferenciaSVM::decide(Rascunho &rascunho) const
+{
+    const float *kernel = rascunho.kernel.data();
+
+    // Regressao e ONE_CLASS: uma funcao sobre todos os vetores de suporte
+    if (classes.empty())
+    {
+        double soma = -rho[0];
+        for (int i = 0; i < inicio_funcao[1]; i++)
+            soma += kernel[i] * alfas[i];
+        return tipo_svm == SVM::ONE_CLASS ? (float)(soma > 0) : (float)soma;
+    }
+
+    // Classificacao um contra um: cada funcao de decisao vota numa das duas classes
+    int num_classes = (int)classes.size();
+    int *votos = rascunho.votos.data();
+    fill(votos, votos + num_classes, 0);
+    for (int i = 0, f = 0; i < num_classes; i++)
+    {
+        for (int j = i + 1; j < num_classes; j++, f++)
+        {
+            double soma = -rho[f];
+            for (int k = inicio_funcao[f]; k < inicio_funcao[f + 1]; k++)
+                soma += alfas[k] * kernel[indices[k]];
+            votos[soma > 0 ? i : j]++;
+        }
+    }
+
+    int vencedora = 0;
+    for (int i = 1; i < num_classes; i++)
+    {
+        if (votos[i] > votos[vencedora])
+            vencedora = i;
+    }
+    return (float)classes[vencedora];
+}
+
+void InferenciaSVM::predizFaixa(const Mat &amostras, Mat &resultados, int inicio, int fim) const
+{
+    Rascunho rascunho;
+    rascunho.acumulado.resize(num_vetores);
+    rascunho.kernel.resize(num_vetores);
+    rascunho.votos.resize(classes.size());
+    rascunho.amostra.resize(num_variaveis);
+    const float *minimo = escala_treino.empty() ? NULL : minimo_treino.ptr<float>();
+
+    for (int i = inicio; i < fim; i++)
+    {
+        const float *amostra = amostras.ptr<float>(i);
+        if (minimo != NULL)
+        {
+            // Mesma conta de aplicaNormalizacao
+            for (int k = 0; k < num_variaveis; k++)
+                rascunho.amostra[k] = max(0.0f, (amostra[k] - minimo[k]) * escala_treino[k]);
+            amostra = rascunho.amostra.data();
+        }
+        if (num_variaveis == 2)
+            calculaKernel<2>(amostra, rascunho);
+        else if (num_variaveis == 12)
+            calculaKernel<12>(amostra, rascunho);
+        else
+            calculaKernel<0>(amostra, rascunho);
+        resultados.at<float>(i) = decide(rascunho);
+    }
+}
+
+void InferenciaSVM::prediz(const Mat &amostras, Mat &resultados, int num_threads) const
+{
+    CV_Assert(compilada() && amostras.type() == CV_32FC1 && amostras.cols == num_variaveis);
+
+    if (!original.empty())
+    {
+        Mat normalizadas;
+        aplicaNormalizacao(amostras, minimo_treino, maximo_treino, normalizadas);
+        original->predict(normalizadas, resultados);
+        return;
+    }
+
+    resultados.create(amostras.rows, 1, CV_32FC1);
+    if (amostras.rows == 0)
+        return;
+
+    if (num_threads <= 0)
+        num_threads = max(1, (int)thread::hardware_concurrency());
+    num_threads = max(1, min(num_threads, amostras.rows / AMOSTRAS_POR_THREAD));
+    if (num_threads == 1)
+    {
+        predizFaixa(amostras, resultados, 0, amostras.rows);
+        return;
+    }
+
+    // Faixas contiguas de amostras; cada thread escreve so nas suas linhas de resultados
+    vector<thread> threads;
+    for (int t = 0; t < num_threads; t++)
+    {
+        int inicio = (int)((int64)amostras.rows * t / num_threads);
+        int fim = (int)((int64)amostras.rows * (t + 1) / num_threads);
+        threads.push_back(thread([&, inicio, fim]() { predizFaixa(amostras, resultados, inicio, fim); }));
+    }
+    for (size_t t = 0; t < threads.size(); t++)
+        threads[t].join();
+}
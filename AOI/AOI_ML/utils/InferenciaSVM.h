@@ -0,0 +1,107 @@
+/**
+ * Inferencia compilada da SVM
+ *
+ * Copia os vetores de suporte, os coeficientes (alfa) e o rho de cada
+ * funcao de decisao de uma SVM treinada para arrays contiguos e classifica
+ * a matriz de caracteristicas de um quadro inteiro numa unica chamada, sem
+ * criar um Mat e sem passar pelo parallel_for_ do OpenCV para cada objeto.
+ *
+ * Os vetores de suporte ficam transpostos (uma linha por caracteristica),
+ * entao o laco do kernel percorre todos os vetores de forma contigua e e
+ * vetorizado pelo compilador. Com 2 caracteristicas (area e proporcao) ou
+ * 12 (o conjunto completo de ExtraiCaracteristicas, o modelo atual) o numero
+ * de caracteristicas e fixo em tempo de compilacao.
+ *
+ * As operacoes sao as do SVM::predict do OpenCV, na mesma ordem e precisao:
+ * kernel acumulado em double por vetor de suporte e gravado em float,
+ * cv::exp / cv::pow sobre o vetor de kernels de cada amostra, e a soma das
+ * funcoes de decisao em double, na ordem dos indices. O resultado e
+ * identico ao do predict para C_SVC, NU_SVC, ONE_CLASS, EPS_SVR e NU_SVR
+ * com os kernels LINEAR, POLY, RBF, SIGMOID, CHI2 e INTER; o arquivo e
+ * compilado sem contracao em FMA para isso valer tambem com -march=native.
+ * Kernels CUSTOM usam o proprio predict.
+ *
+ * Com a faixa do treinamento, cada amostra passa antes por
+ * aplicaNormalizacao (ModeloSVM.h), com as mesmas operacoes: prediz(x) e
+ * igual a SVM::predict(aplicaNormalizacao(x)).
+ *
+ */
+
+#ifndef INFERENCIA_SVM_h
+#define INFERENCIA_SVM_h
+
+#include <vector>
+using namespace std;
+
+// OpenCV includes
+#include "opencv2/core.hpp"
+#include "opencv2/ml.hpp"
+using namespace cv;
+using namespace cv::ml;
+
+class InferenciaSVM
+{
+public:
+    InferenciaSVM();
+
+    /**
+     * Copia os parametros de uma SVM treinada
+     * @param Ptr<SVM> svm - SVM treinada ou carregada
+     * @param Mat minimo - faixa do treinamento (calculaNormalizacao); vazio nao normaliza
+     * @param Mat maximo - faixa do treinamento; vazio nao normaliza
+     * @return bool false se a SVM nao esta treinada ou a faixa nao tem uma coluna por variavel
+     */
+    bool compila(const Ptr<SVM> &svm, const Mat &minimo = Mat(), const Mat &maximo = Mat());
+
+    /**
+     * @return bool true depois de compila() com sucesso
+     */
+    bool compilada() const;
+
+    /**
+     * Numero de caracteristicas de cada amostra
+     */
+    int numCaracteristicas() const;
+
+    /**
+     * Classifica todas as amostras, uma por linha
+     * @param Mat amostras - N x numCaracteristicas() CV_32F
+     * @param Mat resultados - saida N x 1 CV_32F, igual a de SVM::predict
+     * @param int num_threads - 1 na thread atual, 0 usa todos os nucleos
+     */
+    void prediz(const Mat &amostras, Mat &resultados, int num_threads = 1) const;
+
+private:
+    // Memoria de trabalho de uma thread
+    struct Rascunho
+    {
+        vector<double> acumulado;
+        vector<float> kernel;
+        vector<int> votos;
+        vector<float> amostra; // amostra normalizada
+    };
+
+    Ptr<SVM> original; // so para kernels CUSTOM
+    int tipo_svm;
+    int tipo_kernel;
+    int num_variaveis;
+    int num_vetores;
+    int passo_vetores; // num_vetores arredondado para multiplo de 8
+    double gamma, coef0, grau;
+    Mat minimo_treino, maximo_treino; // vazios sem normalizacao
+    vector<float> escala_treino;
+
+    vector<float> vetores_t;   // num_variaveis linhas de passo_vetores floats
+    vector<int> classes;       // rotulo de cada classe, vazio em regressao e ONE_CLASS
+    vector<double> rho;        // um por funcao de decisao
+    vector<int> inicio_funcao; // alfas / indices da funcao f em [inicio_funcao[f], inicio_funcao[f + 1])
+    vector<double> alfas;
+    vector<int> indices;
+
+    template <int N>
+    void calculaKernel(const float *amostra, Rascunho &rascunho) const;
+    float decide(Rascunho &rascunho) const;
+    void predizFaixa(const Mat &amostras, Mat &resultados, int inicio, int fim) const;
+};
+
+#endif
@@ -0,0 +1,242 @@
+#include "ModeloSVM.h"
+
+#include <algorithm>
+#include <sstream>
+#include <fstream>
+#include <filesystem>
+
+static const struct
+{
+    int kernel;
+    const char *nome;
+} NOMES_KERNEL[] = {{SVM::LINEAR, "LINEAR"}, {SVM::POLY, "POLY"}, {SVM::RBF, "RBF"},
+                    {SVM::SIGMOID, "SIGMOID"}, {SVM::CHI2, "CHI2"}, {SVM::INTER, "INTER"}};
+static const int NUM_KERNELS = 6;
+
+String descreveParametrosSVM(const ParametrosSVM &parametros)
+{
+    ParametrosSVM padrao;
+    String texto = "C_SVC,";
+    for (int i = 0; i < NUM_KERNELS; i++)
+    {
+        if (NOMES_KERNEL[i].kernel == parametros.kernel)
+            texto += NOMES_KERNEL[i].nome;
+    }
+
+    bool usa_gamma = parametros.kernel == SVM::POLY || parametros.kernel == SVM::RBF || parametros.kernel == SVM::SIGMOID ||
+                     parametros.kernel == SVM::CHI2;
+    if (parametros.C != padrao.C)
+        texto += format(",C=%g", parametros.C);
+    if (usa_gamma && parametros.gamma != padrao.gamma)
+        texto += format(",gamma=%g", parametros.gamma);
+    if (parametros.kernel == SVM::POLY)
+        texto += format(",grau=%g", parametros.grau);
+    texto += format(",MAX_ITER=%d", parametros.max_iter);
+
+    return texto;
+}
+
+bool interpretaParametrosSVM(const String &texto, ParametrosSVM &parametros)
+{
+    ParametrosSVM lidos;
+    stringstream ss(texto);
+    String campo;
+    bool tem_kernel = false;
+    while (getline(ss, campo, ','))
+    {
+        if (campo == "C_SVC")
+            continue;
+
+        size_t igual = campo.find('=');
+        if (igual == String::npos)
+        {
+            tem_kernel = false;
+            for (int i = 0; i < NUM_KERNELS && !tem_kernel; i++)
+            {
+                if (campo == NOMES_KERNEL[i].nome)
+                {
+                    lidos.kernel = NOMES_KERNEL[i].kernel;
+                    tem_kernel = true;
+                }
+            }
+            if (!tem_kernel)
+                return false;
+            continue;
+        }
+
+        String nome = campo.substr(0, igual);
+        double valor = atof(campo.substr(igual + 1).c_str());
+        if (nome == "C")
+            lidos.C = valor;
+        else if (nome == "gamma")
+            lidos.gamma = valor;
+        else if (nome == "grau")
+            lidos.grau = valor;
+        else if (nome == "MAX_ITER")
+            lidos.max_iter = (int)valor;
+        else
+            return false;
+    }
+    if (!tem_kernel || lidos.C <= 0 || lidos.max_iter <= 0)
+        return false;
+
+    parametros = lidos;
+    return true;
+}
+
+void calculaNormalizacao(const Mat &dados, Mat &minimo, Mat &maximo)
+{
+    minimo.release();
+    maximo.release();
+    if (dados.rows == 0)
+        return;
+
+    reduce(dados, minimo, 0, REDUCE_MIN);
+    reduce(dados, maximo, 0, REDUCE_MAX);
+}
+
+void calculaNormalizacao(const Mat &dados, MetadadosModelo &meta)
+{
+    calculaNormalizacao(dados, meta.minimo, meta.maximo);
+}
+
+float escalaNormalizacao(float minimo, float maximo)
+{
+    return maximo > minimo ? 1.0f / (maximo - minimo) : 0.0f;
+}
+
+void aplicaNormalizacao(const Mat &dados, const Mat &minimo, const Mat &maximo, Mat &saida)
+{
+    CV_Assert(dados.empty() || dados.type() == CV_32FC1);
+    if (minimo.empty())
+    {
+        dados.copyTo(saida);
+        return;
+    }
+    CV_Assert(minimo.type() == CV_32FC1 && maximo.type() == CV_32FC1 && (int)minimo.total() == dados.cols &&
+              (int)maximo.total() == dados.cols);
+
+    const float *mn = minimo.ptr<float>(), *mx = maximo.ptr<float>();
+    vector<float> escala(dados.cols);
+    for (int k = 0; k < dados.cols; k++)
+        escala[k] = escalaNormalizacao(mn[k], mx[k]);
+
+    saida.create(dados.rows, dados.cols, CV_32FC1);
+    for (int i = 0; i < dados.rows; i++)
+    {
+        const float *x = dados.ptr<float>(i);
+        float *s = saida.ptr<float>(i);
+        for (int k = 0; k < dados.cols; k++)
+            s[k] = max(0.0f, (x[k] - mn[k]) * escala[k]);
+    }
+}
+
+// Metadados e SVM, na ordem em que carregaModelo le
+static void escreveModelo(FileStorage &fs, const Ptr<SVM> &svm, const MetadadosModelo &meta)
+{
+    fs << "impressao_digital" << meta.impressao_digital;
+    fs << "caracteristicas" << "[";
+    for (size_t i = 0; i < meta.caracteristicas.size(); i++)
+        fs << meta.caracteristicas[i];
+    fs << "]";
+    fs << "minimo" << meta.minimo;
+    fs << "maximo" << meta.maximo;
+    fs << "num_treino" << meta.num_treino;
+    fs << "num_teste" << meta.num_teste;
+    fs << "erro" << meta.erro;
+    fs << "parametros_svm" << meta.parametros_svm;
+
+    // A SVM fica em um no proprio para ser lida com Algorithm::load<SVM>(arquivo, "svm")
+    fs << "svm" << "{";
+    svm->write(fs);
+    fs << "}";
+}
+
+bool gravaModelo(const String &arquivo, const Ptr<SVM> &svm, const MetadadosModelo &meta)
+{
+    if (svm.empty() || !svm->isTrained())
+        return false;
+
+    // Monta o arquivo em memoria (o formato sai da extensao de arquivo), grava em <arquivo>.tmp
+    // e so entao troca pelo nome final: quem le o modelo ao mesmo tempo ve o antigo ou o novo inteiro
+    String conteudo;
+    try
+    {
+        FileStorage fs(arquivo, FileStorage::WRITE | FileStorage::MEMORY);
+        if (!fs.isOpened())
+            return false;
+        escreveModelo(fs, svm, meta);
+        conteudo = fs.releaseAndGetString();
+    }
+    catch (const cv::Exception &)
+    {
+        return false;
+    }
+
+    String temporario = arquivo + ".tmp";
+    {
+        ofstream saida(temporario.c_str(), ios::binary);
+        if (!saida.write(conteudo.data(), conteudo.size()) || !saida.flush())
+            return false;
+    }
+
+    std::error_code erro;
+    std::filesystem::rename(temporario, arquivo, erro);
+    if (erro)
+    {
+        std::filesystem::remove(temporario, erro);
+        return false;
+    }
+
+    return true;
+}
+
+Ptr<SVM> carregaModelo(const String &arquivo, MetadadosModelo &meta)
+{
+    // Um arquivo truncado ou corrompido faz o FileStorage lancar excecao: tudo vira modelo ausente
+    try
+    {
+        FileStorage fs;
+        if (!fs.open(arquivo, FileStorage::READ))
+            return Ptr<SVM>();
+
+        if (fs["svm"].empty())
+            return Ptr<SVM>();
+
+        MetadadosModelo lidos;
+        fs["impressao_digital"] >> lidos.impressao_digital;
+        fs["caracteristicas"] >> lidos.caracteristicas;
+        fs["minimo"] >> lidos.minimo;
+        fs["maximo"] >> lidos.maximo;
+        fs["num_treino"] >> lidos.num_treino;
+        fs["num_teste"] >> lidos.num_teste;
+        fs["erro"] >> lidos.erro;
+        // Modelos gravados antes dos hiper-parametros configuraveis nao tem o campo
+        if (!fs["parametros_svm"].empty())
+            fs["parametros_svm"] >> lidos.parametros_svm;
+
+        // A SVM sai da mesma abertura do arquivo que os metadados, como Algorithm::load<SVM>(arquivo, "svm")
+        Ptr<SVM> svm = SVM::create();
+        svm->read(fs["svm"]);
+        if (!svm->isTrained())
+            return Ptr<SVM>();
+
+        // A faixa e aplicada a cada amostra antes da SVM: tem que ter uma coluna por variavel
+        int num_variaveis = svm->getVarCount();
+        if (lidos.minimo.type() != CV_32FC1 || lidos.maximo.type() != CV_32FC1 || (int)lidos.minimo.total() != num_variaveis ||
+            (int)lidos.maximo.total() != num_variaveis ||
+            (!lidos.caracteristicas.empty() && (int)lidos.caracteristicas.size() != num_variaveis))
+            return Ptr<SVM>();
+
+        meta = lidos;
+        return svm;
+    }
+    catch (const cv::Exception &)
+    {
+        return Ptr<SVM>();
+    }
+    catch (const std::exception &)
+    {
+        return Ptr<SVM>();
+    }
+}
@@ -0,0 +1,123 @@
+/**
+ * Modelo SVM persistente
+ *
+ * Grava e carrega a SVM treinada em um unico arquivo do FileStorage
+ * (YAML/XML), junto com a faixa de cada caracteristica usada no
+ * treinamento e a impressao digital do dataset. Assim a classificacao
+ * carrega o modelo em milissegundos e so retreina quando o dataset ou
+ * os parametros mudam.
+ *
+ * A SVM e treinada e consultada com as caracteristicas levadas a faixa
+ * do treinamento (aplicaNormalizacao); sem isso a area, em centenas ou
+ * milhares de pixels, domina os momentos de Hu no kernel.
+ *
+ */
+
+#ifndef MODELO_SVM_h
+#define MODELO_SVM_h
+
+#include <string>
+#include <vector>
+using namespace std;
+
+// OpenCV includes
+#include "opencv2/core.hpp"
+#include "opencv2/ml.hpp"
+using namespace cv;
+using namespace cv::ml;
+
+/**
+ * Hiper-parametros da SVM (sempre C_SVC); os padrao sao os do treinamento original
+ */
+struct ParametrosSVM
+{
+    int kernel;    // SVM::LINEAR, POLY, RBF, SIGMOID, CHI2 ou INTER
+    double C;
+    double gamma;  // POLY, RBF, SIGMOID e CHI2
+    double grau;   // POLY
+    int max_iter;
+
+    ParametrosSVM() : kernel(SVM::CHI2), C(1), gamma(1), grau(3), max_iter(100) {}
+};
+
+/**
+ * Descricao dos hiper-parametros, ex. "C_SVC,RBF,C=10,gamma=0.001,MAX_ITER=100"
+ *
+ * So aparecem os valores diferentes do padrao que o kernel usa; os
+ * parametros padrao dao "C_SVC,CHI2,MAX_ITER=100", o texto que ja entrava
+ * na impressao digital dos modelos gravados.
+ */
+String descreveParametrosSVM(const ParametrosSVM &parametros);
+
+/**
+ * Le uma descricao no formato de descreveParametrosSVM
+ * @return bool false com um kernel ou campo desconhecido; parametros nao muda
+ */
+bool interpretaParametrosSVM(const String &texto, ParametrosSVM &parametros);
+
+/**
+ * Informacoes gravadas junto com a SVM
+ */
+struct MetadadosModelo
+{
+    String impressao_digital;        // ver impressaoDigital() em Dataset.h
+    vector<String> caracteristicas;  // nome de cada coluna do vetor de caracteristicas
+    Mat minimo;                      // 1 x N CV_32F, menor valor de cada caracteristica no treinamento
+    Mat maximo;                      // 1 x N CV_32F, maior valor de cada caracteristica no treinamento
+    int num_treino;
+    int num_teste;
+    float erro;                      // erro percentual no conjunto de teste, -1 sem teste
+    String parametros_svm;           // descreveParametrosSVM() dos hiper-parametros do treino
+
+    MetadadosModelo() : num_treino(0), num_teste(0), erro(-1) {}
+};
+
+/**
+ * Faixa de cada coluna de uma matriz de caracteristicas (uma amostra por linha)
+ * @param Mat dados - matriz CV_32F
+ * @param Mat minimo - saida 1 x M CV_32F, vazia sem amostras
+ * @param Mat maximo - saida 1 x M CV_32F, vazia sem amostras
+ */
+void calculaNormalizacao(const Mat &dados, Mat &minimo, Mat &maximo);
+
+/**
+ * @param MetadadosModelo meta - recebe minimo e maximo
+ */
+void calculaNormalizacao(const Mat &dados, MetadadosModelo &meta);
+
+/**
+ * Fator de cada coluna: 1 / (maximo - minimo), 0 nas colunas constantes no treinamento
+ */
+float escalaNormalizacao(float minimo, float maximo);
+
+/**
+ * Leva cada caracteristica a faixa do treinamento: max(0, (x - minimo) * escalaNormalizacao())
+ *
+ * As amostras do treinamento ficam em [0, 1]. Abaixo do minimo o valor e
+ * cortado em 0, ja que o kernel CHI2 padrao supoe caracteristicas nao
+ * negativas; acima do maximo passa de 1 sem corte. Com minimo e maximo
+ * vazios a saida e uma copia da entrada.
+ *
+ * @param Mat dados - N x M CV_32F
+ * @param Mat minimo - 1 x M CV_32F de calculaNormalizacao
+ * @param Mat maximo - 1 x M CV_32F de calculaNormalizacao
+ * @param Mat saida - N x M CV_32F normalizada
+ */
+void aplicaNormalizacao(const Mat &dados, const Mat &minimo, const Mat &maximo, Mat &saida);
+
+/**
+ * Grava a SVM e os metadados em <arquivo>.tmp e renomeia para arquivo,
+ * para que uma carga concorrente nunca leia um modelo pela metade
+ * @return bool false se o arquivo nao pode ser gravado
+ */
+bool gravaModelo(const String &arquivo, const Ptr<SVM> &svm, const MetadadosModelo &meta);
+
+/**
+ * Carrega a SVM e os metadados
+ * @param MetadadosModelo meta - so e alterado quando o modelo e carregado
+ * @return Ptr<SVM> vazio se o arquivo nao existe, esta truncado, nao contem um modelo
+ *         treinado ou a faixa gravada nao tem uma coluna por variavel da SVM
+ */
+Ptr<SVM> carregaModelo(const String &arquivo, MetadadosModelo &meta);
+
+#endif
@@ -0,0 +1,183 @@
+#include "SegmentacaoMultiescala.h"
+#include "Classificacao.h"
+#include "RemocaoLuz.h"
+#include "Instrumentacao.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include "opencv2/imgproc.hpp"
+#include "opencv2/core/utility.hpp"
+
+/**
+ * Reduz a imagem a um pixel por bloco fator x fator com o menor ou o maior valor do bloco
+ * @param bool maximo - true guarda o maior valor, false o menor
+ * @return Mat CV_8UC1 com ceil(linhas / fator) x ceil(colunas / fator) pixels
+ */
+static Mat reduzBlocos(const Mat &img, int fator, bool maximo)
+{
+    Mat reduzida((img.rows + fator - 1) / fator, (img.cols + fator - 1) / fator, CV_8UC1);
+
+    parallel_for_(Range(0, reduzida.rows), [&](const Range &faixa) {
+        Mat linha;
+        for (int by = faixa.start; by < faixa.end; by++)
+        {
+            // Primeiro entre as linhas do bloco, vetorizado pelo OpenCV, depois dentro de cada bloco da linha
+            int y0 = by * fator;
+            int y1 = min(img.rows, y0 + fator);
+            img.row(y0).copyTo(linha);
+            for (int y = y0 + 1; y < y1; y++)
+            {
+                if (maximo)
+                    cv::max(linha, img.row(y), linha);
+                else
+                    cv::min(linha, img.row(y), linha);
+            }
+
+            const uchar *l = linha.ptr<uchar>();
+            uchar *saida = reduzida.ptr<uchar>(by);
+            for (int bx = 0; bx < reduzida.cols; bx++)
+            {
+                int x0 = bx * fator;
+                int x1 = min(img.cols, x0 + fator);
+                uchar v = l[x0];
+                for (int x = x0 + 1; x < x1; x++)
+                    v = maximo ? std::max(v, l[x]) : std::min(v, l[x]);
+                saida[bx] = v;
+            }
+        }
+    });
+
+    return reduzida;
+}
+
+SegmentacaoMultiescala::SegmentacaoMultiescala()
+    : fator(0)
+{
+}
+
+void SegmentacaoMultiescala::define(const PadraoLuz &padrao, int fator_reducao)
+{
+    CV_Assert(!padrao.vazio() && fator_reducao >= 2);
+    padrao_fino = padrao;
+    fator = fator_reducao;
+
+    // Para cada valor do padrao, 1 + o maior cinza que passa do limiar depois da divisao.
+    // A saida cai com o cinza, entao basta contar quantos cinzas passam; a contagem usa o
+    // proprio kernel de removeLuzDivisaoLinha e por isso bate com a passada fina.
+    // Padrao 0 da sempre 0 depois da remocao de luz: nenhum cinza passa.
+    Mat tabela(1, 256, CV_8UC1);
+    uchar cinzas[256], valor_padrao[256], sem_luz[256];
+    for (int i = 0; i < 256; i++)
+        cinzas[i] = (uchar)i;
+    for (int p = 0; p < 256; p++)
+    {
+        memset(valor_padrao, p, sizeof(valor_padrao));
+        removeLuzDivisaoLinha(cinzas, valor_padrao, sem_luz, 256);
+        int limite = 0;
+        while (limite < 256 && sem_luz[limite] > LIMIAR_BINARIZACAO)
+            limite++;
+        tabela.at<uchar>(p) = (uchar)min(limite, 255);
+    }
+    Mat limite_fino;
+    LUT(padrao.padrao(), tabela, limite_fino);
+
+    // O maior limite do bloco e dos vizinhos: a mediana pode trazer um pixel do bloco ao lado
+    limite_grosso = reduzBlocos(limite_fino, fator, true);
+    dilate(limite_grosso, limite_grosso, Mat());
+}
+
+bool SegmentacaoMultiescala::vazio() const
+{
+    return fator == 0;
+}
+
+int SegmentacaoMultiescala::extrai(const Mat &img, Mat &caracteristicas, vector<Point> *posicoes, vector<Rect> *regioes) const
+{
+    CV_Assert(!vazio() && img.type() == CV_8UC1 && padrao_fino.compativel(img.size()));
+
+    // Busca grossa: blocos em que o menor cinza pode passar do limiar, mais os vizinhos
+    Mat rotulos, estatisticas, centroides;
+    int num_candidatos;
+    {
+        MEDE_ETAPA("busca grosseira");
+        Mat candidatos;
+        compare(reduzBlocos(img, fator, false), limite_grosso, candidatos, CMP_LT);
+        dilate(candidatos, candidatos, Mat());
+        num_candidatos = connectedComponentsWithStats(candidatos, rotulos, estatisticas, centroides, 8, CV_32S);
+    }
+
+    Rect quadro(0, 0, img.cols, img.rows);
+    vector<Mat> por_candidato(num_candidatos);
+    vector<vector<Point>> centros(num_candidatos);
+    vector<Rect> caixas(num_candidatos);
+
+    // Cada candidato em resolucao cheia, em paralelo; o rotulo 0 e o fundo
+    parallel_for_(Range(1, num_candidatos), [&](const Range &faixa) {
+        Mat sem_ruido, sem_luz, binaria;
+        for (int k = faixa.start; k < faixa.end; k++)
+        {
+            const int *e = estatisticas.ptr<int>(k);
+            // Blocos do candidato com 1 pixel de margem, que fica de fundo e separa os objetos da borda
+            Rect roi = Rect(e[CC_STAT_LEFT] * fator - 1, e[CC_STAT_TOP] * fator - 1,
+                            e[CC_STAT_WIDTH] * fator + 2, e[CC_STAT_HEIGHT] * fator + 2) &
+                       quadro;
+            int borda = TAMANHO_MEDIANA / 2;
+            Rect halo = Rect(roi.x - borda, roi.y - borda, roi.width + 2 * borda, roi.height + 2 * borda) & quadro;
+
+            // Mediana com os vizinhos da regiao; na borda do quadro replica como no quadro inteiro
+            medianBlur(img(halo), sem_ruido, TAMANHO_MEDIANA);
+            Mat nucleo = sem_ruido(Rect(roi.tl() - halo.tl(), roi.size()));
+
+            sem_luz.create(roi.size(), CV_8UC1);
+            for (int y = 0; y < roi.height; y++)
+                removeLuzDivisaoLinha(nucleo.ptr<uchar>(y), padrao_fino.padrao().ptr<uchar>(roi.y + y) + roi.x,
+                                      sem_luz.ptr<uchar>(y), roi.width);
+            // Mesmo pre-processamento de preProcessaImagem com o limiar fixo
+            threshold(sem_luz, binaria, LIMIAR_BINARIZACAO, 255, THRESH_BINARY);
+
+            // Apaga o que cai em blocos de outros candidatos: sao objetos inteiros de outra regiao
+            for (int y = 0; y < roi.height; y++)
+            {
+                const int *rotulo = rotulos.ptr<int>((roi.y + y) / fator);
+                uchar *b = binaria.ptr<uchar>(y);
+                for (int x = 0; x < roi.width; x++)
+                {
+                    if (rotulo[(roi.x + x) / fator] != k)
+                        b[x] = 0;
+                }
+            }
+
+            // Contornos nas coordenadas do quadro: mesmos pontos, mesmas caracteristicas do quadro inteiro
+            ExtraiCaracteristicas(binaria, por_candidato[k], &centros[k], NULL, roi.tl());
+            caixas[k] = roi;
+        }
+    });
+
+    // Junta as linhas dos candidatos numa matriz so, na ordem dos rotulos
+    int num_objetos = 0;
+    for (int k = 1; k < num_candidatos; k++)
+        num_objetos += por_candidato[k].rows;
+
+    if (caracteristicas.type() != CV_32FC1 || caracteristicas.cols != NUM_CARACTERISTICAS)
+        caracteristicas.create(0, NUM_CARACTERISTICAS, CV_32FC1);
+    caracteristicas.resize(num_objetos);
+    if (posicoes != NULL)
+        posicoes->clear();
+
+    int linha = 0;
+    for (int k = 1; k < num_candidatos; k++)
+    {
+        if (por_candidato[k].rows > 0)
+        {
+            por_candidato[k].copyTo(caracteristicas.rowRange(linha, linha + por_candidato[k].rows));
+            linha += por_candidato[k].rows;
+        }
+        if (posicoes != NULL)
+            posicoes->insert(posicoes->end(), centros[k].begin(), centros[k].end());
+        if (regioes != NULL)
+            regioes->push_back(caixas[k]);
+    }
+
+    return num_objetos;
+}
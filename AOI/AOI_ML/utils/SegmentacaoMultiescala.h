@@ -0,0 +1,65 @@
+/**
+ * Segmentacao do grosseiro ao fino
+ *
+ * Para quadros com poucas pecas num fundo quase vazio. Primeiro uma busca
+ * numa escala reduzida (blocos de fator x fator pixels) marca os blocos em
+ * que algum pixel ainda pode passar do limiar depois da mediana e da
+ * remocao de luz; os blocos marcados sao agrupados em candidatos. So dentro
+ * da caixa de cada candidato, com margem, roda o pre-processamento em
+ * resolucao cheia (mediana 3, divisao pelo padrao e limiar fixo 30, como
+ * preProcessaImagem) e ExtraiCaracteristicas.
+ *
+ * A busca grossa nao perde objetos: o bloco guarda o menor cinza dos seus
+ * pixels e e comparado com o maior cinza que ainda passa do limiar sob o
+ * padrao do bloco e dos vizinhos (a mediana pode trazer um pixel escuro do
+ * bloco ao lado). Todo objeto cai inteiro nos blocos de um unico candidato,
+ * e pixels de outros candidatos que entram na margem sao apagados, entao a
+ * area e a proporcao de cada objeto acima da area minima sao identicas as
+ * do quadro inteiro. So a ordem dos objetos muda: sai por candidato, na
+ * ordem em que os candidatos aparecem na escala reduzida.
+ *
+ */
+
+#ifndef SEGMENTACAO_MULTIESCALA_h
+#define SEGMENTACAO_MULTIESCALA_h
+
+#include <vector>
+using namespace std;
+
+// OpenCV includes
+#include "opencv2/core.hpp"
+using namespace cv;
+
+#include "PadraoLuz.h"
+
+class SegmentacaoMultiescala
+{
+public:
+    SegmentacaoMultiescala();
+
+    /**
+     * Prepara o limite de cada bloco da escala reduzida a partir do padrao de fundo
+     * @param PadraoLuz padrao - padrao de fundo ja carregado
+     * @param int fator - lado do bloco da escala reduzida, pelo menos 2
+     */
+    void define(const PadraoLuz &padrao, int fator = 4);
+
+    bool vazio() const;
+
+    /**
+     * Mesmos objetos de ExtraiCaracteristicas(preProcessaImagem(img, padrao)), so em volta dos candidatos
+     * @param Mat img - quadro CV_8UC1 do tamanho do padrao
+     * @param Mat caracteristicas - saida N x NUM_CARACTERISTICAS CV_32F, uma linha por objeto
+     * @param vector<Point> posicoes - saida opcional do centro de cada objeto
+     * @param vector<Rect> regioes - saida opcional das regioes processadas em resolucao cheia
+     * @return int numero de objetos
+     */
+    int extrai(const Mat &img, Mat &caracteristicas, vector<Point> *posicoes = NULL, vector<Rect> *regioes = NULL) const;
+
+private:
+    PadraoLuz padrao_fino;
+    Mat limite_grosso; // um bloco e candidato se o seu menor cinza e menor que o limite
+    int fator;
+};
+
+#endif
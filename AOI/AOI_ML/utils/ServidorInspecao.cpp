@@ -0,0 +1,495 @@
+#include "ServidorInspecao.h"
+
+#include <cstring>
+#include <exception>
+#include <iostream>
+
+#include "opencv2/core/utility.hpp"
+
+#ifndef _WIN32
+#include <cerrno>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+
+static_assert(sizeof(CabecalhoPedido) == 16 && sizeof(CabecalhoResposta) == 24 && sizeof(ObjetoInspecionado) == 20,
+              "estruturas do protocolo sem preenchimento");
+
+// Maior quadro aceito, para um cabecalho corrompido nao alocar memoria sem limite
+static const int64 MAXIMO_PIXELS = (int64)1 << 28;
+
+// Intervalo em que a thread de aceitacao confere os pedidos de parada e de recarga
+static const int ESPERA_ACEITACAO_MS = 200;
+
+static bool leTudo(int conexao, void *dados, size_t tamanho)
+{
+    char *p = (char *)dados;
+    while (tamanho > 0)
+    {
+        ssize_t lidos = recv(conexao, p, tamanho, 0);
+        if (lidos < 0 && errno == EINTR)
+            continue;
+        if (lidos <= 0)
+            return false;
+        p += lidos;
+        tamanho -= (size_t)lidos;
+    }
+    return true;
+}
+
+static bool escreveTudo(int conexao, const void *dados, size_t tamanho)
+{
+    const char *p = (const char *)dados;
+    while (tamanho > 0)
+    {
+        // MSG_NOSIGNAL: um cliente que fechou a conexao nao derruba o processo com SIGPIPE
+        ssize_t escritos = send(conexao, p, tamanho, MSG_NOSIGNAL);
+        if (escritos < 0 && errno == EINTR)
+            continue;
+        if (escritos <= 0)
+            return false;
+        p += escritos;
+        tamanho -= (size_t)escritos;
+    }
+    return true;
+}
+
+static bool enderecoSocket(const String &caminho, sockaddr_un &endereco)
+{
+    memset(&endereco, 0, sizeof(endereco));
+    endereco.sun_family = AF_UNIX;
+    if (caminho.empty() || caminho.size() >= sizeof(endereco.sun_path))
+        return false;
+    memcpy(endereco.sun_path, caminho.c_str(), caminho.size());
+    return true;
+}
+
+static bool respondeInspecao(int conexao, int estado, int versao, int64 microssegundos, const vector<ObjetoInspecionado> &objetos)
+{
+    CabecalhoResposta cabecalho;
+    memcpy(cabecalho.magica, "AOIR", 4);
+    cabecalho.estado = estado;
+    cabecalho.versao = versao;
+    cabecalho.num_objetos = (int32_t)objetos.size();
+    cabecalho.microssegundos = microssegundos;
+    if (!escreveTudo(conexao, &cabecalho, sizeof(cabecalho)))
+        return false;
+    return objetos.empty() || escreveTudo(conexao, objetos.data(), objetos.size() * sizeof(ObjetoInspecionado));
+}
+
+ServidorInspecao::ServidorInspecao()
+    : socket_escuta(-1), parar(false), recarga_pedida(false), quadros(0), threads_opencv(-1)
+{
+}
+
+ServidorInspecao::~ServidorInspecao()
+{
+    solicitaParada();
+    encerra();
+}
+
+bool ServidorInspecao::inicia(const String &caminho_, ProcessaInspecao processa_, RecarregaInspecao recarrega_, int num_threads)
+{
+    sockaddr_un endereco;
+    if (!enderecoSocket(caminho_, endereco))
+    {
+        cout << "Caminho de socket invalido: " << caminho_ << endl;
+        return false;
+    }
+
+    // So remove o que ja e um socket: um arquivo comum no caminho e erro do usuario
+    struct stat info;
+    if (lstat(caminho_.c_str(), &info) == 0)
+    {
+        if (!S_ISSOCK(info.st_mode))
+        {
+            cout << caminho_ << " existe e nao e um socket" << endl;
+            return false;
+        }
+        unlink(caminho_.c_str());
+    }
+
+    socket_escuta = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (socket_escuta < 0)
+    {
+        cout << "Erro ao criar o socket: " << strerror(errno) << endl;
+        return false;
+    }
+    if (bind(socket_escuta, (sockaddr *)&endereco, sizeof(endereco)) < 0 || listen(socket_escuta, 64) < 0)
+    {
+        cout << "Erro ao escutar em " << caminho_ << ": " << strerror(errno) << endl;
+        close(socket_escuta);
+        socket_escuta = -1;
+        return false;
+    }
+
+    caminho = caminho_;
+    processa = processa_;
+    recarrega = recarrega_;
+    parar = false;
+    recarga_pedida = false;
+
+    if (num_threads <= 0)
+        num_threads = max(1, (int)thread::hardware_concurrency());
+
+    // Um quadro por thread: o paralelismo interno do OpenCV so atrapalharia
+    threads_opencv = getNumThreads();
+    setNumThreads(0);
+
+    for (int t = 0; t < num_threads; t++)
+        trabalhadores.push_back(thread([this]() { atende(); }));
+    return true;
+}
+
+void ServidorInspecao::executa()
+{
+    while (!parar && socket_escuta >= 0)
+    {
+        if (recarga_pedida.exchange(false))
+        {
+            // Em segundo plano: a aceitacao e o atendimento continuam durante a recarga
+            if (recarga.joinable())
+                recarga.join();
+            recarga = thread([this]() {
+                int versao = 0;
+                executaRecarga(versao);
+            });
+        }
+
+        pollfd espera = {socket_escuta, POLLIN, 0};
+        int prontos = poll(&espera, 1, ESPERA_ACEITACAO_MS);
+        if (prontos <= 0)
+            continue;
+
+        int conexao = accept(socket_escuta, NULL, NULL);
+        if (conexao < 0)
+            continue;
+
+        lock_guard<mutex> lock(trava);
+        conexoes.push_back(conexao);
+        tem_conexao.notify_one();
+    }
+
+    encerra();
+}
+
+void ServidorInspecao::solicitaParada()
+{
+    parar = true;
+}
+
+void ServidorInspecao::solicitaRecarga()
+{
+    recarga_pedida = true;
+}
+
+int64 ServidorInspecao::numQuadros() const
+{
+    return quadros;
+}
+
+void ServidorInspecao::atende()
+{
+    for (;;)
+    {
+        int conexao;
+        {
+            unique_lock<mutex> lock(trava);
+            tem_conexao.wait(lock, [&]() { return !conexoes.empty() || parar; });
+            if (parar)
+                return;
+            conexao = conexoes.front();
+            conexoes.pop_front();
+            em_atendimento.insert(conexao);
+        }
+
+        atendeConexao(conexao);
+
+        lock_guard<mutex> lock(trava);
+        em_atendimento.erase(conexao);
+        close(conexao);
+    }
+}
+
+void ServidorInspecao::atendeConexao(int conexao)
+{
+    // Reaproveitados entre os pedidos da conexao
+    Mat quadro;
+    vector<ObjetoInspecionado> objetos;
+
+    while (!parar)
+    {
+        CabecalhoPedido pedido;
+        if (!leTudo(conexao, &pedido, sizeof(pedido)))
+            return;
+
+        objetos.clear();
+        if (memcmp(pedido.magica, "AOIP", 4) != 0 ||
+            (pedido.tipo != PEDIDO_QUADRO && pedido.tipo != PEDIDO_RECARREGA))
+        {
+            respondeInspecao(conexao, RESPOSTA_PEDIDO_INVALIDO, 0, 0, objetos);
+            return;
+        }
+
+        if (pedido.tipo == PEDIDO_RECARREGA)
+        {
+            int versao = 0;
+            int estado = executaRecarga(versao);
+            if (!respondeInspecao(conexao, estado, versao, 0, objetos))
+                return;
+            continue;
+        }
+
+        if (pedido.largura <= 0 || pedido.altura <= 0 || (int64)pedido.largura * pedido.altura > MAXIMO_PIXELS)
+        {
+            respondeInspecao(conexao, RESPOSTA_PEDIDO_INVALIDO, 0, 0, objetos);
+            return;
+        }
+        quadro.create(pedido.altura, pedido.largura, CV_8UC1);
+        if (!leTudo(conexao, quadro.data, quadro.total()))
+            return;
+
+        int64 inicio = getTickCount();
+        int versao = 0;
+        int estado;
+        try
+        {
+            estado = processa(quadro, objetos, versao);
+        }
+        catch (const exception &e)
+        {
+            // cv::Exception ou bad_alloc: sem o catch, terminate derrubaria o servidor inteiro
+            cout << "Erro ao processar quadro: " << e.what() << endl;
+            objetos.clear();
+            estado = RESPOSTA_ERRO_PROCESSAMENTO;
+        }
+        int64 microssegundos = (int64)(1e6 * (getTickCount() - inicio) / getTickFrequency());
+        quadros++;
+
+        if (!respondeInspecao(conexao, estado, versao, microssegundos, objetos))
+            return;
+    }
+}
+
+int ServidorInspecao::executaRecarga(int &versao)
+{
+    lock_guard<mutex> lock(trava_recarga);
+    try
+    {
+        return recarrega(versao) ? RESPOSTA_OK : RESPOSTA_RECARGA_FALHOU;
+    }
+    catch (const exception &e)
+    {
+        // Tambem roda na thread de recarga; quem recarrega so troca o estado no fim
+        cout << "Erro ao recarregar: " << e.what() << endl;
+        return RESPOSTA_RECARGA_FALHOU;
+    }
+}
+
+void ServidorInspecao::encerra()
+{
+    parar = true;
+    {
+        // Acorda as threads paradas em recv() e as que esperam conexao
+        lock_guard<mutex> lock(trava);
+        for (set<int>::const_iterator c = em_atendimento.begin(); c != em_atendimento.end(); ++c)
+            shutdown(*c, SHUT_RDWR);
+        for (size_t i = 0; i < conexoes.size(); i++)
+            close(conexoes[i]);
+        conexoes.clear();
+        tem_conexao.notify_all();
+    }
+    for (size_t t = 0; t < trabalhadores.size(); t++)
+        trabalhadores[t].join();
+    trabalhadores.clear();
+    if (recarga.joinable())
+        recarga.join();
+
+    if (socket_escuta >= 0)
+    {
+        close(socket_escuta);
+        socket_escuta = -1;
+        unlink(caminho.c_str());
+    }
+    if (threads_opencv >= 0)
+    {
+        setNumThreads(threads_opencv);
+        threads_opencv = -1;
+    }
+}
+
+ClienteInspecao::ClienteInspecao() : conexao(-1)
+{
+}
+
+ClienteInspecao::~ClienteInspecao()
+{
+    fecha();
+}
+
+bool ClienteInspecao::conecta(const String &caminho)
+{
+    fecha();
+
+    sockaddr_un endereco;
+    if (!enderecoSocket(caminho, endereco))
+        return false;
+
+    conexao = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (conexao < 0)
+        return false;
+    if (connect(conexao, (sockaddr *)&endereco, sizeof(endereco)) < 0)
+    {
+        fecha();
+        return false;
+    }
+    return true;
+}
+
+void ClienteInspecao::fecha()
+{
+    if (conexao >= 0)
+        close(conexao);
+    conexao = -1;
+}
+
+int ClienteInspecao::inspeciona(const Mat &quadro, vector<ObjetoInspecionado> &objetos, int *versao, int64 *microssegundos)
+{
+    CV_Assert(quadro.type() == CV_8UC1);
+    if (conexao < 0)
+        return -1;
+
+    CabecalhoPedido pedido;
+    memcpy(pedido.magica, "AOIP", 4);
+    pedido.tipo = PEDIDO_QUADRO;
+    pedido.largura = quadro.cols;
+    pedido.altura = quadro.rows;
+    if (!escreveTudo(conexao, &pedido, sizeof(pedido)))
+        return -1;
+
+    // Uma escrita so se o quadro e contiguo; uma vista de regiao vai linha a linha
+    if (quadro.isContinuous())
+    {
+        if (!escreveTudo(conexao, quadro.data, quadro.total()))
+            return -1;
+    }
+    else
+    {
+        for (int y = 0; y < quadro.rows; y++)
+        {
+            if (!escreveTudo(conexao, quadro.ptr<uchar>(y), quadro.cols))
+                return -1;
+        }
+    }
+
+    return leResposta(&objetos, versao, microssegundos);
+}
+
+int ClienteInspecao::recarrega(int *versao)
+{
+    if (conexao < 0)
+        return -1;
+
+    CabecalhoPedido pedido;
+    memcpy(pedido.magica, "AOIP", 4);
+    pedido.tipo = PEDIDO_RECARREGA;
+    pedido.largura = pedido.altura = 0;
+    if (!escreveTudo(conexao, &pedido, sizeof(pedido)))
+        return -1;
+
+    return leResposta(NULL, versao, NULL);
+}
+
+int ClienteInspecao::leResposta(vector<ObjetoInspecionado> *objetos, int *versao, int64 *microssegundos)
+{
+    CabecalhoResposta resposta;
+    if (!leTudo(conexao, &resposta, sizeof(resposta)) || memcmp(resposta.magica, "AOIR", 4) != 0 || resposta.num_objetos < 0)
+    {
+        fecha();
+        return -1;
+    }
+
+    vector<ObjetoInspecionado> recebidos(resposta.num_objetos);
+    if (!recebidos.empty() && !leTudo(conexao, recebidos.data(), recebidos.size() * sizeof(ObjetoInspecionado)))
+    {
+        fecha();
+        return -1;
+    }
+
+    if (objetos != NULL)
+        objetos->swap(recebidos);
+    if (versao != NULL)
+        *versao = resposta.versao;
+    if (microssegundos != NULL)
+        *microssegundos = resposta.microssegundos;
+    return resposta.estado;
+}
+
+#else
+
+// Sem AF_UNIX por aqui no Windows: o servidor e o cliente nao abrem e o resto nunca roda
+
+ServidorInspecao::ServidorInspecao()
+    : socket_escuta(-1), parar(false), recarga_pedida(false), quadros(0), threads_opencv(-1)
+{
+}
+
+ServidorInspecao::~ServidorInspecao()
+{
+}
+
+bool ServidorInspecao::inicia(const String &, ProcessaInspecao, RecarregaInspecao, int)
+{
+    cout << "Servidor de inspecao so em sistemas com sockets Unix" << endl;
+    return false;
+}
+
+void ServidorInspecao::executa()
+{
+}
+
+void ServidorInspecao::solicitaParada()
+{
+    parar = true;
+}
+
+void ServidorInspecao::solicitaRecarga()
+{
+    recarga_pedida = true;
+}
+
+int64 ServidorInspecao::numQuadros() const
+{
+    return quadros;
+}
+
+ClienteInspecao::ClienteInspecao() : conexao(-1)
+{
+}
+
+ClienteInspecao::~ClienteInspecao()
+{
+}
+
+bool ClienteInspecao::conecta(const String &)
+{
+    return false;
+}
+
+void ClienteInspecao::fecha()
+{
+}
+
+int ClienteInspecao::inspeciona(const Mat &, vector<ObjetoInspecionado> &, int *, int64 *)
+{
+    return -1;
+}
+
+int ClienteInspecao::recarrega(int *)
+{
+    return -1;
+}
+
+#endif
@@ -0,0 +1,188 @@
+/**
+ * Servidor de inspecao local
+ *
+ * Mantem o processo vivo entre as pecas: o padrao de fundo, o modelo e as
+ * threads de trabalho ficam carregados, e os quadros chegam por um socket
+ * Unix (AF_UNIX), acessivel so na propria maquina. Cada conexao manda
+ * quantos quadros quiser, um pedido por vez; as conexoes sao atendidas por
+ * um numero fixo de threads, e cada thread fica presa a uma conexao ate o
+ * cliente fechar. Com N threads (-workers) e N clientes que mantem a
+ * conexao aberta, o cliente N + 1 nao e atendido ate um deles sair, mesmo
+ * com as threads ociosas entre os quadros: dimensione -workers pelo numero
+ * de clientes simultaneos, ou feche a conexao entre as pecas.
+ *
+ * Protocolo, com os inteiros na ordem de bytes da maquina:
+ *   pedido:   CabecalhoPedido e, com PEDIDO_QUADRO, largura * altura bytes
+ *             do quadro em cinza, linha a linha
+ *   resposta: CabecalhoResposta e num_objetos ObjetoInspecionado
+ *
+ * A recarga (PEDIDO_RECARREGA, ou solicitaRecarga() a partir de um SIGHUP)
+ * roda em paralelo ao atendimento: quem implementa a recarga monta um
+ * estado novo e o troca de uma vez, e os quadros em andamento terminam com
+ * o estado antigo. Nenhum pedido e recusado durante a recarga.
+ *
+ */
+
+#ifndef SERVIDOR_INSPECAO_h
+#define SERVIDOR_INSPECAO_h
+
+#include <cstdint>
+#include <vector>
+#include <deque>
+#include <set>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <functional>
+#include <condition_variable>
+using namespace std;
+
+// OpenCV includes
+#include "opencv2/core.hpp"
+using namespace cv;
+
+enum TipoPedido
+{
+    PEDIDO_QUADRO = 1,   // classifica o quadro que segue o cabecalho
+    PEDIDO_RECARREGA = 2 // rele o modelo e o padrao de fundo
+};
+
+enum EstadoResposta
+{
+    RESPOSTA_OK = 0,
+    RESPOSTA_TAMANHO_INCOMPATIVEL = 1, // quadro de tamanho diferente do padrao de fundo
+    RESPOSTA_PEDIDO_INVALIDO = 2,      // cabecalho desconhecido ou tamanho absurdo; a conexao e fechada
+    RESPOSTA_RECARGA_FALHOU = 3,       // o estado anterior continua valendo
+    RESPOSTA_ERRO_PROCESSAMENTO = 4    // excecao ao processar o quadro; a conexao continua aberta
+};
+
+struct CabecalhoPedido
+{
+    char magica[4]; // "AOIP"
+    int32_t tipo;   // TipoPedido
+    int32_t largura, altura;
+};
+
+struct CabecalhoResposta
+{
+    char magica[4]; // "AOIR"
+    int32_t estado; // EstadoResposta
+    int32_t versao; // versao do modelo e do padrao que atenderam o pedido
+    int32_t num_objetos;
+    int64_t microssegundos; // tempo de processamento no servidor, sem a transmissao
+};
+
+struct ObjetoInspecionado
+{
+    int32_t classe;
+    float x, y; // centro do objeto no quadro
+    float area, proporcao;
+};
+
+/**
+ * Processa um quadro: preenche os objetos e a versao do estado usado
+ * @return int EstadoResposta
+ */
+typedef function<int(const Mat &quadro, vector<ObjetoInspecionado> &objetos, int &versao)> ProcessaInspecao;
+
+/**
+ * Rele o modelo e o padrao e troca o estado; em erro mantem o anterior
+ * @return bool true se o estado foi trocado; versao recebe a versao em vigor
+ */
+typedef function<bool(int &versao)> RecarregaInspecao;
+
+class ServidorInspecao
+{
+public:
+    ServidorInspecao();
+
+    /**
+     * Encerra o atendimento e remove o socket
+     */
+    ~ServidorInspecao();
+
+    /**
+     * Cria o socket e as threads de atendimento
+     * @param String caminho - arquivo do socket; um socket antigo no mesmo caminho e removido
+     * @param ProcessaInspecao processa - chamada em paralelo pelas threads de atendimento
+     * @param RecarregaInspecao recarrega - chamada por uma thread de cada vez
+     * @param int num_threads - threads de atendimento, 0 usa todos os nucleos
+     * @return bool false se o socket nao pode ser criado
+     */
+    bool inicia(const String &caminho, ProcessaInspecao processa, RecarregaInspecao recarrega, int num_threads = 0);
+
+    /**
+     * Aceita conexoes na thread chamadora ate solicitaParada(); depois espera as threads e fecha tudo
+     */
+    void executa();
+
+    /**
+     * Pede o fim do atendimento; so grava um atomic, pode ser chamada de um tratador de sinal
+     */
+    void solicitaParada();
+
+    /**
+     * Pede uma recarga em segundo plano; pode ser chamada de um tratador de sinal
+     */
+    void solicitaRecarga();
+
+    /**
+     * Quadros atendidos desde o inicio
+     */
+    int64 numQuadros() const;
+
+private:
+    String caminho;
+    int socket_escuta;
+    ProcessaInspecao processa;
+    RecarregaInspecao recarrega;
+
+    vector<thread> trabalhadores;
+    mutex trava;
+    condition_variable tem_conexao;
+    deque<int> conexoes;    // aceitas e ainda nao atendidas
+    set<int> em_atendimento;
+    mutex trava_recarga;    // uma recarga por vez
+    thread recarga;
+
+    atomic<bool> parar, recarga_pedida;
+    atomic<int64> quadros;
+    int threads_opencv;
+
+    void atende();
+    void atendeConexao(int conexao);
+    int executaRecarga(int &versao);
+    void encerra();
+};
+
+class ClienteInspecao
+{
+public:
+    ClienteInspecao();
+    ~ClienteInspecao();
+
+    bool conecta(const String &caminho);
+    void fecha();
+
+    /**
+     * Manda um quadro e espera os objetos
+     * @param Mat quadro - CV_8UC1
+     * @param int* versao - saida opcional da versao do estado que atendeu
+     * @param int64* microssegundos - saida opcional do tempo de processamento no servidor
+     * @return int EstadoResposta, ou -1 se a conexao falhou
+     */
+    int inspeciona(const Mat &quadro, vector<ObjetoInspecionado> &objetos, int *versao = NULL, int64 *microssegundos = NULL);
+
+    /**
+     * Pede ao servidor para reler o modelo e o padrao
+     * @return int EstadoResposta, ou -1 se a conexao falhou
+     */
+    int recarrega(int *versao = NULL);
+
+private:
+    int conexao;
+
+    int leResposta(vector<ObjetoInspecionado> *objetos, int *versao, int64 *microssegundos);
+};
+
+#endif
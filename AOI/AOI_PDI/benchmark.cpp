@@ -0,0 +1,442 @@
+// Benchmark das etapas do AOI_PDI
+//
+// Mede cada etapa com as imagens do dataset, com a imagem de teste ampliada
+// e com cenas sinteticas de milhares de pecas, e grava pixels/s e objetos/s
+// em JSON para comparar otimizacoes.
+
+// Arquivos de include do C++
+#include <iostream>
+#include <string>
+#include <sstream>
+#include <cstdio>
+
+// Arquivos de include do OpenCV
+#include <opencv2/imgproc.hpp>
+#include <opencv2/imgcodecs.hpp>
+#include <opencv2/core/utility.hpp>
+
+// Utilitarios comuns ao AOI_PDI e ao AOI_ML (AOI/common)
+#include "PadraoLuz.h"
+#include "RemocaoLuz.h"
+#include "Histograma.h"
+#include "MascaraRLE.h"
+#include "ImagemPGM.h"
+#include "GeradorCenas.h"
+#include "Benchmark.h"
+
+#include "utils/Segmentacao.h"
+#include "utils/FundoMultiescala.h"
+
+// Namespaces
+using namespace std;
+using namespace cv;
+
+const char *chavesB =
+	{
+		"{help h uso ? |   | imprime esta mensagem}"
+		"{data         | ../x64/Debug/data | Diretorio do dataset (nut, ring, screw, test.pgm e pattern.pgm)}"
+		"{scales       | 2,4,8,16 | Fatores de ampliacao da imagem de teste para os tamanhos sinteticos (8 ~ 5 MP, 16 ~ 20 MP)}"
+		"{synthetic    | 4096x4096@120,5472x3648@100 | Cenas do GeradorCenas, LxA@pecas por MP separadas por virgula; vazio nao gera}"
+		"{minTime      | 0.5 | Tempo minimo em segundos de cada medida}"
+		"{json         | benchmark_pdi.json | Arquivo JSON com as medidas}"};
+
+// Descarta o que as funcoes de segmentacao interativas imprimem enquanto sao medidas
+struct SilenciaCout
+{
+	streambuf *original;
+	SilenciaCout() : original(cout.rdbuf(NULL)) {}
+	~SilenciaCout()
+	{
+		cout.rdbuf(original);
+		cout.clear();
+	}
+};
+
+struct EntradaBenchmark
+{
+	String nome;
+	Mat img;
+	PadraoLuz padrao;
+	int pecas_geradas; // cenas sinteticas: numero real de pecas; -1 nas outras
+
+	EntradaBenchmark() : pecas_geradas(-1) {}
+};
+
+static vector<double> leFatores(const String &texto)
+{
+	vector<double> fatores;
+	stringstream ss(texto);
+	String item;
+	while (getline(ss, item, ','))
+	{
+		double fator = atof(item.c_str());
+		if (fator > 0)
+			fatores.push_back(fator);
+	}
+	return fatores;
+}
+
+// Referencia escalar da divisao: as operacoes em float do caminho original, 0 onde o padrao vale 0
+static uchar divisaoReferencia(uchar i, uchar p)
+{
+	if (p == 0)
+		return 0;
+	return saturate_cast<uchar>((1.f - (float)i / (float)p) * 255.f);
+}
+
+// Compara removeLuzDivisao com a referencia nos 65536 pares (img, padrao): linhas inteiras passam so
+// pelo kernel vetorial, e as deslocadas de 1 pixel leem desalinhado e terminam na cauda escalar
+static int confereDivisao()
+{
+	Mat img(256, 256, CV_8UC1), padrao(256, 256, CV_8UC1);
+	for (int p = 0; p < 256; p++)
+	{
+		for (int i = 0; i < 256; i++)
+		{
+			img.at<uchar>(p, i) = (uchar)i;
+			padrao.at<uchar>(p, i) = (uchar)p;
+		}
+	}
+
+	Mat inteira, deslocada(256, 256, CV_8UC1, Scalar(0));
+	removeLuzDivisao(img, padrao, inteira);
+	for (int p = 0; p < 256; p++)
+		removeLuzDivisaoLinha(img.ptr<uchar>(p) + 1, padrao.ptr<uchar>(p) + 1, deslocada.ptr<uchar>(p) + 1, 255);
+
+	int diferentes = 0;
+	for (int p = 0; p < 256; p++)
+	{
+		for (int i = 0; i < 256; i++)
+		{
+			uchar esperado = divisaoReferencia((uchar)i, (uchar)p);
+			if (inteira.at<uchar>(p, i) != esperado || (i > 0 && deslocada.at<uchar>(p, i) != esperado))
+				diferentes++;
+		}
+	}
+	return diferentes;
+}
+
+// Carga de um PGM: imread contra o mapeamento, sempre lendo todos os pixels, que o mapeamento so traz sob demanda
+static void medeLeitura(Benchmark &bench, const String &nome, const String &arquivo)
+{
+	Mat referencia = imread(arquivo, IMREAD_GRAYSCALE);
+	if (referencia.empty())
+		return;
+	Size tamanho = referencia.size();
+
+	bench.mede("carga imread", nome, tamanho, [&]() {
+		return sum(imread(arquivo, IMREAD_GRAYSCALE))[0] > 0 ? 0 : 1;
+	});
+	bench.mede("carga leImagemCinza (mapeada)", nome, tamanho, [&]() {
+		return sum(leImagemCinza(arquivo))[0] > 0 ? 0 : 1;
+	});
+
+	Mat lida = leImagemCinza(arquivo);
+	if (lida.size() != referencia.size() || countNonZero(lida != referencia) > 0)
+		cout << "ERRO: leImagemCinza difere de imread em " << arquivo << endl;
+}
+
+static void medeEntrada(Benchmark &bench, const EntradaBenchmark &entrada)
+{
+	const Mat &img = entrada.img;
+	const PadraoLuz &padrao = entrada.padrao;
+	Size tamanho = img.size();
+
+	// Saidas de cada etapa, usadas como entrada da seguinte
+	Mat sem_ruido = removeRuido(img);
+	Mat sem_fundo = removeFundo(padrao, sem_ruido, 1);
+	Mat thr = thresholding(sem_fundo, 1);
+
+	Mat rotulos;
+	int num_componentes = connectedComponents(thr, rotulos) - 1;
+	vector<vector<Point>> contornos;
+	findContours(thr, contornos, RETR_EXTERNAL, CHAIN_APPROX_SIMPLE);
+	int num_contornos = (int)contornos.size();
+	if (entrada.pecas_geradas >= 0)
+		cout << "Cena sintetica " << entrada.nome << ": " << entrada.pecas_geradas << " pecas geradas, " << num_componentes
+			 << " componentes e " << num_contornos << " contornos encontrados" << endl;
+
+	bench.mede("removeRuido (medianBlur 7)", entrada.nome, tamanho, [&]() {
+		removeRuido(img);
+		return 0;
+	});
+	bench.mede("calculaPadraoLuz", entrada.nome, tamanho, [&]() {
+		calculaPadraoLuz(sem_ruido);
+		return 0;
+	});
+	bench.mede("calculaPadraoLuz + mediana 7", entrada.nome, tamanho, [&]() {
+		Mat referencia;
+		medianBlur(calculaPadraoLuz(sem_ruido), referencia, 7);
+		return 0;
+	});
+	bench.mede("estimaFundoMultiescala", entrada.nome, tamanho, [&]() {
+		estimaFundoMultiescala(sem_ruido);
+		return 0;
+	});
+
+	// Confere o erro do fundo multiescala contra o limite documentado em FundoMultiescala.h
+	Mat referencia, diferenca;
+	medianBlur(calculaPadraoLuz(sem_ruido), referencia, 7);
+	absdiff(referencia, estimaFundoMultiescala(sem_ruido), diferenca);
+	double erro_max, minimo, maximo;
+	minMaxLoc(diferenca, NULL, &erro_max);
+	minMaxLoc(sem_ruido, &minimo, &maximo);
+	int fator = fatorFundoMultiescala(tamanho.width);
+	double limite = (maximo - minimo) * (6 * fator + 6) / (tamanho.width / 3) + 1;
+	cout << "Fundo multiescala em " << entrada.nome << ": fator " << fator << ", erro maximo " << erro_max
+		 << " (limite " << limite << ")" << endl;
+	bench.mede("removeLuz metodo 0 (diferenca)", entrada.nome, tamanho, [&]() {
+		removeLuz(sem_ruido, padrao.padrao(), 0);
+		return 0;
+	});
+	bench.mede("removeLuz metodo 1 (divisao)", entrada.nome, tamanho, [&]() {
+		removeLuz(sem_ruido, padrao.padrao(), 1);
+		return 0;
+	});
+	bench.mede("removeFundo metodo 1 (divisao)", entrada.nome, tamanho, [&]() {
+		removeFundo(padrao, sem_ruido, LUZ_DIVISAO);
+		return 0;
+	});
+	bench.mede("removeFundo metodo 3 (reciproco)", entrada.nome, tamanho, [&]() {
+		removeFundo(padrao, sem_ruido, LUZ_DIVISAO_RECIPROCO);
+		return 0;
+	});
+	bench.mede("thresholding", entrada.nome, tamanho, [&]() {
+		thresholding(sem_fundo, 1);
+		return 0;
+	});
+	bench.mede("preProcessa (etapas separadas)", entrada.nome, tamanho, [&]() {
+		preProcessa(img, padrao, 1, LIMIAR_FIXO, 90, false);
+		return 0;
+	});
+	bench.mede("preProcessa fundido metodo 0 (diferenca)", entrada.nome, tamanho, [&]() {
+		preProcessa(img, padrao, 0, LIMIAR_FIXO, 90, true);
+		return 0;
+	});
+	bench.mede("preProcessa fundido metodo 1 (divisao)", entrada.nome, tamanho, [&]() {
+		preProcessa(img, padrao, 1, LIMIAR_FIXO, 90, true);
+		return 0;
+	});
+
+	// O caminho fundido deve ser identico bit a bit as etapas separadas, em todos os metodos de luz
+	for (int metodo_luz = LUZ_DIFERENCA; metodo_luz <= LUZ_DIVISAO_RECIPROCO; metodo_luz++)
+	{
+		Mat separado = preProcessa(img, padrao, metodo_luz, LIMIAR_FIXO, 90, false);
+		int diferentes = countNonZero(preProcessa(img, padrao, metodo_luz, LIMIAR_FIXO, 90, true) != separado);
+		if (diferentes > 0)
+			cout << "ERRO: pre-processamento fundido difere em " << diferentes << " pixels de " << entrada.nome
+				 << " com lightMethod=" << metodo_luz << endl;
+	}
+
+	// Mascara em corridas: binarizacao, rotulacao e o lote inteiro sem imagem binaria
+	MascaraRLE mascara;
+	codificaRLE(thr, mascara);
+	bench.mede("binarizaRLE", entrada.nome, tamanho, [&]() {
+		MascaraRLE saida;
+		binarizaRLE(sem_fundo, 30, THRESH_BINARY, saida);
+		return 0;
+	});
+	bench.mede("rotulaRLE (estatisticas)", entrada.nome, tamanho, [&]() {
+		vector<int> rotulos;
+		vector<ComponenteRLE> componentes;
+		return rotulaRLE(mascara, rotulos, componentes) - 1;
+	});
+	bench.mede("connectedComponentsWithStats", entrada.nome, tamanho, [&]() {
+		Mat rotulos, estatisticas, centroides;
+		return connectedComponentsWithStats(thr, rotulos, estatisticas, centroides, 8) - 1;
+	});
+	bench.mede("preProcessaRLE fundido + estatisticas", entrada.nome, tamanho, [&]() {
+		MascaraRLE saida;
+		ResultadoImagem resultado;
+		preProcessaRLE(img, padrao, 1, LIMIAR_FIXO, 90, true, saida);
+		estatisticasObjetosRLE(saida, resultado);
+		return resultado.num_objetos;
+	});
+
+	// As estatisticas sobre corridas devem ser as mesmas das da imagem binaria
+	ResultadoImagem resultado_rle, resultado_imagem;
+	estatisticasObjetosRLE(mascara, resultado_rle);
+	estatisticasObjetos(thr, 2, resultado_imagem);
+	cout << "Mascara RLE de " << entrada.nome << ": " << mascara.corridas.size() << " corridas, "
+		 << mascara.corridas.size() * sizeof(CorridaRLE) << " bytes contra " << thr.total() << " da imagem" << endl;
+	if (resultado_rle.num_objetos != resultado_imagem.num_objetos || resultado_rle.area_total != resultado_imagem.area_total ||
+		resultado_rle.area_min != resultado_imagem.area_min || resultado_rle.area_max != resultado_imagem.area_max)
+		cout << "ERRO: estatisticas em corridas diferem das de connectedComponentsWithStats em " << entrada.nome << endl;
+	bench.mede("calculaHistograma", entrada.nome, tamanho, [&]() {
+		int histograma[256];
+		calculaHistograma(sem_fundo, histograma);
+		return 0;
+	});
+	bench.mede("thresholding Otsu", entrada.nome, tamanho, [&]() {
+		thresholding(sem_fundo, 1, LIMIAR_OTSU);
+		return 0;
+	});
+	bench.mede("thresholding triangulo", entrada.nome, tamanho, [&]() {
+		thresholding(sem_fundo, 1, LIMIAR_TRIANGULO);
+		return 0;
+	});
+	bench.mede("thresholding percentil", entrada.nome, tamanho, [&]() {
+		thresholding(sem_fundo, 1, LIMIAR_PERCENTIL, 90);
+		return 0;
+	});
+
+	// As funcoes interativas encerram o programa sem objetos
+	if (num_componentes > 0)
+	{
+		SilenciaCout silencio;
+		bench.mede("ComponentesConexas", entrada.nome, tamanho, [&]() {
+			ComponentesConexas(thr);
+			return num_componentes;
+		});
+		bench.mede("ComponentesConexasComEstatisticas", entrada.nome, tamanho, [&]() {
+			ComponentesConexasComEstatisticas(thr);
+			return num_componentes;
+		});
+	}
+	if (num_contornos > 0)
+	{
+		SilenciaCout silencio;
+		bench.mede("EncontraContornos", entrada.nome, tamanho, [&]() {
+			EncontraContornos(thr);
+			return num_contornos;
+		});
+	}
+
+	bench.mede("pipeline (ruido+fundo+limiar+estatisticas)", entrada.nome, tamanho, [&]() {
+		ResultadoImagem resultado;
+		estatisticasObjetos(thresholding(removeFundo(padrao, removeRuido(img), 1), 1), 2, resultado);
+		return resultado.num_objetos;
+	});
+}
+
+int main(int argc, const char **argv)
+{
+	CommandLineParser parser(argc, argv, chavesB);
+
+	if (parser.has("help"))
+	{
+		parser.printMessage();
+		return 0;
+	}
+
+	String pasta = parser.get<String>("data");
+	vector<double> fatores = leFatores(parser.get<String>("scales"));
+	String cenas = parser.get<String>("synthetic");
+	double tempo_minimo = parser.get<double>("minTime");
+	String arq_json = parser.get<String>("json");
+
+	if (!parser.check())
+	{
+		parser.printErrors();
+		return 0;
+	}
+
+	// O kernel vetorial da divisao tem de ser identico bit a bit a referencia escalar; sem isso as medidas nao valem
+	int pares_diferentes = confereDivisao();
+	if (pares_diferentes > 0)
+	{
+		cout << "ERRO: removeLuzDivisao difere da referencia escalar em " << pares_diferentes << " dos 65536 pares (img, padrao)" << endl;
+		return 1;
+	}
+	cout << "removeLuzDivisao identica a referencia escalar nos 65536 pares (img, padrao)" << endl;
+
+	// Mesmo padrao do modo interativo: mediana 7, sem gravar cache
+	PadraoLuz padrao;
+	if (!padrao.carrega(pasta + "/pattern.pgm", 7, false))
+	{
+		cout << "Erro ao carregar " << pasta << "/pattern.pgm" << endl;
+		return 1;
+	}
+
+	const char *imagens[][2] = {
+		{"nut", "nut/tuerca_0000.pgm"},
+		{"ring", "ring/arandela_0000.pgm"},
+		{"screw", "screw/tornillo_0000.pgm"},
+		{"test", "test.pgm"}};
+
+	vector<EntradaBenchmark> entradas;
+	for (int i = 0; i < 4; i++)
+	{
+		EntradaBenchmark entrada;
+		entrada.nome = imagens[i][0];
+		entrada.img = imread(pasta + "/" + imagens[i][1], IMREAD_GRAYSCALE);
+		if (entrada.img.empty() || !padrao.compativel(entrada.img.size()))
+		{
+			cout << "Imagem " << imagens[i][1] << " ignorada (ilegivel ou de tamanho diferente do padrao)" << endl;
+			continue;
+		}
+		entrada.padrao = padrao;
+		entradas.push_back(entrada);
+	}
+	if (entradas.empty())
+		return 1;
+
+	// Tamanhos sinteticos: a ultima entrada (test) e o padrao ampliados
+	EntradaBenchmark base = entradas.back();
+	for (size_t i = 0; i < fatores.size(); i++)
+	{
+		EntradaBenchmark entrada;
+		entrada.nome = base.nome + format("_x%g", fatores[i]);
+		resize(base.img, entrada.img, Size(), fatores[i], fatores[i], INTER_LINEAR);
+		Mat padrao_ampliado;
+		resize(padrao.padrao(), padrao_ampliado, entrada.img.size(), 0, 0, INTER_LINEAR);
+		entrada.padrao.define(padrao_ampliado, 1);
+		entradas.push_back(entrada);
+	}
+
+	// Cenas sinteticas com o padrao do proprio gerador e pecas do tamanho das do dataset
+	stringstream ss(cenas);
+	String cena;
+	while (getline(ss, cena, ','))
+	{
+		ParametrosCena parametros;
+		if (sscanf(cena.c_str(), "%dx%d@%lf", &parametros.tamanho.width, &parametros.tamanho.height, &parametros.densidade) != 3)
+		{
+			cout << "Cena sintetica " << cena << " ignorada (use LxA@densidade)" << endl;
+			continue;
+		}
+		GeradorCenas gerador;
+		if (!gerador.define(parametros))
+			continue;
+
+		EntradaBenchmark entrada;
+		entrada.nome = "sintetico_" + cena;
+		vector<ObjetoGerado> objetos;
+		gerador.gera(0, entrada.img, &objetos);
+		entrada.padrao.define(gerador.padrao(), 1);
+		entrada.pecas_geradas = (int)objetos.size();
+		entradas.push_back(entrada);
+	}
+
+	Benchmark bench(tempo_minimo);
+	for (size_t i = 0; i < entradas.size(); i++)
+	{
+		cout << "Medindo " << entradas[i].nome << " (" << entradas[i].img.cols << "x" << entradas[i].img.rows << ")" << endl;
+		medeEntrada(bench, entradas[i]);
+	}
+
+	// Carga: os arquivos do dataset (P2 e P5) e os tamanhos sinteticos gravados como P5 temporarios
+	for (int i = 0; i < 4; i++)
+		medeLeitura(bench, imagens[i][0], pasta + "/" + imagens[i][1]);
+	for (size_t i = 0; i < entradas.size(); i++)
+	{
+		if (entradas[i].nome.find("_x") == String::npos)
+			continue;
+		String temporario = "benchmark_" + entradas[i].nome + ".pgm";
+		bench.mede("gravaPGM", entradas[i].nome, entradas[i].img.size(), [&]() {
+			return gravaPGM(temporario, entradas[i].img) ? 0 : 1;
+		});
+		medeLeitura(bench, entradas[i].nome, temporario);
+		remove(temporario.c_str());
+	}
+
+	bench.imprime();
+	if (!bench.gravaJson(arq_json, "AOI_PDI"))
+	{
+		cout << "Erro ao gravar " << arq_json << endl;
+		return 1;
+	}
+	cout << "Medidas gravadas em " << arq_json << endl;
+
+	return 0;
+}
@@ -0,0 +1,135 @@
+// Gerador de cenas sinteticas do AOI_PDI
+//
+// Desenha porcas, arruelas e parafusos com a resolucao, densidade, tamanho,
+// sobreposicao, ruido e iluminacao pedidos e grava os quadros em PGM, o
+// padrao de luz e o rotulo verdadeiro de cada peca em CSV. Os mesmos
+// parametros com o prefixo "sintetico:" servem de fonte para o -stream do
+// main, tocada no ritmo de -playFps para medir vazao e latencia.
+
+// Arquivos de include do C++
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <filesystem>
+
+// Arquivos de include do OpenCV
+#include <opencv2/core/utility.hpp>
+
+// Utilitarios comuns ao AOI_PDI e ao AOI_ML (AOI/common)
+#include "GeradorCenas.h"
+#include "ImagemPGM.h"
+
+// Namespaces
+using namespace std;
+using namespace cv;
+namespace fs = std::filesystem;
+
+const char *chavesG =
+	{
+		"{help h uso ? |   | imprime esta mensagem}"
+		"{scene        | size=5472x3648,density=100 | Parametros da cena: size, density, minSize, maxSize, overlap, noise, impulse, light, pattern, seed}"
+		"{frames       | 8 | Quadros gravados (o frames de -scene vale so para a fonte sintetica do stream)}"
+		"{out          | gerado | Pasta de saida: padrao.pgm, cena_%05d.pgm e rotulos.csv}"};
+
+static bool gravaRotulos(const String &arquivo, const vector<vector<ObjetoGerado>> &quadros)
+{
+	ofstream csv(arquivo.c_str());
+	if (!csv.is_open())
+		return false;
+
+	csv << "quadro,classe,nome,x,y,angulo,tamanho,area,caixa_x,caixa_y,caixa_largura,caixa_altura,sobreposto" << endl;
+	for (size_t q = 0; q < quadros.size(); q++)
+	{
+		for (size_t i = 0; i < quadros[q].size(); i++)
+		{
+			const ObjetoGerado &o = quadros[q][i];
+			csv << q << "," << o.classe << "," << nomeClasseGerada(o.classe) << "," << o.centro.x << "," << o.centro.y << ","
+				<< o.angulo << "," << o.tamanho << "," << o.area << "," << o.caixa.x << "," << o.caixa.y << ","
+				<< o.caixa.width << "," << o.caixa.height << "," << (o.sobreposto ? 1 : 0) << endl;
+		}
+	}
+
+	return csv.good();
+}
+
+int main(int argc, const char **argv)
+{
+	CommandLineParser parser(argc, argv, chavesG);
+
+	if (parser.has("help"))
+	{
+		parser.printMessage();
+		return 0;
+	}
+
+	String cena = parser.get<String>("scene");
+	int num_quadros = parser.get<int>("frames");
+	String pasta = parser.get<String>("out");
+
+	if (!parser.check())
+	{
+		parser.printErrors();
+		return 0;
+	}
+
+	ParametrosCena parametros;
+	if (!interpretaParametrosCena(cena, parametros))
+	{
+		cout << "Parametros de cena invalidos: " << cena << endl;
+		return 1;
+	}
+	GeradorCenas gerador;
+	if (!gerador.define(parametros))
+	{
+		cout << "Erro ao preparar o padrao de luz da cena " << cena << endl;
+		return 1;
+	}
+
+	std::error_code erro;
+	fs::create_directories(pasta.c_str(), erro);
+	if (!gravaPGM(pasta + "/padrao.pgm", gerador.padrao()))
+	{
+		cout << "Erro ao gravar " << pasta << "/padrao.pgm" << endl;
+		return 1;
+	}
+
+	// Cada quadro so depende do seu indice: desenho e gravacao em paralelo
+	Size tamanho = gerador.parametros().tamanho;
+	vector<vector<ObjetoGerado>> rotulos(max(0, num_quadros));
+	vector<char> gravados(rotulos.size(), 0);
+	int64 inicio = getTickCount();
+	parallel_for_(Range(0, (int)rotulos.size()), [&](const Range &trecho) {
+		for (int i = trecho.start; i < trecho.end; i++)
+		{
+			Mat quadro;
+			gerador.gera(i, quadro, &rotulos[i]);
+			gravados[i] = gravaPGM(pasta + format("/cena_%05d.pgm", i), quadro);
+		}
+	});
+	double segundos = (getTickCount() - inicio) / getTickFrequency();
+
+	size_t num_objetos = 0, num_sobrepostos = 0;
+	for (size_t q = 0; q < rotulos.size(); q++)
+	{
+		if (!gravados[q])
+		{
+			cout << "Erro ao gravar " << pasta << format("/cena_%05d.pgm", (int)q) << endl;
+			return 1;
+		}
+		num_objetos += rotulos[q].size();
+		for (size_t i = 0; i < rotulos[q].size(); i++)
+			num_sobrepostos += rotulos[q][i].sobreposto ? 1 : 0;
+	}
+
+	if (!gravaRotulos(pasta + "/rotulos.csv", rotulos))
+	{
+		cout << "Erro ao gravar " << pasta << "/rotulos.csv" << endl;
+		return 1;
+	}
+
+	cout << rotulos.size() << " quadros de " << tamanho.width << "x" << tamanho.height << " em " << pasta << ": "
+		 << num_objetos << " objetos, " << num_sobrepostos << " sobrepostos" << endl;
+	cout << "Tempo: " << segundos << " s, " << rotulos.size() * tamanho.area() / 1e6 / max(segundos, 1e-9) << " MP/s" << endl;
+
+	return 0;
+}
@@ -3,15 +3,39 @@
 #include <string>
 #include <sstream>
 #include <cmath>
+#include <filesystem>
 
 // Arquivos de include do OpenCV
 #include <opencv2/highgui.hpp>
 #include <opencv2/imgproc.hpp>
 #include <opencv2/core/utility.hpp>
 
-#include "utils/MultipleImageWindow.h"
+// Utilitarios comuns ao AOI_PDI e ao AOI_ML (AOI/common)
+#include "MultipleImageWindow.h"
+#include "PadraoLuz.h"
+#include "ImagemPGM.h"
+#include "PipelineStream.h"
+#include "Instrumentacao.h"
+
+#include "utils/ProcessamentoLote.h"
+#include "utils/ProcessamentoBlocos.h"
+#include "utils/Segmentacao.h"
 MultipleImageWindow *miw;
 
+// Com -headless as janelas viram mosaicos fora da tela, gravados em -mosaic
+MultipleImageWindow::Backend backend_janela = MultipleImageWindow::BACKEND_HIGHGUI;
+String arq_mosaico;
+
+// Limiar de binarizacao: fixo ou escolhido pelo histograma de cada quadro
+int metodo_limiar = LIMIAR_FIXO;
+double percentil_limiar = 90;
+
+// Com -fused os modos em lote e stream pre-processam numa unica passada por faixas
+bool pre_fundido = false;
+
+// Pasta de -masks: o lote grava ali a imagem binaria de cada entrada
+String pasta_mascaras;
+
 // Namespaces
 using namespace std;
 using namespace cv;
@@ -23,198 +47,215 @@ const char *chavesM =
 		"{help h uso ?  |   | imprime esta mensagem}"
 		"{@image        |   | Imagem a processar}"
 		"{@lightPattern |   | Imagem com padrao de luz a aplicar na imagem de entrada}"
-		"{lightMethod   | 1 | Metodo para remover a luz de fundo, 0 diferenca, 1 divisao}"
-		"{segMethod     | 1 | Metodo para segmentar: 1 componentes conexas, 2 componentes conexas com estatisticas, 3 encontrar contornos}"};
-
-static Scalar corAleatoria(RNG &rng)
+		"{lightMethod   | 1 | Metodo para remover a luz de fundo, 0 diferenca, 1 divisao, 2 nenhum, 3 divisao pelo reciproco (inteira, ate 1 nivel de diferenca)}"
+		"{segMethod     | 1 | Metodo para segmentar: 1 componentes conexas, 2 componentes conexas com estatisticas, 3 encontrar contornos}"
+		"{lightCache    | 1 | Le/grava o padrao de luz ja suavizado em um cache binario ao lado do arquivo (.plc)}"
+		"{batch         |   | Processa sem janelas todas as imagens de @image (diretorio, glob, sequencia %04d ou lista .txt)}"
+		"{csv           | resultados.csv | Arquivo CSV com o resumo do processamento em lote}"
+		"{threads       | 0 | Numero de threads do processamento em lote, 0 usa todos os nucleos}"
+		"{masks         |   | Pasta onde o lote grava a imagem binaria de cada entrada, em PGM binario (P5)}"
+		"{stream        |   | Processa continuamente @image como camera (indice 0, 1, ...), arquivo de video ou cenas sinteticas (sintetico:size=LxA,density=N,...)}"
+		"{queueSize     | 4 | Quadros em cada fila entre os estagios do stream}"
+		"{dropFrames    | 1 | Com a fila cheia: 1 descarta o quadro novo, 0 espera o estagio seguinte (backpressure)}"
+		"{playFps       | 0 | Ritmo de leitura de arquivos no stream: 0 usa o FPS do arquivo, -1 o mais rapido possivel}"
+		"{tiles         | 0 | Processa @image sem janela em blocos de N x N pixels, para imagens que nao cabem na memoria}"
+		"{thrMethod     | 0 | Limiar: 0 fixo (30, ou 140 com lightMethod=2), 1 Otsu, 2 triangulo, 3 percentil, escolhido a cada quadro}"
+		"{thrPercentile | 90 | Com thrMethod=3, porcentagem de pixels de fundo}"
+		"{fused         |   | Lote e stream: mediana, fundo e limiar numa unica passada por faixas, mesmo resultado; so com limiar fixo e padrao}"
+		"{headless      |   | Sem janelas nem highgui: o mosaico das imagens fica so na memoria ou e gravado em -mosaic}"
+		"{mosaic        |   | Grava o mosaico a cada atualizacao, ex. mosaico.png ou mosaico_%05d.png (um arquivo por quadro)}"
+		"{profile       |   | Mede o tempo de cada etapa e imprime p50/p95/p99 no fim}"
+		"{profileEvery  | 0 | Com -profile, imprime tambem o relatorio a cada N segundos}"};
+
+Mat carregaImagem(const String &arquivo)
 {
-	int icor = (unsigned)rng;
-
-	return Scalar(icor & 255, (icor >> 8) & 255, (icor >> 16) & 255);
+	MEDE_ETAPA("carga");
+	// PGM mapeado direto do arquivo, sem copia; os outros formatos pelo imread
+	return leImagemCinza(arquivo);
 }
 
-Mat thresholding(Mat img_sem_luz, int metodo_luz)
+// Grava a imagem binaria de uma entrada do lote em -masks, com o nome do arquivo de entrada
+void gravaMascaraLote(const String &img_arquivo, const Mat &img_thr)
 {
-	// Segmentao atravs de binarizao
-	Mat img_thr;
-
-	if (metodo_luz != 2)
-	{
-		threshold(img_sem_luz, img_thr, 30, 255, THRESH_BINARY);
-	}
-	else
-	{
-		threshold(img_sem_luz, img_thr, 140, 255, THRESH_BINARY_INV);
-	}
-
-	return (img_thr);
+	String nome = std::filesystem::path(img_arquivo).stem().string() + ".pgm";
+	if (!gravaPGM(pasta_mascaras + "/" + nome, img_thr))
+		cout << "Erro ao gravar a mascara de " << img_arquivo << endl;
 }
 
-// Calculate image pattern from an input image
-Mat calculaPadraoLuz(Mat img)
+ResultadoImagem processaImagemLote(const String &img_arquivo, const PadraoLuz &padrao_luz, int metodo_luz, int metodo_seg)
 {
-	Mat padrao;
-	// Basic and effective way to calculate the light pattern from one image
-	blur(img, padrao, Size(img.cols / 3, img.cols / 3));
-
-	return padrao;
-}
+	ResultadoImagem resultado;
 
-Mat removeLuz(Mat img, Mat padrao, int metodo)
-{
-	Mat aux;
+	// Imagem ilegivel ou de tamanho diferente do padrao de luz e registrada como erro
+	Mat img = carregaImagem(img_arquivo);
+	if (img.data == NULL || (!padrao_luz.vazio() && !padrao_luz.compativel(img.size())))
+		return resultado;
+	resultado.carregada = true;
 
-	// Metodo 1: normalizacao
-	if (metodo == 1)
+	// Componentes conexas so precisam das corridas; contornos precisam da imagem binaria
+	if (metodo_seg != 3)
 	{
-		// Necessario mudar imagem para float 32 bits para divisao
-		Mat img32, padrao32;
-		img.convertTo(img32, CV_32F);
-		padrao.convertTo(padrao32, CV_32F);
-
-		// Divide imagem pelo padrao
-		aux = 1 - (img32 / padrao32);
-
-		// Escalona cores para converter para 8 bits
-		aux *= 255;
-
-		// Converte para formato 8 bits
-		aux.convertTo(aux, CV_8U);
-	}
-	else
-	{
-		aux = padrao - img;
+		MascaraRLE mascara;
+		preProcessaRLE(img, padrao_luz, metodo_luz, metodo_limiar, percentil_limiar, pre_fundido, mascara);
+		estatisticasObjetosRLE(mascara, resultado);
+		if (!pasta_mascaras.empty())
+		{
+			Mat img_thr;
+			decodificaRLE(mascara, img_thr);
+			gravaMascaraLote(img_arquivo, img_thr);
+		}
+		return resultado;
 	}
 
-	return aux;
+	Mat img_thr = preProcessa(img, padrao_luz, metodo_luz, metodo_limiar, percentil_limiar, pre_fundido);
+	estatisticasObjetos(img_thr, metodo_seg, resultado);
+	if (!pasta_mascaras.empty())
+		gravaMascaraLote(img_arquivo, img_thr);
+
+	return resultado;
 }
 
-Mat removeFundo(String arq_padrao_fundo, Mat img, int metodo_luz)
+int processaEmLote(const String &entrada, const PadraoLuz &padrao_luz, int metodo_luz, int metodo_seg,
+				   const String &arq_csv, int num_threads)
 {
-	// Carrega imagem
-	Mat padrao_fundo = imread(arq_padrao_fundo, 0);
-
-	if (padrao_fundo.data == NULL)
+	vector<String> arquivos = listaArquivosEntrada(entrada);
+	if (arquivos.empty())
 	{
-		// Calcula padrao de luz
-		padrao_fundo = calculaPadraoLuz(img);
+		cout << "Nenhuma imagem encontrada em " << entrada << endl;
+		return 1;
 	}
-	medianBlur(padrao_fundo, padrao_fundo, 7);
 
-	// Remove fundo
-	Mat img_sem_fundo;
-	img.copyTo(img_sem_fundo);
-	if (metodo_luz != 2)
+	int64 inicio = getTickCount();
+	vector<ResultadoImagem> resultados = processaLote(arquivos, num_threads, [&](const String &arquivo) {
+		return processaImagemLote(arquivo, padrao_luz, metodo_luz, metodo_seg);
+	});
+	double segundos = (getTickCount() - inicio) / getTickFrequency();
+
+	int vazias = 0, erros = 0;
+	for (size_t i = 0; i < resultados.size(); i++)
 	{
-		img_sem_fundo = removeLuz(img, padrao_fundo, metodo_luz);
+		if (!resultados[i].carregada)
+			erros++;
+		else if (resultados[i].num_objetos == 0)
+			vazias++;
 	}
 
-	miw->addImage("Fundo", padrao_fundo);
-	//	imshow("Fundo", padrao_fundo);
+	cout << "Imagens processadas: " << resultados.size() << " (" << vazias << " sem objetos, " << erros << " com erro)" << endl;
+	cout << "Tempo total: " << segundos << " s, " << resultados.size() / segundos << " imagens/s" << endl;
 
-	return img_sem_fundo;
-}
-
-Mat removeRuido(Mat imagem)
-{
-	// Remove ruido
-	Mat img_sem_ruido;
-
-	medianBlur(imagem, img_sem_ruido, 7);
+	if (!gravaCsv(arq_csv, resultados))
+	{
+		cout << "Erro ao gravar " << arq_csv << endl;
+		return 1;
+	}
+	cout << "Resultados gravados em " << arq_csv << endl;
 
-	return img_sem_ruido;
+	return 0;
 }
 
-void verificaNumObjDetectados(int num_objetos)
+int processaImagemEmBlocos(const String &arq_imagem, const String &arq_padrao, int tamanho_bloco, int metodo_luz,
+						   int metodo_seg, const String &arq_csv)
 {
-	// Verifica o numero de objetos detectados
-	if (num_objetos < 2)
-	{
-		cout << "Nenhum objeto detectado" << endl;
-		exit(0);
-	}
-	else
+	int64 inicio = getTickCount();
+	vector<ObjetoBloco> objetos;
+	if (!processaEmBlocos(arq_imagem, arq_padrao, tamanho_bloco, metodo_luz, metodo_seg, objetos))
+		return 1;
+	double segundos = (getTickCount() - inicio) / getTickFrequency();
+
+	int64 area_total = 0, area_min = 0, area_max = 0;
+	for (size_t i = 0; i < objetos.size(); i++)
 	{
-		cout << "Numero de objetos detectados: " << (num_objetos - 1) << endl;
+		area_total += objetos[i].area;
+		area_min = i == 0 ? objetos[i].area : min(area_min, objetos[i].area);
+		area_max = max(area_max, objetos[i].area);
 	}
-}
-
-Mat ComponentesConexas(Mat img)
-{
-	// Usa componentes conexas para segmentar partes da imagem
-	Mat rotulos;
-	int num_objetos = connectedComponents(img, rotulos);
-	verificaNumObjDetectados(num_objetos);
 
-	// Cria imagem de sada colorindo objetos
-	Mat resultado = Mat::zeros(img.rows, img.cols, CV_8UC3);
-	RNG rng(0xFFFFFFFF);
+	cout << "Numero de objetos detectados: " << objetos.size() << endl;
+	cout << "Area total: " << area_total << " (min " << area_min << ", max " << area_max << ")" << endl;
+	cout << "Tempo total: " << segundos << " s" << endl;
 
-	for (int i = 1; i < num_objetos; i++)
+	if (!gravaCsvObjetos(arq_csv, objetos))
 	{
-		Mat mascara = (rotulos == i);
-		resultado.setTo(corAleatoria(rng), mascara);
+		cout << "Erro ao gravar " << arq_csv << endl;
+		return 1;
 	}
+	cout << "Objetos gravados em " << arq_csv << endl;
 
-	return resultado;
+	return 0;
 }
 
-Mat ComponentesConexasComEstatisticas(Mat img)
+int processaStream(const String &fonte, const PadraoLuz &padrao_luz, int metodo_luz, int metodo_seg,
+				   int capacidade_fila, PoliticaFila politica, double fps_captura)
 {
-	// Usa componentes conexas com estatisticas
-	Mat rotulos, estatisticas, centroides;
-	int num_objetos = connectedComponentsWithStats(img, rotulos, estatisticas, centroides, 8);
-	verificaNumObjDetectados(num_objetos);
-
-	// Cria imagem de sada colorindo objetos e mostra rea
-	Mat resultado = Mat::zeros(img.rows, img.cols, CV_8UC3);
-	RNG rng(0xFFFFFFFF);
-
-	for (int i = 1; i < num_objetos; i++)
+	FonteStream captura;
+	if (!abreFonteStream(captura, fonte, fps_captura))
 	{
-		cout << "Objeto " << i << " posicao: [" << centroides.at<double>(i, 0) << ", " << centroides.at<double>(i, 1) << "]";
-		cout << ", area: " << estatisticas.at<int>(i, CC_STAT_AREA);
-		cout << " pixels, largura: " << estatisticas.at<int>(i, CC_STAT_WIDTH);
-		cout << " pixels, altura: " << estatisticas.at<int>(i, CC_STAT_HEIGHT) << " pixels" << endl;
-
-		Mat mascara = (rotulos == i);
-		resultado.setTo(corAleatoria(rng), mascara);
-
-		stringstream ss;
-		ss << "area: " << estatisticas.at<int>(i, CC_STAT_AREA);
-
-		Point c(centroides.at<double>(i, 0) - 25, centroides.at<double>(i, 1) - 25);
-		putText(resultado, ss.str(), c, FONT_HERSHEY_SIMPLEX, 0.4, Scalar(255, 255, 255));
+		cout << "Erro ao abrir a camera ou o video " << fonte << endl;
+		return 1;
 	}
 
-	return resultado;
-}
-
-Mat EncontraContornos(Mat img)
-{
-	vector<vector<Point>> contornos;
-	findContours(img, contornos, RETR_EXTERNAL, CHAIN_APPROX_SIMPLE);
-
-	Mat resultado = Mat::zeros(img.rows, img.cols, CV_8UC3);
-
-	// Verifica o nmero de objetos detectados
-	if (contornos.size() == 0)
+	// Cada estagio e uma thread; a janela e atualizada so na thread principal, no fim do pipeline
+	PipelineStream pipeline(capacidade_fila, politica);
+	if (pre_fundido)
 	{
-		cout << "Nenhum objeto detectado" << endl;
-		exit(0);
+		// Um unico estagio no lugar de ruido, fundo e limiar; o paralelismo fica nas faixas do quadro
+		pipeline.adicionaEstagio("preprocessamento", [&](QuadroStream &quadro) {
+			if (!padrao_luz.vazio() && !padrao_luz.compativel(quadro.img.size()))
+				return false;
+			quadro.img = preProcessa(quadro.img, padrao_luz, metodo_luz, metodo_limiar, percentil_limiar, true);
+			return true;
+		});
 	}
 	else
 	{
-		cout << "Numero de objetos detectados: " << contornos.size() << endl;
+		pipeline.adicionaEstagio("ruido", [&](QuadroStream &quadro) {
+			quadro.img = removeRuido(quadro.img);
+			return true;
+		});
+		pipeline.adicionaEstagio("fundo", [&](QuadroStream &quadro) {
+			if (!padrao_luz.vazio() && !padrao_luz.compativel(quadro.img.size()))
+				return false;
+			quadro.img = removeFundo(padrao_luz, quadro.img, metodo_luz);
+			return true;
+		});
+		pipeline.adicionaEstagio("limiar", [&](QuadroStream &quadro) {
+			quadro.img = thresholding(quadro.img, metodo_luz, metodo_limiar, percentil_limiar);
+			return true;
+		});
 	}
+	pipeline.adicionaEstagio("segmentacao", [&](QuadroStream &quadro) {
+		quadro.saida = segmentaQuadro(quadro.img, metodo_seg, quadro.num_objetos);
+		return true;
+	});
+
+	// Janela propria do stream, atualizada so na thread principal; guarda so as 2 imagens do ultimo quadro
+	MultipleImageWindow janela("Stream", 2, 1, WINDOW_AUTOSIZE, backend_janela);
+	janela.setRingBuffer(true);
+	janela.setOutputFile(arq_mosaico);
+	EstatisticasStream estatisticas = pipeline.executa(captura, [&](QuadroStream &quadro) {
+		// Sem janela e sem arquivo de mosaico nao ha o que desenhar
+		if (janela.isOffscreen() && arq_mosaico.empty())
+			return true;
 
-	RNG rng(0xFFFFFFFF);
-	for (int i = 0; i < contornos.size(); i++)
-	{
-		drawContours(resultado, contornos, i, corAleatoria(rng));
-	}
+		stringstream ss;
+		ss << "Quadro " << quadro.indice << ", objetos: " << quadro.num_objetos;
+		putText(quadro.saida, ss.str(), Point(10, 20), FONT_HERSHEY_SIMPLEX, 0.5, Scalar(255, 255, 255));
 
-	return resultado;
+		// Cada imagem nova substitui a do quadro anterior na mesma celula
+		janela.addImage("Entrada", quadro.original);
+		janela.addImage("Resultado", quadro.saida);
+		janela.render();
+		if (janela.isOffscreen())
+			return true;
+
+		// ESC ou q encerram o stream
+		int tecla = waitKey(1);
+		return tecla != 27 && tecla != 'q';
+	}, fps_captura);
+
+	imprimeEstatisticasStream(estatisticas);
+
+	return 0;
 }
 
 void mostraResultados(Mat entrada, Mat sem_ruido, Mat sem_fundo, Mat thr, Mat componentes)
@@ -258,25 +299,86 @@ int main(int argc, const char **argv)
 		return 0;
 	}
 
+	if (parser.has("headless"))
+		backend_janela = MultipleImageWindow::BACKEND_OFFSCREEN;
+	arq_mosaico = parser.get<String>("mosaic");
+	metodo_limiar = parser.get<int>("thrMethod");
+	percentil_limiar = parser.get<double>("thrPercentile");
+	pre_fundido = parser.has("fused");
+	if (pre_fundido && metodo_limiar != LIMIAR_FIXO)
+		cout << "Limiar automatico precisa do quadro inteiro, pre-processamento feito etapa por etapa" << endl;
+
+	// Relatorio de tempo por etapa na saida do programa, em qualquer modo
+	if (parser.has("profile"))
+		Instrumentacao::inicia(parser.get<double>("profileEvery"));
+
+	// Modo em blocos: imagem e padrao lidos por partes, a imagem inteira nunca fica na memoria
+	if (parser.get<int>("tiles") > 0)
+	{
+		// Um limiar por bloco quebraria os objetos na divisa; os blocos usam o fixo
+		if (metodo_limiar != LIMIAR_FIXO)
+			cout << "Modo em blocos usa o limiar fixo, thrMethod ignorado" << endl;
+		return processaImagemEmBlocos(img_arquivo, arq_padrao_luz, parser.get<int>("tiles"), metodo_luz, metodo_seg,
+									  parser.get<String>("csv"));
+	}
+
+	// Carrega e suaviza o padrao de luz uma unica vez; e so lido pelas threads do lote
+	PadraoLuz padrao_luz;
+	if (!arq_padrao_luz.empty() && !padrao_luz.carrega(arq_padrao_luz, 7, parser.get<bool>("lightCache")))
+	{
+		cout << "Padrao de luz " << arq_padrao_luz << " nao carregado, sera calculado a partir de cada imagem" << endl;
+	}
+
+	// Modo em lote: sem janela e sem interromper em quadros vazios
+	if (parser.has("batch"))
+	{
+		pasta_mascaras = parser.get<String>("masks");
+		std::error_code erro;
+		if (!pasta_mascaras.empty() && !std::filesystem::is_directory(pasta_mascaras) &&
+			!std::filesystem::create_directories(pasta_mascaras, erro))
+		{
+			cout << "Erro ao criar a pasta " << pasta_mascaras << endl;
+			return 1;
+		}
+		return processaEmLote(img_arquivo, padrao_luz, metodo_luz, metodo_seg,
+							  parser.get<String>("csv"), parser.get<int>("threads"));
+	}
+
+	// Modo stream: camera ou video, com os estagios em threads separadas
+	if (parser.has("stream"))
+	{
+		return processaStream(img_arquivo, padrao_luz, metodo_luz, metodo_seg,
+							  parser.get<int>("queueSize"), parser.get<bool>("dropFrames") ? FILA_DESCARTA : FILA_BLOQUEIA,
+							  parser.get<double>("playFps"));
+	}
+
 	// Carrega imagem
-	Mat img = imread(img_arquivo, 0);
+	Mat img = carregaImagem(img_arquivo);
 	if (img.data == NULL)
 	{
 		cout << "Erro ao carregar imagem " << img_arquivo << endl;
 		return 0;
 	}
+	if (!padrao_luz.vazio() && !padrao_luz.compativel(img.size()))
+	{
+		cout << "Padrao de luz " << arq_padrao_luz << " tem tamanho diferente da imagem " << img_arquivo << endl;
+		return 0;
+	}
 
 	// Cria janela para mltiplas imagens
-	miw = new MultipleImageWindow("Janela", 3, 2, WINDOW_AUTOSIZE);
+	miw = new MultipleImageWindow("Janela", 3, 2, WINDOW_AUTOSIZE, backend_janela);
+	miw->setOutputFile(arq_mosaico);
 
 	// Remove ruido
 	Mat img_sem_ruido = removeRuido(img);
 
 	// Remove fundo
-	Mat img_sem_fundo = removeFundo(arq_padrao_luz, img_sem_ruido, metodo_luz);
+	Mat padrao_usado;
+	Mat img_sem_fundo = removeFundo(padrao_luz, img_sem_ruido, metodo_luz, &padrao_usado);
+	miw->addImage("Fundo", padrao_usado);
 
 	// Thresholding
-	Mat img_thr = thresholding(img_sem_fundo, metodo_luz);
+	Mat img_thr = thresholding(img_sem_fundo, metodo_luz, metodo_limiar, percentil_limiar);
 
 	// Componentes conexas
 	Mat img_componentes;
@@ -295,5 +397,6 @@ int main(int argc, const char **argv)
 
 	mostraResultados(img, img_sem_ruido, img_sem_fundo, img_thr, img_componentes);
 
-	waitKey(0);
+	if (!miw->isOffscreen())
+		waitKey(0);
 }
\ No newline at end of file
@@ -0,0 +1,62 @@
+#include "FundoMultiescala.h"
+#include "Instrumentacao.h"
+
+#include <algorithm>
+
+#include "opencv2/imgproc.hpp"
+
+// Janela do blur na copia reduzida: impar, para ficar centrada como na resolucao cheia
+static int janelaReduzida(int janela, double escala)
+{
+    int reduzida = max(1, cvRound(janela / escala));
+    return reduzida | 1;
+}
+
+int fatorFundoMultiescala(int largura)
+{
+    int janela = largura / 3;
+    int fator = 1;
+    while (janela / (2 * fator) >= JANELA_MINIMA_FUNDO)
+        fator *= 2;
+    return fator;
+}
+
+Mat fundoReduzido(const Mat &reduzida, Size tamanho)
+{
+    int janela = tamanho.width / 3;
+    if (reduzida.size() == tamanho)
+    {
+        // Sem reducao: a janela da referencia, mesmo se for par
+        Mat fundo;
+        blur(reduzida, fundo, Size(janela, janela));
+        return fundo;
+    }
+
+    Size janela_reduzida(janelaReduzida(janela, (double)tamanho.width / reduzida.cols),
+                         janelaReduzida(janela, (double)tamanho.height / reduzida.rows));
+
+    Mat fundo;
+    blur(reduzida, fundo, janela_reduzida);
+    return fundo;
+}
+
+Mat estimaFundoMultiescala(const Mat &img)
+{
+    MEDE_ETAPA("fundo multiescala");
+
+    int fator = fatorFundoMultiescala(img.cols);
+    Mat fundo;
+    if (fator == 1)
+    {
+        // Imagem pequena: o proprio blur + mediana da referencia
+        medianBlur(fundoReduzido(img, img.size()), fundo, 7);
+        return fundo;
+    }
+
+    // A copia tem ceil(tamanho / f) pixels; resize usa a mesma escala na ida e na volta
+    Mat reduzida;
+    resize(img, reduzida, Size((img.cols + fator - 1) / fator, (img.rows + fator - 1) / fator), 0, 0, INTER_AREA);
+    resize(fundoReduzido(reduzida, img.size()), fundo, img.size(), 0, 0, INTER_LINEAR);
+
+    return fundo;
+}
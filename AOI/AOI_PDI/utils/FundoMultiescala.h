@@ -0,0 +1,67 @@
+/**
+ * Estimativa multiescala do padrao de luz
+ *
+ * Sem pattern.pgm o padrao de luz vem da propria imagem: um blur com
+ * janela de k = largura / 3 pixels seguido da mediana 7x7 do PadraoLuz.
+ * Em imagens de 5 a 20 MP as duas passadas na resolucao cheia dominam o
+ * tempo. Como o resultado e muito suave, aqui o blur e feito numa copia
+ * reduzida pelo fator f (media de blocos f x f, INTER_AREA) com a janela
+ * de k / f pixels, e o campo volta a resolucao cheia por interpolacao
+ * bilinear. A mediana 7x7 deixa de ser aplicada.
+ *
+ * Limite do erro em relacao ao blur + mediana na resolucao cheia, com A
+ * a diferenca entre o maior e o menor nivel de cinza da imagem:
+ *
+ *   |estimado - referencia| <= A * (6 f + 6) / k + 1
+ *
+ * - janela da copia ate f pixels maior ou menor e ate f / 2 deslocada
+ *   em cada eixo: 3 A f / k
+ * - interpolacao bilinear entre amostras a f pixels de um campo com
+ *   inclinacao de no maximo A / k por pixel: A f / k
+ * - reflexao da borda feita na copia e nao na imagem: 2 A f / k
+ * - mediana 7x7 omitida (3 pixels em cada eixo): 6 A / k
+ * - arredondamento para 8 bits: 1
+ *
+ * O fator e a maior potencia de 2 com k / f >= JANELA_MINIMA_FUNDO, entao
+ * o termo em f fica abaixo de 4.7% de A; esse e o pior caso, com um
+ * degrau de contraste total dentro da janela. Imagens com menos de 768
+ * pixels de largura usam f = 1 e o resultado e o da referencia, bit a bit.
+ *
+ */
+
+#ifndef FUNDO_MULTIESCALA_h
+#define FUNDO_MULTIESCALA_h
+
+// OpenCV includes
+#include "opencv2/core.hpp"
+using namespace cv;
+
+/**
+ * Menor janela do blur, em pixels da copia reduzida
+ */
+const int JANELA_MINIMA_FUNDO = 128;
+
+/**
+ * Fator de reducao usado para uma imagem com essa largura
+ * @param int largura - largura da imagem em pixels
+ * @return int potencia de 2, 1 para imagens pequenas
+ */
+int fatorFundoMultiescala(int largura);
+
+/**
+ * Blur do fundo sobre a copia reduzida, com a janela de largura / 3 da imagem original
+ * medida na escala da copia
+ * @param Mat reduzida - imagem CV_8UC1 reduzida com INTER_AREA
+ * @param Size tamanho - tamanho da imagem original
+ * @return Mat fundo no tamanho da copia; sem reducao, e o blur da referencia
+ */
+Mat fundoReduzido(const Mat &reduzida, Size tamanho);
+
+/**
+ * Estima o padrao de luz da imagem: blur de largura / 3 + mediana 7x7, calculado na copia reduzida
+ * @param Mat img - imagem CV_8UC1 sem ruido
+ * @return Mat padrao de luz CV_8UC1 do tamanho da imagem
+ */
+Mat estimaFundoMultiescala(const Mat &img);
+
+#endif
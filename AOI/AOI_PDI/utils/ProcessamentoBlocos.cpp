@@ -0,0 +1,512 @@
+#include "ProcessamentoBlocos.h"
+#include "PadraoLuz.h"
+#include "Segmentacao.h"
+#include "FundoMultiescala.h"
+#include "Instrumentacao.h"
+
+#include <iostream>
+#include <algorithm>
+#include <cstdlib>
+
+#include "opencv2/imgproc.hpp"
+#include "opencv2/imgcodecs.hpp"
+
+// Halo das medianas 7x7 da imagem (removeRuido) e do padrao de luz
+static const int HALO = 3;
+
+// Le um campo do cabecalho PGM, pulando espacos e comentarios; o separador seguinte nao e consumido
+static bool leCampoPgm(istream &f, string &campo)
+{
+    campo.clear();
+    int c = f.get();
+    while (c != EOF && (isspace(c) || c == '#'))
+    {
+        if (c == '#')
+        {
+            while (c != EOF && c != '\n')
+                c = f.get();
+        }
+        c = f.get();
+    }
+    while (c != EOF && !isspace(c))
+    {
+        campo += (char)c;
+        if (isspace(f.peek()) || f.peek() == EOF)
+            break;
+        c = f.get();
+    }
+    return !campo.empty();
+}
+
+bool FonteImagem::abre(const String &nome)
+{
+    inteira.release();
+    if (arquivo.is_open())
+        arquivo.close();
+    arquivo.clear();
+
+    arquivo.open(nome.c_str(), ios::binary);
+    if (!arquivo.is_open())
+        return false;
+
+    string magica, largura, altura, maximo;
+    if (leCampoPgm(arquivo, magica) && magica == "P5" && leCampoPgm(arquivo, largura) && leCampoPgm(arquivo, altura) &&
+        leCampoPgm(arquivo, maximo) && atoi(maximo.c_str()) <= 255)
+    {
+        // Um unico espaco separa o cabecalho dos pixels
+        arquivo.get();
+        dimensoes = Size(atoi(largura.c_str()), atoi(altura.c_str()));
+        inicio_dados = arquivo.tellg();
+        if (dimensoes.width > 0 && dimensoes.height > 0 && arquivo.good())
+            return true;
+    }
+
+    // PGM ASCII, 16 bits ou outros formatos: imagem inteira na memoria
+    arquivo.close();
+    inteira = imread(nome, IMREAD_GRAYSCALE);
+    dimensoes = inteira.size();
+    return !inteira.empty();
+}
+
+Size FonteImagem::tamanho() const
+{
+    return dimensoes;
+}
+
+Mat FonteImagem::le(Rect regiao)
+{
+    MEDE_ETAPA("carga");
+
+    Rect dentro = regiao & Rect(0, 0, dimensoes.width, dimensoes.height);
+    if (dentro.width <= 0 || dentro.height <= 0)
+        return Mat::zeros(regiao.height, regiao.width, CV_8UC1);
+
+    Mat parte;
+    if (!inteira.empty())
+    {
+        parte = inteira(dentro);
+    }
+    else
+    {
+        // Arquivo truncado: as linhas que faltarem ficam pretas
+        parte = Mat::zeros(dentro.height, dentro.width, CV_8UC1);
+        for (int y = 0; y < dentro.height; y++)
+        {
+            arquivo.seekg(inicio_dados + (streamoff)(dentro.y + y) * dimensoes.width + dentro.x);
+            arquivo.read((char *)parte.ptr<uchar>(y), dentro.width);
+            if (!arquivo)
+            {
+                // Limpa o estado para a proxima regiao; o resto desta continua zerado
+                arquivo.clear();
+                break;
+            }
+        }
+    }
+
+    Mat saida;
+    copyMakeBorder(parte, saida, dentro.y - regiao.y, regiao.y + regiao.height - dentro.y - dentro.height,
+                   dentro.x - regiao.x, regiao.x + regiao.width - dentro.x - dentro.width, BORDER_REPLICATE);
+    return saida;
+}
+
+// Estado compartilhado pelos blocos de uma imagem
+struct ContextoBlocos
+{
+    FonteImagem imagem;
+    FonteImagem padrao;
+    bool tem_padrao;
+    Mat fundo_reduzido; // fundo estimado na escala 1 / fator, sem padrao de luz
+    int fator;
+    int metodo_luz;
+};
+
+// Fundo estimado de uma regiao: interpolacao bilinear do fundo reduzido nas coordenadas globais,
+// entao blocos vizinhos recebem os mesmos valores nas suas bordas
+static Mat amostraFundo(const ContextoBlocos &ctx, Rect regiao)
+{
+    double escala = 1.0 / ctx.fator;
+    Mat transformacao = Mat::zeros(2, 3, CV_64F);
+    transformacao.at<double>(0, 0) = escala;
+    transformacao.at<double>(0, 2) = (regiao.x + 0.5) * escala - 0.5;
+    transformacao.at<double>(1, 1) = escala;
+    transformacao.at<double>(1, 2) = (regiao.y + 0.5) * escala - 0.5;
+
+    Mat fundo;
+    warpAffine(ctx.fundo_reduzido, fundo, transformacao, regiao.size(), INTER_LINEAR | WARP_INVERSE_MAP, BORDER_REPLICATE);
+    return fundo;
+}
+
+// Imagem binaria de uma regiao, igual ao mesmo recorte da imagem inteira processada
+static Mat limiarRegiao(ContextoBlocos &ctx, Rect regiao)
+{
+    Rect com_halo(regiao.x - HALO, regiao.y - HALO, regiao.width + 2 * HALO, regiao.height + 2 * HALO);
+    Mat sem_ruido = removeRuido(ctx.imagem.le(com_halo));
+
+    Mat sem_fundo = sem_ruido;
+    if (ctx.metodo_luz != 2)
+    {
+        // Mesma mediana 7x7 que main aplica ao padrao carregado inteiro
+        PadraoLuz padrao;
+        if (ctx.tem_padrao)
+            padrao.define(ctx.padrao.le(com_halo), 7);
+        else
+            padrao.define(amostraFundo(ctx, com_halo), 1);
+        sem_fundo = removeFundo(padrao, sem_ruido, ctx.metodo_luz);
+    }
+
+    return thresholding(sem_fundo(Rect(HALO, HALO, regiao.width, regiao.height)), ctx.metodo_luz);
+}
+
+// Sem padrao de luz: o mesmo fundo de estimaFundoMultiescala, com a copia da imagem sem ruido
+// reduzida pelo fator montada bloco a bloco
+static void estimaFundo(ContextoBlocos &ctx, int tamanho_bloco)
+{
+    Size tamanho = ctx.imagem.tamanho();
+    int f = ctx.fator;
+    Mat copia((tamanho.height + f - 1) / f, (tamanho.width + f - 1) / f, CV_8UC1);
+
+    for (int y0 = 0; y0 < tamanho.height; y0 += tamanho_bloco)
+    {
+        for (int x0 = 0; x0 < tamanho.width; x0 += tamanho_bloco)
+        {
+            int w = min(tamanho_bloco, tamanho.width - x0);
+            int h = min(tamanho_bloco, tamanho.height - y0);
+            Mat bloco = ctx.imagem.le(Rect(x0 - HALO, y0 - HALO, w + 2 * HALO, h + 2 * HALO));
+            Mat sem_ruido = removeRuido(bloco);
+            sem_ruido = sem_ruido(Rect(HALO, HALO, w, h));
+
+            // tamanho_bloco e multiplo de f: cada bloco cai numa regiao propria da copia
+            Mat reduzido;
+            resize(sem_ruido, reduzido, Size((w + f - 1) / f, (h + f - 1) / f), 0, 0, INTER_AREA);
+            reduzido.copyTo(copia(Rect(x0 / f, y0 / f, reduzido.cols, reduzido.rows)));
+        }
+    }
+
+    ctx.fundo_reduzido = fundoReduzido(copia, tamanho);
+    if (f == 1)
+        medianBlur(ctx.fundo_reduzido, ctx.fundo_reduzido, 7);
+}
+
+// Componente de um bloco; depois da uniao, o componente raiz acumula o objeto inteiro
+struct ComponenteBloco
+{
+    int64 area;
+    int x0, y0, x1, y1;
+    double soma_x, soma_y;
+};
+
+static int raiz(vector<int> &pai, int i)
+{
+    while (pai[i] != i)
+    {
+        pai[i] = pai[pai[i]];
+        i = pai[i];
+    }
+    return i;
+}
+
+static void une(vector<int> &pai, int a, int b)
+{
+    a = raiz(pai, a);
+    b = raiz(pai, b);
+    if (a != b)
+        pai[max(a, b)] = min(a, b);
+}
+
+// Fundo rotulado com vizinhanca-4 (o complemento da vizinhanca-8 dos objetos), para a regra do
+// RETR_EXTERNAL: um objeto e externo se toca a borda da imagem ou um fundo que toca a borda
+struct FundoBlocos
+{
+    vector<int> pai;
+    vector<char> na_borda;
+    vector<pair<int, int>> vizinhos; // (objeto, fundo) com pixels vizinhos-4
+
+    void anota(int objeto, int fundo)
+    {
+        if (vizinhos.empty() || vizinhos.back() != make_pair(objeto, fundo))
+            vizinhos.push_back(make_pair(objeto, fundo));
+    }
+};
+
+bool processaEmBlocos(const String &arq_imagem, const String &arq_padrao, int tamanho_bloco,
+                      int metodo_luz, int metodo_seg, vector<ObjetoBloco> &objetos)
+{
+    objetos.clear();
+
+    ContextoBlocos ctx;
+    ctx.metodo_luz = metodo_luz;
+    if (!ctx.imagem.abre(arq_imagem))
+    {
+        cout << "Erro ao abrir " << arq_imagem << endl;
+        return false;
+    }
+    Size tamanho = ctx.imagem.tamanho();
+
+    ctx.tem_padrao = !arq_padrao.empty();
+    if (ctx.tem_padrao && (!ctx.padrao.abre(arq_padrao) || ctx.padrao.tamanho() != tamanho))
+    {
+        cout << "Padrao de luz " << arq_padrao << " nao pode ser lido ou tem tamanho diferente da imagem" << endl;
+        return false;
+    }
+
+    ctx.fator = fatorFundoMultiescala(tamanho.width);
+    tamanho_bloco = max(tamanho_bloco, 16);
+    if (!ctx.tem_padrao && metodo_luz != 2)
+    {
+        tamanho_bloco = (tamanho_bloco + ctx.fator - 1) / ctx.fator * ctx.fator;
+        estimaFundo(ctx, tamanho_bloco);
+    }
+
+    bool so_externos = metodo_seg == 3;
+    vector<ComponenteBloco> componentes;
+    vector<int> pai;
+    FundoBlocos fundo;
+
+    // Rotulos globais (-1 fundo) da ultima linha da faixa de blocos anterior e da faixa atual,
+    // e da ultima coluna do bloco a esquerda; os _fundo guardam os rotulos do fundo (-1 objeto)
+    vector<int> linha_anterior(tamanho.width, -1), linha_atual(tamanho.width, -1);
+    vector<int> linha_anterior_fundo(tamanho.width, -1), linha_atual_fundo(tamanho.width, -1);
+    vector<int> coluna_esquerda, coluna_esquerda_fundo;
+
+    for (int y0 = 0; y0 < tamanho.height; y0 += tamanho_bloco)
+    {
+        int h = min(tamanho_bloco, tamanho.height - y0);
+        coluna_esquerda.assign(h, -1);
+        coluna_esquerda_fundo.assign(h, -1);
+
+        for (int x0 = 0; x0 < tamanho.width; x0 += tamanho_bloco)
+        {
+            int w = min(tamanho_bloco, tamanho.width - x0);
+            Mat thr = limiarRegiao(ctx, Rect(x0, y0, w, h));
+
+            Mat rotulos, estatisticas, centroides;
+            int n = connectedComponentsWithStats(thr, rotulos, estatisticas, centroides, 8, CV_32S);
+
+            // Rotulo local l > 0 vira o global base + l - 1
+            int base = (int)componentes.size();
+            for (int l = 1; l < n; l++)
+            {
+                ComponenteBloco c;
+                c.area = estatisticas.at<int>(l, CC_STAT_AREA);
+                c.x0 = x0 + estatisticas.at<int>(l, CC_STAT_LEFT);
+                c.y0 = y0 + estatisticas.at<int>(l, CC_STAT_TOP);
+                c.x1 = c.x0 + estatisticas.at<int>(l, CC_STAT_WIDTH) - 1;
+                c.y1 = c.y0 + estatisticas.at<int>(l, CC_STAT_HEIGHT) - 1;
+                c.soma_x = (x0 + centroides.at<double>(l, 0)) * c.area;
+                c.soma_y = (y0 + centroides.at<double>(l, 1)) * c.area;
+
+                componentes.push_back(c);
+                pai.push_back(base + l - 1);
+            }
+
+            // Divisa de cima: cada pixel com os 3 vizinhos da ultima linha da faixa anterior
+            if (y0 > 0)
+            {
+                const int *topo = rotulos.ptr<int>(0);
+                for (int x = 0; x < w; x++)
+                {
+                    if (topo[x] == 0)
+                        continue;
+                    for (int dx = -1; dx <= 1; dx++)
+                    {
+                        int xx = x0 + x + dx;
+                        if (xx >= 0 && xx < tamanho.width && linha_anterior[xx] >= 0)
+                            une(pai, base + topo[x] - 1, linha_anterior[xx]);
+                    }
+                }
+            }
+
+            // Divisa da esquerda; as diagonais para fora da faixa sao vistas pela divisa de cima
+            if (x0 > 0)
+            {
+                for (int y = 0; y < h; y++)
+                {
+                    int l = rotulos.at<int>(y, 0);
+                    if (l == 0)
+                        continue;
+                    for (int dy = -1; dy <= 1; dy++)
+                    {
+                        int yy = y + dy;
+                        if (yy >= 0 && yy < h && coluna_esquerda[yy] >= 0)
+                            une(pai, base + l - 1, coluna_esquerda[yy]);
+                    }
+                }
+            }
+
+            // Fundo do bloco (so segMethod 3): rotulo local l > 0 vira o global base_fundo + l - 1
+            if (so_externos)
+            {
+                Mat rotulos_fundo;
+                int n_fundo = connectedComponents(thr == 0, rotulos_fundo, 4, CV_32S);
+                int base_fundo = (int)fundo.pai.size();
+                size_t inicio_vizinhos = fundo.vizinhos.size();
+                for (int l = 1; l < n_fundo; l++)
+                {
+                    fundo.pai.push_back(base_fundo + l - 1);
+                    fundo.na_borda.push_back(0);
+                }
+
+                // Fundo na borda da imagem
+                for (int y = 0; y < h; y++)
+                {
+                    const int *rf = rotulos_fundo.ptr<int>(y);
+                    bool linha_na_borda = (y == 0 && y0 == 0) || (y == h - 1 && y0 + h == tamanho.height);
+                    for (int x = 0; x < w; x++)
+                    {
+                        bool na_borda = linha_na_borda || (x == 0 && x0 == 0) || (x == w - 1 && x0 + w == tamanho.width);
+                        if (rf[x] > 0 && na_borda)
+                            fundo.na_borda[base_fundo + rf[x] - 1] = 1;
+                    }
+                }
+
+                // Objeto e fundo vizinhos-4 dentro do bloco
+                for (int y = 0; y < h; y++)
+                {
+                    const int *r = rotulos.ptr<int>(y);
+                    const int *rf = rotulos_fundo.ptr<int>(y);
+                    const int *r_baixo = y + 1 < h ? rotulos.ptr<int>(y + 1) : 0;
+                    const int *rf_baixo = y + 1 < h ? rotulos_fundo.ptr<int>(y + 1) : 0;
+                    for (int x = 0; x < w; x++)
+                    {
+                        if (x + 1 < w && r[x] > 0 && rf[x + 1] > 0)
+                            fundo.anota(base + r[x] - 1, base_fundo + rf[x + 1] - 1);
+                        if (x + 1 < w && rf[x] > 0 && r[x + 1] > 0)
+                            fundo.anota(base + r[x + 1] - 1, base_fundo + rf[x] - 1);
+                        if (r_baixo && r[x] > 0 && rf_baixo[x] > 0)
+                            fundo.anota(base + r[x] - 1, base_fundo + rf_baixo[x] - 1);
+                        if (r_baixo && rf[x] > 0 && r_baixo[x] > 0)
+                            fundo.anota(base + r_baixo[x] - 1, base_fundo + rf[x] - 1);
+                    }
+                }
+
+                // Divisas de cima e da esquerda: fundo com fundo se une, objeto com fundo e anotado
+                if (y0 > 0)
+                {
+                    const int *topo = rotulos.ptr<int>(0);
+                    const int *topo_fundo = rotulos_fundo.ptr<int>(0);
+                    for (int x = 0; x < w; x++)
+                    {
+                        int acima = linha_anterior[x0 + x], acima_fundo = linha_anterior_fundo[x0 + x];
+                        if (topo_fundo[x] > 0 && acima_fundo >= 0)
+                            une(fundo.pai, base_fundo + topo_fundo[x] - 1, acima_fundo);
+                        if (topo_fundo[x] > 0 && acima >= 0)
+                            fundo.anota(acima, base_fundo + topo_fundo[x] - 1);
+                        if (topo[x] > 0 && acima_fundo >= 0)
+                            fundo.anota(base + topo[x] - 1, acima_fundo);
+                    }
+                }
+                if (x0 > 0)
+                {
+                    for (int y = 0; y < h; y++)
+                    {
+                        int l = rotulos.at<int>(y, 0), lf = rotulos_fundo.at<int>(y, 0);
+                        if (lf > 0 && coluna_esquerda_fundo[y] >= 0)
+                            une(fundo.pai, base_fundo + lf - 1, coluna_esquerda_fundo[y]);
+                        if (lf > 0 && coluna_esquerda[y] >= 0)
+                            fundo.anota(coluna_esquerda[y], base_fundo + lf - 1);
+                        if (l > 0 && coluna_esquerda_fundo[y] >= 0)
+                            fundo.anota(base + l - 1, coluna_esquerda_fundo[y]);
+                    }
+                }
+
+                // Pares repetidos do bloco; a memoria fica nos pares distintos de objeto e fundo
+                sort(fundo.vizinhos.begin() + inicio_vizinhos, fundo.vizinhos.end());
+                fundo.vizinhos.erase(unique(fundo.vizinhos.begin() + inicio_vizinhos, fundo.vizinhos.end()),
+                                     fundo.vizinhos.end());
+
+                const int *baixo_fundo = rotulos_fundo.ptr<int>(h - 1);
+                for (int x = 0; x < w; x++)
+                    linha_atual_fundo[x0 + x] = baixo_fundo[x] > 0 ? base_fundo + baixo_fundo[x] - 1 : -1;
+                for (int y = 0; y < h; y++)
+                {
+                    int lf = rotulos_fundo.at<int>(y, w - 1);
+                    coluna_esquerda_fundo[y] = lf > 0 ? base_fundo + lf - 1 : -1;
+                }
+            }
+
+            const int *baixo = rotulos.ptr<int>(h - 1);
+            for (int x = 0; x < w; x++)
+                linha_atual[x0 + x] = baixo[x] > 0 ? base + baixo[x] - 1 : -1;
+            for (int y = 0; y < h; y++)
+            {
+                int l = rotulos.at<int>(y, w - 1);
+                coluna_esquerda[y] = l > 0 ? base + l - 1 : -1;
+            }
+        }
+
+        swap(linha_anterior, linha_atual);
+        swap(linha_anterior_fundo, linha_atual_fundo);
+    }
+
+    // Acumula cada componente na raiz do seu objeto
+    for (size_t i = 0; i < componentes.size(); i++)
+    {
+        int r = raiz(pai, (int)i);
+        if (r == (int)i)
+            continue;
+        ComponenteBloco &destino = componentes[r];
+        const ComponenteBloco &c = componentes[i];
+        destino.area += c.area;
+        destino.x0 = min(destino.x0, c.x0);
+        destino.y0 = min(destino.y0, c.y0);
+        destino.x1 = max(destino.x1, c.x1);
+        destino.y1 = max(destino.y1, c.y1);
+        destino.soma_x += c.soma_x;
+        destino.soma_y += c.soma_y;
+    }
+
+    // segMethod 3: so os objetos que tocam a borda ou o fundo externo, como o RETR_EXTERNAL
+    vector<char> externo(componentes.size(), !so_externos);
+    if (so_externos)
+    {
+        for (size_t i = 0; i < fundo.pai.size(); i++)
+        {
+            if (fundo.na_borda[i])
+                fundo.na_borda[raiz(fundo.pai, (int)i)] = 1;
+        }
+        for (size_t i = 0; i < fundo.vizinhos.size(); i++)
+        {
+            if (fundo.na_borda[raiz(fundo.pai, fundo.vizinhos[i].second)])
+                externo[raiz(pai, fundo.vizinhos[i].first)] = 1;
+        }
+    }
+
+    for (size_t i = 0; i < componentes.size(); i++)
+    {
+        if (pai[i] != (int)i)
+            continue;
+        const ComponenteBloco &c = componentes[i];
+        bool na_borda = c.x0 == 0 || c.y0 == 0 || c.x1 == tamanho.width - 1 || c.y1 == tamanho.height - 1;
+        if (!externo[i] && !na_borda)
+            continue;
+
+        ObjetoBloco objeto;
+        objeto.area = c.area;
+        objeto.caixa = Rect(c.x0, c.y0, c.x1 - c.x0 + 1, c.y1 - c.y0 + 1);
+        objeto.centroide = Point2d(c.soma_x / c.area, c.soma_y / c.area);
+        objetos.push_back(objeto);
+    }
+
+    sort(objetos.begin(), objetos.end(), [](const ObjetoBloco &a, const ObjetoBloco &b) {
+        return a.caixa.y != b.caixa.y ? a.caixa.y < b.caixa.y : a.caixa.x < b.caixa.x;
+    });
+
+    return true;
+}
+
+bool gravaCsvObjetos(const String &arquivo, const vector<ObjetoBloco> &objetos)
+{
+    ofstream csv(arquivo.c_str());
+    if (!csv.is_open())
+        return false;
+
+    csv << "objeto,area,x,y,largura,altura,centroide_x,centroide_y" << endl;
+    for (size_t i = 0; i < objetos.size(); i++)
+    {
+        const ObjetoBloco &o = objetos[i];
+        csv << i + 1 << "," << o.area << "," << o.caixa.x << "," << o.caixa.y << "," << o.caixa.width << "," << o.caixa.height << ","
+            << o.centroide.x << "," << o.centroide.y << endl;
+    }
+
+    return csv.good();
+}
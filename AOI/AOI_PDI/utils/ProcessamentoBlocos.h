@@ -0,0 +1,99 @@
+/**
+ * Processamento em blocos de imagens muito grandes
+ *
+ * A imagem (e o padrao de luz) e lida bloco a bloco direto do arquivo,
+ * com uma borda extra (halo) de 3 pixels para as medianas 7x7. Cada bloco
+ * passa por removeRuido, removeFundo e thresholding e e rotulado com
+ * connectedComponentsWithStats; os objetos que cruzam a divisa entre
+ * blocos sao unidos (union-find) comparando a ultima linha/coluna de
+ * rotulos do bloco vizinho, com vizinhanca-8.
+ *
+ * Com segMethod 3 o fundo tambem e rotulado (vizinhanca-4) e unido entre
+ * blocos, para aplicar a mesma regra do findContours com RETR_EXTERNAL:
+ * objetos dentro de buracos de outros objetos nao sao contados.
+ *
+ * Com um padrao de luz a memoria fica limitada ao tamanho do bloco, mais
+ * uma linha de rotulos da largura da imagem e as estatisticas dos objetos,
+ * e o resultado e identico ao processamento da imagem inteira. Sem padrao,
+ * o fundo e o de estimaFundoMultiescala, com a copia reduzida montada
+ * bloco a bloco, e herda o seu limite de erro em relacao ao calculaPadraoLuz.
+ * Essa copia e o seu fundo ficam inteiros na memoria: sao 2 * ceil(L / f)
+ * * ceil(A / f) bytes, com o fator f de fatorFundoMultiescala escolhido
+ * so pela largura L. Imagens com menos de 768 pixels de largura usam f = 1,
+ * entao numa imagem estreita e muito alta (line scan) isso e o dobro da
+ * imagem inteira; nesse caso passe o padrao de luz.
+ *
+ * So PGM binario (P5, 8 bits) e lido por partes; outros formatos sao
+ * carregados inteiros com imread.
+ *
+ */
+
+#ifndef PROCESSAMENTO_BLOCOS_h
+#define PROCESSAMENTO_BLOCOS_h
+
+#include <string>
+#include <vector>
+#include <fstream>
+using namespace std;
+
+// OpenCV includes
+#include "opencv2/core.hpp"
+using namespace cv;
+
+/**
+ * Imagem em cinza lida por regioes
+ */
+class FonteImagem
+{
+public:
+    /**
+     * @return bool false se o arquivo nao pode ser lido
+     */
+    bool abre(const String &arquivo);
+
+    Size tamanho() const;
+
+    /**
+     * Le uma regiao; o que fica fora da imagem repete a borda (BORDER_REPLICATE)
+     * @param Rect regiao - regiao em coordenadas da imagem, pode passar dos limites
+     * @return Mat CV_8UC1 do tamanho da regiao
+     */
+    Mat le(Rect regiao);
+
+private:
+    ifstream arquivo;
+    streamoff inicio_dados;
+    Size dimensoes;
+    Mat inteira;  // formatos que nao podem ser lidos por partes
+};
+
+/**
+ * Objeto encontrado no processamento em blocos
+ */
+struct ObjetoBloco
+{
+    int64 area; // pixels do componente conexo
+    Rect caixa; // retangulo envolvente na imagem
+    Point2d centroide;
+};
+
+/**
+ * Processa uma imagem em blocos e devolve os objetos ja unidos entre blocos
+ *
+ * @param String arq_imagem - imagem de entrada
+ * @param String arq_padrao - padrao de luz, vazio estima o fundo da propria imagem
+ * @param int tamanho_bloco - lado do bloco em pixels
+ * @param int metodo_luz - 0 diferenca, 1 divisao, 2 sem remocao
+ * @param int metodo_seg - 3 ignora os objetos dentro de buracos, como RETR_EXTERNAL
+ * @param vector<ObjetoBloco> objetos - saida, ordenados por linha e coluna
+ * @return bool false se a imagem ou o padrao nao puderam ser lidos
+ */
+bool processaEmBlocos(const String &arq_imagem, const String &arq_padrao, int tamanho_bloco,
+                      int metodo_luz, int metodo_seg, vector<ObjetoBloco> &objetos);
+
+/**
+ * Grava um CSV com uma linha por objeto
+ */
+bool gravaCsvObjetos(const String &arquivo, const vector<ObjetoBloco> &objetos);
+
+#endif
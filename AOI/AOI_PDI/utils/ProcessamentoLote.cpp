@@ -0,0 +1,154 @@
+#include "ProcessamentoLote.h"
+#include "ImagemPGM.h"
+#include "ThreadsOpenCV.h"
+
+#include <atomic>
+#include <exception>
+#include <thread>
+#include <fstream>
+#include <iostream>
+#include <algorithm>
+
+#include "opencv2/core/utility.hpp"
+
+static bool terminaCom(const String &texto, const String &sufixo)
+{
+    if (texto.size() < sufixo.size())
+        return false;
+    String fim = texto.substr(texto.size() - sufixo.size());
+    transform(fim.begin(), fim.end(), fim.begin(), ::tolower);
+    return fim == sufixo;
+}
+
+static bool arquivoExiste(const String &arquivo)
+{
+    ifstream f(arquivo.c_str());
+    return f.good();
+}
+
+static bool ehImagem(const String &arquivo)
+{
+    const char *extensoes[] = {".pgm", ".ppm", ".pbm", ".png", ".bmp", ".jpg", ".jpeg", ".tif", ".tiff"};
+    for (size_t i = 0; i < sizeof(extensoes) / sizeof(extensoes[0]); i++)
+    {
+        if (terminaCom(arquivo, extensoes[i]))
+            return true;
+    }
+    return false;
+}
+
+vector<String> listaArquivosEntrada(const String &entrada)
+{
+    vector<String> arquivos;
+
+    if (entrada.find('%') != String::npos)
+    {
+        // Sequencia no estilo do VideoCapture: comeca em 0 ou 1 e para no primeiro buraco
+        if (!formatoSequenciaValido(entrada))
+        {
+            cout << "Sequencia " << entrada << " precisa de exatamente um campo inteiro (ex. %04d)" << endl;
+            return arquivos;
+        }
+        int indice = arquivoExiste(format(entrada.c_str(), 0)) ? 0 : 1;
+        for (;; indice++)
+        {
+            String arquivo = format(entrada.c_str(), indice);
+            if (!arquivoExiste(arquivo))
+                break;
+            arquivos.push_back(arquivo);
+        }
+    }
+    else if (terminaCom(entrada, ".txt") || terminaCom(entrada, ".lst"))
+    {
+        // Lista com um caminho por linha
+        ifstream lista(entrada.c_str());
+        String linha;
+        while (getline(lista, linha))
+        {
+            if (!linha.empty() && linha[linha.size() - 1] == '\r')
+                linha.erase(linha.size() - 1);
+            if (!linha.empty() && linha[0] != '#')
+                arquivos.push_back(linha);
+        }
+    }
+    else if (ehImagem(entrada) && entrada.find_first_of("*?") == String::npos)
+    {
+        arquivos.push_back(entrada);
+    }
+    else
+    {
+        // Diretorio ou padrao glob; o glob ja devolve a lista ordenada
+        vector<String> encontrados;
+        glob(entrada, encontrados, false);
+        for (size_t i = 0; i < encontrados.size(); i++)
+        {
+            if (ehImagem(encontrados[i]))
+                arquivos.push_back(encontrados[i]);
+        }
+    }
+
+    return arquivos;
+}
+
+vector<ResultadoImagem> processaLote(const vector<String> &arquivos, int num_threads,
+                                     function<ResultadoImagem(const String &)> processa)
+{
+    vector<ResultadoImagem> resultados(arquivos.size());
+
+    if (num_threads <= 0)
+        num_threads = max(1, (int)thread::hardware_concurrency());
+    num_threads = min(num_threads, max(1, (int)arquivos.size()));
+
+    // Uma imagem por thread: o paralelismo interno do OpenCV so atrapalharia
+    RestauraThreadsOpenCV restaura;
+    setNumThreads(0);
+
+    atomic<size_t> proximo(0);
+    vector<thread> trabalhadores;
+    for (int t = 0; t < num_threads; t++)
+    {
+        trabalhadores.push_back(thread([&]() {
+            for (size_t i = proximo++; i < arquivos.size(); i = proximo++)
+            {
+                int64 inicio = getTickCount();
+                try
+                {
+                    resultados[i] = processa(arquivos[i]);
+                }
+                catch (const exception &e)
+                {
+                    // Uma excecao saindo da thread chamaria terminate e perderia o lote inteiro
+                    cout << "Erro ao processar " << arquivos[i] << ": " << e.what() << endl;
+                    resultados[i] = ResultadoImagem();
+                }
+                resultados[i].arquivo = arquivos[i];
+                resultados[i].tempo_ms = 1000.0 * (getTickCount() - inicio) / getTickFrequency();
+            }
+        }));
+    }
+    for (size_t t = 0; t < trabalhadores.size(); t++)
+        trabalhadores[t].join();
+
+    return resultados;
+}
+
+bool gravaCsv(const String &arq_csv, const vector<ResultadoImagem> &resultados)
+{
+    ofstream csv(arq_csv.c_str());
+    if (!csv.is_open())
+        return false;
+
+    csv << "arquivo,status,num_objetos,area_total,area_media,area_min,area_max,tempo_ms" << endl;
+    for (size_t i = 0; i < resultados.size(); i++)
+    {
+        const ResultadoImagem &r = resultados[i];
+        const char *status = !r.carregada ? "erro" : (r.num_objetos == 0 ? "vazia" : "ok");
+        double area_media = r.num_objetos > 0 ? r.area_total / r.num_objetos : 0;
+
+        csv << r.arquivo << "," << status << "," << r.num_objetos << ","
+            << r.area_total << "," << area_media << "," << r.area_min << "," << r.area_max << ","
+            << r.tempo_ms << endl;
+    }
+
+    return csv.good();
+}
@@ -0,0 +1,71 @@
+/**
+ * Processamento em lote
+ *
+ * Executa o pipeline de segmentacao sobre um conjunto de imagens usando
+ * um grupo de threads, sem nenhuma dependencia do highgui, e grava um
+ * resumo por imagem em um arquivo CSV.
+ *
+ */
+
+#ifndef PROCESSAMENTO_LOTE_h
+#define PROCESSAMENTO_LOTE_h
+
+#include <string>
+#include <vector>
+#include <functional>
+using namespace std;
+
+// OpenCV includes
+#include "opencv2/core.hpp"
+using namespace cv;
+
+/**
+ * Resumo do processamento de uma imagem do lote
+ */
+struct ResultadoImagem
+{
+    String arquivo;
+    bool carregada;
+    int num_objetos;
+    double area_total;
+    double area_min;
+    double area_max;
+    double tempo_ms;
+
+    ResultadoImagem() : carregada(false), num_objetos(0), area_total(0), area_min(0), area_max(0), tempo_ms(0) {}
+};
+
+/**
+ * Lista as imagens a processar a partir de uma especificacao de entrada
+ *
+ * @param String entrada - diretorio, padrao glob (ex. "data/nut/tuerca_00*.pgm"),
+ *                         sequencia printf (ex. "data/screw/tornillo_%04d.pgm")
+ *                         ou arquivo .txt/.lst com um caminho por linha
+ * @return vector<String> caminhos das imagens, em ordem
+ */
+vector<String> listaArquivosEntrada(const String &entrada);
+
+/**
+ * Processa todas as imagens em paralelo
+ *
+ * Cada thread retira o proximo indice da lista e chama a funcao de
+ * processamento; o resultado e gravado na mesma posicao do arquivo de entrada.
+ * Uma imagem cuja funcao lanca excecao fica com carregada = false ("erro" no CSV).
+ * O paralelismo interno do OpenCV e desligado durante o lote para nao
+ * disputar nucleos com as threads de trabalho.
+ *
+ * @param vector<String> arquivos - imagens a processar
+ * @param int num_threads - numero de threads, 0 usa todos os nucleos
+ * @param function processa - processa uma imagem e devolve o seu resumo
+ * @return vector<ResultadoImagem> resumo de cada imagem, na ordem de entrada
+ */
+vector<ResultadoImagem> processaLote(const vector<String> &arquivos, int num_threads,
+                                     function<ResultadoImagem(const String &)> processa);
+
+/**
+ * Grava os resultados do lote em CSV
+ * @return true se o arquivo foi gravado
+ */
+bool gravaCsv(const String &arq_csv, const vector<ResultadoImagem> &resultados);
+
+#endif
@@ -0,0 +1,384 @@
+#include "Segmentacao.h"
+#include "RemocaoLuz.h"
+#include "FundoMultiescala.h"
+#include "Histograma.h"
+#include "PreProcessamentoFundido.h"
+#include "Instrumentacao.h"
+
+#include <iostream>
+#include <sstream>
+
+#include "opencv2/imgproc.hpp"
+
+static Scalar corAleatoria(RNG &rng)
+{
+    int icor = (unsigned)rng;
+
+    return Scalar(icor & 255, (icor >> 8) & 255, (icor >> 16) & 255);
+}
+
+// Limiar e tipo de threshold de thresholding, usados tambem pela binarizacao em corridas
+static void parametrosLimiar(const Mat &img_sem_luz, int metodo_luz, int metodo_limiar, double percentil,
+                             double &limiar, int &tipo_limiar)
+{
+    // Limiar automatico pelo histograma do proprio quadro; -1 mantem o fixo
+    int limiar_auto = escolheLimiar(img_sem_luz, metodo_limiar, metodo_luz != 2 ? percentil : 100 - percentil);
+
+    if (metodo_luz != 2)
+    {
+        limiar = limiar_auto >= 0 ? limiar_auto : 30;
+        tipo_limiar = THRESH_BINARY;
+    }
+    else
+    {
+        limiar = limiar_auto >= 0 ? limiar_auto : 140;
+        tipo_limiar = THRESH_BINARY_INV;
+    }
+}
+
+Mat thresholding(Mat img_sem_luz, int metodo_luz, int metodo_limiar, double percentil)
+{
+    MEDE_ETAPA("limiar");
+    double limiar;
+    int tipo_limiar;
+    parametrosLimiar(img_sem_luz, metodo_luz, metodo_limiar, percentil, limiar, tipo_limiar);
+    // Segmentao atravs de binarizao
+    Mat img_thr;
+    threshold(img_sem_luz, img_thr, limiar, 255, tipo_limiar);
+
+    return (img_thr);
+}
+
+// Calculate image pattern from an input image
+Mat calculaPadraoLuz(Mat img)
+{
+    MEDE_ETAPA("padrao de luz");
+    Mat padrao;
+    // Basic and effective way to calculate the light pattern from one image
+    blur(img, padrao, Size(img.cols / 3, img.cols / 3));
+
+    return padrao;
+}
+
+Mat removeLuz(Mat img, Mat padrao, int metodo)
+{
+    MEDE_ETAPA("remocao de luz");
+    Mat aux;
+
+    // Metodo 1: normalizacao
+    if (metodo == 1)
+    {
+        // 255 * (1 - img / padrao) em uma passada 8 bits, sem imagens float intermediarias
+        removeLuzDivisao(img, padrao, aux);
+    }
+    // Metodo 3: a mesma divisao pela tabela de reciprocos, ate 1 nivel de diferenca
+    else if (metodo == LUZ_DIVISAO_RECIPROCO)
+    {
+        removeLuzReciproco(img, padrao, aux);
+    }
+    else
+    {
+        aux = padrao - img;
+    }
+
+    return aux;
+}
+
+Mat removeFundo(const PadraoLuz &padrao_luz, Mat img, int metodo_luz, Mat *padrao_usado)
+{
+    MEDE_ETAPA("fundo");
+    // Padrao carregado uma vez em main; sem arquivo, calcula a partir da propria imagem
+    PadraoLuz padrao_calculado;
+    const PadraoLuz *padrao_fundo = &padrao_luz;
+    if (padrao_luz.vazio())
+    {
+        // Estima o padrao de luz numa copia reduzida; ja inclui o efeito da mediana 7x7
+        padrao_calculado.define(estimaFundoMultiescala(img), 1);
+        padrao_fundo = &padrao_calculado;
+    }
+
+    // Remove fundo
+    Mat img_sem_fundo;
+    img.copyTo(img_sem_fundo);
+    if (metodo_luz != 2)
+    {
+        padrao_fundo->removeLuz(img, img_sem_fundo, metodo_luz);
+    }
+
+    // A janela fica com quem chamou; os modos em lote e stream nao mostram o padrao
+    if (padrao_usado != NULL)
+        *padrao_usado = padrao_fundo->padrao();
+
+    return img_sem_fundo;
+}
+
+Mat removeRuido(Mat imagem)
+{
+    MEDE_ETAPA("ruido");
+    // Remove ruido
+    Mat img_sem_ruido;
+
+    medianBlur(imagem, img_sem_ruido, 7);
+
+    return img_sem_ruido;
+}
+
+Mat preProcessa(Mat img, const PadraoLuz &padrao_luz, int metodo_luz, int metodo_limiar, double percentil, bool fundido)
+{
+    // O padrao estimado e o limiar automatico precisam do quadro inteiro ja filtrado
+    bool tem_padrao = metodo_luz == 2 || padrao_luz.compativel(img.size());
+    if (fundido && tem_padrao && metodo_limiar == LIMIAR_FIXO)
+    {
+        Mat img_thr;
+        if (metodo_luz != 2)
+            preProcessaFundido(img, padrao_luz, 7, metodo_luz, 30, THRESH_BINARY, img_thr);
+        else
+            preProcessaFundido(img, padrao_luz, 7, metodo_luz, 140, THRESH_BINARY_INV, img_thr);
+        return img_thr;
+    }
+
+    Mat img_sem_ruido = removeRuido(img);
+    Mat img_sem_fundo = removeFundo(padrao_luz, img_sem_ruido, metodo_luz);
+    return thresholding(img_sem_fundo, metodo_luz, metodo_limiar, percentil);
+}
+
+void preProcessaRLE(Mat img, const PadraoLuz &padrao_luz, int metodo_luz, int metodo_limiar, double percentil,
+                    bool fundido, MascaraRLE &mascara)
+{
+    bool tem_padrao = metodo_luz == 2 || padrao_luz.compativel(img.size());
+    if (fundido && tem_padrao && metodo_limiar == LIMIAR_FIXO)
+    {
+        if (metodo_luz != 2)
+            preProcessaFundidoRLE(img, padrao_luz, 7, metodo_luz, 30, THRESH_BINARY, mascara);
+        else
+            preProcessaFundidoRLE(img, padrao_luz, 7, metodo_luz, 140, THRESH_BINARY_INV, mascara);
+        return;
+    }
+
+    // O limiar vai direto para as corridas, sem a imagem binaria
+    Mat img_sem_fundo = removeFundo(padrao_luz, removeRuido(img), metodo_luz);
+    double limiar;
+    int tipo_limiar;
+    parametrosLimiar(img_sem_fundo, metodo_luz, metodo_limiar, percentil, limiar, tipo_limiar);
+    binarizaRLE(img_sem_fundo, limiar, tipo_limiar, mascara);
+}
+
+void verificaNumObjDetectados(int num_objetos)
+{
+    // Verifica o numero de objetos detectados
+    if (num_objetos < 2)
+    {
+        cout << "Nenhum objeto detectado" << endl;
+        exit(0);
+    }
+    else
+    {
+        cout << "Numero de objetos detectados: " << (num_objetos - 1) << endl;
+    }
+}
+
+Mat colorizaRotulos(const Mat &rotulos, int num_objetos)
+{
+    MEDE_ETAPA("colorizacao");
+    // Tabela rotulo -> cor montada uma vez, com a mesma sequencia do RNG de antes
+    vector<Vec3b> cores(max(num_objetos, 1), Vec3b(0, 0, 0));
+    RNG rng(0xFFFFFFFF);
+    for (int i = 1; i < num_objetos; i++)
+    {
+        Scalar cor = corAleatoria(rng);
+        cores[i] = Vec3b((uchar)cor[0], (uchar)cor[1], (uchar)cor[2]);
+    }
+
+    // Uma unica varredura da imagem de rotulos, em paralelo por faixas de linhas
+    Mat resultado(rotulos.rows, rotulos.cols, CV_8UC3);
+    parallel_for_(Range(0, rotulos.rows), [&](const Range &faixa) {
+        for (int y = faixa.start; y < faixa.end; y++)
+        {
+            const int *rotulo = rotulos.ptr<int>(y);
+            Vec3b *saida = resultado.ptr<Vec3b>(y);
+            for (int x = 0; x < rotulos.cols; x++)
+                saida[x] = cores[rotulo[x]];
+        }
+    });
+
+    return resultado;
+}
+
+Mat ComponentesConexas(Mat img)
+{
+    MEDE_ETAPA("segmentacao");
+    // Usa componentes conexas para segmentar partes da imagem
+    Mat rotulos;
+    int num_objetos = connectedComponents(img, rotulos);
+    verificaNumObjDetectados(num_objetos);
+
+    // Cria imagem de sada colorindo objetos
+    Mat resultado = colorizaRotulos(rotulos, num_objetos);
+
+    return resultado;
+}
+
+Mat ComponentesConexasComEstatisticas(Mat img)
+{
+    MEDE_ETAPA("segmentacao");
+    // Usa componentes conexas com estatisticas
+    Mat rotulos, estatisticas, centroides;
+    int num_objetos = connectedComponentsWithStats(img, rotulos, estatisticas, centroides, 8);
+    verificaNumObjDetectados(num_objetos);
+
+    // Cria imagem de sada colorindo objetos e mostra rea
+    Mat resultado = colorizaRotulos(rotulos, num_objetos);
+
+    for (int i = 1; i < num_objetos; i++)
+    {
+        cout << "Objeto " << i << " posicao: [" << centroides.at<double>(i, 0) << ", " << centroides.at<double>(i, 1) << "]";
+        cout << ", area: " << estatisticas.at<int>(i, CC_STAT_AREA);
+        cout << " pixels, largura: " << estatisticas.at<int>(i, CC_STAT_WIDTH);
+        cout << " pixels, altura: " << estatisticas.at<int>(i, CC_STAT_HEIGHT) << " pixels" << endl;
+
+        stringstream ss;
+        ss << "area: " << estatisticas.at<int>(i, CC_STAT_AREA);
+
+        Point c(centroides.at<double>(i, 0) - 25, centroides.at<double>(i, 1) - 25);
+        putText(resultado, ss.str(), c, FONT_HERSHEY_SIMPLEX, 0.4, Scalar(255, 255, 255));
+    }
+
+    return resultado;
+}
+
+Mat EncontraContornos(Mat img)
+{
+    MEDE_ETAPA("segmentacao");
+    vector<vector<Point>> contornos;
+    findContours(img, contornos, RETR_EXTERNAL, CHAIN_APPROX_SIMPLE);
+
+    Mat resultado = Mat::zeros(img.rows, img.cols, CV_8UC3);
+
+    // Verifica o nmero de objetos detectados
+    if (contornos.size() == 0)
+    {
+        cout << "Nenhum objeto detectado" << endl;
+        exit(0);
+    }
+    else
+    {
+        cout << "Numero de objetos detectados: " << contornos.size() << endl;
+    }
+
+    RNG rng(0xFFFFFFFF);
+    for (int i = 0; i < contornos.size(); i++)
+    {
+        drawContours(resultado, contornos, i, corAleatoria(rng));
+    }
+
+    return resultado;
+}
+
+Mat segmentaQuadro(Mat img_thr, int metodo_seg, int &num_objetos)
+{
+    MEDE_ETAPA("segmentacao");
+    // Mesmos metodos de segmentacao, mas um quadro sem objetos nao encerra o stream
+    if (metodo_seg == 3)
+    {
+        vector<vector<Point>> contornos;
+        findContours(img_thr, contornos, RETR_EXTERNAL, CHAIN_APPROX_SIMPLE);
+        num_objetos = (int)contornos.size();
+
+        Mat resultado = Mat::zeros(img_thr.rows, img_thr.cols, CV_8UC3);
+        RNG rng(0xFFFFFFFF);
+        for (size_t i = 0; i < contornos.size(); i++)
+            drawContours(resultado, contornos, (int)i, corAleatoria(rng));
+        return resultado;
+    }
+
+    Mat rotulos;
+    int num_rotulos = connectedComponents(img_thr, rotulos);
+    num_objetos = num_rotulos - 1;
+
+    return colorizaRotulos(rotulos, num_rotulos);
+}
+
+// Numero de objetos e area total, minima e maxima do lote
+static void resumeAreas(const vector<double> &areas, ResultadoImagem &resultado)
+{
+    // Quadro vazio e um resultado valido, nao encerra o lote
+    resultado.num_objetos = (int)areas.size();
+    for (size_t i = 0; i < areas.size(); i++)
+    {
+        resultado.area_total += areas[i];
+        if (i == 0 || areas[i] < resultado.area_min)
+            resultado.area_min = areas[i];
+        if (i == 0 || areas[i] > resultado.area_max)
+            resultado.area_max = areas[i];
+    }
+}
+
+// Areas em pixels dos objetos que findContours com RETR_EXTERNAL devolve: os que tocam a borda ou o
+// fundo ligado a ela (vizinhanca-4); objetos dentro de buracos de outros objetos ficam de fora
+static void areasObjetosExternos(Mat img_thr, vector<double> &areas)
+{
+    Mat rotulos, estatisticas, centroides;
+    int num_rotulos = connectedComponentsWithStats(img_thr, rotulos, estatisticas, centroides, 8, CV_32S);
+
+    // Fundo externo preenchido a partir de uma moldura em volta da imagem, e os pixels vizinhos dele
+    Mat moldura;
+    copyMakeBorder(img_thr != 0, moldura, 1, 1, 1, 1, BORDER_CONSTANT, Scalar(0));
+    floodFill(moldura, Point(0, 0), Scalar(128), 0, Scalar(0), Scalar(0), 4);
+    Mat externo = moldura == 128;
+    dilate(externo, externo, getStructuringElement(MORPH_CROSS, Size(3, 3)));
+    externo = externo(Rect(1, 1, img_thr.cols, img_thr.rows));
+
+    vector<char> eh_externo(num_rotulos, 0);
+    for (int y = 0; y < rotulos.rows; y++)
+    {
+        const int *r = rotulos.ptr<int>(y);
+        const uchar *e = externo.ptr<uchar>(y);
+        for (int x = 0; x < rotulos.cols; x++)
+        {
+            if (r[x] > 0 && e[x])
+                eh_externo[r[x]] = 1;
+        }
+    }
+
+    for (int i = 1; i < num_rotulos; i++)
+    {
+        if (eh_externo[i])
+            areas.push_back(estatisticas.at<int>(i, CC_STAT_AREA));
+    }
+}
+
+void estatisticasObjetos(Mat img_thr, int metodo_seg, ResultadoImagem &resultado)
+{
+    MEDE_ETAPA("segmentacao");
+    // Mesma segmentacao dos metodos interativos, mas sem colorir nem imprimir
+    vector<double> areas;
+    if (metodo_seg == 3)
+    {
+        // Mesmos objetos dos contornos externos, com a area em pixels como nos metodos 1 e 2
+        areasObjetosExternos(img_thr, areas);
+    }
+    else
+    {
+        Mat rotulos, estatisticas, centroides;
+        int num_objetos = connectedComponentsWithStats(img_thr, rotulos, estatisticas, centroides, 8);
+        for (int i = 1; i < num_objetos; i++)
+            areas.push_back(estatisticas.at<int>(i, CC_STAT_AREA));
+    }
+
+    resumeAreas(areas, resultado);
+}
+
+void estatisticasObjetosRLE(const MascaraRLE &mascara, ResultadoImagem &resultado)
+{
+    MEDE_ETAPA("segmentacao");
+    // Componentes conexas 8 sobre as corridas, sem imagem de rotulos
+    vector<int> rotulos;
+    vector<ComponenteRLE> componentes;
+    int num_rotulos = rotulaRLE(mascara, rotulos, componentes, 8);
+
+    vector<double> areas;
+    for (int i = 1; i < num_rotulos; i++)
+        areas.push_back(componentes[i].area);
+
+    resumeAreas(areas, resultado);
+}
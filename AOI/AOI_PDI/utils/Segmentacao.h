@@ -0,0 +1,115 @@
+/**
+ * Etapas de processamento do AOI_PDI
+ *
+ * Remocao de ruido, remocao da luz de fundo, binarizacao e segmentacao
+ * usadas pelos modos interativo, em lote e stream e pelo benchmark.
+ *
+ */
+
+#ifndef SEGMENTACAO_h
+#define SEGMENTACAO_h
+
+#include <string>
+#include <vector>
+using namespace std;
+
+// OpenCV includes
+#include "opencv2/core.hpp"
+using namespace cv;
+
+#include "PadraoLuz.h"
+#include "ProcessamentoLote.h"
+#include "Histograma.h"
+#include "MascaraRLE.h"
+
+/**
+ * Binariza a imagem sem fundo
+ * @param Mat img_sem_luz - imagem com a luz de fundo removida
+ * @param int metodo_luz - metodo usado na remocao da luz; 2 (sem remocao) usa limiar invertido
+ * @param int metodo_limiar - LIMIAR_FIXO (30, ou 140 invertido) ou um MetodoLimiar automatico
+ * @param double percentil - porcentagem de pixels de fundo com LIMIAR_PERCENTIL
+ * @return Mat imagem binaria
+ */
+Mat thresholding(Mat img_sem_luz, int metodo_luz, int metodo_limiar = LIMIAR_FIXO, double percentil = 90);
+
+/**
+ * Estima o padrao de luz a partir da propria imagem, na resolucao cheia; referencia de estimaFundoMultiescala
+ */
+Mat calculaPadraoLuz(Mat img);
+
+/**
+ * Remove a luz de fundo com um padrao qualquer
+ * @param int metodo - 1 divisao, 3 divisao pelo reciproco, senao diferenca
+ */
+Mat removeLuz(Mat img, Mat padrao, int metodo);
+
+/**
+ * Remove a luz de fundo com o padrao carregado, ou com um estimado da imagem (estimaFundoMultiescala)
+ * se ele estiver vazio
+ * @param PadraoLuz padrao_luz - padrao carregado em main, pode estar vazio
+ * @param Mat img - imagem sem ruido
+ * @param int metodo_luz - 0 diferenca, 1 divisao, 2 nao remove, 3 divisao pelo reciproco
+ * @param Mat* padrao_usado - saida opcional do padrao efetivamente usado, para mostrar
+ * @return Mat imagem sem fundo
+ */
+Mat removeFundo(const PadraoLuz &padrao_luz, Mat img, int metodo_luz, Mat *padrao_usado = NULL);
+
+/**
+ * Remove ruido com filtro de mediana 7x7
+ */
+Mat removeRuido(Mat imagem);
+
+/**
+ * Remove ruido, luz de fundo e binariza (modos em lote e stream)
+ *
+ * Com fundido, o padrao compativel e o limiar fixo usa preProcessaFundido, numa unica passada
+ * por faixas; senao, ou sem padrao, aplica removeRuido, removeFundo e thresholding. O resultado e o mesmo.
+ * @param bool fundido - permite o caminho fundido
+ * @return Mat imagem binaria
+ */
+Mat preProcessa(Mat img, const PadraoLuz &padrao_luz, int metodo_luz, int metodo_limiar, double percentil, bool fundido);
+
+/**
+ * Mesmo que preProcessa, mas binariza direto em corridas, sem escrever a imagem binaria
+ * @param MascaraRLE mascara - saida em corridas
+ */
+void preProcessaRLE(Mat img, const PadraoLuz &padrao_luz, int metodo_luz, int metodo_limiar, double percentil,
+                    bool fundido, MascaraRLE &mascara);
+
+/**
+ * Imprime o numero de objetos; encerra o programa se nao ha nenhum
+ */
+void verificaNumObjDetectados(int num_objetos);
+
+/**
+ * Colore cada rotulo de connectedComponents com uma cor aleatoria fixa
+ */
+Mat colorizaRotulos(const Mat &rotulos, int num_objetos);
+
+/**
+ * Segmentacao interativa; imprimem os objetos e encerram o programa se nao ha nenhum
+ */
+Mat ComponentesConexas(Mat img);
+Mat ComponentesConexasComEstatisticas(Mat img);
+Mat EncontraContornos(Mat img);
+
+/**
+ * Segmenta um quadro sem imprimir nem encerrar o programa (modo stream)
+ * @param int metodo_seg - 3 contornos, senao componentes conexas
+ * @param int num_objetos - saida do numero de objetos
+ * @return Mat imagem colorida com os objetos
+ */
+Mat segmentaQuadro(Mat img_thr, int metodo_seg, int &num_objetos);
+
+/**
+ * Numero e areas em pixels dos objetos de uma imagem binaria (modo em lote); com segMethod 3 so os
+ * objetos externos, os mesmos do findContours com RETR_EXTERNAL
+ */
+void estatisticasObjetos(Mat img_thr, int metodo_seg, ResultadoImagem &resultado);
+
+/**
+ * Numero e areas dos objetos de uma mascara em corridas, componentes conexas 8 (segMethod 1 e 2)
+ */
+void estatisticasObjetosRLE(const MascaraRLE &mascara, ResultadoImagem &resultado);
+
+#endif
@@ -0,0 +1,116 @@
+#include "Benchmark.h"
+
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <algorithm>
+#include <ctime>
+
+// Limite de repeticoes para etapas muito rapidas
+static const int REPETICOES_MAXIMAS = 100000;
+
+static String escapaJson(const String &texto)
+{
+    String saida;
+    for (size_t i = 0; i < texto.size(); i++)
+    {
+        char c = texto[i];
+        if (c == '"' || c == '\\')
+            saida += '\\';
+        saida += c;
+    }
+    return saida;
+}
+
+Benchmark::Benchmark(double tempo_minimo_s, int repeticoes_minimas)
+    : tempo_minimo_s(tempo_minimo_s), repeticoes_minimas(max(1, repeticoes_minimas))
+{
+}
+
+void Benchmark::mede(const String &etapa, const String &entrada, Size tamanho, function<int()> corpo)
+{
+    MedidaBenchmark medida;
+    medida.etapa = etapa;
+    medida.entrada = entrada;
+    medida.largura = tamanho.width;
+    medida.altura = tamanho.height;
+
+    // Aquecimento: alocacoes, caches e threads do OpenCV
+    medida.objetos = corpo();
+
+    vector<double> tempos;
+    double total_s = 0;
+    while ((int)tempos.size() < repeticoes_minimas || (total_s < tempo_minimo_s && (int)tempos.size() < REPETICOES_MAXIMAS))
+    {
+        int64 inicio = getTickCount();
+        corpo();
+        double segundos = (getTickCount() - inicio) / getTickFrequency();
+        tempos.push_back(1000.0 * segundos);
+        total_s += segundos;
+    }
+
+    medida.repeticoes = (int)tempos.size();
+    medida.ms_media = 1000.0 * total_s / tempos.size();
+    sort(tempos.begin(), tempos.end());
+    medida.ms_minimo = tempos.front();
+    medida.ms_mediana = tempos[tempos.size() / 2];
+
+    double mediana_s = max(medida.ms_mediana, 1e-6) / 1000.0;
+    medida.pixels_s = (double)tamanho.area() / mediana_s;
+    medida.objetos_s = medida.objetos / mediana_s;
+
+    resultados.push_back(medida);
+}
+
+void Benchmark::imprime() const
+{
+    cout << left << setw(34) << "etapa" << setw(22) << "entrada" << right << setw(11) << "tamanho"
+         << setw(12) << "ms (med)" << setw(12) << "ms (min)" << setw(14) << "Mpixels/s" << setw(12) << "objetos/s" << endl;
+    for (size_t i = 0; i < resultados.size(); i++)
+    {
+        const MedidaBenchmark &m = resultados[i];
+        cout << left << setw(34) << m.etapa << setw(22) << m.entrada << right
+             << setw(11) << format("%dx%d", m.largura, m.altura)
+             << fixed << setprecision(3) << setw(12) << m.ms_mediana << setw(12) << m.ms_minimo
+             << setprecision(1) << setw(14) << m.pixels_s / 1e6 << setw(12) << m.objetos_s << endl;
+        cout.unsetf(ios::fixed);
+    }
+}
+
+bool Benchmark::gravaJson(const String &arquivo, const String &programa) const
+{
+    ofstream json(arquivo.c_str());
+    if (!json.is_open())
+        return false;
+
+    char data[32];
+    time_t agora = time(NULL);
+    strftime(data, sizeof(data), "%Y-%m-%dT%H:%M:%S", localtime(&agora));
+
+    json << setprecision(10);
+    json << "{\n";
+    json << "  \"programa\": \"" << escapaJson(programa) << "\",\n";
+    json << "  \"data\": \"" << data << "\",\n";
+    json << "  \"opencv\": \"" << CV_VERSION << "\",\n";
+    json << "  \"threads\": " << getNumThreads() << ",\n";
+    json << "  \"medidas\": [\n";
+    for (size_t i = 0; i < resultados.size(); i++)
+    {
+        const MedidaBenchmark &m = resultados[i];
+        json << "    {\"etapa\": \"" << escapaJson(m.etapa) << "\", \"entrada\": \"" << escapaJson(m.entrada) << "\""
+             << ", \"largura\": " << m.largura << ", \"altura\": " << m.altura
+             << ", \"repeticoes\": " << m.repeticoes << ", \"objetos\": " << m.objetos
+             << ", \"ms_mediana\": " << m.ms_mediana << ", \"ms_minimo\": " << m.ms_minimo << ", \"ms_media\": " << m.ms_media
+             << ", \"pixels_s\": " << m.pixels_s << ", \"objetos_s\": " << m.objetos_s << "}"
+             << (i + 1 < resultados.size() ? "," : "") << "\n";
+    }
+    json << "  ]\n";
+    json << "}\n";
+
+    return json.good();
+}
+
+const vector<MedidaBenchmark> &Benchmark::medidas() const
+{
+    return resultados;
+}
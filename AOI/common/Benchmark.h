@@ -0,0 +1,79 @@
+/**
+ * Medicao de tempo das etapas de processamento
+ *
+ * Cada medida repete a etapa ate somar um tempo minimo e guarda a mediana,
+ * o minimo e a media por execucao, com a taxa em pixels/s e objetos/s.
+ * O resultado vai para um JSON que pode ser comparado entre execucoes.
+ *
+ */
+
+#ifndef BENCHMARK_h
+#define BENCHMARK_h
+
+#include <string>
+#include <vector>
+#include <functional>
+using namespace std;
+
+// OpenCV includes
+#include "opencv2/core.hpp"
+using namespace cv;
+
+/**
+ * Resultado da medicao de uma etapa com uma entrada
+ */
+struct MedidaBenchmark
+{
+    String etapa;
+    String entrada;
+    int largura;
+    int altura;
+    int repeticoes;
+    int objetos;              // objetos encontrados por execucao, 0 se nao se aplica
+    double ms_mediana;
+    double ms_minimo;
+    double ms_media;
+    double pixels_s;          // pixels da entrada por segundo, pela mediana
+    double objetos_s;         // objetos por segundo, pela mediana
+};
+
+class Benchmark
+{
+public:
+    /**
+     * @param double tempo_minimo_s - tempo minimo somado das repeticoes de cada medida
+     * @param int repeticoes_minimas - numero minimo de repeticoes de cada medida
+     */
+    Benchmark(double tempo_minimo_s = 0.5, int repeticoes_minimas = 5);
+
+    /**
+     * Mede uma etapa; uma execucao de aquecimento nao entra na medida
+     * @param String etapa - nome da etapa
+     * @param String entrada - nome da entrada
+     * @param Size tamanho - tamanho da entrada, para pixels/s
+     * @param function corpo - executa a etapa uma vez e retorna o numero de objetos (0 se nao se aplica)
+     */
+    void mede(const String &etapa, const String &entrada, Size tamanho, function<int()> corpo);
+
+    /**
+     * Imprime uma tabela com as medidas
+     */
+    void imprime() const;
+
+    /**
+     * Grava as medidas em JSON
+     * @param String arquivo - arquivo de saida
+     * @param String programa - nome do programa medido
+     * @return bool false se o arquivo nao pode ser gravado
+     */
+    bool gravaJson(const String &arquivo, const String &programa) const;
+
+    const vector<MedidaBenchmark> &medidas() const;
+
+private:
+    double tempo_minimo_s;
+    int repeticoes_minimas;
+    vector<MedidaBenchmark> resultados;
+};
+
+#endif
@@ -0,0 +1,78 @@
+/**
+ * Fila circular sem trava para um produtor e um consumidor
+ *
+ * Liga dois estagios do pipeline de stream: so a thread produtora chama
+ * tentaInserir() e so a consumidora chama tentaRetirar(). Nenhuma das duas
+ * bloqueia; com a fila cheia ou vazia elas retornam false e quem chamou
+ * decide se espera (backpressure) ou descarta o quadro.
+ *
+ */
+
+#ifndef FILA_SPSC_h
+#define FILA_SPSC_h
+
+#include <atomic>
+#include <vector>
+#include <utility>
+using namespace std;
+
+template <typename T>
+class FilaSPSC
+{
+public:
+    /**
+     * @param size_t capacidade - numero maximo de itens na fila
+     */
+    explicit FilaSPSC(size_t capacidade) : itens(capacidade + 1), inicio(0), fim(0)
+    {
+    }
+
+    /**
+     * Move o item para a fila (so a thread produtora)
+     * @return bool false se a fila esta cheia; nesse caso o item nao e alterado
+     */
+    bool tentaInserir(T &item)
+    {
+        size_t atual = fim.load(memory_order_relaxed);
+        size_t proximo = avanca(atual);
+        if (proximo == inicio.load(memory_order_acquire))
+            return false;
+
+        itens[atual] = std::move(item);
+        fim.store(proximo, memory_order_release);
+        return true;
+    }
+
+    /**
+     * Move o item mais antigo para fora da fila (so a thread consumidora)
+     * @return bool false se a fila esta vazia
+     */
+    bool tentaRetirar(T &item)
+    {
+        size_t atual = inicio.load(memory_order_relaxed);
+        if (atual == fim.load(memory_order_acquire))
+            return false;
+
+        item = std::move(itens[atual]);
+        inicio.store(avanca(atual), memory_order_release);
+        return true;
+    }
+
+    size_t capacidade() const
+    {
+        return itens.size() - 1;
+    }
+
+private:
+    size_t avanca(size_t posicao) const
+    {
+        return posicao + 1 == itens.size() ? 0 : posicao + 1;
+    }
+
+    vector<T> itens;
+    // Em linhas de cache separadas para o produtor e o consumidor nao disputarem a mesma linha
+    alignas(64) atomic<size_t> inicio;
+    alignas(64) atomic<size_t> fim;
+};
+
+#endif
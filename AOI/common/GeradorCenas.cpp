@@ -0,0 +1,326 @@
+#include "GeradorCenas.h"
+#include "ImagemPGM.h"
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <sstream>
+
+#include "opencv2/imgproc.hpp"
+
+// Nivel da peca como fracao do padrao no mesmo ponto, sorteado por peca
+static const double REFLETANCIA_MIN = 0.2;
+static const double REFLETANCIA_MAX = 0.35;
+// Distancia minima entre os circulos circunscritos de pecas que nao se sobrepoem; o arredondamento
+// do desenho avanca ate 1 pixel em cada peca e sobra pelo menos 1 pixel de fundo entre elas
+static const int AFASTAMENTO = 3;
+// Tentativas de achar um lugar livre antes de desistir da peca
+static const int TENTATIVAS_POSICAO = 30;
+
+/**
+ * Desenha a peca com 255 numa mascara do tamanho da sua caixa
+ * @param Point2f centro - centro da peca nas coordenadas da mascara
+ */
+static void desenhaPeca(Mat &mascara, int classe, Point2f centro, float angulo, int tamanho)
+{
+    float raio = tamanho / 2.0f;
+    float rad = angulo * (float)CV_PI / 180;
+    Point2f direcao(cos(rad), sin(rad));
+    Point2f normal(-direcao.y, direcao.x);
+
+    if (classe == GERADO_PORCA)
+    {
+        vector<Point> hexagono;
+        for (int k = 0; k < 6; k++)
+        {
+            float a = rad + k * (float)CV_PI / 3;
+            hexagono.push_back(Point(cvRound(centro.x + raio * cos(a)), cvRound(centro.y + raio * sin(a))));
+        }
+        fillConvexPoly(mascara, hexagono, Scalar(255));
+        circle(mascara, centro, max(2, cvRound(tamanho * 0.22)), Scalar(0), FILLED);
+    }
+    else if (classe == GERADO_ARRUELA)
+    {
+        circle(mascara, centro, cvRound(raio), Scalar(255), FILLED);
+        circle(mascara, centro, max(2, cvRound(tamanho * 0.25)), Scalar(0), FILLED);
+    }
+    else
+    {
+        // Haste ao longo da direcao, cabeca na ponta negativa; os cantos da cabeca ficam dentro do raio
+        float largura_haste = max(3.0f, tamanho * 0.2f);
+        float largura_cabeca = max(5.0f, tamanho * 0.4f);
+        float comprimento_cabeca = max(3.0f, tamanho * 0.2f);
+        float meio = sqrt(raio * raio - largura_cabeca * largura_cabeca / 4);
+        Point2f inicio = centro - direcao * meio;
+        Point2f fim = centro + direcao * meio;
+        Point2f fim_cabeca = inicio + direcao * comprimento_cabeca;
+
+        Point haste[4] = {inicio + normal * (largura_haste / 2), fim + normal * (largura_haste / 2),
+                          fim - normal * (largura_haste / 2), inicio - normal * (largura_haste / 2)};
+        Point cabeca[4] = {inicio + normal * (largura_cabeca / 2), fim_cabeca + normal * (largura_cabeca / 2),
+                           fim_cabeca - normal * (largura_cabeca / 2), inicio - normal * (largura_cabeca / 2)};
+        fillConvexPoly(mascara, haste, 4, Scalar(255));
+        fillConvexPoly(mascara, cabeca, 4, Scalar(255));
+    }
+}
+
+/**
+ * Vinheta com o centro deslocado mais um gradiente horizontal; o centro fica perto de 200
+ */
+static Mat geraPadrao(Size tamanho, double iluminacao)
+{
+    Mat padrao(tamanho, CV_8UC1);
+    double cx = 0.6 * tamanho.width, cy = 0.45 * tamanho.height;
+    double raio2 = max(cx * cx, (tamanho.width - cx) * (tamanho.width - cx)) + max(cy * cy, (tamanho.height - cy) * (tamanho.height - cy));
+
+    for (int y = 0; y < tamanho.height; y++)
+    {
+        uchar *linha = padrao.ptr<uchar>(y);
+        double dy2 = (y - cy) * (y - cy);
+        for (int x = 0; x < tamanho.width; x++)
+        {
+            double r2 = ((x - cx) * (x - cx) + dy2) / raio2;
+            double gradiente = 1 - 0.25 * iluminacao * x / tamanho.width;
+            linha[x] = saturate_cast<uchar>(200 * (1 - 0.75 * iluminacao * r2) * gradiente);
+        }
+    }
+
+    return padrao;
+}
+
+GeradorCenas::GeradorCenas()
+{
+}
+
+bool GeradorCenas::define(const ParametrosCena &parametros)
+{
+    if (parametros.tamanho_min < 8 || parametros.tamanho_max < parametros.tamanho_min)
+        return false;
+
+    if (parametros.arq_padrao.empty())
+    {
+        if (parametros.tamanho.width <= 0 || parametros.tamanho.height <= 0)
+            return false;
+        fundo = geraPadrao(parametros.tamanho, parametros.iluminacao);
+    }
+    else
+    {
+        Mat lido = leImagemCinza(parametros.arq_padrao);
+        if (lido.empty())
+            return false;
+        if (parametros.tamanho.width <= 0 || parametros.tamanho.height <= 0 || parametros.tamanho == lido.size())
+            fundo = lido.clone();
+        else
+            resize(lido, fundo, parametros.tamanho, 0, 0, INTER_LINEAR);
+    }
+
+    param = parametros;
+    param.tamanho = fundo.size();
+    return true;
+}
+
+const ParametrosCena &GeradorCenas::parametros() const
+{
+    return param;
+}
+
+const Mat &GeradorCenas::padrao() const
+{
+    return fundo;
+}
+
+void GeradorCenas::gera(int64 indice, Mat &quadro, vector<ObjetoGerado> *objetos) const
+{
+    fundo.copyTo(quadro);
+    Size tamanho = fundo.size();
+    RNG rng((param.semente * 0x9E3779B97F4A7C15ULL) ^ ((uint64)(indice + 1) * 0xBF58476D1CE4E5B9ULL));
+
+    // Grade de celulas do tamanho da maior peca: os vizinhos que podem tocar estao nas 3x3 em volta
+    int celula = param.tamanho_max + AFASTAMENTO;
+    int colunas = tamanho.width / celula + 1, linhas = tamanho.height / celula + 1;
+    vector<vector<int>> grade(colunas * linhas);
+
+    vector<ObjetoGerado> pecas;
+    vector<Mat> mascaras;
+    vector<Rect> caixas; // caixa de cada mascara, sem recortar no quadro
+    vector<bool> sem_teste;
+
+    int num_pecas = cvRound(param.densidade * tamanho.area() / 1e6);
+    for (int n = 0; n < num_pecas; n++)
+    {
+        ObjetoGerado peca;
+        peca.classe = rng.uniform(0, 3);
+        peca.tamanho = rng.uniform(param.tamanho_min, param.tamanho_max + 1);
+        peca.angulo = rng.uniform(0.0f, 180.0f);
+        float raio = peca.tamanho / 2.0f;
+        if (tamanho.width <= peca.tamanho || tamanho.height <= peca.tamanho)
+            continue;
+
+        bool livre = rng.uniform(0.0, 1.0) < param.sobreposicao;
+        bool colocada = livre;
+        if (livre)
+            peca.centro = Point2f(rng.uniform(raio, tamanho.width - raio), rng.uniform(raio, tamanho.height - raio));
+        for (int t = 0; !colocada && t < TENTATIVAS_POSICAO; t++)
+        {
+            peca.centro = Point2f(rng.uniform(raio, tamanho.width - raio), rng.uniform(raio, tamanho.height - raio));
+            int cx = (int)peca.centro.x / celula, cy = (int)peca.centro.y / celula;
+            colocada = true;
+            for (int gy = max(0, cy - 1); colocada && gy <= min(linhas - 1, cy + 1); gy++)
+            {
+                for (int gx = max(0, cx - 1); colocada && gx <= min(colunas - 1, cx + 1); gx++)
+                {
+                    const vector<int> &vizinhos = grade[gy * colunas + gx];
+                    for (size_t v = 0; colocada && v < vizinhos.size(); v++)
+                    {
+                        const ObjetoGerado &outra = pecas[vizinhos[v]];
+                        float distancia = raio + outra.tamanho / 2.0f + AFASTAMENTO;
+                        Point2f d = peca.centro - outra.centro;
+                        colocada = d.dot(d) >= distancia * distancia;
+                    }
+                }
+            }
+        }
+        if (!colocada)
+            continue;
+
+        Rect caixa(cvFloor(peca.centro.x - raio) - 1, cvFloor(peca.centro.y - raio) - 1, peca.tamanho + 3, peca.tamanho + 3);
+        Mat mascara = Mat::zeros(caixa.size(), CV_8UC1);
+        desenhaPeca(mascara, peca.classe, peca.centro - Point2f((float)caixa.x, (float)caixa.y), peca.angulo, peca.tamanho);
+
+        peca.caixa = caixa & Rect(Point(), tamanho);
+        Mat visivel = mascara(peca.caixa - caixa.tl());
+        peca.area = countNonZero(visivel);
+
+        // Peca escura: fracao do padrao no mesmo ponto
+        Mat escura;
+        fundo(peca.caixa).convertTo(escura, -1, rng.uniform(REFLETANCIA_MIN, REFLETANCIA_MAX));
+        Mat destino = quadro(peca.caixa);
+        escura.copyTo(destino, visivel);
+
+        grade[((int)peca.centro.y / celula) * colunas + (int)peca.centro.x / celula].push_back((int)pecas.size());
+        pecas.push_back(peca);
+        mascaras.push_back(mascara);
+        caixas.push_back(caixa);
+        sem_teste.push_back(livre);
+    }
+
+    // So um par com uma peca colocada sem teste pode se tocar; confere pixel a pixel com a mascara dilatada
+    if (param.sobreposicao > 0 && objetos)
+    {
+        Mat elemento = getStructuringElement(MORPH_RECT, Size(3, 3));
+        for (size_t i = 0; i < pecas.size(); i++)
+        {
+            if (!sem_teste[i])
+                continue;
+            Mat dilatada;
+            dilate(mascaras[i], dilatada, elemento);
+            int cx = (int)pecas[i].centro.x / celula, cy = (int)pecas[i].centro.y / celula;
+            for (int gy = max(0, cy - 1); gy <= min(linhas - 1, cy + 1); gy++)
+            {
+                for (int gx = max(0, cx - 1); gx <= min(colunas - 1, cx + 1); gx++)
+                {
+                    const vector<int> &vizinhos = grade[gy * colunas + gx];
+                    for (size_t v = 0; v < vizinhos.size(); v++)
+                    {
+                        size_t j = vizinhos[v];
+                        Rect comum = caixas[i] & caixas[j];
+                        if (j == i || comum.empty())
+                            continue;
+                        Mat toque;
+                        bitwise_and(dilatada(comum - caixas[i].tl()), mascaras[j](comum - caixas[j].tl()), toque);
+                        if (countNonZero(toque) > 0)
+                            pecas[i].sobreposto = pecas[j].sobreposto = true;
+                    }
+                }
+            }
+        }
+    }
+
+    if (param.ruido > 0)
+    {
+        Mat ruido(tamanho, CV_16SC1);
+        rng.fill(ruido, RNG::NORMAL, 0, param.ruido);
+        add(quadro, ruido, quadro, noArray(), CV_8U);
+    }
+    int64 num_impulsos = (int64)(param.impulsos * tamanho.area());
+    for (int64 i = 0; i < num_impulsos; i++)
+        quadro.at<uchar>(rng.uniform(0, tamanho.height), rng.uniform(0, tamanho.width)) = (rng.next() & 1) ? 255 : 0;
+
+    if (objetos)
+        objetos->swap(pecas);
+}
+
+bool interpretaParametrosCena(const String &texto, ParametrosCena &parametros)
+{
+    ParametrosCena lidos;
+    bool tem_tamanho = false;
+
+    stringstream ss(texto);
+    String item;
+    while (getline(ss, item, ','))
+    {
+        size_t igual = item.find('=');
+        if (igual == String::npos)
+            return false;
+        String chave = item.substr(0, igual);
+        String valor = item.substr(igual + 1);
+        const char *v = valor.c_str();
+
+        if (chave == "size")
+        {
+            if (sscanf(v, "%dx%d", &lidos.tamanho.width, &lidos.tamanho.height) != 2)
+                return false;
+            tem_tamanho = true;
+        }
+        else if (chave == "density")
+            lidos.densidade = atof(v);
+        else if (chave == "minSize")
+            lidos.tamanho_min = atoi(v);
+        else if (chave == "maxSize")
+            lidos.tamanho_max = atoi(v);
+        else if (chave == "overlap")
+            lidos.sobreposicao = atof(v);
+        else if (chave == "noise")
+            lidos.ruido = atof(v);
+        else if (chave == "impulse")
+            lidos.impulsos = atof(v);
+        else if (chave == "light")
+            lidos.iluminacao = atof(v);
+        else if (chave == "pattern")
+            lidos.arq_padrao = valor;
+        else if (chave == "seed")
+            lidos.semente = (uint64)strtoull(v, NULL, 10);
+        else if (chave == "frames")
+            lidos.quadros = atoi(v);
+        else if (chave == "cycle")
+            lidos.ciclo = atoi(v);
+        else
+            return false;
+    }
+
+    // Com padrao em arquivo e sem tamanho pedido, os quadros ficam do tamanho do arquivo
+    if (!lidos.arq_padrao.empty() && !tem_tamanho)
+        lidos.tamanho = Size();
+
+    if (lidos.densidade < 0 || lidos.tamanho_min < 8 || lidos.tamanho_max < lidos.tamanho_min ||
+        lidos.sobreposicao < 0 || lidos.sobreposicao > 1 || lidos.ruido < 0 || lidos.impulsos < 0 || lidos.impulsos > 1 ||
+        lidos.iluminacao < 0 || lidos.iluminacao > 1 || lidos.quadros < 1 || lidos.ciclo < 1)
+        return false;
+
+    parametros = lidos;
+    return true;
+}
+
+String nomeClasseGerada(int classe)
+{
+    switch (classe)
+    {
+    case GERADO_PORCA:
+        return "porca";
+    case GERADO_ARRUELA:
+        return "arruela";
+    case GERADO_PARAFUSO:
+        return "parafuso";
+    }
+    return "";
+}
@@ -0,0 +1,132 @@
+/**
+ * Cenas sinteticas para testes de escala e de carga
+ *
+ * O dataset tem algumas centenas de quadros de 320x240 com poucas pecas
+ * cada; aqui os quadros sao desenhados com a resolucao e a densidade
+ * pedidas, com o rotulo verdadeiro de cada objeto:
+ *
+ * - porca: hexagono com um furo redondo no centro
+ * - arruela: disco com um furo de metade do diametro
+ * - parafuso: haste estreita com uma cabeca mais larga numa ponta
+ *
+ * As pecas sao escuras sobre um fundo claro, como no dataset: o nivel de
+ * cada peca e uma fracao do padrao de luz no mesmo ponto, entao removeFundo
+ * com o padrao gravado por padrao() recupera o contraste. O padrao vem de
+ * um arquivo (ex. o pattern.pgm do dataset, redimensionado) ou e gerado:
+ * vinheta com o centro deslocado mais um gradiente linear.
+ *
+ * Sem sobreposicao sobra pelo menos 1 pixel de fundo entre as pecas, e
+ * cada componente conexa e um objeto. Com sobreposicao > 0 essa fracao
+ * das pecas e colocada sem teste e pode tocar as outras;
+ * ObjetoGerado::sobreposto marca as que tocam.
+ *
+ * O quadro i depende so dos parametros e de i: gera() pode ser chamada em
+ * qualquer ordem e de varias threads ao mesmo tempo.
+ *
+ */
+
+#ifndef GERADOR_CENAS_h
+#define GERADOR_CENAS_h
+
+#include <string>
+#include <vector>
+using namespace std;
+
+// OpenCV includes
+#include "opencv2/core.hpp"
+using namespace cv;
+
+// Mesmos rotulos das sequencias de treinamento do AOI_ML
+enum ClasseGerada
+{
+    GERADO_PORCA = 0,
+    GERADO_ARRUELA = 1,
+    GERADO_PARAFUSO = 2
+};
+
+struct ParametrosCena
+{
+    Size tamanho;        // resolucao dos quadros; vazio usa a do arquivo de padrao
+    double densidade;    // pecas por megapixel
+    int tamanho_min;     // maior dimensao de cada peca, em pixels (pelo menos 8; abaixo de 48 o
+                         // parafuso fica com menos de 500 pixels e o AOI_ML o descarta)
+    int tamanho_max;
+    double sobreposicao; // fracao das pecas colocadas sem evitar as outras, 0 a 1
+    double ruido;        // desvio padrao do ruido gaussiano, em niveis de cinza
+    double impulsos;     // fracao dos pixels trocados por 0 ou 255 (sal e pimenta)
+    double iluminacao;   // queda relativa da luz do centro para os cantos, 0 a 1
+    String arq_padrao;   // padrao de luz lido do arquivo no lugar do gerado
+    uint64 semente;
+    int quadros;         // quadros da fonte sintetica do stream
+    int ciclo;           // quadros distintos desenhados e repetidos pela fonte
+
+    ParametrosCena() : tamanho(2048, 1536), densidade(100), tamanho_min(48), tamanho_max(80), sobreposicao(0),
+                       ruido(4), impulsos(0), iluminacao(0.4), semente(1), quadros(300), ciclo(8) {}
+};
+
+/**
+ * Rotulo verdadeiro de uma peca desenhada
+ */
+struct ObjetoGerado
+{
+    int classe;        // ClasseGerada
+    Point2f centro;
+    float angulo;      // graus
+    int tamanho;       // maior dimensao, em pixels
+    int area;          // pixels da peca, sem descontar as que a cobrem
+    Rect caixa;        // retangulo envolvente, recortado no quadro
+    bool sobreposto;   // toca ou cobre outra peca
+
+    ObjetoGerado() : classe(0), angulo(0), tamanho(0), area(0), sobreposto(false) {}
+};
+
+class GeradorCenas
+{
+public:
+    GeradorCenas();
+
+    /**
+     * Prepara o padrao de luz dos parametros
+     * @return bool false se o arquivo de padrao nao pode ser lido ou os parametros sao invalidos
+     */
+    bool define(const ParametrosCena &parametros);
+
+    const ParametrosCena &parametros() const;
+
+    /**
+     * Fundo sem pecas nem ruido, CV_8UC1 do tamanho dos quadros; e o padrao a passar para removeFundo
+     */
+    const Mat &padrao() const;
+
+    /**
+     * Desenha o quadro i
+     *
+     * @param int64 indice - numero do quadro; o mesmo indice gera sempre o mesmo quadro
+     * @param Mat quadro - saida CV_8UC1
+     * @param vector<ObjetoGerado> objetos - saida opcional com o rotulo de cada peca
+     */
+    void gera(int64 indice, Mat &quadro, vector<ObjetoGerado> *objetos = NULL) const;
+
+private:
+    ParametrosCena param;
+    Mat fundo;
+};
+
+/**
+ * Le os parametros no formato chave=valor separados por virgula, ex.
+ * "size=5472x3648,density=60,overlap=0.1,noise=4,light=0.4,seed=1"
+ *
+ * Chaves: size (LxA), density, minSize, maxSize, overlap, noise, impulse,
+ * light, pattern (arquivo), seed, frames, cycle. As que faltam ficam com o
+ * valor de ParametrosCena().
+ *
+ * @return bool false com uma chave desconhecida ou um valor invalido
+ */
+bool interpretaParametrosCena(const String &texto, ParametrosCena &parametros);
+
+/**
+ * Nome da classe em minusculas (porca, arruela, parafuso)
+ */
+String nomeClasseGerada(int classe);
+
+#endif
@@ -0,0 +1,198 @@
+#include "Histograma.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <vector>
+using namespace std;
+
+#include "opencv2/core/utility.hpp"
+
+// Pixels por faixa do calculo em paralelo; imagens pequenas ficam numa faixa so
+static const int PIXELS_POR_FAIXA = 1 << 16;
+
+// Conta as linhas [inicio, fim) de passo em passo em 4 tabelas intercaladas de 256 contadores
+static void contaLinhas(const Mat &img, int inicio, int fim, int passo, int *tabelas)
+{
+    int *h0 = tabelas, *h1 = tabelas + 256, *h2 = tabelas + 512, *h3 = tabelas + 768;
+    for (int y = inicio; y < fim; y += passo)
+    {
+        const uchar *p = img.ptr<uchar>(y);
+        int x = 0;
+        for (; x <= img.cols - 4; x += 4)
+        {
+            h0[p[x]]++;
+            h1[p[x + 1]]++;
+            h2[p[x + 2]]++;
+            h3[p[x + 3]]++;
+        }
+        for (; x < img.cols; x++)
+            h0[p[x]]++;
+    }
+}
+
+void calculaHistograma(const Mat &img, int histograma[256], int passo_linhas)
+{
+    CV_Assert(img.type() == CV_8UC1);
+
+    fill(histograma, histograma + 256, 0);
+    int passo = max(1, passo_linhas);
+    int linhas = (img.rows + passo - 1) / passo;
+    if (linhas == 0 || img.cols == 0)
+        return;
+
+    // Cada faixa tem as suas tabelas; a soma no fim nao depende da ordem das faixas
+    int linhas_por_faixa = max(1, PIXELS_POR_FAIXA / img.cols);
+    int num_faixas = (linhas + linhas_por_faixa - 1) / linhas_por_faixa;
+    vector<int> tabelas((size_t)num_faixas * 1024, 0);
+
+    parallel_for_(Range(0, num_faixas), [&](const Range &faixas) {
+        for (int f = faixas.start; f < faixas.end; f++)
+        {
+            int inicio = f * linhas_por_faixa * passo;
+            int fim = min(img.rows, min(linhas, (f + 1) * linhas_por_faixa) * passo);
+            contaLinhas(img, inicio, fim, passo, &tabelas[(size_t)f * 1024]);
+        }
+    });
+
+    for (int f = 0; f < num_faixas; f++)
+    {
+        const int *t = &tabelas[(size_t)f * 1024];
+        for (int i = 0; i < 256; i++)
+            histograma[i] += t[i] + t[256 + i] + t[512 + i] + t[768 + i];
+    }
+}
+
+int limiarOtsu(const int histograma[256])
+{
+    double total = 0, mu = 0;
+    for (int i = 0; i < 256; i++)
+    {
+        total += histograma[i];
+        mu += i * (double)histograma[i];
+    }
+    if (total == 0)
+        return 0;
+    mu /= total;
+
+    // Mesmo laco do getThreshVal_Otsu_8u do OpenCV
+    const double eps = FLT_EPSILON;
+    double q1 = 0, mu1 = 0, max_sigma = 0;
+    int limiar = 0;
+    for (int i = 0; i < 256; i++)
+    {
+        double p_i = histograma[i] / total;
+        mu1 *= q1;
+        q1 += p_i;
+        double q2 = 1. - q1;
+
+        if (std::min(q1, q2) < eps || std::max(q1, q2) > 1. - eps)
+            continue;
+
+        mu1 = (mu1 + i * p_i) / q1;
+        double mu2 = (mu - q1 * mu1) / q2;
+        double sigma = q1 * q2 * (mu1 - mu2) * (mu1 - mu2);
+        if (sigma > max_sigma)
+        {
+            max_sigma = sigma;
+            limiar = i;
+        }
+    }
+
+    return limiar;
+}
+
+int limiarTriangulo(const int histograma[256])
+{
+    int h[256];
+    copy(histograma, histograma + 256, h);
+
+    int esquerda = 0, direita = 0, pico = 0, maximo = 0;
+    for (int i = 0; i < 256; i++)
+    {
+        if (h[i] > 0)
+        {
+            esquerda = i;
+            break;
+        }
+    }
+    if (esquerda > 0)
+        esquerda--;
+
+    for (int i = 255; i > 0; i--)
+    {
+        if (h[i] > 0)
+        {
+            direita = i;
+            break;
+        }
+    }
+    if (direita < 255)
+        direita++;
+
+    for (int i = 0; i < 256; i++)
+    {
+        if (h[i] > maximo)
+        {
+            maximo = h[i];
+            pico = i;
+        }
+    }
+
+    // A cauda mais longa fica a esquerda do pico
+    bool invertido = false;
+    if (pico - esquerda < direita - pico)
+    {
+        invertido = true;
+        reverse(h, h + 256);
+        esquerda = 255 - direita;
+        pico = 255 - pico;
+    }
+
+    // Nivel mais distante da reta entre (esquerda, 0) e (pico, maximo)
+    int limiar = esquerda;
+    double a = maximo, b = esquerda - pico, distancia = 0;
+    for (int i = esquerda + 1; i <= pico; i++)
+    {
+        double d = a * i + b * h[i];
+        if (d > distancia)
+        {
+            distancia = d;
+            limiar = i;
+        }
+    }
+    limiar--;
+
+    return invertido ? 255 - limiar : limiar;
+}
+
+int limiarPercentil(const int histograma[256], double percentil)
+{
+    double total = 0;
+    for (int i = 0; i < 256; i++)
+        total += histograma[i];
+
+    double alvo = total * min(100.0, max(0.0, percentil)) / 100.0;
+    double acumulado = 0;
+    for (int i = 0; i < 256; i++)
+    {
+        acumulado += histograma[i];
+        if (acumulado >= alvo)
+            return i;
+    }
+    return 255;
+}
+
+int escolheLimiar(const Mat &img, int metodo, double percentil)
+{
+    if (metodo != LIMIAR_OTSU && metodo != LIMIAR_TRIANGULO && metodo != LIMIAR_PERCENTIL)
+        return -1;
+
+    int histograma[256];
+    calculaHistograma(img, histograma, 2);
+
+    if (metodo == LIMIAR_OTSU)
+        return limiarOtsu(histograma);
+    if (metodo == LIMIAR_TRIANGULO)
+        return limiarTriangulo(histograma);
+    return limiarPercentil(histograma, percentil);
+}
@@ -0,0 +1,79 @@
+/**
+ * Histograma 8 bits e limiar automatico
+ *
+ * calculaHistograma conta os niveis de cinza de uma imagem CV_8UC1, ou de
+ * uma regiao dela (um Mat de ROI), em paralelo por faixas de linhas. Cada
+ * faixa conta em 4 tabelas intercaladas (os pixels 0, 1, 2 e 3 de cada
+ * grupo de 4 vao para tabelas diferentes), assim pixels iguais seguidos,
+ * o caso comum no fundo, nao esperam o incremento anterior do mesmo
+ * contador. As tabelas sao somadas no fim. A contagem e escalar, sem SIMD:
+ * espalhar pixels em 256 contadores nao cabe nas lanes de um vetor, e o
+ * gargalo e o incremento repetido do mesmo contador, que as tabelas
+ * intercaladas ja resolvem.
+ *
+ * Sobre o histograma, limiarOtsu, limiarTriangulo e limiarPercentil
+ * escolhem o limiar de cada quadro, acompanhando a variacao de iluminacao
+ * da linha. Dado o mesmo histograma, Otsu e triangulo dao o limiar de
+ * THRESH_OTSU e THRESH_TRIANGLE do OpenCV. Aqui so o limiar e escolhido;
+ * o lado que e objeto fica com quem binariza (no AOI_PDI, acima do limiar
+ * com lightMethod 0 e 1 e abaixo dele com lightMethod 2, THRESH_BINARY_INV).
+ *
+ * Para a escolha do limiar basta uma linha a cada 2: o histograma le meia
+ * imagem, entao histograma, escolha e binarizacao custam menos que uma
+ * passada a mais sobre o quadro. Por isso o limiar de escolheLimiar pode
+ * diferir do THRESH_OTSU/THRESH_TRIANGLE aplicado ao quadro inteiro.
+ *
+ */
+
+#ifndef HISTOGRAMA_h
+#define HISTOGRAMA_h
+
+// OpenCV includes
+#include "opencv2/core.hpp"
+using namespace cv;
+
+/**
+ * Metodos de escolha do limiar de binarizacao
+ */
+enum MetodoLimiar
+{
+    LIMIAR_FIXO = 0,      // limiar do programa (ex. 30)
+    LIMIAR_OTSU = 1,      // maior variancia entre as duas classes
+    LIMIAR_TRIANGULO = 2, // maior distancia da reta entre o pico e a ponta da cauda
+    LIMIAR_PERCENTIL = 3  // nivel abaixo do qual fica a porcentagem pedida dos pixels
+};
+
+/**
+ * Histograma de uma imagem ou regiao
+ * @param Mat img - imagem CV_8UC1, pode ser uma ROI
+ * @param int histograma - saida com as contagens dos 256 niveis
+ * @param int passo_linhas - conta so uma linha a cada passo_linhas
+ */
+void calculaHistograma(const Mat &img, int histograma[256], int passo_linhas = 1);
+
+/**
+ * Limiar de Otsu; sobre o histograma da imagem inteira, igual ao THRESH_OTSU do OpenCV
+ */
+int limiarOtsu(const int histograma[256]);
+
+/**
+ * Limiar do triangulo; sobre o histograma da imagem inteira, igual ao THRESH_TRIANGLE do OpenCV
+ */
+int limiarTriangulo(const int histograma[256]);
+
+/**
+ * Menor nivel com pelo menos `percentil` % dos pixels nele ou abaixo
+ * @param double percentil - porcentagem de pixels de fundo, 0 a 100
+ */
+int limiarPercentil(const int histograma[256], double percentil);
+
+/**
+ * Escolhe o limiar de uma imagem, com o histograma de uma linha a cada 2
+ * @param Mat img - imagem CV_8UC1
+ * @param int metodo - LIMIAR_OTSU, LIMIAR_TRIANGULO ou LIMIAR_PERCENTIL
+ * @param double percentil - usado por LIMIAR_PERCENTIL
+ * @return int limiar, ou -1 com LIMIAR_FIXO ou metodo desconhecido
+ */
+int escolheLimiar(const Mat &img, int metodo, double percentil);
+
+#endif
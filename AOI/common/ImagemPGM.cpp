@@ -0,0 +1,452 @@
+#include "ImagemPGM.h"
+#include "Instrumentacao.h"
+
+#include <algorithm>
+#include <cctype>
+#include <climits>
+#include <cstdio>
+#include <fstream>
+#include <filesystem>
+
+#include "opencv2/imgcodecs.hpp"
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#if CV_VERSION_MAJOR >= 4
+typedef AccessFlag FlagAcesso;
+typedef UMatUsageFlags FlagUso;
+#else
+typedef int FlagAcesso;
+typedef UMatUsageFlags FlagUso;
+#endif
+
+// Desfaz o mapeamento quando o ultimo Mat que aponta para ele e liberado
+class AlocadorMapeamento : public MatAllocator
+{
+public:
+    // Mats que sao realocados (create) passam a usar o alocador padrao
+    UMatData *allocate(int dims, const int *tamanhos, int tipo, void *dados, size_t *passo, FlagAcesso flags,
+                       FlagUso uso) const override
+    {
+        return Mat::getDefaultAllocator()->allocate(dims, tamanhos, tipo, dados, passo, flags, uso);
+    }
+
+    bool allocate(UMatData *u, FlagAcesso flags, FlagUso uso) const override
+    {
+        return Mat::getDefaultAllocator()->allocate(u, flags, uso);
+    }
+
+    void deallocate(UMatData *u) const override
+    {
+        if (u == NULL)
+            return;
+#ifdef _WIN32
+        UnmapViewOfFile(u->origdata);
+#else
+        munmap(u->origdata, u->size);
+#endif
+        delete u;
+    }
+};
+
+static AlocadorMapeamento alocador_mapeamento;
+
+// Bytes lidos do inicio do arquivo para conferir o cabecalho antes de mapear
+static const size_t TAMANHO_LEITURA_CABECALHO = 512;
+
+static size_t tamanhoDeclaradoPGM(const uchar *inicio, size_t lidos);
+
+Mat mapeiaArquivo(const String &arquivo)
+{
+    MEDE_ETAPA("leitura");
+    uchar *dados = NULL;
+    size_t tamanho = 0;
+
+#ifdef _WIN32
+    HANDLE h = CreateFileA(arquivo.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+    if (h == INVALID_HANDLE_VALUE)
+        return Mat();
+    uchar cabecalho[TAMANHO_LEITURA_CABECALHO];
+    DWORD lidos = 0;
+    if (!ReadFile(h, cabecalho, sizeof(cabecalho), &lidos, NULL))
+        lidos = 0;
+    LARGE_INTEGER tamanho_arquivo;
+    if (GetFileSizeEx(h, &tamanho_arquivo) && tamanho_arquivo.QuadPart > 0 && tamanho_arquivo.QuadPart <= INT_MAX &&
+        (size_t)tamanho_arquivo.QuadPart >= tamanhoDeclaradoPGM(cabecalho, lidos))
+    {
+        tamanho = (size_t)tamanho_arquivo.QuadPart;
+        HANDLE mapa = CreateFileMappingA(h, NULL, PAGE_WRITECOPY, 0, 0, NULL);
+        if (mapa != NULL)
+        {
+            dados = (uchar *)MapViewOfFile(mapa, FILE_MAP_COPY, 0, 0, tamanho);
+            // A vista mantem o arquivo aberto sozinha
+            CloseHandle(mapa);
+        }
+    }
+    CloseHandle(h);
+#else
+    int fd = open(arquivo.c_str(), O_RDONLY);
+    if (fd < 0)
+        return Mat();
+    uchar cabecalho[TAMANHO_LEITURA_CABECALHO];
+    ssize_t lidos = pread(fd, cabecalho, sizeof(cabecalho), 0);
+    // Um P5 ja truncado nao e mapeado: os pixels que faltam dariam SIGBUS em vez de erro
+    struct stat info;
+    if (fstat(fd, &info) == 0 && info.st_size > 0 && info.st_size <= INT_MAX &&
+        (size_t)info.st_size >= tamanhoDeclaradoPGM(cabecalho, lidos > 0 ? (size_t)lidos : 0))
+    {
+        tamanho = (size_t)info.st_size;
+        void *mapa = mmap(NULL, tamanho, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+        if (mapa != MAP_FAILED)
+        {
+            dados = (uchar *)mapa;
+#ifdef MADV_WILLNEED
+            // Leitura antecipada em segundo plano; as faltas de pagina depois encontram os dados no cache
+            madvise(mapa, tamanho, MADV_WILLNEED);
+#endif
+        }
+    }
+    close(fd);
+#endif
+
+    if (dados == NULL)
+        return Mat();
+
+    // Mesmo esquema do alocador do numpy no OpenCV: o Mat aponta para o mapeamento e o UMatData o desfaz no fim
+    Mat bytes(1, (int)tamanho, CV_8UC1, dados);
+    UMatData *u = new UMatData(&alocador_mapeamento);
+    u->data = u->origdata = dados;
+    u->size = tamanho;
+    bytes.u = u;
+    bytes.addref();
+    return bytes;
+}
+
+// Campos do cabecalho PGM e posicao do primeiro pixel
+struct CabecalhoPGM
+{
+    bool binario;
+    int largura;
+    int altura;
+    int maximo;
+    size_t inicio_dados;
+};
+
+// Le um numero do cabecalho, pulando espacos e comentarios
+static bool leNumeroPGM(const uchar *&p, const uchar *fim, int &valor)
+{
+    while (p < fim && (isspace(*p) || *p == '#'))
+    {
+        if (*p == '#')
+        {
+            while (p < fim && *p != '\n')
+                p++;
+        }
+        else
+        {
+            p++;
+        }
+    }
+    if (p == fim || !isdigit(*p))
+        return false;
+
+    long long v = 0;
+    while (p < fim && isdigit(*p))
+    {
+        v = v * 10 + (*p++ - '0');
+        if (v > INT_MAX)
+            return false;
+    }
+    valor = (int)v;
+    return true;
+}
+
+static bool leCabecalhoPGM(const Mat &bytes, CabecalhoPGM &cabecalho)
+{
+    if (bytes.empty() || bytes.type() != CV_8UC1 || !bytes.isContinuous() || bytes.total() < 2)
+        return false;
+
+    const uchar *inicio = bytes.ptr<uchar>(0);
+    const uchar *fim = inicio + bytes.total();
+    if (inicio[0] != 'P' || (inicio[1] != '5' && inicio[1] != '2'))
+        return false;
+    cabecalho.binario = inicio[1] == '5';
+
+    const uchar *p = inicio + 2;
+    if (!leNumeroPGM(p, fim, cabecalho.largura) || !leNumeroPGM(p, fim, cabecalho.altura) ||
+        !leNumeroPGM(p, fim, cabecalho.maximo))
+        return false;
+    if (cabecalho.largura <= 0 || cabecalho.altura <= 0 || cabecalho.maximo <= 0 || cabecalho.maximo > 65535)
+        return false;
+
+    // Um unico espaco separa o cabecalho dos pixels
+    if (p == fim || !isspace(*p))
+        return false;
+    cabecalho.inicio_dados = (size_t)(p + 1 - inicio);
+    return true;
+}
+
+// Tamanho que o cabecalho de um P5 exige do arquivo; 0 se nao e um P5 ou o cabecalho nao coube nos bytes lidos
+static size_t tamanhoDeclaradoPGM(const uchar *inicio, size_t lidos)
+{
+    CabecalhoPGM cabecalho;
+    if (lidos == 0 || !leCabecalhoPGM(Mat(1, (int)lidos, CV_8UC1, (void *)inicio), cabecalho) || !cabecalho.binario)
+        return 0;
+    size_t bytes_pixel = cabecalho.maximo > 255 ? 2 : 1;
+    return cabecalho.inicio_dados + (size_t)cabecalho.largura * cabecalho.altura * bytes_pixel;
+}
+
+// P2: numeros separados por espacos, saturados no maxval como no imread
+static bool leDadosASCII(const uchar *p, const uchar *fim, const CabecalhoPGM &cabecalho, Mat &img)
+{
+    bool dezesseis_bits = cabecalho.maximo > 255;
+    img.create(cabecalho.altura, cabecalho.largura, dezesseis_bits ? CV_16UC1 : CV_8UC1);
+
+    for (int y = 0; y < img.rows; y++)
+    {
+        uchar *linha8 = img.ptr<uchar>(y);
+        ushort *linha16 = img.ptr<ushort>(y);
+        for (int x = 0; x < img.cols; x++)
+        {
+            int valor;
+            if (!leNumeroPGM(p, fim, valor))
+                return false;
+            valor = min(valor, cabecalho.maximo);
+            if (dezesseis_bits)
+                linha16[x] = (ushort)valor;
+            else
+                linha8[x] = (uchar)valor;
+        }
+    }
+    return true;
+}
+
+bool decodificaPGM(const Mat &bytes, Mat &img)
+{
+    MEDE_ETAPA("decodificacao");
+    CabecalhoPGM cabecalho;
+    if (!leCabecalhoPGM(bytes, cabecalho))
+        return false;
+
+    const uchar *dados = bytes.ptr<uchar>(0) + cabecalho.inicio_dados;
+    const uchar *fim = bytes.ptr<uchar>(0) + bytes.total();
+    if (!cabecalho.binario)
+        return leDadosASCII(dados, fim, cabecalho, img);
+
+    size_t pixels = (size_t)cabecalho.largura * cabecalho.altura;
+    size_t bytes_pixel = cabecalho.maximo > 255 ? 2 : 1;
+    if ((size_t)(fim - dados) < pixels * bytes_pixel)
+        return false;
+
+    if (bytes_pixel == 1)
+    {
+        // Vista dos pixels dentro dos bytes do arquivo, com a mesma referencia ao mapeamento
+        int inicio = (int)cabecalho.inicio_dados;
+        img = bytes.colRange(inicio, inicio + (int)pixels).reshape(1, cabecalho.altura);
+        return true;
+    }
+
+    // 16 bits big-endian; sem alinhamento de 2 bytes a vista nao e possivel e os pixels sao copiados
+    uchar *origem = (uchar *)dados;
+    bool alinhado = ((size_t)origem & 1) == 0;
+    Mat saida;
+    if (alinhado)
+    {
+        saida = bytes.colRange((int)cabecalho.inicio_dados, (int)(cabecalho.inicio_dados + 2 * pixels))
+                    .reshape(1, cabecalho.altura);
+        // Mesmo buffer visto como CV_16UC1, compartilhando a referencia ao mapeamento
+        Mat vista(cabecalho.altura, cabecalho.largura, CV_16UC1, origem);
+        vista.u = saida.u;
+        vista.addref();
+        saida = vista;
+    }
+    else
+    {
+        saida.create(cabecalho.altura, cabecalho.largura, CV_16UC1);
+    }
+
+    ushort *destino = saida.ptr<ushort>(0);
+    for (size_t i = 0; i < pixels; i++)
+        destino[i] = (ushort)((origem[2 * i] << 8) | origem[2 * i + 1]);
+
+    img = saida;
+    return true;
+}
+
+Mat lePGM(const String &arquivo)
+{
+    Mat img;
+    if (!decodificaPGM(mapeiaArquivo(arquivo), img))
+        return Mat();
+    return img;
+}
+
+Mat decodificaImagemCinza(const Mat &bytes)
+{
+    // So com maxval 255 os valores sao os mesmos do imread; os outros casos ficam com o OpenCV
+    CabecalhoPGM cabecalho;
+    Mat img;
+    if (leCabecalhoPGM(bytes, cabecalho) && cabecalho.maximo == 255 && decodificaPGM(bytes, img))
+        return img;
+
+    MEDE_ETAPA("decodificacao");
+    return bytes.empty() ? Mat() : imdecode(bytes, IMREAD_GRAYSCALE);
+}
+
+Mat leImagemCinza(const String &arquivo)
+{
+    Mat bytes = mapeiaArquivo(arquivo);
+    if (bytes.empty())
+        return imread(arquivo, IMREAD_GRAYSCALE);
+    return decodificaImagemCinza(bytes);
+}
+
+bool gravaPGM(const String &arquivo, const Mat &img)
+{
+    MEDE_ETAPA("gravacao");
+    CV_Assert(img.type() == CV_8UC1 || img.type() == CV_16UC1);
+
+    // Reescrever o destino no lugar truncaria o arquivo sob quem o tem mapeado
+    String temporario = arquivo + ".tmp";
+    FILE *f = fopen(temporario.c_str(), "wb");
+    if (f == NULL)
+        return false;
+
+    bool dezesseis_bits = img.type() == CV_16UC1;
+    bool ok = fprintf(f, "P5\n%d %d\n%d\n", img.cols, img.rows, dezesseis_bits ? 65535 : 255) > 0;
+
+    if (!dezesseis_bits && img.isContinuous())
+    {
+        ok = ok && fwrite(img.ptr<uchar>(0), 1, img.total(), f) == img.total();
+    }
+    else
+    {
+        // ROIs linha a linha; 16 bits vao para o arquivo em big-endian
+        vector<uchar> linha(img.cols * img.elemSize());
+        for (int y = 0; ok && y < img.rows; y++)
+        {
+            const uchar *origem = img.ptr<uchar>(y);
+            if (dezesseis_bits)
+            {
+                const ushort *valores = img.ptr<ushort>(y);
+                for (int x = 0; x < img.cols; x++)
+                {
+                    linha[2 * x] = (uchar)(valores[x] >> 8);
+                    linha[2 * x + 1] = (uchar)(valores[x] & 255);
+                }
+                origem = linha.data();
+            }
+            ok = fwrite(origem, 1, linha.size(), f) == linha.size();
+        }
+    }
+
+    ok = fclose(f) == 0 && ok;
+
+    std::error_code erro;
+    if (ok)
+        std::filesystem::rename(temporario.c_str(), arquivo.c_str(), erro);
+    if (!ok || erro)
+    {
+        std::filesystem::remove(temporario.c_str(), erro);
+        return false;
+    }
+    return true;
+}
+
+bool formatoSequenciaValido(const String &sequencia)
+{
+    int campos = 0;
+    for (size_t i = 0; i < sequencia.size(); i++)
+    {
+        if (sequencia[i] != '%')
+            continue;
+        i++;
+        if (i < sequencia.size() && sequencia[i] == '%')
+            continue;
+
+        // Flags, largura e precisao; '*' e modificadores de tamanho pediriam outros argumentos
+        while (i < sequencia.size() && String("-+ #0").find(sequencia[i]) != String::npos)
+            i++;
+        while (i < sequencia.size() && isdigit((uchar)sequencia[i]))
+            i++;
+        if (i < sequencia.size() && sequencia[i] == '.')
+        {
+            i++;
+            while (i < sequencia.size() && isdigit((uchar)sequencia[i]))
+                i++;
+        }
+        if (i == sequencia.size() || String("diuoxX").find(sequencia[i]) == String::npos)
+            return false;
+        campos++;
+    }
+    return campos == 1;
+}
+
+static bool arquivoExiste(const String &arquivo)
+{
+    ifstream f(arquivo.c_str());
+    return f.good();
+}
+
+SequenciaPGM::SequenciaPGM() : proximo(0)
+{
+}
+
+bool SequenciaPGM::abre(const String &sequencia)
+{
+    arquivos.clear();
+    proximo = 0;
+    proximo_mapeado.release();
+
+    if (!formatoSequenciaValido(sequencia))
+        return false;
+
+    int indice = arquivoExiste(format(sequencia.c_str(), 0)) ? 0 : 1;
+    for (;; indice++)
+    {
+        String arquivo = format(sequencia.c_str(), indice);
+        if (!arquivoExiste(arquivo))
+            break;
+        arquivos.push_back(arquivo);
+    }
+
+    if (!arquivos.empty())
+        proximo_mapeado = mapeiaArquivo(arquivos[0]);
+    return !arquivos.empty();
+}
+
+bool SequenciaPGM::le(Mat &quadro)
+{
+    if (proximo >= arquivos.size())
+        return false;
+
+    Mat bytes = proximo_mapeado;
+    proximo++;
+    // O quadro seguinte ja comeca a ser lido do disco enquanto este e processado
+    proximo_mapeado = proximo < arquivos.size() ? mapeiaArquivo(arquivos[proximo]) : Mat();
+
+    quadro = bytes.empty() ? imread(arquivos[proximo - 1], IMREAD_GRAYSCALE) : decodificaImagemCinza(bytes);
+    return !quadro.empty();
+}
+
+int SequenciaPGM::numQuadros() const
+{
+    return (int)arquivos.size();
+}
+
+bool ehSequenciaPGM(const String &fonte)
+{
+    if (fonte.size() < 4 || !formatoSequenciaValido(fonte))
+        return false;
+    String extensao = fonte.substr(fonte.size() - 4);
+    transform(extensao.begin(), extensao.end(), extensao.begin(), ::tolower);
+    return extensao == ".pgm";
+}
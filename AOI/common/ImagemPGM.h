@@ -0,0 +1,133 @@
+/**
+ * Leitura e gravacao de PGM sem copia
+ *
+ * O arquivo inteiro e mapeado na memoria (mmap, ou MapViewOfFile no
+ * Windows) em modo copy-on-write, e os pixels de um PGM binario (P5) viram
+ * um Mat que aponta direto para o mapeamento: carregar um quadro custa so
+ * as faltas de pagina na primeira leitura dos pixels. O Mat guarda uma
+ * referencia ao mapeamento, que so e desfeito quando a ultima copia do Mat
+ * (ou de uma ROI dele) e liberada; escrever nos pixels nao altera o arquivo.
+ *
+ * - P5 com maxval ate 255: CV_8UC1, sem copia
+ * - P5 com maxval acima de 255: CV_16UC1; os pixels sao big-endian no arquivo
+ *   e sao trocados no proprio mapeamento (as paginas tocadas viram privadas)
+ * - P2 (ASCII), como o padrao de luz e as sequencias do dataset: os numeros
+ *   sao lidos do mapeamento para um Mat novo, sem passar pelo imread
+ *
+ * Os valores sao os do arquivo, sem reescalar para 255. leImagemCinza usa
+ * esse caminho so quando o resultado e identico ao de imread em cinza
+ * (maxval 255) e cai para o imread nos outros casos e formatos.
+ *
+ * O arquivo nao pode ser truncado nem reescrito no lugar enquanto algum Mat
+ * aponta para o mapeamento: no Linux, ler uma pagina que ficou alem do novo
+ * fim do arquivo gera SIGBUS. Um PGM menor que o tamanho do cabecalho nao e
+ * mapeado, e gravaPGM grava num arquivo temporario e renomeia, entao quem ja
+ * mapeou continua com o conteudo antigo.
+ *
+ */
+
+#ifndef IMAGEM_PGM_h
+#define IMAGEM_PGM_h
+
+#include <string>
+#include <vector>
+using namespace std;
+
+// OpenCV includes
+#include "opencv2/core.hpp"
+using namespace cv;
+
+/**
+ * Mapeia um arquivo inteiro na memoria e pede a leitura antecipada das paginas
+ *
+ * O arquivo nao deve mudar enquanto estiver mapeado (veja acima).
+ *
+ * @param String arquivo - arquivo a mapear, ate 2 GB
+ * @return Mat 1 x N CV_8UC1 com os bytes do arquivo, vazio se nao pode ser mapeado
+ *         ou se e um PGM P5 menor que o tamanho declarado no cabecalho
+ */
+Mat mapeiaArquivo(const String &arquivo);
+
+/**
+ * Decodifica um PGM (P5 ou P2) a partir dos bytes do arquivo
+ *
+ * @param Mat bytes - bytes do arquivo, por exemplo de mapeiaArquivo
+ * @param Mat img - saida CV_8UC1 ou CV_16UC1; em P5 8 bits e uma vista de bytes, sem copia
+ * @return bool false se nao e um PGM valido ou esta truncado
+ */
+bool decodificaPGM(const Mat &bytes, Mat &img);
+
+/**
+ * mapeiaArquivo + decodificaPGM
+ * @return Mat imagem, vazia se o arquivo nao e um PGM legivel
+ */
+Mat lePGM(const String &arquivo);
+
+/**
+ * Decodifica uma imagem em cinza 8 bits: PGM com maxval 255 por decodificaPGM, o resto por imdecode
+ */
+Mat decodificaImagemCinza(const Mat &bytes);
+
+/**
+ * Substituto de imread(arquivo, IMREAD_GRAYSCALE) com o mesmo resultado, sem copia para PGM P5
+ */
+Mat leImagemCinza(const String &arquivo);
+
+/**
+ * Grava um PGM binario (P5) com uma unica escrita por imagem continua, num
+ * arquivo temporario que depois substitui o destino
+ * @param Mat img - imagem CV_8UC1 ou CV_16UC1
+ * @return bool false se o arquivo nao pode ser gravado
+ */
+bool gravaPGM(const String &arquivo, const Mat &img);
+
+/**
+ * Confere se o caminho de uma sequencia pode ir para format(): exatamente um
+ * campo de inteiro (%d, %i, %u, %o, %x ou %X, com flags, largura e precisao
+ * opcionais), alem de %% literais
+ * @param String sequencia - caminho com o campo printf, ex. tuerca_%04d.pgm
+ * @return bool false para qualquer outro campo, campos a mais ou nenhum
+ */
+bool formatoSequenciaValido(const String &sequencia);
+
+/**
+ * Sequencia de quadros PGM numerados no estilo printf (ex. tuerca_%04d.pgm)
+ *
+ * Comeca no indice 0 ou 1 e para no primeiro numero que falta, como o
+ * VideoCapture faz com sequencias de imagens. O quadro seguinte ja fica
+ * mapeado, com a leitura antecipada pedida, enquanto o atual e processado.
+ */
+class SequenciaPGM
+{
+public:
+    SequenciaPGM();
+
+    /**
+     * @param String sequencia - caminho com um campo printf de inteiro
+     * @return bool false se o formato nao passa em formatoSequenciaValido ou nenhum quadro existe
+     */
+    bool abre(const String &sequencia);
+
+    /**
+     * Le o proximo quadro em cinza 8 bits
+     * @return bool false no fim da sequencia ou com um arquivo ilegivel
+     */
+    bool le(Mat &quadro);
+
+    /**
+     * Numero de quadros encontrados por abre()
+     */
+    int numQuadros() const;
+
+private:
+    vector<String> arquivos;
+    size_t proximo;
+    Mat proximo_mapeado;
+};
+
+/**
+ * @return bool true se a fonte e uma sequencia de arquivos PGM (formato valido e extensao .pgm)
+ */
+bool ehSequenciaPGM(const String &fonte);
+
+#endif
@@ -0,0 +1,171 @@
+#include "Instrumentacao.h"
+
+#include <iomanip>
+#include <sstream>
+#include <limits>
+#include <cmath>
+#include <cstring>
+#include <cstdlib>
+#include <mutex>
+#include <thread>
+#include <chrono>
+#include <condition_variable>
+
+// Faixa 0: ate 1 us; faixa b > 0: [2^((b-1)/8), 2^(b/8)) us; a ultima acumula o resto
+static const int FAIXAS_POR_OITAVA = 8;
+static const int NUM_FAIXAS = 1 + FAIXAS_POR_OITAVA * 28;
+static const int MAX_ETAPAS = 64;
+
+struct EstatisticaEtapa
+{
+    char nome[48];
+    atomic<uint64_t> chamadas;
+    atomic<int64> ticks_total;
+    atomic<int64> ticks_min;
+    atomic<int64> ticks_max;
+    atomic<uint64_t> faixas[NUM_FAIXAS];
+};
+
+static EstatisticaEtapa etapas[MAX_ETAPAS];
+static atomic<int> num_etapas(0);
+static mutex trava_registro;
+
+static mutex trava_periodico;
+static condition_variable acorda_periodico;
+static thread thread_periodico;
+static bool parar_periodico = false;
+static int64 tick_inicio = 0;
+
+atomic<bool> Instrumentacao::ligada(false);
+
+static int faixaDe(double us)
+{
+    if (us <= 1)
+        return 0;
+    int faixa = 1 + (int)(FAIXAS_POR_OITAVA * log2(us));
+    return min(faixa, NUM_FAIXAS - 1);
+}
+
+// Centro geometrico da faixa, em ms
+static double centroFaixaMs(int faixa)
+{
+    if (faixa == 0)
+        return 0.0005;
+    return pow(2.0, (faixa - 0.5) / FAIXAS_POR_OITAVA) / 1000.0;
+}
+
+static double percentilMs(const EstatisticaEtapa &e, uint64_t chamadas, double p, double min_ms, double max_ms)
+{
+    uint64_t alvo = (uint64_t)ceil(p * chamadas);
+    uint64_t acumulado = 0;
+    for (int f = 0; f < NUM_FAIXAS; f++)
+    {
+        acumulado += e.faixas[f].load(memory_order_relaxed);
+        if (acumulado >= alvo)
+            return std::max(min_ms, std::min(max_ms, centroFaixaMs(f)));
+    }
+    return max_ms;
+}
+
+static void encerra()
+{
+    {
+        lock_guard<mutex> lock(trava_periodico);
+        parar_periodico = true;
+    }
+    acorda_periodico.notify_all();
+    if (thread_periodico.joinable())
+        thread_periodico.join();
+
+    Instrumentacao::imprimeRelatorio(cout);
+}
+
+void Instrumentacao::inicia(double intervalo_s)
+{
+    if (ligada.exchange(true))
+        return;
+
+    tick_inicio = getTickCount();
+    atexit(encerra);
+
+    if (intervalo_s > 0)
+    {
+        thread_periodico = thread([intervalo_s]() {
+            unique_lock<mutex> lock(trava_periodico);
+            while (!acorda_periodico.wait_for(lock, chrono::duration<double>(intervalo_s), []() { return parar_periodico; }))
+                Instrumentacao::imprimeRelatorio(cout);
+        });
+    }
+}
+
+int Instrumentacao::etapa(const char *nome)
+{
+    lock_guard<mutex> lock(trava_registro);
+
+    int total = num_etapas.load();
+    for (int i = 0; i < total; i++)
+    {
+        if (strncmp(etapas[i].nome, nome, sizeof(etapas[i].nome) - 1) == 0)
+            return i;
+    }
+
+    // Sem espaco: as etapas extras dividem a ultima posicao
+    if (total == MAX_ETAPAS)
+        return MAX_ETAPAS - 1;
+
+    EstatisticaEtapa &e = etapas[total];
+    strncpy(e.nome, nome, sizeof(e.nome) - 1);
+    e.nome[sizeof(e.nome) - 1] = '\0';
+    e.ticks_min = numeric_limits<int64>::max();
+    num_etapas = total + 1;
+
+    return total;
+}
+
+void Instrumentacao::registra(int etapa, int64 ticks)
+{
+    EstatisticaEtapa &e = etapas[etapa];
+    double us = 1e6 * ticks / getTickFrequency();
+
+    e.chamadas.fetch_add(1, memory_order_relaxed);
+    e.ticks_total.fetch_add(ticks, memory_order_relaxed);
+    e.faixas[faixaDe(us)].fetch_add(1, memory_order_relaxed);
+
+    int64 atual = e.ticks_min.load(memory_order_relaxed);
+    while (ticks < atual && !e.ticks_min.compare_exchange_weak(atual, ticks, memory_order_relaxed))
+        ;
+    atual = e.ticks_max.load(memory_order_relaxed);
+    while (ticks > atual && !e.ticks_max.compare_exchange_weak(atual, ticks, memory_order_relaxed))
+        ;
+}
+
+void Instrumentacao::imprimeRelatorio(ostream &saida)
+{
+    double ms_por_tick = 1000.0 / getTickFrequency();
+    int total = num_etapas.load();
+
+    stringstream ss;
+    ss << "Tempo por etapa apos " << fixed << setprecision(1) << (getTickCount() - tick_inicio) * ms_por_tick / 1000.0 << " s (ms)" << endl;
+    ss << left << setw(24) << "etapa" << right << setw(10) << "chamadas" << setw(12) << "total" << setw(10) << "media"
+       << setw(10) << "p50" << setw(10) << "p95" << setw(10) << "p99" << setw(10) << "max" << endl;
+    ss << setprecision(3);
+    for (int i = 0; i < total; i++)
+    {
+        const EstatisticaEtapa &e = etapas[i];
+        uint64_t chamadas = e.chamadas.load(memory_order_relaxed);
+        if (chamadas == 0)
+            continue;
+
+        double total_ms = e.ticks_total.load(memory_order_relaxed) * ms_por_tick;
+        double min_ms = e.ticks_min.load(memory_order_relaxed) * ms_por_tick;
+        double max_ms = e.ticks_max.load(memory_order_relaxed) * ms_por_tick;
+        ss << left << setw(24) << e.nome << right << setw(10) << chamadas << setw(12) << total_ms << setw(10) << total_ms / chamadas
+           << setw(10) << percentilMs(e, chamadas, 0.50, min_ms, max_ms)
+           << setw(10) << percentilMs(e, chamadas, 0.95, min_ms, max_ms)
+           << setw(10) << percentilMs(e, chamadas, 0.99, min_ms, max_ms)
+           << setw(10) << max_ms << endl;
+    }
+
+    // Uma unica escrita para nao misturar com a saida de outras threads
+    saida << ss.str() << flush;
+}
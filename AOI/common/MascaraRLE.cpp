@@ -0,0 +1,173 @@
+#include "MascaraRLE.h"
+#include "Instrumentacao.h"
+
+#include <algorithm>
+#include <climits>
+using namespace std;
+
+#include "opencv2/imgproc.hpp"
+#include "opencv2/core/utility.hpp"
+
+// Pixels por faixa da binarizacao em paralelo; imagens pequenas ficam numa faixa so
+static const int PIXELS_POR_FAIXA = 1 << 16;
+
+void binarizaLinhaRLE(const uchar *linha, int n, int y, double limiar, int tipo_limiar, vector<CorridaRLE> &corridas)
+{
+    // threshold em 8 bits compara com o limiar arredondado para baixo
+    int t = cvFloor(limiar);
+    bool inverso = tipo_limiar == THRESH_BINARY_INV;
+
+    int x = 0;
+    while (x < n)
+    {
+        while (x < n && (linha[x] > t) == inverso)
+            x++;
+        if (x == n)
+            break;
+
+        CorridaRLE corrida;
+        corrida.linha = y;
+        corrida.inicio = x;
+        while (x < n && (linha[x] > t) != inverso)
+            x++;
+        corrida.fim = x;
+        corridas.push_back(corrida);
+    }
+}
+
+void montaRLE(int largura, int altura, const vector<vector<CorridaRLE>> &faixas, MascaraRLE &mascara)
+{
+    mascara.largura = largura;
+    mascara.altura = altura;
+
+    size_t total = 0;
+    for (size_t f = 0; f < faixas.size(); f++)
+        total += faixas[f].size();
+    mascara.corridas.clear();
+    mascara.corridas.reserve(total);
+    for (size_t f = 0; f < faixas.size(); f++)
+        mascara.corridas.insert(mascara.corridas.end(), faixas[f].begin(), faixas[f].end());
+
+    // Linhas sem corridas apontam para a primeira corrida da linha seguinte
+    mascara.inicio_linha.assign(altura + 1, 0);
+    for (size_t i = 0; i < mascara.corridas.size(); i++)
+        mascara.inicio_linha[mascara.corridas[i].linha + 1]++;
+    for (int y = 0; y < altura; y++)
+        mascara.inicio_linha[y + 1] += mascara.inicio_linha[y];
+}
+
+void binarizaRLE(const Mat &img, double limiar, int tipo_limiar, MascaraRLE &mascara)
+{
+    MEDE_ETAPA("limiar");
+    CV_Assert(img.type() == CV_8UC1);
+
+    int linhas_por_faixa = max(1, PIXELS_POR_FAIXA / max(1, img.cols));
+    int num_faixas = (img.rows + linhas_por_faixa - 1) / linhas_por_faixa;
+    vector<vector<CorridaRLE>> faixas(num_faixas);
+
+    parallel_for_(Range(0, num_faixas), [&](const Range &trecho) {
+        for (int f = trecho.start; f < trecho.end; f++)
+        {
+            int fim = min(img.rows, (f + 1) * linhas_por_faixa);
+            for (int y = f * linhas_por_faixa; y < fim; y++)
+                binarizaLinhaRLE(img.ptr<uchar>(y), img.cols, y, limiar, tipo_limiar, faixas[f]);
+        }
+    });
+
+    montaRLE(img.cols, img.rows, faixas, mascara);
+}
+
+void codificaRLE(const Mat &binaria, MascaraRLE &mascara)
+{
+    binarizaRLE(binaria, 0, THRESH_BINARY, mascara);
+}
+
+void decodificaRLE(const MascaraRLE &mascara, Mat &binaria)
+{
+    binaria = Mat::zeros(mascara.altura, mascara.largura, CV_8UC1);
+    for (size_t i = 0; i < mascara.corridas.size(); i++)
+    {
+        const CorridaRLE &c = mascara.corridas[i];
+        uchar *linha = binaria.ptr<uchar>(c.linha);
+        fill(linha + c.inicio, linha + c.fim, (uchar)255);
+    }
+}
+
+static int raiz(vector<int> &pai, int i)
+{
+    while (pai[i] != i)
+    {
+        pai[i] = pai[pai[i]];
+        i = pai[i];
+    }
+    return i;
+}
+
+int rotulaRLE(const MascaraRLE &mascara, vector<int> &rotulos, vector<ComponenteRLE> &componentes, int conectividade)
+{
+    MEDE_ETAPA("rotulacao");
+    const vector<CorridaRLE> &corridas = mascara.corridas;
+    int n = (int)corridas.size();
+
+    // Com vizinhanca 8 as corridas tambem se tocam pela diagonal
+    int folga = conectividade == 8 ? 1 : 0;
+
+    vector<int> pai(n);
+    for (int i = 0; i < n; i++)
+        pai[i] = i;
+
+    for (int y = 1; y < mascara.altura; y++)
+    {
+        int j = mascara.inicio_linha[y - 1], fim_anterior = mascara.inicio_linha[y];
+        for (int i = mascara.inicio_linha[y]; i < mascara.inicio_linha[y + 1]; i++)
+        {
+            // Corridas de cima que terminam antes desta tambem terminam antes das proximas
+            while (j < fim_anterior && corridas[j].fim + folga <= corridas[i].inicio)
+                j++;
+            for (int k = j; k < fim_anterior && corridas[k].inicio < corridas[i].fim + folga; k++)
+            {
+                // A raiz e sempre a primeira corrida do objeto
+                int a = raiz(pai, i), b = raiz(pai, k);
+                if (a < b)
+                    pai[b] = a;
+                else if (b < a)
+                    pai[a] = b;
+            }
+        }
+    }
+
+    // Rotulos na ordem da primeira corrida; a raiz de cada corrida ja foi rotulada antes dela
+    rotulos.resize(n);
+    int num_rotulos = 1;
+    for (int i = 0; i < n; i++)
+    {
+        int r = raiz(pai, i);
+        rotulos[i] = r == i ? num_rotulos++ : rotulos[r];
+    }
+
+    // Estatisticas somadas por corrida
+    componentes.assign(num_rotulos, ComponenteRLE());
+    vector<int> x_min(num_rotulos, INT_MAX), x_max(num_rotulos, -1), y_min(num_rotulos, INT_MAX), y_max(num_rotulos, -1);
+    vector<double> soma_x(num_rotulos, 0), soma_y(num_rotulos, 0);
+    for (int i = 0; i < n; i++)
+    {
+        const CorridaRLE &c = corridas[i];
+        int r = rotulos[i];
+        int comprimento = c.fim - c.inicio;
+        componentes[r].area += comprimento;
+        x_min[r] = min(x_min[r], c.inicio);
+        x_max[r] = max(x_max[r], c.fim - 1);
+        y_min[r] = min(y_min[r], c.linha);
+        y_max[r] = max(y_max[r], c.linha);
+        // Soma das colunas inicio, ..., fim - 1
+        soma_x[r] += (double)(c.inicio + c.fim - 1) * comprimento / 2;
+        soma_y[r] += (double)c.linha * comprimento;
+    }
+    for (int r = 1; r < num_rotulos; r++)
+    {
+        componentes[r].caixa = Rect(x_min[r], y_min[r], x_max[r] - x_min[r] + 1, y_max[r] - y_min[r] + 1);
+        componentes[r].centroide = Point2d(soma_x[r] / componentes[r].area, soma_y[r] / componentes[r].area);
+    }
+
+    return num_rotulos;
+}
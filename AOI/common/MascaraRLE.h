@@ -0,0 +1,115 @@
+/**
+ * Mascara binaria em corridas (run-length)
+ *
+ * Os quadros binarizados sao quase todos fundo. Em vez da imagem de 8 bits
+ * inteira, a mascara guarda so as corridas de pixels de objeto de cada
+ * linha, [inicio, fim), em ordem de linha e coluna, mais o indice da
+ * primeira corrida de cada linha. A memoria cresce com o numero de
+ * corridas, isto e, com o contorno dos objetos, e nao com a area do quadro.
+ *
+ * binarizaRLE aplica o limiar e produz as corridas na mesma passada, sem
+ * a imagem binaria intermediaria, com o mesmo criterio de threshold
+ * (THRESH_BINARY ou THRESH_BINARY_INV).
+ *
+ * rotulaRLE faz a rotulacao de componentes conexas sobre as corridas:
+ * cada corrida so e comparada com as corridas da linha de cima que a
+ * tocam (union-find com o menor indice como raiz) e area, retangulo
+ * envolvente e centroide saem da soma das corridas. Os objetos e as
+ * estatisticas sao os mesmos de connectedComponentsWithStats; os rotulos
+ * sao numerados pela ordem da primeira corrida de cada objeto, que pode
+ * nao ser a numeracao do OpenCV.
+ *
+ */
+
+#ifndef MASCARA_RLE_h
+#define MASCARA_RLE_h
+
+#include <vector>
+using namespace std;
+
+// OpenCV includes
+#include "opencv2/core.hpp"
+using namespace cv;
+
+/**
+ * Pixels de objeto [inicio, fim) da linha `linha`
+ */
+struct CorridaRLE
+{
+    int linha;
+    int inicio;
+    int fim;
+};
+
+/**
+ * Mascara binaria em corridas
+ */
+struct MascaraRLE
+{
+    int largura;
+    int altura;
+    vector<CorridaRLE> corridas; // em ordem de linha e coluna
+    vector<int> inicio_linha;    // primeira corrida de cada linha; altura + 1 entradas
+
+    MascaraRLE() : largura(0), altura(0) {}
+};
+
+/**
+ * Estatisticas de um objeto, como as de connectedComponentsWithStats
+ */
+struct ComponenteRLE
+{
+    int area;
+    Rect caixa;
+    Point2d centroide;
+
+    ComponenteRLE() : area(0) {}
+};
+
+/**
+ * Acrescenta as corridas de uma linha binarizada com o criterio de threshold
+ * @param const uchar* linha - linha CV_8UC1
+ * @param int n - numero de pixels
+ * @param int y - indice da linha
+ * @param double limiar - limiar, arredondado para baixo como em threshold
+ * @param int tipo_limiar - THRESH_BINARY (objeto acima do limiar) ou THRESH_BINARY_INV
+ * @param vector<CorridaRLE> corridas - corridas da linha acrescentadas no fim
+ */
+void binarizaLinhaRLE(const uchar *linha, int n, int y, double limiar, int tipo_limiar, vector<CorridaRLE> &corridas);
+
+/**
+ * Junta corridas de faixas consecutivas de linhas, ja em ordem, numa mascara
+ * @param vector<vector<CorridaRLE>> faixas - corridas de cada faixa, de cima para baixo
+ */
+void montaRLE(int largura, int altura, const vector<vector<CorridaRLE>> &faixas, MascaraRLE &mascara);
+
+/**
+ * Binariza uma imagem direto em corridas, em paralelo por faixas de linhas
+ * @param Mat img - imagem CV_8UC1
+ * @param double limiar - limiar de threshold
+ * @param int tipo_limiar - THRESH_BINARY ou THRESH_BINARY_INV
+ * @param MascaraRLE mascara - saida
+ */
+void binarizaRLE(const Mat &img, double limiar, int tipo_limiar, MascaraRLE &mascara);
+
+/**
+ * Codifica uma imagem binaria ja pronta; qualquer valor diferente de 0 e objeto
+ */
+void codificaRLE(const Mat &binaria, MascaraRLE &mascara);
+
+/**
+ * Imagem binaria CV_8UC1 (0 ou 255) de uma mascara
+ */
+void decodificaRLE(const MascaraRLE &mascara, Mat &binaria);
+
+/**
+ * Rotula as componentes conexas de uma mascara
+ * @param MascaraRLE mascara - mascara em corridas
+ * @param vector<int> rotulos - saida do rotulo (1 a N) de cada corrida
+ * @param vector<ComponenteRLE> componentes - saida com N + 1 entradas; a 0 (fundo) fica vazia
+ * @param int conectividade - 8 ou 4
+ * @return int N + 1, como connectedComponents
+ */
+int rotulaRLE(const MascaraRLE &mascara, vector<int> &rotulos, vector<ComponenteRLE> &componentes, int conectividade = 8);
+
+#endif
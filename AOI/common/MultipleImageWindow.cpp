@@ -0,0 +1,163 @@
+#include "MultipleImageWindow.h"
+#include "ImagemPGM.h"
+
+#include "opencv2/imgcodecs.hpp"
+
+MultipleImageWindow::MultipleImageWindow(string window_title, int cols, int rows, int flags, Backend backend)
+{
+    this->window_title = window_title;
+    this->cols = cols;
+    this->rows = rows;
+    this->backend = backend;
+    this->ring_buffer = false;
+    this->ring_next = 0;
+    this->render_count = 0;
+    this->next_id = 1;
+    this->drawn.assign(cols * rows, 0);
+    // ToDo: detect resolution of desktop and show fullresolution canvas
+    this->canvas_width = 1200;
+    this->canvas_height = 700;
+    this->canvas = Mat(this->canvas_height, this->canvas_width, CV_8UC3, Scalar(20, 20, 20));
+    if (this->backend == BACKEND_HIGHGUI)
+    {
+        namedWindow(window_title, flags);
+        imshow(this->window_title, this->canvas);
+    }
+}
+
+int MultipleImageWindow::addImage(string title, Mat image, bool render)
+{
+    int pos;
+    if (this->ring_buffer && (int)this->images.size() == cols * rows)
+    {
+        // Full: overwrite the oldest image, the other cells stay as they are
+        pos = this->ring_next;
+        this->titles[pos] = title;
+        this->images[pos] = image;
+        this->thumbnails[pos].release();
+        this->ids[pos] = this->next_id++;
+    }
+    else
+    {
+        this->titles.push_back(title);
+        this->images.push_back(image);
+        this->thumbnails.push_back(Mat());
+        this->ids.push_back(this->next_id++);
+        pos = this->images.size() - 1;
+    }
+    if (this->ring_buffer)
+        this->ring_next = (pos + 1) % (cols * rows);
+
+    if (render)
+        this->render();
+    return pos;
+}
+
+void MultipleImageWindow::removeImage(int pos)
+{
+    this->titles.erase(this->titles.begin() + pos);
+    this->images.erase(this->images.begin() + pos);
+    this->thumbnails.erase(this->thumbnails.begin() + pos);
+    this->ids.erase(this->ids.begin() + pos);
+    if (this->ring_next > pos)
+        this->ring_next--;
+}
+
+void MultipleImageWindow::updateImage(int pos, Mat image)
+{
+    this->images[pos] = image;
+    this->thumbnails[pos].release();
+    this->ids[pos] = this->next_id++;
+}
+
+void MultipleImageWindow::setRingBuffer(bool enabled)
+{
+    this->ring_buffer = enabled;
+    this->ring_next = this->images.size() % (cols * rows);
+}
+
+void MultipleImageWindow::setOutputFile(string file)
+{
+    this->output_file = file;
+}
+
+const Mat &MultipleImageWindow::getCanvas() const
+{
+    return this->canvas;
+}
+
+bool MultipleImageWindow::isOffscreen() const
+{
+    return this->backend == BACKEND_OFFSCREEN;
+}
+
+void MultipleImageWindow::drawCell(int cell, int pos)
+{
+    // width and height of cell
+    int cell_width = (canvas_width / cols);
+    int cell_height = (canvas_height / rows);
+    int cell_x = (cell_width) * ((cell) % cols);
+    int cell_y = (cell_height) * (cell / cols);
+    Rect mask(cell_x, cell_y, cell_width, cell_height);
+    Mat cell_mat(this->canvas, mask);
+
+    // Clean only this cell
+    cell_mat.setTo(Scalar(20, 20, 20));
+    if (pos < 0)
+        return;
+
+    // Draw a rectangle for each cell mat
+    rectangle(canvas, mask, Scalar(200, 200, 200), 1);
+
+    // resize image to cell size and convert it to BGR, once per image
+    Mat &resized = this->thumbnails[pos];
+    if (resized.empty())
+    {
+        double cell_aspect = (double)cell_width / (double)cell_height;
+        Mat img = this->images[pos];
+        double img_aspect = (double)img.cols / (double)img.rows;
+        double f = (cell_aspect < img_aspect) ? (double)cell_width / (double)img.cols : (double)cell_height / (double)img.rows;
+        resize(img, resized, Size(0, 0), f, f);
+        if (resized.channels() == 1)
+        {
+            cvtColor(resized, resized, COLOR_GRAY2BGR);
+        }
+    }
+
+    // Assign the image
+    Mat sub_cell(this->canvas, Rect(cell_x, cell_y, resized.cols, resized.rows));
+    resized.copyTo(sub_cell);
+    putText(cell_mat, this->titles[pos].c_str(), Point(20, 20), FONT_HERSHEY_SIMPLEX, 0.5, Scalar(200, 0, 0), 1, LINE_AA);
+}
+
+void MultipleImageWindow::render()
+{
+    int max_images = ((int)this->images.size() > cols * rows) ? cols * rows : this->images.size();
+
+    // Redraw only the cells whose image changed since the last render
+    for (int i = 0; i < cols * rows; i++)
+    {
+        long long id = (i < max_images) ? this->ids[i] : 0;
+        if (this->drawn[i] == id)
+            continue;
+        drawCell(i, (i < max_images) ? i : -1);
+        this->drawn[i] = id;
+    }
+
+    // Thumbnails of images that are not on screen are not kept
+    for (size_t i = max_images; i < this->thumbnails.size(); i++)
+        this->thumbnails[i].release();
+
+    this->render_count++;
+    if (!this->output_file.empty())
+    {
+        string file = this->output_file;
+        if (formatoSequenciaValido(file))
+            file = format(file.c_str(), this->render_count);
+        imwrite(file, this->canvas);
+    }
+
+    // show image
+    if (this->backend == BACKEND_HIGHGUI)
+        imshow(this->window_title, this->canvas);
+}
@@ -0,0 +1,120 @@
+/**
+ * Mutliple Image Window
+ *
+ * This class create a window with multiple images showed on it
+ * in a grid with optional titles each one
+ *
+ * Each image is resized and converted to BGR only once, the first time it
+ * is rendered, and render() only redraws the cells whose image changed.
+ * In ring buffer mode the window keeps only the last cols*rows images, the
+ * newest one replacing the oldest in its cell. The offscreen backend never
+ * calls highgui: the mosaic stays in memory (getCanvas) and can be written
+ * to disk on each render (setOutputFile).
+ *
+ * @author: David Millan Escriva
+ * @email: david.millan@damiles.com
+ *
+ */
+
+#ifndef MIW_h
+#define MIW_h
+
+#include <string>
+#include <vector>
+#include <iostream>
+using namespace std;
+
+// OpenCV includes
+#include "opencv2/imgproc.hpp"
+#include "opencv2/highgui.hpp"
+using namespace cv;
+
+class MultipleImageWindow
+{
+public:
+    enum Backend
+    {
+        BACKEND_HIGHGUI = 0,  // window shown with imshow
+        BACKEND_OFFSCREEN = 1 // mosaic only in memory / on disk, no window
+    };
+
+    /**
+     * Constructor
+     * Create new window with a max of cols*row images
+     *
+     * @param string window_title
+     * @param int cols number of cols
+     * @param int rows number of rows
+     * @param int flags see highgui window documentation
+     * @param Backend backend highgui window or offscreen mosaic
+     */
+    MultipleImageWindow(string window_title, int cols, int rows, int flags, Backend backend = BACKEND_HIGHGUI);
+
+    /**
+     * Add new image to stack of window
+     * @param Mat image
+     * @param string title caption of image to show
+     * @return int position of image in stack
+     */
+    int addImage(string title, Mat image, bool render = false);
+
+    /**
+     * Remove a image from position n
+     */
+    void removeImage(int pos);
+
+    /**
+     * Replace the image at position n, e.g. after drawing on it
+     */
+    void updateImage(int pos, Mat image);
+
+    /**
+     * Keep only the last cols*rows images; each new image takes the cell of the oldest one
+     */
+    void setRingBuffer(bool enabled);
+
+    /**
+     * Write the mosaic to this file on each render; a single integer printf field (e.g. "mosaic_%05d.png")
+     * is replaced by the render number, any other name is used as is. Empty disables writing
+     */
+    void setOutputFile(string file);
+
+    /**
+     * Mosaic of the last render
+     */
+    const Mat &getCanvas() const;
+
+    /**
+     * @return bool true if the window is offscreen (no highgui)
+     */
+    bool isOffscreen() const;
+
+    /**
+     * Render/redraw/update window
+     */
+    void render();
+
+private:
+    int cols;
+    int rows;
+    int canvas_width;
+    int canvas_height;
+    string window_title;
+    vector<string> titles;
+    vector<Mat> images;
+    Mat canvas;
+
+    Backend backend;
+    bool ring_buffer;
+    int ring_next;              // ring buffer: cell of the next image
+    string output_file;
+    int render_count;
+    vector<Mat> thumbnails;     // resized BGR copy of each image, empty until rendered
+    vector<long long> ids;      // identity of each image, new on add/update
+    vector<long long> drawn;    // id drawn on each cell, 0 empty cell
+    long long next_id;
+
+    void drawCell(int cell, int pos);
+};
+
+#endif
@@ -0,0 +1,227 @@
+#include "PadraoLuz.h"
+#include "RemocaoLuz.h"
+#include "ImagemPGM.h"
+
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <filesystem>
+
+#include "opencv2/imgproc.hpp"
+
+namespace fs = std::filesystem;
+
+// Cabecalho do cache binario; os pixels do padrao suavizado vem logo depois, linha a linha.
+// Em disco: magica (4 bytes), versao, largura, altura, mediana (4 bytes cada) e
+// tamanho e data do arquivo de origem (8 bytes cada), todos em little-endian
+struct CabecalhoCachePadrao
+{
+    char magica[4];
+    uint32_t versao;
+    int32_t largura;
+    int32_t altura;
+    int32_t mediana;
+    uint64_t tamanho_origem;
+    int64_t data_origem;
+};
+
+static const char MAGICA_CACHE[4] = {'P', 'L', 'U', 'Z'};
+static const uint32_t VERSAO_CACHE = 2;
+static const size_t TAMANHO_CABECALHO_CACHE = 4 + 4 * 4 + 2 * 8;
+
+static uchar *escreveLE(uchar *p, uint64_t valor, int bytes)
+{
+    for (int i = 0; i < bytes; i++)
+        *p++ = (uchar)(valor >> (8 * i));
+    return p;
+}
+
+static const uchar *leLE(const uchar *p, uint64_t &valor, int bytes)
+{
+    valor = 0;
+    for (int i = 0; i < bytes; i++)
+        valor |= (uint64_t)*p++ << (8 * i);
+    return p;
+}
+
+static void serializaCabecalho(const CabecalhoCachePadrao &c, uchar *buf)
+{
+    memcpy(buf, c.magica, 4);
+    uchar *p = escreveLE(buf + 4, c.versao, 4);
+    p = escreveLE(p, (uint32_t)c.largura, 4);
+    p = escreveLE(p, (uint32_t)c.altura, 4);
+    p = escreveLE(p, (uint32_t)c.mediana, 4);
+    p = escreveLE(p, c.tamanho_origem, 8);
+    escreveLE(p, (uint64_t)c.data_origem, 8);
+}
+
+static void desserializaCabecalho(const uchar *buf, CabecalhoCachePadrao &c)
+{
+    uint64_t v;
+    memcpy(c.magica, buf, 4);
+    const uchar *p = leLE(buf + 4, v, 4);
+    c.versao = (uint32_t)v;
+    p = leLE(p, v, 4);
+    c.largura = (int32_t)(uint32_t)v;
+    p = leLE(p, v, 4);
+    c.altura = (int32_t)(uint32_t)v;
+    p = leLE(p, v, 4);
+    c.mediana = (int32_t)(uint32_t)v;
+    p = leLE(p, c.tamanho_origem, 8);
+    leLE(p, v, 8);
+    c.data_origem = (int64_t)v;
+}
+
+static bool identificaOrigem(const String &arquivo, uint64_t &tamanho, int64_t &data)
+{
+    std::error_code erro;
+    tamanho = fs::file_size(arquivo, erro);
+    if (erro)
+        return false;
+    data = fs::last_write_time(arquivo, erro).time_since_epoch().count();
+    return !erro;
+}
+
+PadraoLuz::PadraoLuz()
+{
+}
+
+bool PadraoLuz::carrega(const String &arquivo, int tamanho_mediana, bool usa_cache)
+{
+    if (usa_cache && leCache(arquivo, tamanho_mediana))
+        return true;
+
+    Mat img = leImagemCinza(arquivo);
+    if (img.data == NULL)
+        return false;
+
+    define(img, tamanho_mediana);
+
+    if (usa_cache)
+        gravaCache(arquivo, tamanho_mediana);
+
+    return true;
+}
+
+void PadraoLuz::define(const Mat &padrao, int tamanho_mediana)
+{
+    CV_Assert(padrao.type() == CV_8UC1);
+
+    if (tamanho_mediana > 1)
+        medianBlur(padrao, padrao_suave, tamanho_mediana);
+    else
+        padrao_suave = padrao.clone();
+}
+
+bool PadraoLuz::vazio() const
+{
+    return padrao_suave.empty();
+}
+
+bool PadraoLuz::compativel(Size tamanho_quadro) const
+{
+    return !vazio() && padrao_suave.size() == tamanho_quadro;
+}
+
+const Mat &PadraoLuz::padrao() const
+{
+    return padrao_suave;
+}
+
+void PadraoLuz::removeLuz(const Mat &img, Mat &saida, int metodo) const
+{
+    CV_Assert(compativel(img.size()));
+
+    if (metodo == LUZ_DIVISAO)
+        removeLuzDivisao(img, padrao_suave, saida);
+    else if (metodo == LUZ_DIVISAO_RECIPROCO)
+        removeLuzReciproco(img, padrao_suave, saida);
+    else
+        subtract(padrao_suave, img, saida);
+}
+
+String PadraoLuz::arquivoCache(const String &arquivo, int tamanho_mediana)
+{
+    return arquivo + ".m" + to_string(tamanho_mediana) + ".plc";
+}
+
+bool PadraoLuz::leCache(const String &arquivo, int tamanho_mediana)
+{
+    uint64_t tamanho;
+    int64_t data;
+    if (!identificaOrigem(arquivo, tamanho, data))
+        return false;
+
+    ifstream cache(arquivoCache(arquivo, tamanho_mediana).c_str(), ios::binary);
+    if (!cache.is_open())
+        return false;
+
+    uchar buf[TAMANHO_CABECALHO_CACHE];
+    if (!cache.read((char *)buf, sizeof(buf)))
+        return false;
+    CabecalhoCachePadrao cabecalho;
+    desserializaCabecalho(buf, cabecalho);
+
+    // Cache de outra versao, outra mediana ou de um arquivo que mudou
+    if (memcmp(cabecalho.magica, MAGICA_CACHE, 4) != 0 || cabecalho.versao != VERSAO_CACHE ||
+        cabecalho.mediana != tamanho_mediana || cabecalho.tamanho_origem != tamanho || cabecalho.data_origem != data ||
+        cabecalho.largura <= 0 || cabecalho.altura <= 0)
+        return false;
+
+    // Cabecalho corrompido: confere as dimensoes com o resto do arquivo antes de alocar.
+    // Mede pelo proprio stream, que continua no arquivo aberto mesmo se o cache for trocado
+    streamoff inicio_pixels = cache.tellg();
+    cache.seekg(0, ios::end);
+    streamoff restante = cache.tellg() - inicio_pixels;
+    cache.seekg(inicio_pixels);
+    if (!cache || (uint64_t)restante != (uint64_t)cabecalho.largura * (uint64_t)cabecalho.altura)
+        return false;
+
+    Mat padrao(cabecalho.altura, cabecalho.largura, CV_8UC1);
+    if (!cache.read((char *)padrao.data, padrao.total()))
+        return false;
+
+    padrao_suave = padrao;
+
+    return true;
+}
+
+bool PadraoLuz::gravaCache(const String &arquivo, int tamanho_mediana) const
+{
+    CabecalhoCachePadrao cabecalho;
+    memcpy(cabecalho.magica, MAGICA_CACHE, 4);
+    cabecalho.versao = VERSAO_CACHE;
+    cabecalho.largura = padrao_suave.cols;
+    cabecalho.altura = padrao_suave.rows;
+    cabecalho.mediana = tamanho_mediana;
+    if (!identificaOrigem(arquivo, cabecalho.tamanho_origem, cabecalho.data_origem))
+        return false;
+
+    // Grava ao lado e renomeia: outro processo lendo o cache ve o antigo ou o novo inteiro
+    String destino = arquivoCache(arquivo, tamanho_mediana);
+    String temporario = destino + ".tmp";
+    {
+        ofstream cache(temporario.c_str(), ios::binary);
+        if (!cache.is_open())
+            return false;
+
+        uchar buf[TAMANHO_CABECALHO_CACHE];
+        serializaCabecalho(cabecalho, buf);
+        cache.write((const char *)buf, sizeof(buf));
+        for (int y = 0; y < padrao_suave.rows; y++)
+            cache.write((const char *)padrao_suave.ptr<uchar>(y), padrao_suave.cols);
+
+        if (!cache.flush())
+            return false;
+    }
+
+    std::error_code erro;
+    fs::rename(temporario, destino, erro);
+    if (erro)
+    {
+        fs::remove(temporario, erro);
+        return false;
+    }
+
+    return true;
+}
@@ -0,0 +1,96 @@
+/**
+ * Padrao de luz
+ *
+ * Guarda o padrao de luz ja suavizado pela mediana. E carregado uma vez e
+ * depois so lido, entao pode ser compartilhado entre threads.
+ *
+ * Opcionalmente grava um cache binario ao lado do arquivo do padrao
+ * (<arquivo>.m<mediana>.plc) para que as proximas execucoes nao precisem
+ * decodificar a imagem nem aplicar a mediana de novo. O cache e descartado
+ * se o tamanho ou a data do arquivo original mudarem. O cabecalho e gravado
+ * campo a campo em little-endian, sem depender do layout da struct, e o
+ * cache e escrito em <cache>.tmp e renomeado, nunca lido pela metade.
+ *
+ */
+
+#ifndef PADRAO_LUZ_h
+#define PADRAO_LUZ_h
+
+#include <string>
+using namespace std;
+
+// OpenCV includes
+#include "opencv2/core.hpp"
+using namespace cv;
+
+/**
+ * Metodos de remocao de luz. A divisao exata e o padrao; a versao pelo
+ * reciproco so e usada quando pedida explicitamente.
+ */
+enum MetodoLuz
+{
+    LUZ_DIFERENCA = 0,        // padrao - img
+    LUZ_DIVISAO = 1,          // 255 * (1 - img / padrao), identica bit a bit a divisao em float
+    LUZ_NENHUMA = 2,          // nao remove (so onde o chamador aceita)
+    LUZ_DIVISAO_RECIPROCO = 3 // divisao pela tabela de reciprocos: ate 1 nivel de diferenca da exata
+};
+
+class PadraoLuz
+{
+public:
+    /**
+     * Cria um padrao vazio
+     */
+    PadraoLuz();
+
+    /**
+     * Carrega o padrao de luz de um arquivo e aplica a mediana
+     *
+     * @param String arquivo - imagem do padrao de luz
+     * @param int tamanho_mediana - abertura da mediana aplicada ao padrao
+     * @param bool usa_cache - le/grava o cache binario ao lado do arquivo
+     * @return bool false se o arquivo nao pode ser lido
+     */
+    bool carrega(const String &arquivo, int tamanho_mediana, bool usa_cache = true);
+
+    /**
+     * Define o padrao a partir de uma imagem ja calculada e aplica a mediana
+     *
+     * @param Mat padrao - padrao CV_8UC1
+     * @param int tamanho_mediana - abertura da mediana, 0 para nao suavizar
+     */
+    void define(const Mat &padrao, int tamanho_mediana);
+
+    /**
+     * @return bool true se nenhum padrao foi carregado
+     */
+    bool vazio() const;
+
+    /**
+     * Confere se o padrao pode ser aplicado a um quadro deste tamanho
+     */
+    bool compativel(Size tamanho_quadro) const;
+
+    /**
+     * Padrao suavizado, CV_8UC1
+     */
+    const Mat &padrao() const;
+
+    /**
+     * Remove a luz de fundo de um quadro
+     *
+     * @param Mat img - quadro CV_8UC1 do mesmo tamanho do padrao
+     * @param Mat saida - quadro sem luz de fundo
+     * @param int metodo - MetodoLuz: 0 diferenca, 1 divisao, 3 divisao pelo reciproco
+     */
+    void removeLuz(const Mat &img, Mat &saida, int metodo) const;
+
+private:
+    static String arquivoCache(const String &arquivo, int tamanho_mediana);
+    bool leCache(const String &arquivo, int tamanho_mediana);
+    bool gravaCache(const String &arquivo, int tamanho_mediana) const;
+
+    Mat padrao_suave;
+};
+
+#endif
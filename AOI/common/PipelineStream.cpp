@@ -0,0 +1,275 @@
+#include "PipelineStream.h"
+#include "FilaSPSC.h"
+
+#include <iostream>
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <chrono>
+#include <memory>
+
+#include "opencv2/imgproc.hpp"
+#include "opencv2/core/utility.hpp"
+
+// Espera curta de quem encontrou a fila vazia ou cheia: cede a CPU algumas vezes e depois dorme
+static void aguardaFila(int &tentativas)
+{
+    if (tentativas++ < 64)
+        this_thread::yield();
+    else
+        this_thread::sleep_for(chrono::microseconds(200));
+}
+
+static double percentil(const vector<double> &ordenado, double p)
+{
+    if (ordenado.empty())
+        return 0;
+    size_t posicao = (size_t)(p * (ordenado.size() - 1) + 0.5);
+    return ordenado[min(posicao, ordenado.size() - 1)];
+}
+
+bool FonteStream::le(Mat &quadro)
+{
+    if (usa_gerador)
+    {
+        if (ciclo.empty() || gerados >= gerador.parametros().quadros)
+            return false;
+        // Copia: os estagios podem escrever no quadro, e o mesmo volta no ciclo seguinte
+        ciclo[gerados++ % ciclo.size()].copyTo(quadro);
+        return true;
+    }
+    if (usa_sequencia)
+        return sequencia.le(quadro);
+    return captura.read(quadro);
+}
+
+PipelineStream::PipelineStream(int capacidade_fila, PoliticaFila politica)
+    : capacidade(max(1, capacidade_fila)), politica(politica)
+{
+}
+
+void PipelineStream::adicionaEstagio(const String &nome, EstagioStream corpo)
+{
+    nomes.push_back(nome);
+    estagios.push_back(corpo);
+}
+
+EstatisticasStream PipelineStream::executa(FonteStream &captura, function<bool(QuadroStream &)> consome, double fps_captura)
+{
+    EstatisticasStream estatisticas;
+    size_t num_estagios = estagios.size();
+
+    // Fila i liga o estagio i - 1 (ou a captura) ao estagio i; a ultima vai para consome()
+    vector<unique_ptr<FilaSPSC<QuadroStream>>> filas;
+    for (size_t i = 0; i <= num_estagios; i++)
+    {
+        filas.push_back(unique_ptr<FilaSPSC<QuadroStream>>(new FilaSPSC<QuadroStream>(capacidade)));
+        String origem = i == 0 ? String("captura") : nomes[i - 1];
+        String destino = i == num_estagios ? String("saida") : nomes[i];
+        estatisticas.filas.push_back(origem + " -> " + destino);
+    }
+
+    vector<atomic<bool>> terminou(num_estagios + 1);
+    vector<atomic<int64>> descartados(num_estagios + 1);
+    for (size_t i = 0; i <= num_estagios; i++)
+    {
+        terminou[i] = false;
+        descartados[i] = 0;
+    }
+    atomic<bool> parar(false);
+    atomic<int64> capturados(0), rejeitados(0);
+
+    // Entrega o quadro na fila seguindo a politica; false so quando o pipeline esta parando
+    auto entrega = [&](size_t fila, QuadroStream &quadro) {
+        int tentativas = 0;
+        while (!filas[fila]->tentaInserir(quadro))
+        {
+            if (politica == FILA_DESCARTA)
+            {
+                descartados[fila]++;
+                return true;
+            }
+            if (parar)
+                return false;
+            aguardaFila(tentativas);
+        }
+        return true;
+    };
+
+    int64 inicio = getTickCount();
+
+    vector<thread> threads;
+    threads.push_back(thread([&]() {
+        double periodo = fps_captura > 0 ? getTickFrequency() / fps_captura : 0;
+        double proximo_tick = (double)getTickCount();
+        for (int64 indice = 0; !parar; indice++)
+        {
+            // Arquivo tocado como camera: le no ritmo do FPS pedido
+            if (periodo > 0)
+            {
+                double falta = (proximo_tick - getTickCount()) / getTickFrequency();
+                if (falta > 0)
+                    this_thread::sleep_for(chrono::duration<double>(falta));
+                proximo_tick += periodo;
+            }
+
+            QuadroStream quadro;
+            if (!captura.le(quadro.original) || quadro.original.empty())
+                break;
+            quadro.indice = indice;
+            quadro.tick_captura = getTickCount();
+            capturados++;
+
+            if (quadro.original.channels() == 3)
+                cvtColor(quadro.original, quadro.img, COLOR_BGR2GRAY);
+            else
+                quadro.img = quadro.original;
+
+            if (!entrega(0, quadro))
+                break;
+        }
+        terminou[0] = true;
+    }));
+
+    for (size_t e = 0; e < num_estagios; e++)
+    {
+        threads.push_back(thread([&, e]() {
+            int tentativas = 0;
+            while (!parar)
+            {
+                // Le o fim da etapa anterior antes da fila: fila vazia depois disso e o fim de verdade
+                bool anterior_terminou = terminou[e];
+                QuadroStream quadro;
+                if (!filas[e]->tentaRetirar(quadro))
+                {
+                    if (anterior_terminou)
+                        break;
+                    aguardaFila(tentativas);
+                    continue;
+                }
+                tentativas = 0;
+
+                if (!estagios[e](quadro))
+                {
+                    rejeitados++;
+                    continue;
+                }
+                if (!entrega(e + 1, quadro))
+                    break;
+            }
+            terminou[e + 1] = true;
+        }));
+    }
+
+    // Saida na thread atual, onde as janelas podem ser atualizadas
+    vector<double> latencias;
+    int tentativas = 0;
+    while (true)
+    {
+        bool anterior_terminou = terminou[num_estagios];
+        QuadroStream quadro;
+        if (!filas[num_estagios]->tentaRetirar(quadro))
+        {
+            if (anterior_terminou)
+                break;
+            aguardaFila(tentativas);
+            continue;
+        }
+        tentativas = 0;
+
+        latencias.push_back(1000.0 * (getTickCount() - quadro.tick_captura) / getTickFrequency());
+        if (!consome(quadro))
+            break;
+    }
+
+    parar = true;
+    for (size_t t = 0; t < threads.size(); t++)
+        threads[t].join();
+
+    estatisticas.duracao_s = (getTickCount() - inicio) / getTickFrequency();
+    estatisticas.capturados = capturados;
+    estatisticas.processados = (int64)latencias.size();
+    estatisticas.rejeitados = rejeitados;
+    for (size_t i = 0; i <= num_estagios; i++)
+        estatisticas.descartados.push_back(descartados[i]);
+    if (estatisticas.duracao_s > 0)
+        estatisticas.fps = estatisticas.processados / estatisticas.duracao_s;
+
+    if (!latencias.empty())
+    {
+        double soma = 0;
+        for (size_t i = 0; i < latencias.size(); i++)
+            soma += latencias[i];
+        sort(latencias.begin(), latencias.end());
+        estatisticas.latencia_media_ms = soma / latencias.size();
+        estatisticas.latencia_p50_ms = percentil(latencias, 0.50);
+        estatisticas.latencia_p95_ms = percentil(latencias, 0.95);
+        estatisticas.latencia_p99_ms = percentil(latencias, 0.99);
+        estatisticas.latencia_max_ms = latencias.back();
+    }
+
+    return estatisticas;
+}
+
+bool abreFonteStream(FonteStream &captura, const String &fonte, double &fps_captura)
+{
+    // So digitos: indice de camera, que ja entrega no seu proprio ritmo
+    bool camera = !fonte.empty() && all_of(fonte.begin(), fonte.end(), [](char c) { return c >= '0' && c <= '9'; });
+    if (camera)
+    {
+        fps_captura = 0;
+        return captura.captura.open(atoi(fonte.c_str()));
+    }
+
+    // Cenas sinteticas: todos os quadros do ciclo sao desenhados aqui, antes de comecar a medir
+    const String prefixo_sintetico = "sintetico:";
+    if (fonte.compare(0, prefixo_sintetico.size(), prefixo_sintetico) == 0)
+    {
+        ParametrosCena parametros;
+        if (!interpretaParametrosCena(fonte.substr(prefixo_sintetico.size()), parametros) || !captura.gerador.define(parametros))
+            return false;
+
+        captura.ciclo.resize(min(parametros.ciclo, parametros.quadros));
+        parallel_for_(Range(0, (int)captura.ciclo.size()), [&](const Range &trecho) {
+            for (int i = trecho.start; i < trecho.end; i++)
+                captura.gerador.gera(i, captura.ciclo[i]);
+        });
+        captura.gerados = 0;
+        captura.usa_gerador = true;
+        fps_captura = max(fps_captura, 0.0);
+        return true;
+    }
+
+    // Sequencia de imagens nao tem FPS proprio: sem ritmo pedido le o mais rapido possivel
+    captura.usa_sequencia = ehSequenciaPGM(fonte);
+    if (captura.usa_sequencia)
+    {
+        fps_captura = max(fps_captura, 0.0);
+        return captura.sequencia.abre(fonte);
+    }
+
+    if (!captura.captura.open(fonte))
+        return false;
+
+    if (fps_captura == 0)
+        fps_captura = captura.captura.get(CAP_PROP_FPS);
+    if (fps_captura < 0)
+        fps_captura = 0;
+
+    return true;
+}
+
+void imprimeEstatisticasStream(const EstatisticasStream &estatisticas)
+{
+    cout << "Quadros capturados: " << estatisticas.capturados << ", processados: " << estatisticas.processados
+         << ", rejeitados pelos estagios: " << estatisticas.rejeitados << endl;
+    for (size_t i = 0; i < estatisticas.filas.size(); i++)
+    {
+        if (estatisticas.descartados[i] > 0)
+            cout << "  descartados na fila " << estatisticas.filas[i] << ": " << estatisticas.descartados[i] << endl;
+    }
+    cout << "Tempo: " << estatisticas.duracao_s << " s, " << estatisticas.fps << " quadros/s" << endl;
+    cout << "Latencia captura -> saida (ms): media " << estatisticas.latencia_media_ms
+         << ", p50 " << estatisticas.latencia_p50_ms << ", p95 " << estatisticas.latencia_p95_ms
+         << ", p99 " << estatisticas.latencia_p99_ms << ", max " << estatisticas.latencia_max_ms << endl;
+}
@@ -0,0 +1,159 @@
+/**
+ * Pipeline de processamento de video ou camera
+ *
+ * Cada estagio roda na sua propria thread e recebe os quadros do estagio
+ * anterior por uma FilaSPSC limitada. A captura (FonteStream: VideoCapture,
+ * SequenciaPGM para sequencias de arquivos PGM, ou cenas sinteticas do
+ * GeradorCenas) e o primeiro estagio; o ultimo entrega os quadros na
+ * thread que chamou executa(), onde ficam as janelas do HighGUI. Com a
+ * fila cheia o quadro e descartado (FILA_DESCARTA) ou o estagio espera o
+ * seguinte liberar espaco (FILA_BLOQUEIA). No fim sao informados a
+ * latencia captura -> saida e a taxa de quadros sustentada.
+ *
+ */
+
+#ifndef PIPELINE_STREAM_h
+#define PIPELINE_STREAM_h
+
+#include <string>
+#include <vector>
+#include <functional>
+using namespace std;
+
+// OpenCV includes
+#include "opencv2/core.hpp"
+#include "opencv2/videoio.hpp"
+using namespace cv;
+
+#include "ImagemPGM.h"
+#include "GeradorCenas.h"
+
+enum PoliticaFila
+{
+    FILA_BLOQUEIA = 0, // espera espaco na fila seguinte (backpressure ate a captura)
+    FILA_DESCARTA = 1  // descarta o quadro novo quando a fila seguinte esta cheia
+};
+
+/**
+ * Quadro em transito pelo pipeline
+ */
+struct QuadroStream
+{
+    int64 indice;                              // posicao do quadro na captura
+    int64 tick_captura;                        // getTickCount() logo apos a leitura
+    Mat original;                              // quadro como foi capturado
+    Mat img;                                   // saida do ultimo estagio que passou, em cinza
+    Mat saida;                                 // imagem de resultado para mostrar
+    int num_objetos;
+    Mat caracteristicas;                       // uma linha por objeto, CV_32F
+    vector<Point> posicoes;                    // posicao de cada objeto na imagem
+    vector<float> classes;                     // classe prevista de cada objeto
+
+    QuadroStream() : indice(0), tick_captura(0), num_objetos(0) {}
+};
+
+/**
+ * Origem dos quadros: camera ou video pelo VideoCapture, sequencia PGM
+ * lida dos arquivos mapeados, ja em cinza e sem decodificar para BGR, ou
+ * cenas sinteticas desenhadas de antemao e repetidas em ciclo, para que a
+ * captura nao pese no ritmo pedido
+ */
+struct FonteStream
+{
+    VideoCapture captura;
+    SequenciaPGM sequencia;
+    GeradorCenas gerador;
+    vector<Mat> ciclo;   // quadros sinteticos distintos
+    int64 gerados;
+    bool usa_sequencia;
+    bool usa_gerador;
+
+    FonteStream() : gerados(0), usa_sequencia(false), usa_gerador(false) {}
+
+    /**
+     * Le o proximo quadro
+     * @return bool false no fim da fonte
+     */
+    bool le(Mat &quadro);
+};
+
+/**
+ * Corpo de um estagio; altera o quadro no lugar
+ * @return bool false descarta o quadro
+ */
+typedef function<bool(QuadroStream &)> EstagioStream;
+
+/**
+ * Resumo de uma execucao do pipeline
+ */
+struct EstatisticasStream
+{
+    int64 capturados;
+    int64 processados;
+    vector<String> filas;            // nome de cada fila, "captura -> ruido", ...
+    vector<int64> descartados;       // quadros descartados com cada fila cheia
+    int64 rejeitados;                // quadros descartados pelos proprios estagios
+    double duracao_s;
+    double fps;                      // quadros entregues por segundo
+    double latencia_media_ms;
+    double latencia_p50_ms;
+    double latencia_p95_ms;
+    double latencia_p99_ms;
+    double latencia_max_ms;
+
+    EstatisticasStream() : capturados(0), processados(0), rejeitados(0), duracao_s(0), fps(0),
+                           latencia_media_ms(0), latencia_p50_ms(0), latencia_p95_ms(0), latencia_p99_ms(0), latencia_max_ms(0) {}
+};
+
+class PipelineStream
+{
+public:
+    /**
+     * @param int capacidade_fila - quadros em cada fila entre estagios
+     * @param PoliticaFila politica - o que fazer com a fila cheia
+     */
+    PipelineStream(int capacidade_fila = 4, PoliticaFila politica = FILA_DESCARTA);
+
+    /**
+     * Adiciona um estagio no fim do pipeline
+     * @param String nome - nome do estagio nos relatorios
+     * @param EstagioStream corpo - processamento do estagio, chamado sempre na mesma thread
+     */
+    void adicionaEstagio(const String &nome, EstagioStream corpo);
+
+    /**
+     * Processa a captura ate o fim do video ou ate consome() retornar false
+     *
+     * @param FonteStream captura - fonte ja aberta; quadros coloridos sao convertidos para cinza em img
+     * @param function consome - chamada na thread atual com cada quadro processado
+     * @param double fps_captura - ritmo da leitura, 0 le o mais rapido possivel
+     * @return EstatisticasStream resumo da execucao
+     */
+    EstatisticasStream executa(FonteStream &captura, function<bool(QuadroStream &)> consome, double fps_captura = 0);
+
+private:
+    int capacidade;
+    PoliticaFila politica;
+    vector<String> nomes;
+    vector<EstagioStream> estagios;
+};
+
+/**
+ * Abre uma camera, um arquivo de video ou uma sequencia de imagens
+ *
+ * @param FonteStream captura - fonte a abrir
+ * @param String fonte - indice da camera ("0", "1", ...), arquivo de video ou sequencia %04d;
+ *                       sequencias .pgm sao lidas por SequenciaPGM; "sintetico:<parametros>"
+ *                       desenha as cenas de interpretaParametrosCena
+ * @param double fps_captura - entrada: FPS pedido, 0 usa o do arquivo, negativo sem ritmo;
+ *                             saida: ritmo a passar para executa() (0 para cameras)
+ * @return bool false se a fonte nao pode ser aberta
+ */
+bool abreFonteStream(FonteStream &captura, const String &fonte, double &fps_captura);
+
+/**
+ * Imprime o resumo de uma execucao do pipeline
+ */
+void imprimeEstatisticasStream(const EstatisticasStream &estatisticas);
+
+#endif
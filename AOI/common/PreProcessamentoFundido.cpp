@@ -0,0 +1,117 @@
+#include "PreProcessamentoFundido.h"
+#include "RemocaoLuz.h"
+#include "Instrumentacao.h"
+
+#include <algorithm>
+#include <functional>
+using namespace std;
+
+#include "opencv2/imgproc.hpp"
+#include "opencv2/core/utility.hpp"
+
+// Dados de uma faixa que devem caber no L2: entrada, mediana, sem luz, padrao e saida, 1 byte cada
+static const int BYTES_POR_FAIXA = 256 * 1024;
+static const int BYTES_POR_PIXEL_FAIXA = 5;
+static const int LINHAS_MINIMAS_FAIXA = 16;
+
+int linhasFaixaFundida(int largura)
+{
+    return max(LINHAS_MINIMAS_FAIXA, BYTES_POR_FAIXA / (BYTES_POR_PIXEL_FAIXA * max(1, largura)));
+}
+
+/**
+ * Mediana e remocao de luz por faixas; entrega cada faixa pronta para o limiar, ainda no cache
+ * @param function binariza - recebe a faixa sem luz e as linhas [inicio, fim) que ela ocupa no quadro
+ */
+static void processaFaixas(const Mat &img, const PadraoLuz &padrao, int tamanho_mediana, int metodo_luz,
+                           function<void(const Mat &, int, int, int)> binariza)
+{
+    CV_Assert(img.type() == CV_8UC1);
+    CV_Assert(metodo_luz == LUZ_NENHUMA || padrao.compativel(img.size()));
+
+    int borda = tamanho_mediana > 1 ? tamanho_mediana / 2 : 0;
+    int linhas_faixa = linhasFaixaFundida(img.cols);
+    int num_faixas = (img.rows + linhas_faixa - 1) / linhas_faixa;
+
+    parallel_for_(Range(0, num_faixas), [&](const Range &faixas) {
+        // Intermediarios reaproveitados por todas as faixas deste trecho, sempre quentes no cache
+        Mat sem_ruido, sem_luz;
+        for (int f = faixas.start; f < faixas.end; f++)
+        {
+            int inicio = f * linhas_faixa;
+            int fim = min(img.rows, inicio + linhas_faixa);
+
+            // Mediana sobre a faixa com as linhas vizinhas; so as linhas [inicio, fim) sao usadas
+            Mat nucleo;
+            if (borda > 0)
+            {
+                int inicio_borda = max(0, inicio - borda);
+                int fim_borda = min(img.rows, fim + borda);
+                medianBlur(img.rowRange(inicio_borda, fim_borda), sem_ruido, tamanho_mediana);
+                nucleo = sem_ruido.rowRange(inicio - inicio_borda, fim - inicio_borda);
+            }
+            else
+            {
+                nucleo = img.rowRange(inicio, fim);
+            }
+
+            // Remocao de luz linha a linha, com as mesmas funcoes de PadraoLuz::removeLuz
+            Mat entrada_limiar = nucleo;
+            if (metodo_luz == LUZ_DIVISAO || metodo_luz == LUZ_DIVISAO_RECIPROCO)
+            {
+                sem_luz.create(nucleo.size(), CV_8UC1);
+                for (int y = inicio; y < fim; y++)
+                {
+                    const uchar *linha = nucleo.ptr<uchar>(y - inicio), *linha_padrao = padrao.padrao().ptr<uchar>(y);
+                    uchar *linha_saida = sem_luz.ptr<uchar>(y - inicio);
+                    if (metodo_luz == LUZ_DIVISAO)
+                        removeLuzDivisaoLinha(linha, linha_padrao, linha_saida, img.cols);
+                    else
+                        removeLuzReciprocoLinha(linha, linha_padrao, linha_saida, img.cols);
+                }
+                entrada_limiar = sem_luz;
+            }
+            else if (metodo_luz != LUZ_NENHUMA)
+            {
+                subtract(padrao.padrao().rowRange(inicio, fim), nucleo, sem_luz);
+                entrada_limiar = sem_luz;
+            }
+
+            binariza(entrada_limiar, f, inicio, fim);
+        }
+    });
+}
+
+void preProcessaFundido(const Mat &img, const PadraoLuz &padrao, int tamanho_mediana, int metodo_luz,
+                        double limiar, int tipo_limiar, Mat &saida)
+{
+    MEDE_ETAPA("pre-processamento fundido");
+    saida.create(img.size(), CV_8UC1);
+    if (img.empty())
+        return;
+
+    processaFaixas(img, padrao, tamanho_mediana, metodo_luz, [&](const Mat &faixa, int, int inicio, int fim) {
+        // Binariza direto nas linhas da saida
+        Mat faixa_saida = saida.rowRange(inicio, fim);
+        threshold(faixa, faixa_saida, limiar, 255, tipo_limiar);
+    });
+}
+
+void preProcessaFundidoRLE(const Mat &img, const PadraoLuz &padrao, int tamanho_mediana, int metodo_luz,
+                           double limiar, int tipo_limiar, MascaraRLE &mascara)
+{
+    MEDE_ETAPA("pre-processamento fundido");
+    int linhas_faixa = linhasFaixaFundida(img.cols);
+    vector<vector<CorridaRLE>> faixas((img.rows + linhas_faixa - 1) / linhas_faixa);
+
+    if (!img.empty())
+    {
+        processaFaixas(img, padrao, tamanho_mediana, metodo_luz, [&](const Mat &faixa, int f, int inicio, int fim) {
+            // Cada faixa vira corridas na sua propria lista; a imagem binaria nunca e escrita
+            for (int y = inicio; y < fim; y++)
+                binarizaLinhaRLE(faixa.ptr<uchar>(y - inicio), img.cols, y, limiar, tipo_limiar, faixas[f]);
+        });
+    }
+
+    montaRLE(img.cols, img.rows, faixas, mascara);
+}
@@ -0,0 +1,62 @@
+/**
+ * Pre-processamento fundido por faixas
+ *
+ * Faz mediana, remocao da luz de fundo e binarizacao numa unica passada
+ * sobre o quadro. A imagem e dividida em faixas de linhas pequenas o
+ * bastante para que a entrada, a saida da mediana e a imagem sem luz de
+ * cada faixa continuem no cache L2 entre uma etapa e a seguinte; so a
+ * entrada, o padrao e a imagem binaria passam pela memoria principal,
+ * contra sete leituras e escritas do quadro inteiro nas etapas separadas.
+ * As faixas sao processadas em paralelo.
+ *
+ * Cada faixa le tambem as tamanho_mediana / 2 linhas vizinhas de cima e de
+ * baixo, que a mediana precisa; nas bordas da imagem a faixa comeca ou
+ * termina na propria borda, onde medianBlur replica as linhas como faz com
+ * o quadro inteiro. As colunas sao sempre todas. Com isso o resultado e
+ * identico bit a bit ao de medianBlur, PadraoLuz::removeLuz e threshold
+ * aplicados um apos o outro.
+ *
+ * preProcessaFundidoRLE binariza cada faixa direto em corridas (MascaraRLE):
+ * nem a imagem binaria chega a ser escrita.
+ *
+ * So o limiar fixo e fundido: os limiares automaticos dependem do
+ * histograma do quadro inteiro ja sem luz e ficam com as etapas separadas.
+ *
+ */
+
+#ifndef PRE_PROCESSAMENTO_FUNDIDO_h
+#define PRE_PROCESSAMENTO_FUNDIDO_h
+
+// OpenCV includes
+#include "opencv2/core.hpp"
+using namespace cv;
+
+#include "PadraoLuz.h"
+#include "MascaraRLE.h"
+
+/**
+ * Linhas de cada faixa para quadros desta largura: cerca de 256 KB de dados por faixa, no minimo 16 linhas
+ */
+int linhasFaixaFundida(int largura);
+
+/**
+ * Mediana, remocao de luz e limiar fixo numa unica passada por faixas
+ * @param Mat img - quadro CV_8UC1
+ * @param PadraoLuz padrao - padrao compativel com o quadro; ignorado com metodo_luz 2
+ * @param int tamanho_mediana - abertura da mediana (3, 5 ou 7), 1 para nao filtrar
+ * @param int metodo_luz - MetodoLuz: 0 diferenca, 1 divisao, 2 nao remove, 3 divisao pelo reciproco
+ * @param double limiar - limiar fixo da binarizacao
+ * @param int tipo_limiar - THRESH_BINARY ou THRESH_BINARY_INV
+ * @param Mat saida - imagem binaria CV_8UC1
+ */
+void preProcessaFundido(const Mat &img, const PadraoLuz &padrao, int tamanho_mediana, int metodo_luz,
+                        double limiar, int tipo_limiar, Mat &saida);
+
+/**
+ * Mesmo que preProcessaFundido, mas com a saida em corridas
+ * @param MascaraRLE mascara - mascara binaria em corridas
+ */
+void preProcessaFundidoRLE(const Mat &img, const PadraoLuz &padrao, int tamanho_mediana, int metodo_luz,
+                           double limiar, int tipo_limiar, MascaraRLE &mascara);
+
+#endif
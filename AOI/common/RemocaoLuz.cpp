@@ -0,0 +1,251 @@
+#include "RemocaoLuz.h"
+
+#include <algorithm>
+#include <vector>
+using namespace std;
+
+#include "opencv2/core/utility.hpp"
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define REMOCAO_LUZ_AVX2
+#elif defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#if defined(__SSE4_1__)
+#include <smmintrin.h>
+#endif
+#define REMOCAO_LUZ_SSE2
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#define REMOCAO_LUZ_NEON
+#endif
+
+static inline uchar removeLuzPixel(uchar i, uchar p)
+{
+    // Mesma sequencia de operacoes em float do caminho antigo
+    if (p == 0)
+        return 0;
+    float q = (float)i / (float)p;
+    return saturate_cast<uchar>((1.f - q) * 255.f);
+}
+
+#if defined(REMOCAO_LUZ_AVX2) || defined(REMOCAO_LUZ_SSE2)
+static inline __m128i divide4(__m128i i32, __m128i p32)
+{
+    const __m128 um = _mm_set1_ps(1.f), c255 = _mm_set1_ps(255.f);
+    __m128 q = _mm_div_ps(_mm_cvtepi32_ps(i32), _mm_cvtepi32_ps(p32));
+    // cvtps arredonda para o par mais proximo, como cvRound
+    return _mm_cvtps_epi32(_mm_mul_ps(_mm_sub_ps(um, q), c255));
+}
+#endif
+
+#if defined(REMOCAO_LUZ_SSE2)
+static inline __m128i multiplica32(__m128i a, __m128i b)
+{
+#if defined(__SSE4_1__)
+    return _mm_mullo_epi32(a, b);
+#else
+    // SSE2 so multiplica as posicoes pares; junta pares e impares
+    __m128i par = _mm_mul_epu32(a, b);
+    __m128i impar = _mm_mul_epu32(_mm_srli_epi64(a, 32), _mm_srli_epi64(b, 32));
+    return _mm_unpacklo_epi32(_mm_shuffle_epi32(par, _MM_SHUFFLE(0, 0, 2, 0)), _mm_shuffle_epi32(impar, _MM_SHUFFLE(0, 0, 2, 0)));
+#endif
+}
+
+// SSE2 nao tem gather: os 4 reciprocos vem da tabela um a um
+static inline __m128i reciproco4(__m128i i32, __m128i p32, const uchar *padrao, const int *tabela)
+{
+    const __m128i zero = _mm_setzero_si128(), meio = _mm_set1_epi32(1 << 15);
+    __m128i d = _mm_sub_epi32(p32, i32);
+    d = _mm_and_si128(d, _mm_cmpgt_epi32(d, zero));
+    __m128i rec = _mm_setr_epi32(tabela[padrao[0]], tabela[padrao[1]], tabela[padrao[2]], tabela[padrao[3]]);
+    __m128i r = multiplica32(d, rec);
+    return _mm_srli_epi32(_mm_add_epi32(r, meio), 16);
+}
+#endif
+
+#if defined(REMOCAO_LUZ_AVX2)
+static inline __m256i reciproco8(__m256i i32, __m256i p32, const int *tabela)
+{
+    const __m256i meio = _mm256_set1_epi32(1 << 15);
+    __m256i d = _mm256_max_epi32(_mm256_sub_epi32(p32, i32), _mm256_setzero_si256());
+    __m256i r = _mm256_mullo_epi32(d, _mm256_i32gather_epi32(tabela, p32, 4));
+    return _mm256_srli_epi32(_mm256_add_epi32(r, meio), 16);
+}
+
+static inline __m256i divide8(__m256i i32, __m256i p32)
+{
+    const __m256 um = _mm256_set1_ps(1.f), c255 = _mm256_set1_ps(255.f);
+    __m256 q = _mm256_div_ps(_mm256_cvtepi32_ps(i32), _mm256_cvtepi32_ps(p32));
+    return _mm256_cvtps_epi32(_mm256_mul_ps(_mm256_sub_ps(um, q), c255));
+}
+#endif
+
+void removeLuzDivisaoLinha(const uchar *img, const uchar *padrao, uchar *saida, int n)
+{
+    int x = 0;
+
+#if defined(REMOCAO_LUZ_AVX2)
+    for (; x <= n - 16; x += 16)
+    {
+        __m128i vi = _mm_loadu_si128((const __m128i *)(img + x));
+        __m128i vp = _mm_loadu_si128((const __m128i *)(padrao + x));
+        __m256i r0 = divide8(_mm256_cvtepu8_epi32(vi), _mm256_cvtepu8_epi32(vp));
+        __m256i r1 = divide8(_mm256_cvtepu8_epi32(_mm_srli_si128(vi, 8)), _mm256_cvtepu8_epi32(_mm_srli_si128(vp, 8)));
+
+        // packs trabalha por metade de 128 bits; reordena antes de empacotar para 8 bits
+        __m256i w = _mm256_permute4x64_epi64(_mm256_packs_epi32(r0, r1), _MM_SHUFFLE(3, 1, 2, 0));
+        __m128i b = _mm_packus_epi16(_mm256_castsi256_si128(w), _mm256_extracti128_si256(w, 1));
+        _mm_storeu_si128((__m128i *)(saida + x), b);
+    }
+#elif defined(REMOCAO_LUZ_SSE2)
+    const __m128i zero = _mm_setzero_si128();
+    for (; x <= n - 16; x += 16)
+    {
+        __m128i vi = _mm_loadu_si128((const __m128i *)(img + x));
+        __m128i vp = _mm_loadu_si128((const __m128i *)(padrao + x));
+        __m128i i_lo = _mm_unpacklo_epi8(vi, zero), i_hi = _mm_unpackhi_epi8(vi, zero);
+        __m128i p_lo = _mm_unpacklo_epi8(vp, zero), p_hi = _mm_unpackhi_epi8(vp, zero);
+
+        __m128i r0 = divide4(_mm_unpacklo_epi16(i_lo, zero), _mm_unpacklo_epi16(p_lo, zero));
+        __m128i r1 = divide4(_mm_unpackhi_epi16(i_lo, zero), _mm_unpackhi_epi16(p_lo, zero));
+        __m128i r2 = divide4(_mm_unpacklo_epi16(i_hi, zero), _mm_unpacklo_epi16(p_hi, zero));
+        __m128i r3 = divide4(_mm_unpackhi_epi16(i_hi, zero), _mm_unpackhi_epi16(p_hi, zero));
+
+        // Saturacao: int32 -> int16 -> uint8 (INT_MIN de -inf/NaN vira 0)
+        __m128i b = _mm_packus_epi16(_mm_packs_epi32(r0, r1), _mm_packs_epi32(r2, r3));
+        _mm_storeu_si128((__m128i *)(saida + x), b);
+    }
+#elif defined(REMOCAO_LUZ_NEON)
+    const float32x4_t um = vdupq_n_f32(1.f), c255 = vdupq_n_f32(255.f);
+    for (; x <= n - 16; x += 16)
+    {
+        uint8x16_t vi = vld1q_u8(img + x), vp = vld1q_u8(padrao + x);
+        uint16x8_t i16[2] = {vmovl_u8(vget_low_u8(vi)), vmovl_u8(vget_high_u8(vi))};
+        uint16x8_t p16[2] = {vmovl_u8(vget_low_u8(vp)), vmovl_u8(vget_high_u8(vp))};
+
+        int16x8_t w[2];
+        for (int k = 0; k < 2; k++)
+        {
+            float32x4_t i0 = vcvtq_f32_u32(vmovl_u16(vget_low_u16(i16[k])));
+            float32x4_t i1 = vcvtq_f32_u32(vmovl_u16(vget_high_u16(i16[k])));
+            float32x4_t p0 = vcvtq_f32_u32(vmovl_u16(vget_low_u16(p16[k])));
+            float32x4_t p1 = vcvtq_f32_u32(vmovl_u16(vget_high_u16(p16[k])));
+            int32x4_t r0 = vcvtnq_s32_f32(vmulq_f32(vsubq_f32(um, vdivq_f32(i0, p0)), c255));
+            int32x4_t r1 = vcvtnq_s32_f32(vmulq_f32(vsubq_f32(um, vdivq_f32(i1, p1)), c255));
+            w[k] = vcombine_s16(vqmovn_s32(r0), vqmovn_s32(r1));
+        }
+        vst1q_u8(saida + x, vcombine_u8(vqmovun_s16(w[0]), vqmovun_s16(w[1])));
+    }
+#endif
+
+    for (; x < n; x++)
+        saida[x] = removeLuzPixel(img[x], padrao[x]);
+}
+
+static inline uchar removeLuzReciprocoPixel(uchar i, uchar p, const int *tabela)
+{
+    int d = (int)p - (int)i;
+    if (d <= 0)
+        return 0;
+    // d <= p, entao d * reciproco <= 255 * 2^16 e cabe em 32 bits
+    return (uchar)std::min(255, (d * tabela[p] + (1 << 15)) >> 16);
+}
+
+const int *tabelaReciprocoLuz()
+{
+    // O divisor e um byte: 256 reciprocos servem para qualquer padrao
+    static const vector<int> tabela = []() {
+        vector<int> t(256, 0);
+        for (int p = 1; p < 256; p++)
+            t[p] = (255 * 65536 + p / 2) / p;
+        return t;
+    }();
+    return tabela.data();
+}
+
+void removeLuzReciprocoLinha(const uchar *img, const uchar *padrao, uchar *saida, int n)
+{
+    const int *tabela = tabelaReciprocoLuz();
+    int x = 0;
+
+#if defined(REMOCAO_LUZ_AVX2)
+    for (; x <= n - 16; x += 16)
+    {
+        __m128i vi = _mm_loadu_si128((const __m128i *)(img + x));
+        __m128i vp = _mm_loadu_si128((const __m128i *)(padrao + x));
+        __m256i r0 = reciproco8(_mm256_cvtepu8_epi32(vi), _mm256_cvtepu8_epi32(vp), tabela);
+        __m256i r1 = reciproco8(_mm256_cvtepu8_epi32(_mm_srli_si128(vi, 8)), _mm256_cvtepu8_epi32(_mm_srli_si128(vp, 8)), tabela);
+
+        __m256i w = _mm256_permute4x64_epi64(_mm256_packs_epi32(r0, r1), _MM_SHUFFLE(3, 1, 2, 0));
+        __m128i b = _mm_packus_epi16(_mm256_castsi256_si128(w), _mm256_extracti128_si256(w, 1));
+        _mm_storeu_si128((__m128i *)(saida + x), b);
+    }
+#elif defined(REMOCAO_LUZ_SSE2)
+    const __m128i zero = _mm_setzero_si128();
+    for (; x <= n - 16; x += 16)
+    {
+        __m128i vi = _mm_loadu_si128((const __m128i *)(img + x));
+        __m128i vp = _mm_loadu_si128((const __m128i *)(padrao + x));
+        __m128i i_lo = _mm_unpacklo_epi8(vi, zero), i_hi = _mm_unpackhi_epi8(vi, zero);
+        __m128i p_lo = _mm_unpacklo_epi8(vp, zero), p_hi = _mm_unpackhi_epi8(vp, zero);
+
+        __m128i r0 = reciproco4(_mm_unpacklo_epi16(i_lo, zero), _mm_unpacklo_epi16(p_lo, zero), padrao + x, tabela);
+        __m128i r1 = reciproco4(_mm_unpackhi_epi16(i_lo, zero), _mm_unpackhi_epi16(p_lo, zero), padrao + x + 4, tabela);
+        __m128i r2 = reciproco4(_mm_unpacklo_epi16(i_hi, zero), _mm_unpacklo_epi16(p_hi, zero), padrao + x + 8, tabela);
+        __m128i r3 = reciproco4(_mm_unpackhi_epi16(i_hi, zero), _mm_unpackhi_epi16(p_hi, zero), padrao + x + 12, tabela);
+
+        __m128i b = _mm_packus_epi16(_mm_packs_epi32(r0, r1), _mm_packs_epi32(r2, r3));
+        _mm_storeu_si128((__m128i *)(saida + x), b);
+    }
+#elif defined(REMOCAO_LUZ_NEON)
+    const int16x8_t zero = vdupq_n_s16(0);
+    for (; x <= n - 16; x += 16)
+    {
+        uint8x16_t vi = vld1q_u8(img + x), vp = vld1q_u8(padrao + x);
+        int16x8_t d16[2] = {vreinterpretq_s16_u16(vsubl_u8(vget_low_u8(vp), vget_low_u8(vi))),
+                            vreinterpretq_s16_u16(vsubl_u8(vget_high_u8(vp), vget_high_u8(vi)))};
+
+        uint16x8_t w[2];
+        for (int k = 0; k < 2; k++)
+        {
+            uint16x8_t d = vreinterpretq_u16_s16(vmaxq_s16(d16[k], zero));
+            const uchar *p = padrao + x + 8 * k;
+            const uint32_t rec[8] = {(uint32_t)tabela[p[0]], (uint32_t)tabela[p[1]], (uint32_t)tabela[p[2]], (uint32_t)tabela[p[3]],
+                                     (uint32_t)tabela[p[4]], (uint32_t)tabela[p[5]], (uint32_t)tabela[p[6]], (uint32_t)tabela[p[7]]};
+            // vrshrq soma 2^15 antes de deslocar, o mesmo arredondamento da versao escalar
+            uint32x4_t r0 = vrshrq_n_u32(vmulq_u32(vmovl_u16(vget_low_u16(d)), vld1q_u32(rec)), 16);
+            uint32x4_t r1 = vrshrq_n_u32(vmulq_u32(vmovl_u16(vget_high_u16(d)), vld1q_u32(rec + 4)), 16);
+            w[k] = vcombine_u16(vqmovn_u32(r0), vqmovn_u32(r1));
+        }
+        vst1q_u8(saida + x, vcombine_u8(vqmovn_u16(w[0]), vqmovn_u16(w[1])));
+    }
+#endif
+
+    for (; x < n; x++)
+        saida[x] = removeLuzReciprocoPixel(img[x], padrao[x], tabela);
+}
+
+void removeLuzReciproco(const Mat &img, const Mat &padrao, Mat &saida)
+{
+    CV_Assert(img.type() == CV_8UC1 && padrao.type() == CV_8UC1 && img.size() == padrao.size());
+
+    saida.create(img.size(), CV_8UC1);
+
+    parallel_for_(Range(0, img.rows), [&](const Range &faixa) {
+        for (int y = faixa.start; y < faixa.end; y++)
+            removeLuzReciprocoLinha(img.ptr<uchar>(y), padrao.ptr<uchar>(y), saida.ptr<uchar>(y), img.cols);
+    });
+}
+
+void removeLuzDivisao(const Mat &img, const Mat &padrao, Mat &saida)
+{
+    CV_Assert(img.type() == CV_8UC1 && padrao.type() == CV_8UC1 && img.size() == padrao.size());
+
+    saida.create(img.size(), CV_8UC1);
+
+    parallel_for_(Range(0, img.rows), [&](const Range &faixa) {
+        for (int y = faixa.start; y < faixa.end; y++)
+            removeLuzDivisaoLinha(img.ptr<uchar>(y), padrao.ptr<uchar>(y), saida.ptr<uchar>(y), img.cols);
+    });
+}
@@ -0,0 +1,64 @@
+/**
+ * Remocao de luz por divisao
+ *
+ * Kernel fundido 8 bits -> 8 bits para resultado = 255 * (1 - img / padrao),
+ * sem as imagens temporarias em float do caminho original. Usa AVX2, SSE2
+ * ou NEON (AArch64) quando disponiveis e cai para uma versao escalar.
+ *
+ * O calculo e feito nos registradores com as mesmas operacoes em float
+ * do caminho antigo (divisao, subtracao, multiplicacao, arredondamento
+ * para o par mais proximo e saturacao), entao o resultado e identico bit
+ * a bit ao de convertTo/divide do OpenCV. Onde o padrao vale 0 a saida e 0,
+ * como ja acontecia com -inf/NaN saturados.
+ *
+ */
+
+#ifndef REMOCAO_LUZ_h
+#define REMOCAO_LUZ_h
+
+// OpenCV includes
+#include "opencv2/core.hpp"
+using namespace cv;
+
+/**
+ * Processa uma linha de n pixels
+ * @param const uchar* img - linha da imagem
+ * @param const uchar* padrao - linha do padrao de luz
+ * @param uchar* saida - linha de saida (pode ser a mesma memoria de img)
+ * @param int n - numero de pixels
+ */
+void removeLuzDivisaoLinha(const uchar *img, const uchar *padrao, uchar *saida, int n);
+
+/**
+ * Remove o padrao de luz por divisao em uma unica passada, em paralelo por faixas de linhas
+ * @param Mat img - imagem CV_8UC1
+ * @param Mat padrao - padrao de luz CV_8UC1 do mesmo tamanho
+ * @param Mat saida - imagem CV_8UC1 sem luz de fundo
+ */
+void removeLuzDivisao(const Mat &img, const Mat &padrao, Mat &saida);
+
+/**
+ * Reciproco em ponto fixo de cada valor do padrao: round(255 * 2^16 / p), 0 para p = 0
+ * @return const int* - tabela de 256 entradas indexada pelo byte do padrao
+ */
+const int *tabelaReciprocoLuz();
+
+/**
+ * Versao aproximada da divisao: so multiplicacao inteira e deslocamento,
+ * saida = ((padrao - img) * tabelaReciprocoLuz()[padrao] + 2^15) >> 16.
+ *
+ * Nao e identica bit a bit ao caminho em float: difere em no maximo 1 nivel
+ * de cinza em 268 dos 65536 pares (img, padrao), todos em empates perto de x.5.
+ * So e usada quando pedida explicitamente (LUZ_DIVISAO_RECIPROCO).
+ */
+void removeLuzReciprocoLinha(const uchar *img, const uchar *padrao, uchar *saida, int n);
+
+/**
+ * Remove o padrao de luz pela divisao aproximada com a tabela de reciprocos
+ * @param Mat img - imagem CV_8UC1
+ * @param Mat padrao - padrao de luz CV_8UC1 do mesmo tamanho
+ * @param Mat saida - imagem CV_8UC1 sem luz de fundo
+ */
+void removeLuzReciproco(const Mat &img, const Mat &padrao, Mat &saida);
+
+#endif
@@ -0,0 +1,28 @@
+/**
+ * Numero de threads do OpenCV em trechos que paralelizam por conta propria
+ *
+ * O lote, o dataset, o corpus e a busca de parametros usam uma thread por
+ * item e desligam o paralelismo interno do OpenCV enquanto rodam; o guarda
+ * devolve o valor anterior mesmo se o trecho terminar com excecao.
+ *
+ */
+
+#ifndef THREADS_OPENCV_h
+#define THREADS_OPENCV_h
+
+// OpenCV includes
+#include "opencv2/core.hpp"
+#include "opencv2/core/utility.hpp"
+using namespace cv;
+
+/**
+ * Restaura o numero de threads do OpenCV na saida do escopo, mesmo com excecao
+ */
+struct RestauraThreadsOpenCV
+{
+    int anterior;
+    RestauraThreadsOpenCV() : anterior(getNumThreads()) {}
+    ~RestauraThreadsOpenCV() { setNumThreads(anterior); }
+};
+
+#endif